@@ -1,5 +1,6 @@
 #include <stdlib.h>
 
+#include "libblast.h"
 #include "utils.h"
 
 // 802A5E10 (061650)
@@ -284,6 +285,28 @@ int decode_block6(unsigned char *in, int length, unsigned char *out)
    return len;
 }
 
+int blast_decode(unsigned char *in, int in_len, int type, unsigned char *out, unsigned char *lut)
+{
+   int out_len = 0;
+   switch (type) {
+      // a0 - input buffer
+      // a1 - input length
+      // a2 - type (always unused)
+      // a3 - output buffer
+      // t4 - blocks 4 & 5 reference t4 which is set to FP
+      case 0: out_len = decode_block0(in, in_len, out); break;
+      case 1: out_len = decode_block1(in, in_len, out); break;
+      case 2: out_len = decode_block2(in, in_len, out); break;
+      // TODO: need to figure out where last param is set for decoders 4 and 5
+      case 4: out_len = decode_block4(in, in_len, out, lut); break;
+      case 5: out_len = decode_block5(in, in_len, out, lut); break;
+      case 3: out_len = decode_block3(in, in_len, out); break;
+      case 6: out_len = decode_block6(in, in_len, out); break;
+      default: ERROR("Unknown Blast type %d\n", type); break;
+   }
+   return out_len;
+}
+
 int blast_decode_file(char *in_filename, int type, char *out_filename, unsigned char *lut)
 {
    unsigned char *in_buf = NULL;
@@ -299,28 +322,13 @@ int blast_decode_file(char *in_filename, int type, char *out_filename, unsigned
    }
 
    // estimate worst case size
-   out_buf = malloc(100*in_len);
+   out_buf = malloc(BLAST_MAX_RATIO*in_len);
    if (out_buf == NULL) {
       ret_val = 2;
       goto free_all;
    }
 
-   switch (type) {
-      // a0 - input buffer
-      // a1 - input length
-      // a2 - type (always unused)
-      // a3 - output buffer
-      // t4 - blocks 4 & 5 reference t4 which is set to FP
-      case 0: out_len = decode_block0(in_buf, in_len, out_buf); break;
-      case 1: out_len = decode_block1(in_buf, in_len, out_buf); break;
-      case 2: out_len = decode_block2(in_buf, in_len, out_buf); break;
-      // TODO: need to figure out where last param is set for decoders 4 and 5
-      case 4: out_len = decode_block4(in_buf, in_len, out_buf, lut); break;
-      case 5: out_len = decode_block5(in_buf, in_len, out_buf, lut); break;
-      case 3: out_len = decode_block3(in_buf, in_len, out_buf); break;
-      case 6: out_len = decode_block6(in_buf, in_len, out_buf); break;
-      default: ERROR("Unknown Blast type %d\n", type); break;
-   }
+   out_len = blast_decode(in_buf, in_len, type, out_buf, lut);
 
    write_len = write_file(out_filename, out_buf, out_len);
    if (write_len != out_len) {
@@ -495,7 +503,7 @@ int main(int argc, char *argv[])
    if (argc < 2) return 1;
 
    // read in Blast Corps ROM
-   size = read_file(argv[1], &data);
+   size = map_file(argv[1], &data);
 
    // loop through from 0x4CE0 to 0xCCE0
    for (off = ROM_OFFSET; off < END_OFFSET; off += 8) {
@@ -603,7 +611,7 @@ int main(int argc, char *argv[])
       }
    }
 
-   free(data);
+   unmap_file(data, size);
 
    return 0;
 }
@@ -32,10 +32,11 @@ typedef enum
    TYPE_SM64_LEVEL,
 } section_type;
 
+// strings in the config are never NULL, empty if not set
 typedef struct _label
 {
    unsigned int ram_addr;
-   char name[2048];
+   const char *name;
 } label;
 
 typedef struct _texture
@@ -50,12 +51,12 @@ typedef struct _texture
 
 typedef struct _split_section
 {
-   char label[512];
+   const char *label;
    unsigned int start;
    unsigned int end;
    unsigned int vaddr;
    section_type type;
-   char section_name[512];
+   const char *section_name;
 
    int subtype;
 
@@ -66,6 +67,13 @@ typedef struct _split_section
    int child_count;
 } split_section;
 
+// section address index entry, sorted by address then section number
+typedef struct _section_index
+{
+   unsigned int addr;
+   int section;
+} section_index;
+
 typedef struct _rom_config
 {
    char name[128];
@@ -77,15 +85,50 @@ typedef struct _rom_config
    split_section *sections;
    int section_count;
 
+   // built by config_index_sections()
+   section_index *start_index;
+   section_index *end_index;
+
    label *labels;
    int label_count;
+
+   // storage for strings parsed from YAML
+   struct _string_block *strings;
+   // compiled config the strings point into, see config_load()
+   unsigned char *mapped;
+   long mapped_len;
 } rom_config;
 
 int config_parse_file(const char *filename, rom_config *config);
+
+// load config from the compiled config next to YAML 'filename' if it is up to date, otherwise parse the YAML
+// compiled configs are mapped and their strings used in place
+// returns 1 if loaded from compiled config, 0 if parsed from YAML, negative on error
+int config_load(const char *filename, rom_config *config);
+
+// write compiled config for YAML 'filename', used by config_load() until the YAML file changes
+// config: validated config parsed from 'filename'
+// returns 0 on success
+int config_compile(const char *filename, const rom_config *config);
+
+// read only the top-level checksum1 and checksum2 values, stopping once both are found
+// much faster than config_parse_file() for checking if a config matches a ROM
+// returns 0 if both were found, -1 otherwise
+int config_read_checksums(const char *filename, unsigned int *checksum1, unsigned int *checksum2);
 void config_print(const rom_config *config);
 int config_validate(const rom_config *config, unsigned int max_len);
 void config_free(rom_config *config);
 
+// build sorted start and end address indexes of the sections
+// must be rebuilt if section addresses change (config_validate() may adjust them)
+void config_index_sections(rom_config *config);
+
+// find section starting or ending at address
+// addr: ROM address to look up
+// is_end: 0 to match section start, 1 to match section end
+// returns index of first section in config order that matches or -1 if none
+int config_find_section(const rom_config *config, unsigned int addr, int is_end);
+
 section_type config_str2section(const char *type_name);
 const char *config_section2str(section_type section);
 
@@ -292,7 +292,7 @@ int main(int argc, char *argv[])
    }
 
    // operation
-   size = read_file(config.in_filename, &data);
+   size = map_file(config.in_filename, &data);
    if (size < 0) {
       perror("Error opening input file");
       return EXIT_FAILURE;
@@ -321,7 +321,7 @@ int main(int argc, char *argv[])
       }
    }
 
-   free(data);
+   unmap_file(data, size);
    if (fout != stdout) {
       fclose(fout);
    }
@@ -180,12 +180,12 @@ static void generate_material_file(arg_config *config, char *mtl_filename, char
    ia   *ia_img;
    unsigned char *img_raw = NULL;
    unsigned char *rom = NULL;
-   long rom_size;
+   long rom_size = 0;
    unsigned int segment;
    unsigned int offset;
    int i;
    if (config->blast_corps_rom != NULL) {
-      rom_size = read_file(config->blast_corps_rom, &rom);
+      rom_size = map_file(config->blast_corps_rom, &rom);
       if (rom_size < 0) {
          perror("Error opening ROM file");
          exit(EXIT_FAILURE);
@@ -291,7 +291,7 @@ static void generate_material_file(arg_config *config, char *mtl_filename, char
       }
    }
    if (rom != NULL) {
-      free(rom);
+      unmap_file(rom, rom_size);
       free(img_raw);
    }
 }
@@ -1,6 +1,9 @@
 #ifndef LIBBLAST_H_
 #define LIBBLAST_H_
 
+// worst case ratio of uncompressed to compressed size
+#define BLAST_MAX_RATIO 100
+
 // 802A5E10 (061650)
 // just a memcpy from a0 to a3
 int decode_block0(unsigned char *in, int length, unsigned char *out);
@@ -23,6 +26,15 @@ int decode_block5(unsigned char *in, int length, unsigned char *out, unsigned ch
 // 802A5958 (061198)
 int decode_block6(unsigned char *in, int length, unsigned char *out);
 
+// decode Blast Corps compressed data of given type in memory
+// in - compressed data
+// in_len - length of 'in'
+// type - type of compression: 0-6
+// out - output buffer, at least BLAST_MAX_RATIO * in_len bytes
+// lut - lookup table to use for types 4 and 5
+// returns length of uncompressed data written to 'out'
+int blast_decode(unsigned char *in, int in_len, int type, unsigned char *out, unsigned char *lut);
+
 // decode Blast Corps compressed data of given type
 // in_filename - input file name of compressed data
 // type - type of compression: 0-6
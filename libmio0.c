@@ -7,50 +7,97 @@
 
 // defines
 
-#define MIO0_VERSION "0.1"
+#define MIO0_VERSION "0.2"
 
 #define GET_BIT(buf, bit) ((buf)[(bit) / 8] & (1 << (7 - ((bit) % 8))))
 
+// match finder parameters
+#define MIO0_MIN_MATCH 3    // shortest encodable match
+#define MIO0_MAX_MATCH 18   // longest encodable match
+#define HASH_BITS      16
+#define HASH_SIZE      (1 << HASH_BITS)
+#define FAST_DEPTH     32   // candidates checked per position in fast mode
+
+// encoded size of each token in bits, including its control bit
+#define LITERAL_BITS   (1 + 8)
+#define MATCH_BITS     (1 + 16)
+
 // types
+
+// hash chain match finder
+// positions with the same 3-byte hash are chained from newest to oldest. consecutive chain entries
+// sharing their first MIO0_MAX_MATCH bytes form a group: every member of a group produces the same
+// match length, so a group is checked once and only its oldest member inside the window is kept.
+// this keeps runs of zeros and repeated tiles from degrading into a scan of the entire window
 typedef struct
 {
-   int *indexes;
-   int allocated;
-   int count;
-   int start;
-} lookback;
+   const unsigned char *buf;
+   int length;
+   int inserted;    // positions [0, inserted) have been added
+   int *head;       // newest position for each hash
+   int *prev;       // next older position with the same hash
+   int *group;      // oldest position of the group each position belongs to
+   int *group_next; // next newer position in the same group
+   int *group_tail; // oldest member of group still in the window, indexed by group
+} match_finder;
 
 // functions
-#define LOOKBACK_COUNT 256
-#define LOOKBACK_INIT_SIZE 128
-static lookback *lookback_init(void)
+static void match_finder_init(match_finder *mf, const unsigned char *buf, int length)
 {
-   lookback *lb = malloc(LOOKBACK_COUNT * sizeof(*lb));
-   for (int i = 0; i < LOOKBACK_COUNT; i++) {
-      lb[i].allocated = LOOKBACK_INIT_SIZE;
-      lb[i].indexes = malloc(lb[i].allocated * sizeof(*lb[i].indexes));
-      lb[i].count = 0;
-      lb[i].start = 0;
-   }
-   return lb;
+   mf->buf = buf;
+   mf->length = length;
+   mf->inserted = 0;
+   mf->head = malloc(HASH_SIZE * sizeof(*mf->head));
+   mf->prev = malloc(length * sizeof(*mf->prev));
+   mf->group = malloc(length * sizeof(*mf->group));
+   mf->group_next = malloc(length * sizeof(*mf->group_next));
+   mf->group_tail = malloc(length * sizeof(*mf->group_tail));
+   for (int i = 0; i < HASH_SIZE; i++) {
+      mf->head[i] = -1;
+   }
 }
 
-static void lookback_free(lookback *lb)
+static void match_finder_free(match_finder *mf)
 {
-   for (int i = 0; i < LOOKBACK_COUNT; i++) {
-      free(lb[i].indexes);
-   }
-   free(lb);
+   free(mf->head);
+   free(mf->prev);
+   free(mf->group);
+   free(mf->group_next);
+   free(mf->group_tail);
+}
+
+static inline unsigned int hash3(const unsigned char *buf)
+{
+   unsigned int val = (buf[0] << 16) | (buf[1] << 8) | buf[2];
+   return (val * 2654435761u) >> (32 - HASH_BITS);
 }
 
-static inline void lookback_push(lookback *lkbk, unsigned char val, int index)
+// add all positions before 'offset' to the hash chains
+static void match_finder_insert(match_finder *mf, int offset)
 {
-   lookback *lb = &lkbk[val];
-   if (lb->count == lb->allocated) {
-      lb->allocated *= 4;
-      lb->indexes = realloc(lb->indexes, lb->allocated * sizeof(*lb->indexes));
+   const unsigned char *buf = mf->buf;
+   for (int pos = mf->inserted; pos < offset; pos++) {
+      mf->group[pos] = pos;
+      mf->group_next[pos] = -1;
+      mf->group_tail[pos] = pos;
+      if (pos + MIO0_MIN_MATCH > mf->length) {
+         mf->prev[pos] = -1;
+         continue;
+      }
+      unsigned int h = hash3(&buf[pos]);
+      int cand = mf->head[h];
+      mf->prev[pos] = cand;
+      // join the newest group in the chain if it starts with the same bytes
+      if (cand >= 0 && pos + MIO0_MAX_MATCH <= mf->length &&
+          !memcmp(&buf[cand], &buf[pos], MIO0_MAX_MATCH)) {
+         mf->group[pos] = mf->group[cand];
+         mf->group_next[cand] = pos;
+      }
+      mf->head[h] = pos;
+   }
+   if (offset > mf->inserted) {
+      mf->inserted = offset;
    }
-   lb->indexes[lb->count++] = index;
 }
 
 static void PUT_BIT(unsigned char *buf, int bit, int val)
@@ -61,21 +108,23 @@ static void PUT_BIT(unsigned char *buf, int bit, int val)
 }
 
 // used to find longest matching stream in buffer
-// buf: buffer
+// mf: match finder containing buffer to search in
 // start_offset: offset in buf to look back from
 // max_search: max number of bytes to find
 // found_offset: returned offset found (0 if none found)
+// mode: in exact mode, ties go to the farthest offset like a full window scan would
+//       otherwise the nearest offset wins and the search stops at max_search
+//       fast mode additionally limits the number of candidates checked
 // returns max length of matching stream (0 if none found)
-static int find_longest(const unsigned char *buf, int start_offset, int max_search, int *found_offset, lookback *lkbk)
+static int find_longest(match_finder *mf, int start_offset, int max_search, int *found_offset, mio0_encode_mode mode)
 {
+   const unsigned char *buf = mf->buf;
+   const unsigned char *start = &buf[start_offset];
    int best_length = 0;
    int best_offset = 0;
-   int cur_length;
-   int search_len;
-   int farthest, off, i;
-   int lb_idx;
-   const unsigned char first = buf[start_offset];
-   lookback *lb = &lkbk[first];
+   int depth = 0;
+   int farthest;
+   int off;
 
    // buf
    //  |    off        start                  max
@@ -84,36 +133,49 @@ static int find_longest(const unsigned char *buf, int start_offset, int max_sear
    //        |+i->       |      |+i->
    //                       +cur_length
 
+   match_finder_insert(mf, start_offset);
+   if (max_search < MIO0_MIN_MATCH) {
+      *found_offset = 0;
+      return 0;
+   }
+
    // check at most the past 4096 values
-   farthest = MAX(start_offset - 4096, 0);
-   // find starting index
-   for (lb_idx = lb->start; lb_idx < lb->count && lb->indexes[lb_idx] < farthest; lb_idx++) {}
-   lb->start = lb_idx;
-   for ( ; lb_idx < lb->count && lb->indexes[lb_idx] < start_offset; lb_idx++) {
-      off = lb->indexes[lb_idx];
-      // check at most requested max or up until start
-      search_len = MIN(max_search, start_offset - off);
-      for (i = 0; i < search_len; i++) {
-         if (buf[start_offset + i] != buf[off + i]) {
+   farthest = MAX(start_offset - MIO0_WINDOW, 0);
+   off = mf->head[hash3(start)];
+   while (off >= farthest) {
+      int cur_length;
+      int group = mf->group[off];
+      int tail = mf->group_tail[group];
+      // matches may overlap start: decoder copies bytes it has just written
+      for (cur_length = 0; cur_length < max_search; cur_length++) {
+         if (start[cur_length] != buf[off + cur_length]) {
             break;
          }
       }
-      cur_length = i;
-      // if matched up until start, continue matching in already matched parts
-      if (cur_length == search_len) {
-         // check at most requested max less current length
-         search_len = max_search - cur_length;
-         for (i = 0; i < search_len; i++) {
-            if (buf[start_offset + cur_length + i] != buf[off + i]) {
+      // drop group members that fell out of the window
+      while (tail < farthest) {
+         tail = mf->group_next[tail];
+      }
+      mf->group_tail[group] = tail;
+      if (cur_length >= MIO0_MIN_MATCH) {
+         if (mode == MIO0_ENCODE_EXACT) {
+            if (cur_length >= best_length) {
+               // every group member has the same length, oldest one wins
+               best_offset = start_offset - tail;
+               best_length = cur_length;
+            }
+         } else if (cur_length > best_length) {
+            best_offset = start_offset - off;
+            best_length = cur_length;
+            if (best_length == max_search) {
                break;
             }
          }
-         cur_length += i;
       }
-      if (cur_length > best_length) {
-         best_offset = start_offset - off;
-         best_length = cur_length;
+      if (mode == MIO0_ENCODE_FAST && ++depth >= FAST_DEPTH) {
+         break;
       }
+      off = mf->prev[tail];
    }
 
    // return best reverse offset and length (may be 0)
@@ -121,6 +183,41 @@ static int find_longest(const unsigned char *buf, int start_offset, int max_sear
    return best_length;
 }
 
+// find the sequence of literals and matches with the smallest encoded size
+// all matches cost the same regardless of length or offset, and any prefix of a match is also a
+// match, so only the longest match at each position needs to be considered
+// mf: match finder containing buffer to parse
+// length: length of buffer
+// match_len: returned length of match to emit at each position (0 for literal)
+// match_off: returned offset of match to emit at each position
+static void optimal_parse(match_finder *mf, int length, int *match_len, int *match_off)
+{
+   unsigned int *cost = malloc((length + 1) * sizeof(*cost));
+
+   // first byte is always a literal
+   match_len[0] = 0;
+   for (int i = 1; i < length; i++) {
+      match_len[i] = find_longest(mf, i, MIN(length - i, MIO0_MAX_MATCH), &match_off[i], MIO0_ENCODE_OPTIMAL);
+   }
+
+   // cost[i] is the minimum number of bits to encode everything from i to the end
+   cost[length] = 0;
+   for (int i = length - 1; i > 0; i--) {
+      unsigned int best_cost = cost[i + 1] + LITERAL_BITS;
+      int best_len = 0;
+      for (int len = match_len[i]; len >= MIO0_MIN_MATCH; len--) {
+         if (cost[i + len] + MATCH_BITS < best_cost) {
+            best_cost = cost[i + len] + MATCH_BITS;
+            best_len = len;
+         }
+      }
+      cost[i] = best_cost;
+      match_len[i] = best_len;
+   }
+
+   free(cost);
+}
+
 // decode MIO0 header
 // returns 1 if valid header, 0 otherwise
 int mio0_decode_header(const unsigned char *buf, mio0_header_t *head)
@@ -145,10 +242,11 @@ void mio0_encode_header(unsigned char *buf, const mio0_header_t *head)
 int mio0_decode(const unsigned char *in, unsigned char *out, unsigned int *end)
 {
    mio0_header_t head;
-   unsigned int bytes_written = 0;
-   int bit_idx = 0;
-   int comp_idx = 0;
-   int uncomp_idx = 0;
+   const unsigned char *ctrl;
+   const unsigned char *comp;
+   const unsigned char *uncomp;
+   unsigned char *dst = out;
+   unsigned char *dst_end;
    int valid;
 
    // extract header
@@ -157,39 +255,151 @@ int mio0_decode(const unsigned char *in, unsigned char *out, unsigned int *end)
    if (!valid) {
       return -2;
    }
-
-   // decode data
-   while (bytes_written < head.dest_size) {
-      if (GET_BIT(&in[MIO0_HEADER_LENGTH], bit_idx)) {
-         // 1 - pull uncompressed data
-         out[bytes_written] = in[head.uncomp_offset + uncomp_idx];
-         bytes_written++;
-         uncomp_idx++;
-      } else {
-         // 0 - read compressed data
-         int idx;
-         int length;
-         int i;
-         const unsigned char *vals = &in[head.comp_offset + comp_idx];
-         comp_idx += 2;
-         length = ((vals[0] & 0xF0) >> 4) + 3;
-         idx = ((vals[0] & 0x0F) << 8) + vals[1] + 1;
-         for (i = 0; i < length; i++) {
-            out[bytes_written] = out[bytes_written - idx];
-            bytes_written++;
+   ctrl = &in[MIO0_HEADER_LENGTH];
+   comp = &in[head.comp_offset];
+   uncomp = &in[head.uncomp_offset];
+   dst_end = out + head.dest_size;
+
+   // decode data, 8 control bits at a time
+   while (dst < dst_end) {
+      unsigned int bits = *ctrl++;
+      // all literals: copy 8 bytes at once
+      if (bits == 0xFF && dst_end - dst >= 8) {
+         memcpy(dst, uncomp, 8);
+         dst += 8;
+         uncomp += 8;
+         continue;
+      }
+      for (int b = 0; b < 8 && dst < dst_end; b++, bits <<= 1) {
+         if (bits & 0x80) {
+            // 1 - pull uncompressed data
+            *dst++ = *uncomp++;
+         } else {
+            // 0 - read compressed data
+            int length = ((comp[0] & 0xF0) >> 4) + 3;
+            int idx = ((comp[0] & 0x0F) << 8) + comp[1] + 1;
+            comp += 2;
+            if (idx >= length) {
+               // source and destination don't overlap
+               memcpy(dst, dst - idx, length);
+            } else if (idx == 1) {
+               // run of a single byte
+               memset(dst, dst[-1], length);
+            } else {
+               // overlapping copy repeats bytes just written
+               for (int i = 0; i < length; i++) {
+                  dst[i] = dst[i - idx];
+               }
+            }
+            dst += length;
          }
       }
-      bit_idx++;
    }
 
    if (end) {
-      *end = head.uncomp_offset + uncomp_idx;
+      *end = uncomp - in;
    }
 
-   return bytes_written;
+   return dst - out;
+}
+
+void mio0_stream_init(mio0_stream *st)
+{
+   memset(st, 0, sizeof(*st));
+}
+
+void mio0_stream_feed(mio0_stream *st, const unsigned char *in, unsigned int in_len)
+{
+   st->in = in;
+   st->in_len = in_len;
 }
 
-int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out)
+int mio0_stream_drain(mio0_stream *st, unsigned char *out, unsigned int out_len)
+{
+   mio0_header_t *head = &st->head;
+   unsigned int count = 0;
+
+   if (!st->have_header) {
+      if (st->in_len < MIO0_HEADER_LENGTH) {
+         return MIO0_STREAM_NEED_INPUT;
+      }
+      if (!mio0_decode_header(st->in, head)) {
+         return MIO0_STREAM_ERROR;
+      }
+      // sections must be in order: control bits, compressed, uncompressed
+      if (head->comp_offset < MIO0_HEADER_LENGTH || head->uncomp_offset < head->comp_offset) {
+         return MIO0_STREAM_ERROR;
+      }
+      st->have_header = 1;
+   }
+
+   while (count < out_len) {
+      unsigned char val;
+      if (st->match_remaining == 0) {
+         unsigned int ctrl_offset;
+         if (st->bytes_written >= head->dest_size) {
+            break;
+         }
+         ctrl_offset = MIO0_HEADER_LENGTH + st->bit_idx / 8;
+         if (ctrl_offset >= head->comp_offset) {
+            return MIO0_STREAM_ERROR;
+         }
+         if (ctrl_offset >= st->in_len) {
+            break;
+         }
+         if (GET_BIT(&st->in[MIO0_HEADER_LENGTH], st->bit_idx)) {
+            // 1 - pull uncompressed data
+            unsigned int offset = head->uncomp_offset + st->uncomp_idx;
+            if (offset >= st->in_len) {
+               break;
+            }
+            val = st->in[offset];
+            st->uncomp_idx++;
+            st->bit_idx++;
+         } else {
+            // 0 - read compressed data
+            unsigned int offset = head->comp_offset + st->comp_idx;
+            const unsigned char *vals;
+            if (offset + 2 > head->uncomp_offset) {
+               return MIO0_STREAM_ERROR;
+            }
+            if (offset + 2 > st->in_len) {
+               break;
+            }
+            vals = &st->in[offset];
+            st->match_remaining = ((vals[0] & 0xF0) >> 4) + 3;
+            st->match_dist = ((vals[0] & 0x0F) << 8) + vals[1] + 1;
+            // back-references must stay within data already written and the output size
+            if (st->match_dist > st->bytes_written ||
+                st->bytes_written + st->match_remaining > head->dest_size) {
+               return MIO0_STREAM_ERROR;
+            }
+            st->comp_idx += 2;
+            st->bit_idx++;
+            continue;
+         }
+      } else {
+         // copy from window, which may include bytes just written by this match
+         val = st->window[(st->bytes_written - st->match_dist) % MIO0_WINDOW];
+         st->match_remaining--;
+      }
+      st->window[st->bytes_written % MIO0_WINDOW] = val;
+      st->bytes_written++;
+      out[count++] = val;
+   }
+
+   if (count == 0 && out_len > 0 && st->bytes_written < head->dest_size) {
+      return MIO0_STREAM_NEED_INPUT;
+   }
+   return count;
+}
+
+unsigned int mio0_stream_in_end(const mio0_stream *st)
+{
+   return st->head.uncomp_offset + st->uncomp_idx;
+}
+
+int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out, mio0_encode_mode mode)
 {
    unsigned char *bit_buf;
    unsigned char *comp_buf;
@@ -202,10 +412,19 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    int bit_idx = 0;
    int comp_idx = 0;
    int uncomp_idx = 0;
-   lookback *lookbacks;
-
-   // initialize lookback buffer
-   lookbacks = lookback_init();
+   int *match_len = NULL;
+   int *match_off = NULL;
+   match_finder finder;
+
+   // initialize match finder
+   match_finder_init(&finder, in, length);
+
+   // optimal parse chooses all tokens up front
+   if (mode == MIO0_ENCODE_OPTIMAL) {
+      match_len = malloc(length * sizeof(*match_len));
+      match_off = malloc(length * sizeof(*match_off));
+      optimal_parse(&finder, length, match_len, match_off);
+   }
 
    // allocate some temporary buffers worst case size
    bit_buf = malloc((length + 7) / 8); // 1-bit/byte
@@ -215,22 +434,28 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
 
    // encode data
    // special case for first byte
-   lookback_push(lookbacks, in[0], 0);
    uncomp_buf[uncomp_idx] = in[0];
    uncomp_idx += 1;
    bytes_proc += 1;
    PUT_BIT(bit_buf, bit_idx++, 1);
    while (bytes_proc < length) {
       int offset;
-      int max_length = MIN(length - bytes_proc, 18);
-      int longest_match = find_longest(in, bytes_proc, max_length, &offset, lookbacks);
-      // push current byte before checking next longer match
-      lookback_push(lookbacks, in[bytes_proc], bytes_proc);
+      int longest_match;
+      if (mode == MIO0_ENCODE_OPTIMAL) {
+         longest_match = match_len[bytes_proc];
+         offset = match_off[bytes_proc];
+      } else {
+         int max_length = MIN(length - bytes_proc, 18);
+         longest_match = find_longest(&finder, bytes_proc, max_length, &offset, mode);
+      }
       if (longest_match > 2) {
          int lookahead_offset;
+         int lookahead_match = 0;
          // lookahead to next byte to see if longer match
-         int lookahead_length = MIN(length - bytes_proc - 1, 18);
-         int lookahead_match = find_longest(in, bytes_proc + 1, lookahead_length, &lookahead_offset, lookbacks);
+         if (mode != MIO0_ENCODE_OPTIMAL) {
+            int lookahead_length = MIN(length - bytes_proc - 1, 18);
+            lookahead_match = find_longest(&finder, bytes_proc + 1, lookahead_length, &lookahead_offset, mode);
+         }
          // better match found, use uncompressed + lookahead compressed
          if ((longest_match + 1) < lookahead_match) {
             // uncompressed byte
@@ -241,11 +466,6 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
             longest_match = lookahead_match;
             offset = lookahead_offset;
             bit_idx++;
-            lookback_push(lookbacks, in[bytes_proc], bytes_proc);
-         }
-         // first byte already pushed above
-         for (int i = 1; i < longest_match; i++) {
-            lookback_push(lookbacks, in[bytes_proc + i], bytes_proc + i);
          }
          // compressed block
          comp_buf[comp_idx] = (((longest_match - 3) & 0x0F) << 4) |
@@ -279,6 +499,8 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    write_u32_be(&out[12], uncomp_offset);
    // output data
    memcpy(&out[MIO0_HEADER_LENGTH], bit_buf, bit_length);
+   // zero alignment padding so output doesn't depend on prior contents of 'out'
+   memset(&out[MIO0_HEADER_LENGTH + bit_length], 0, comp_offset - (MIO0_HEADER_LENGTH + bit_length));
    memcpy(&out[comp_offset], comp_buf, comp_idx);
    memcpy(&out[uncomp_offset], uncomp_buf, uncomp_idx);
 
@@ -286,14 +508,19 @@ int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out
    free(bit_buf);
    free(comp_buf);
    free(uncomp_buf);
-   lookback_free(lookbacks);
+   if (match_len) {
+      free(match_len);
+      free(match_off);
+   }
+   match_finder_free(&finder);
 
    return bytes_written;
 }
 
 int mio0_decode_file(const char *in_file, unsigned long offset, const char *out_file)
 {
-   mio0_header_t head;
+#define DECODE_CHUNK_SIZE (64*1024)
+   mio0_stream stream;
    FILE *in;
    FILE *out;
    unsigned char *in_buf = NULL;
@@ -303,7 +530,6 @@ int mio0_decode_file(const char *in_file, unsigned long offset, const char *out_
    size_t bytes_read;
    int bytes_decoded;
    int bytes_written;
-   int valid;
 
    in = fopen(in_file, "rb");
    if (in == NULL) {
@@ -313,6 +539,10 @@ int mio0_decode_file(const char *in_file, unsigned long offset, const char *out_
    // allocate buffer to read from offset to end of file
    fseek(in, 0, SEEK_END);
    file_size = ftell(in);
+   if ((long)offset > file_size) {
+      ret_val = 3;
+      goto free_all;
+   }
    in_buf = malloc(file_size - offset);
    fseek(in, offset, SEEK_SET);
 
@@ -324,15 +554,10 @@ int mio0_decode_file(const char *in_file, unsigned long offset, const char *out_
    }
 
    // verify header
-   valid = mio0_decode_header(in_buf, &head);
-   if (!valid) {
-      ret_val = 3;
-      goto free_all;
-   }
-   out_buf = malloc(head.dest_size);
-
-   // decompress MIO0 encoded data
-   bytes_decoded = mio0_decode(in_buf, out_buf, NULL);
+   mio0_stream_init(&stream);
+   mio0_stream_feed(&stream, in_buf, bytes_read);
+   out_buf = malloc(DECODE_CHUNK_SIZE);
+   bytes_decoded = mio0_stream_drain(&stream, out_buf, DECODE_CHUNK_SIZE);
    if (bytes_decoded < 0) {
       ret_val = 3;
       goto free_all;
@@ -345,10 +570,18 @@ int mio0_decode_file(const char *in_file, unsigned long offset, const char *out_
       goto free_all;
    }
 
-   // write data to file
-   bytes_written = fwrite(out_buf, 1, bytes_decoded, out);
-   if (bytes_written != bytes_decoded) {
-      ret_val = 5;
+   // decompress MIO0 encoded data a chunk at a time
+   while (bytes_decoded > 0) {
+      bytes_written = fwrite(out_buf, 1, bytes_decoded, out);
+      if (bytes_written != bytes_decoded) {
+         ret_val = 5;
+         break;
+      }
+      bytes_decoded = mio0_stream_drain(&stream, out_buf, DECODE_CHUNK_SIZE);
+   }
+   // all input is present, so running out of input means the data is truncated
+   if (bytes_decoded < 0) {
+      ret_val = 3;
    }
 
    // clean up
@@ -365,7 +598,7 @@ free_all:
    return ret_val;
 }
 
-int mio0_encode_file(const char *in_file, const char *out_file)
+int mio0_encode_file(const char *in_file, const char *out_file, mio0_encode_mode mode)
 {
    FILE *in;
    FILE *out;
@@ -399,7 +632,7 @@ int mio0_encode_file(const char *in_file, const char *out_file)
    out_buf = malloc(MIO0_HEADER_LENGTH + ((file_size+7)/8) + file_size);
 
    // compress data in MIO0 format
-   bytes_encoded = mio0_encode(in_buf, file_size, out_buf);
+   bytes_encoded = mio0_encode(in_buf, file_size, out_buf, mode);
 
    // open output file
    out = fopen(out_file, "wb");
@@ -436,6 +669,7 @@ typedef struct
    char *out_filename;
    unsigned int offset;
    int compress;
+   mio0_encode_mode mode;
 } arg_config;
 
 static arg_config default_config =
@@ -443,18 +677,21 @@ static arg_config default_config =
    NULL,
    NULL,
    0,
-   1
+   1,
+   MIO0_ENCODE_EXACT
 };
 
 static void print_usage(void)
 {
-   ERROR("Usage: mio0 [-c / -d] [-o OFFSET] FILE [OUTPUT]\n"
+   ERROR("Usage: mio0 [-c / -d] [-f / -p] [-o OFFSET] FILE [OUTPUT]\n"
          "\n"
          "mio0 v" MIO0_VERSION ": MIO0 compression and decompression tool\n"
          "\n"
          "Optional arguments:\n"
          " -c           compress raw data into MIO0 (default: compress)\n"
          " -d           decompress MIO0 into raw data\n"
+         " -f           fast compression: bounded match search, output may differ slightly\n"
+         " -p           optimal parse compression: smallest output, reports savings over default\n"
          " -o OFFSET    starting offset in FILE (default: 0)\n"
          "\n"
          "File arguments:\n"
@@ -463,6 +700,18 @@ static void print_usage(void)
    exit(1);
 }
 
+static long get_file_size(const char *filename)
+{
+   long size = -1;
+   FILE *fp = fopen(filename, "rb");
+   if (fp != NULL) {
+      fseek(fp, 0, SEEK_END);
+      size = ftell(fp);
+      fclose(fp);
+   }
+   return size;
+}
+
 // parse command line arguments
 static void parse_arguments(int argc, char *argv[], arg_config *config)
 {
@@ -481,6 +730,12 @@ static void parse_arguments(int argc, char *argv[], arg_config *config)
             case 'd':
                config->compress = 0;
                break;
+            case 'f':
+               config->mode = MIO0_ENCODE_FAST;
+               break;
+            case 'p':
+               config->mode = MIO0_ENCODE_OPTIMAL;
+               break;
             case 'o':
                if (++i >= argc) {
                   print_usage();
@@ -526,8 +781,19 @@ int main(int argc, char *argv[])
    }
 
    // operation
-   if (config.compress) {
-      ret_val = mio0_encode_file(config.in_filename, config.out_filename);
+   if (config.compress && config.mode == MIO0_ENCODE_OPTIMAL) {
+      // compress with greedy parse first to report the savings
+      ret_val = mio0_encode_file(config.in_filename, config.out_filename, MIO0_ENCODE_EXACT);
+      if (ret_val == 0) {
+         long greedy_size = get_file_size(config.out_filename);
+         ret_val = mio0_encode_file(config.in_filename, config.out_filename, config.mode);
+         if (ret_val == 0) {
+            long optimal_size = get_file_size(config.out_filename);
+            printf("Greedy: %ld bytes, optimal: %ld bytes (%+ld)\n", greedy_size, optimal_size, optimal_size - greedy_size);
+         }
+      }
+   } else if (config.compress) {
+      ret_val = mio0_encode_file(config.in_filename, config.out_filename, config.mode);
    } else {
       ret_val = mio0_decode_file(config.in_filename, config.offset, config.out_filename);
    }
@@ -4,9 +4,22 @@
 // defines
 
 #define MIO0_HEADER_LENGTH 16
+#define MIO0_WINDOW        4096 // farthest back-reference
+
+// mio0_stream_drain() return codes
+#define MIO0_STREAM_NEED_INPUT (-1) // more input must be fed to continue
+#define MIO0_STREAM_ERROR      (-2) // invalid or corrupt MIO0 data
 
 // typedefs
 
+// MIO0 encoder match search
+typedef enum
+{
+   MIO0_ENCODE_EXACT,   // longest match, farthest on ties: output identical to earlier versions
+   MIO0_ENCODE_FAST,    // bounded search, nearest match wins: linear time on repetitive data
+   MIO0_ENCODE_OPTIMAL, // minimum size parse over the whole block: smallest output, slower
+} mio0_encode_mode;
+
 typedef struct
 {
    unsigned int dest_size;
@@ -14,6 +27,23 @@ typedef struct
    unsigned int uncomp_offset;
 } mio0_header_t;
 
+// streaming decoder state
+// output is produced in caller-sized pieces; the last MIO0_WINDOW bytes are kept for back-references
+typedef struct
+{
+   mio0_header_t head;
+   const unsigned char *in;      // MIO0 data including header
+   unsigned int in_len;          // bytes available in 'in'
+   int have_header;              // header has been read and validated
+   unsigned int bit_idx;         // next control bit
+   unsigned int comp_idx;        // next byte in compressed data
+   unsigned int uncomp_idx;      // next byte in uncompressed data
+   unsigned int bytes_written;   // total bytes output so far
+   unsigned int match_remaining; // bytes left to copy from current back-reference
+   unsigned int match_dist;      // distance of current back-reference
+   unsigned char window[MIO0_WINDOW];
+} mio0_stream;
+
 // function prototypes
 
 // decode MIO0 header
@@ -30,11 +60,31 @@ void mio0_encode_header(unsigned char *buf, const mio0_header_t *head);
 // returns bytes extracted to 'out' or negative value on failure
 int mio0_decode(const unsigned char *in, unsigned char *out, unsigned int *end);
 
+// initialize streaming decoder
+void mio0_stream_init(mio0_stream *st);
+
+// provide input to streaming decoder
+// in: buffer containing MIO0 data starting at header, must remain valid while decoding
+// in_len: number of valid bytes in 'in'. call again with a larger length as more data arrives
+void mio0_stream_feed(mio0_stream *st, const unsigned char *in, unsigned int in_len);
+
+// decode as much as possible into output buffer
+// header offsets and all reads are validated against input length and the MIO0 sections
+// out: buffer for output data
+// out_len: max bytes to write to 'out'
+// returns bytes written to 'out', 0 when all data is decoded,
+// MIO0_STREAM_NEED_INPUT if no progress can be made without more input or MIO0_STREAM_ERROR
+int mio0_stream_drain(mio0_stream *st, unsigned char *out, unsigned int out_len);
+
+// offset in input just after the last byte consumed by the streaming decoder
+unsigned int mio0_stream_in_end(const mio0_stream *st);
+
 // encode MIO0 data in memory
 // in: buffer containing raw data
 // out: buffer for MIO0 data
+// mode: match search mode
 // returns size of compressed data in 'out' including MIO0 header
-int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out);
+int mio0_encode(const unsigned char *in, unsigned int length, unsigned char *out, mio0_encode_mode mode);
 
 // decode an entire MIO0 block at an offset from file to output file
 // in_file: input filename
@@ -45,6 +95,7 @@ int mio0_decode_file(const char *in_file, unsigned long offset, const char *out_
 // encode an entire file
 // in_file: input filename containing raw data to be encoded
 // out_file: output filename to write MIO0 compressed data to
-int mio0_encode_file(const char *in_file, const char *out_file);
+// mode: match search mode
+int mio0_encode_file(const char *in_file, const char *out_file, mio0_encode_mode mode);
 
 #endif // LIBMIO0_H_
@@ -1,3 +1,5 @@
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,15 +30,21 @@ typedef struct
 
 // find a pointer in the list and return index
 // ptr: address to find in table old values
-// table: list of addresses to MIO0 data
+// table: list of addresses to MIO0 data, sorted by old address
 // count: number of addresses in table
 // returns index in table if found, -1 otherwise
-static int find_ptr(unsigned int ptr, ptr_t table[], int count)
+static int find_ptr(unsigned int ptr, const ptr_t table[], int count)
 {
-   int i;
-   for (i = 0; i < count; i++) {
-      if (ptr == table[i].old) {
-         return i;
+   int lo = 0;
+   int hi = count - 1;
+   while (lo <= hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (ptr == table[mid].old) {
+         return mid;
+      } else if (ptr < table[mid].old) {
+         hi = mid - 1;
+      } else {
+         lo = mid + 1;
       }
    }
    return -1;
@@ -45,17 +53,26 @@ static int find_ptr(unsigned int ptr, ptr_t table[], int count)
 // find locations of existing MIO0 data
 // buf: buffer containing SM64 data
 // length: length of buf
-// table: table to store MIO0 addresses in
+// table: returned table of MIO0 addresses sorted by address, must be freed by caller
 // returns number of MIO0 files stored in table old values
-static int find_mio0(unsigned char *buf, unsigned int length, ptr_t table[])
+static int find_mio0(unsigned char *buf, unsigned int length, ptr_t **table)
 {
    unsigned int addr;
+   int alloc = 128;
    int count = 0;
 
+   *table = malloc(alloc * sizeof(**table));
+
    // MIO0 data is on 16-byte boundaries
-   for (addr = IN_START_ADDR; addr < length; addr += 16) {
+   // scanning in order keeps table sorted
+   for (addr = IN_START_ADDR; addr + MIO0_HEADER_LENGTH <= length; addr += 16) {
       if (!memcmp(&buf[addr], "MIO0", 4)) {
-         table[count].old = addr;
+         if (count >= alloc) {
+            alloc *= 2;
+            *table = realloc(*table, alloc * sizeof(**table));
+         }
+         memset(&(*table)[count], 0, sizeof(**table));
+         (*table)[count].old = addr;
          count++;
       }
    }
@@ -208,76 +225,95 @@ static void sm64_adjust_asm(unsigned char *buf, ptr_t table[], int count)
    }
 }
 
-// compute N64 ROM checksums
-// buf: buffer with extended SM64 data
-// cksum: two element array to write CRC1 and CRC2 to
-// TODO: this could be hand optimized
-static void sm64_calc_checksums(unsigned char *buf, unsigned int cksum[]) {
-   unsigned int t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
-   unsigned int s0, s6;
-   unsigned int a0, a1, a2, a3, at;
-   unsigned int lo;
-   unsigned int v0, v1;
-   unsigned int ra;
-
-   // derived from the SM64 boot code
-   s6 = 0x3f;
-   a0 = 0x1000;     // 59c:   8d640008    lw a0,8(t3)
-   a1 = s6;         // 5a0:   02c02825    move  a1,s6
-   at = 0x5d588b65; // 5a4:   3c015d58    lui   at,0x5d58
-                    // 5a8:   34218b65    ori   at,at,0x8b65
-   lo = a1 * at;    // 5ac:   00a10019    multu a1,at    16 F8CA 4DDB
-
-   ra = 0x100000; // 5bc:  3c1f0010    lui   ra,0x10
-   v1 = 0;  // 5c0:  00001825    move  v1,zero
-   t0 = 0;  // 5c4:  00004025    move  t0,zero
-   t1 = a0; // 5c8:  00804825    move  t1,a0
-   t5 = 32; // 5cc:  240d0020    li t5,32
-   v0 = lo; // 5d0:  00001012    mflo  v0
-   v0++;    // 5d4:  24420001    addiu v0,v0,1
-   a3 = v0; // 5d8:  00403825    move  a3,v0
-   t2 = v0; // 5dc:  00405025    move  t2,v0
-   t3 = v0; // 5e0:  00405825    move  t3,v0
-   s0 = v0; // 5e4:  00408025    move  s0,v0
-   a2 = v0; // 5e8:  00403025    move  a2,v0
-   t4 = v0; // 5ec:  00406025    move  t4,v0
-
-   do {
-      v0 = read_u32_be(&buf[t1]);   // 5f0: 8d220000    lw v0,0(t1)
-      v1 = a3 + v0;   // 5f4: 00e21821    addu  v1,a3,v0
-      at = (v1 < a3); // 5f8: 0067082b    sltu  at,v1,a3
-      a1 = v1;        // 600: 00602825    move  a1,v1 branch delay slot
-      if (at) {       // 5fc: 10200002    beqz  at,0x608
-         t2++;        // 604: 254a0001    addiu t2,t2,1
-      }
-      v1 = v0 & 0x1F;  // 608: 3043001f    andi  v1,v0,0x1f
-      t7 = t5 - v1;    // 60c: 01a37823    subu  t7,t5,v1
-      t8 = v0 >> t7;   // 610: 01e2c006    srlv  t8,v0,t7
-      t6 = v0 << v1;   // 614: 00627004    sllv  t6,v0,v1
-      a0 = t6 | t8;    // 618: 01d82025    or a0,t6,t8
-      at = (a2 < v0);  // 61c: 00c2082b    sltu  at,a2,v0
-      a3 = a1;         // 620: 00a03825    move  a3,a1
-      t3 ^= v0;        // 624: 01625826    xor   t3,t3,v0
-      s0 += a0;        // 62c: 02048021    addu  s0,s0,a0 branch delay slot
-      if (at) {        // 628: 10200004    beqz  at,0x63c
-         t9 = a3 ^ v0; // 630: 00e2c826    xor   t9,a3,v0
-                       // 634: 10000002    b  0x640
-         a2 ^= t9;     // 638: 03263026    xor   a2,t9,a2 branch delay
+// checksum region and boot code mixed in by CIC-NUS-6105
+#define CKSUM_START  0x1000
+#define CKSUM_LENGTH 0x100000
+#define CKSUM_6105_BOOT 0x750
+
+static unsigned int cic_seed(cic_type cic)
+{
+   switch (cic) {
+      case CIC_6103: return 0xA3886759;
+      case CIC_6105: return 0xDF26F436;
+      case CIC_6106: return 0x1FEA617A;
+      case CIC_6101:
+      case CIC_6102:
+      default:       return 0xF8CA4DDC;
+   }
+}
+
+// load a big-endian word with a single host load
+static inline uint32_t load_u32_be(const unsigned char *buf)
+{
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   uint32_t val;
+   memcpy(&val, buf, sizeof(val));
+   return __builtin_bswap32(val);
+#else
+   return read_u32_be(buf);
+#endif
+}
+
+// checksum loop shared by all CICs, derived from the boot code
+// the running sums depend on every previous word, so words are processed in order with the state
+// in registers and the carry and comparison steps done without branches
+// mix_boot: use boot code instead of the rotated sum in the last accumulator (CIC-NUS-6105)
+static inline void checksum_loop(const unsigned char *buf, uint32_t seed, int mix_boot, uint32_t state[6])
+{
+   const unsigned char *data = &buf[CKSUM_START];
+   const unsigned char *boot = &buf[CKSUM_6105_BOOT];
+   uint32_t sum = seed;     // sum of words
+   uint32_t carries = seed; // count of carries out of 'sum'
+   uint32_t xsum = seed;    // xor of words
+   uint32_t rot_sum = seed; // sum of words rotated by their low 5 bits
+   uint32_t mix = seed;     // xor of rotated word or sum depending on word value
+   uint32_t acc = seed;     // sum of words xor rotated sum or boot code
+   for (unsigned int i = 0; i < CKSUM_LENGTH; i += 4) {
+      uint32_t d = load_u32_be(&data[i]);
+      uint32_t rot = (d << (d & 0x1F)) | (d >> ((32 - (d & 0x1F)) & 0x1F));
+      sum += d;
+      carries += (sum < d);
+      xsum ^= d;
+      rot_sum += rot;
+      mix ^= (mix < d) ? (sum ^ d) : rot;
+      if (mix_boot) {
+         acc += load_u32_be(&boot[i & 0xFF]) ^ d;
       } else {
-         a2 ^= a0;     // 63c: 00c43026    xor   a2,a2,a0
+         acc += rot_sum ^ d;
       }
-      t0 += 4;         // 640: 25080004    addiu t0,t0,4
-      t7 = v0 ^ s0;    // 644: 00507826    xor   t7,v0,s0
-      t1 += 4;         // 648: 25290004    addiu t1,t1,4
-      t4 += t7;        // 650: 01ec6021    addu  t4,t7,t4 branch delay
-   } while (t0 != ra); // 64c: 151fffe8    bne   t0,ra,0x5f0
-   t6 = a3 ^ t2;       // 654: 00ea7026    xor   t6,a3,t2
-   a3 = t6 ^ t3;       // 658: 01cb3826    xor   a3,t6,t3
-   t8 = s0 ^ a2;       // 65c: 0206c026    xor   t8,s0,a2
-   s0 = t8 ^ t4;       // 660: 030c8026    xor   s0,t8,t4
-   
-   cksum[0] = a3;
-   cksum[1] = s0;
+   }
+   state[0] = sum;
+   state[1] = carries;
+   state[2] = xsum;
+   state[3] = rot_sum;
+   state[4] = mix;
+   state[5] = acc;
+}
+
+void n64_calc_checksums(const unsigned char *buf, cic_type cic, unsigned int cksum[])
+{
+   uint32_t st[6];
+
+   if (cic == CIC_6105) {
+      checksum_loop(buf, cic_seed(cic), 1, st);
+   } else {
+      checksum_loop(buf, cic_seed(cic), 0, st);
+   }
+
+   switch (cic) {
+      case CIC_6103:
+         cksum[0] = (st[0] ^ st[1]) + st[2];
+         cksum[1] = (st[3] ^ st[4]) + st[5];
+         break;
+      case CIC_6106:
+         cksum[0] = (st[0] * st[1]) + st[2];
+         cksum[1] = (st[3] * st[4]) + st[5];
+         break;
+      default:
+         cksum[0] = st[0] ^ st[1] ^ st[2];
+         cksum[1] = st[3] ^ st[4] ^ st[5];
+         break;
+   }
 }
 
 rom_type sm64_rom_type(unsigned char *buf, unsigned int length)
@@ -324,106 +360,223 @@ rom_version sm64_rom_version(unsigned char *buf)
    return VERSION_UNKNOWN;
 }
 
+typedef struct
+{
+   const sm64_config *config;
+   const unsigned char *in_buf;
+   unsigned int in_length;
+   unsigned char *out_buf;
+   ptr_t *table;
+   int *data_offsets;  // offset from new address to decoded data, negative to skip block
+   int *lengths;       // returned decoded lengths
+   unsigned int *ends; // returned end of MIO0 data relative to block
+   int count;
+   int next;           // next table index to be claimed by a worker
+   pthread_mutex_t lock;
+} extract_queue;
+
+// worker thread: decodes claimed blocks straight into their final location
+static void *extract_worker(void *arg)
+{
+   extract_queue *queue = arg;
+   const sm64_config *config = queue->config;
+   for (;;) {
+      int i;
+      pthread_mutex_lock(&queue->lock);
+      i = queue->next++;
+      pthread_mutex_unlock(&queue->lock);
+      if (i >= queue->count) {
+         break;
+      }
+      if (queue->data_offsets[i] < 0) {
+         continue;
+      }
+      ptr_t *ptr = &queue->table[i];
+      unsigned int in_addr = ptr->old;
+      unsigned char *out = &queue->out_buf[ptr->new + queue->data_offsets[i]];
+      mio0_header_t head;
+      mio0_stream stream;
+      unsigned int out_len = 0;
+      int len;
+      // bounded decode: corrupt blocks can't write past the space laid out for them
+      mio0_decode_header(&queue->in_buf[in_addr], &head);
+      mio0_stream_init(&stream);
+      mio0_stream_feed(&stream, &queue->in_buf[in_addr], queue->in_length - in_addr);
+      while ((len = mio0_stream_drain(&stream, &out[out_len], head.dest_size - out_len)) > 0) {
+         out_len += len;
+      }
+      queue->lengths[i] = len < 0 ? len : (int)out_len;
+      queue->ends[i] = mio0_stream_in_end(&stream);
+      if (queue->lengths[i] > 0) {
+         // dump MIO0 data and decompressed data to file
+         if (config->dump) {
+            char filename[FILENAME_MAX];
+            sprintf(filename, MIO0_DIR "/%08X.mio", in_addr);
+            write_file(filename, (unsigned char *)&queue->in_buf[in_addr], queue->ends[i]);
+            sprintf(filename, MIO0_DIR "/%08X", in_addr);
+            write_file(filename, out, queue->lengths[i]);
+         }
+         if (config->fill) {
+            memset(&queue->out_buf[in_addr], 0x01, queue->ends[i]);
+         }
+      }
+   }
+   return NULL;
+}
+
 void sm64_decompress_mio0(const sm64_config *config,
                           unsigned char *in_buf,
                           unsigned int in_length,
                           unsigned char *out_buf)
 {
-#define MAX_PTRS 128
 #define COMPRESSED_LENGTH 2
+   extract_queue queue;
+   pthread_t *threads;
+   int thread_count;
    mio0_header_t head;
-   int bit_length;
-   int move_offset;
    unsigned int in_addr;
    unsigned int out_addr = OUT_START_ADDR;
    unsigned int align_add = config->alignment - 1;
    unsigned int align_mask = ~align_add;
-   ptr_t ptr_table[MAX_PTRS];
+   ptr_t *ptr_table;
+   int *data_offsets;
+   int *lengths;
+   unsigned int *ends;
    int ptr_count;
+   int kept;
    int i;
 
    // find MIO0 locations and pointers
-   ptr_count = find_mio0(in_buf, in_length, ptr_table);
+   ptr_count = find_mio0(in_buf, in_length, &ptr_table);
    find_pointers(in_buf, in_length, ptr_table, ptr_count);
    find_asm_pointers(in_buf, ptr_table, ptr_count);
 
-   // extract each MIO0 block and prepend fake MIO0 header for 0x1A command and ASM references
+   data_offsets = malloc(ptr_count * sizeof(*data_offsets));
+   lengths = calloc(ptr_count, sizeof(*lengths));
+   ends = calloc(ptr_count, sizeof(*ends));
+
+   // lay out all blocks from the decoded sizes in their headers
    for (i = 0; i < ptr_count; i++) {
+      unsigned int length;
+      unsigned int data_offset = 0;
+      data_offsets[i] = -1;
       in_addr = ptr_table[i].old;
-      if (!memcmp(&in_buf[in_addr], "MIO0", 4)) {
-         unsigned int end;
-         int length;
-         int is_mio0 = 0;
-         // align output address
-         out_addr = (out_addr + align_add) & align_mask;
-         length = mio0_decode(&in_buf[in_addr], &out_buf[out_addr], &end);
-         if (length > 0) {
-            // dump MIO0 data and decompressed data to file
-            if (config->dump) {
-               char filename[FILENAME_MAX];
-               sprintf(filename, MIO0_DIR "/%08X.mio", in_addr);
-               write_file(filename, &in_buf[in_addr], end);
-               sprintf(filename, MIO0_DIR "/%08X", in_addr);
-               write_file(filename, &out_buf[out_addr], length);
-            }
-            // 0x1A commands and ASM references need fake MIO0 header
-            // relocate data and add MIO0 header with all uncompressed data
-            if (ptr_table[i].command == 0x1A || ptr_table[i].command == 0xFF) {
-               bit_length = (length + 7) / 8 + 2;
-               move_offset = MIO0_HEADER_LENGTH + bit_length + COMPRESSED_LENGTH;
-               memmove(&out_buf[out_addr + move_offset], &out_buf[out_addr], length);
-               head.dest_size = length;
-               head.comp_offset = move_offset - COMPRESSED_LENGTH;
-               head.uncomp_offset = move_offset;
-               mio0_encode_header(&out_buf[out_addr], &head);
-               memset(&out_buf[out_addr + MIO0_HEADER_LENGTH], 0xFF, head.comp_offset - MIO0_HEADER_LENGTH);
-               memset(&out_buf[out_addr + head.comp_offset], 0x0, 2);
-               length += head.uncomp_offset;
-               is_mio0 = 1;
-            } else if (ptr_table[i].command == 0x18) {
-               // 0x18 commands become 0x17
-               ptr_table[i].command = 0x17;
-            }
-            // use output from decoder to find end of ASM referenced MIO0 blocks
-            if (ptr_table[i].old_end == 0x00) {
-               ptr_table[i].old_end = in_addr + end;
-            }
-            INFO("MIO0 file %08X-%08X decompressed to %08X-%08X as raw data%s\n",
-                  in_addr, ptr_table[i].old_end, out_addr, out_addr + length,
-                  is_mio0 ? " with a MIO0 header" : "");
-            if (config->fill) {
-               INFO("Filling old MIO0 with 0x01 from %X length %X\n", in_addr, end);
-               memset(&out_buf[in_addr], 0x01, end);
-            }
-            // keep track of new pointers
-            ptr_table[i].new = out_addr;
-            ptr_table[i].new_end = out_addr + length;
-            out_addr += length + config->padding;
-         } else {
-            ERROR("Error decoding MIO0 block at %X\n", in_addr);
-         }
+      if (!mio0_decode_header(&in_buf[in_addr], &head)) {
+         continue;
+      }
+      // dest_size is untrusted: bound it before any address arithmetic can wrap
+      length = head.dest_size;
+      if (length > config->ext_size) {
+         ERROR("Error: MIO0 block at %X decoded size %X larger than extended ROM size %X\n",
+               in_addr, length, config->ext_size);
+         continue;
+      }
+      // align output address
+      out_addr = (out_addr + align_add) & align_mask;
+      // 0x1A commands and ASM references need fake MIO0 header with all uncompressed data
+      if (ptr_table[i].command == 0x1A || ptr_table[i].command == 0xFF) {
+         unsigned int bit_length = (length + 7) / 8 + 2;
+         data_offset = MIO0_HEADER_LENGTH + bit_length + COMPRESSED_LENGTH;
       }
+      if (out_addr > config->ext_size || data_offset > config->ext_size - out_addr ||
+          length > config->ext_size - out_addr - data_offset) {
+         ERROR("Error: extended ROM size %X too small for MIO0 block at %X\n", config->ext_size, in_addr);
+         ptr_count = i;
+         break;
+      }
+      if (ptr_table[i].command == 0x18) {
+         // 0x18 commands become 0x17
+         ptr_table[i].command = 0x17;
+      }
+      data_offsets[i] = data_offset;
+      // keep track of new pointers
+      ptr_table[i].new = out_addr;
+      ptr_table[i].new_end = out_addr + data_offset + length;
+      out_addr = ptr_table[i].new_end + config->padding;
    }
 
    INFO("Ending offset: %X\n", out_addr);
 
+   // decode every block in parallel
+   queue.config = config;
+   queue.in_buf = in_buf;
+   queue.in_length = in_length;
+   queue.out_buf = out_buf;
+   queue.table = ptr_table;
+   queue.data_offsets = data_offsets;
+   queue.lengths = lengths;
+   queue.ends = ends;
+   queue.count = ptr_count;
+   queue.next = 0;
+   pthread_mutex_init(&queue.lock, NULL);
+   thread_count = config->threads > 0 ? config->threads : cpu_count();
+   thread_count = MAX(MIN(thread_count, ptr_count), 1);
+   threads = malloc(thread_count * sizeof(*threads));
+   for (i = 0; i < thread_count; i++) {
+      pthread_create(&threads[i], NULL, extract_worker, &queue);
+   }
+   for (i = 0; i < thread_count; i++) {
+      pthread_join(threads[i], NULL);
+   }
+   free(threads);
+   pthread_mutex_destroy(&queue.lock);
+
+   // write fake MIO0 headers in front of the decoded data and report results in order
+   // only blocks that decoded are kept in the table, so pointers to the others are left alone
+   kept = 0;
+   for (i = 0; i < ptr_count; i++) {
+      unsigned int new_addr = ptr_table[i].new;
+      in_addr = ptr_table[i].old;
+      if (data_offsets[i] < 0) {
+         continue;
+      }
+      if (lengths[i] <= 0) {
+         ERROR("Error decoding MIO0 block at %X\n", in_addr);
+         continue;
+      }
+      if (data_offsets[i] > 0) {
+         head.dest_size = lengths[i];
+         head.comp_offset = data_offsets[i] - COMPRESSED_LENGTH;
+         head.uncomp_offset = data_offsets[i];
+         mio0_encode_header(&out_buf[new_addr], &head);
+         memset(&out_buf[new_addr + MIO0_HEADER_LENGTH], 0xFF, head.comp_offset - MIO0_HEADER_LENGTH);
+         memset(&out_buf[new_addr + head.comp_offset], 0x0, 2);
+      }
+      // use output from decoder to find end of ASM referenced MIO0 blocks
+      if (ptr_table[i].old_end == 0x00) {
+         ptr_table[i].old_end = in_addr + ends[i];
+      }
+      INFO("MIO0 file %08X-%08X decompressed to %08X-%08X as raw data%s\n",
+            in_addr, ptr_table[i].old_end, new_addr, ptr_table[i].new_end,
+            data_offsets[i] > 0 ? " with a MIO0 header" : "");
+      if (config->fill) {
+         INFO("Filled old MIO0 with 0x01 from %X length %X\n", in_addr, ends[i]);
+      }
+      ptr_table[kept++] = ptr_table[i];
+   }
+
    // adjust pointers and ASM pointers to new values
-   sm64_adjust_pointers(out_buf, in_length, ptr_table, ptr_count);
-   sm64_adjust_asm(out_buf, ptr_table, ptr_count);
+   sm64_adjust_pointers(out_buf, in_length, ptr_table, kept);
+   sm64_adjust_asm(out_buf, ptr_table, kept);
+
+   free(data_offsets);
+   free(lengths);
+   free(ends);
+   free(ptr_table);
 }
 
-void sm64_update_checksums(unsigned char *buf)
+void sm64_update_checksums(unsigned char *buf, cic_type cic)
 {
+   static const char *cic_names[] = {"6101", "6102", "6103", "6105", "6106"};
    unsigned int cksum_offsets[] = {0x10, 0x14};
    unsigned int read_cksum[2];
    unsigned int calc_cksum[2];
    int i;
 
-   // assume CIC-NUS-6102
-   INFO("BootChip: CIC-NUS-6102\n");
+   INFO("BootChip: CIC-NUS-%s\n", cic_names[cic]);
 
    // calculate new N64 header checksum
-   sm64_calc_checksums(buf, calc_cksum);
+   n64_calc_checksums(buf, cic, calc_cksum);
 
    // mimic the n64sums output
    for (i = 0; i < 2; i++) {
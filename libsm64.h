@@ -23,6 +23,16 @@ typedef enum
    VERSION_SM64_IQUE,
 } rom_version;
 
+// N64 boot chip, determines checksum seed and algorithm
+typedef enum
+{
+   CIC_6101,
+   CIC_6102,
+   CIC_6103,
+   CIC_6105,
+   CIC_6106,
+} cic_type;
+
 typedef struct
 {
    char *in_filename;
@@ -32,6 +42,7 @@ typedef struct
    unsigned int alignment;
    char fill;
    char dump;
+   int threads;
 } sm64_config;
 
 // determine ROM type based on data
@@ -55,9 +66,16 @@ void sm64_decompress_mio0(const sm64_config *config,
                           unsigned int in_length,
                           unsigned char *out_buf);
 
+// compute N64 ROM header checksums
+// buf: buffer containing ROM data, at least 0x101000 bytes
+// cic: boot chip the ROM uses
+// cksum: two element array to write CRC1 and CRC2 to
+void n64_calc_checksums(const unsigned char *buf, cic_type cic, unsigned int cksum[]);
+
 // update N64 header checksums
 // buf: buffer containing ROM data
+// cic: boot chip the ROM uses (SM64 uses CIC_6102)
 // checksums are written into the buffer
-void sm64_update_checksums(unsigned char *buf);
+void sm64_update_checksums(unsigned char *buf, cic_type cic);
 
 #endif // LIBSM64_H_
@@ -2,21 +2,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <inttypes.h>
 
+#include <pthread.h>
+
+#ifdef USE_CAPSTONE
 #include <capstone/capstone.h>
+#endif
 
 #include "mipsdisasm.h"
+#include "r4300.h"
 #include "utils.h"
 
-#define MIPSDISASM_VERSION "0.2+"
+#define MIPSDISASM_VERSION "0.3"
 
 // typedefs
 typedef struct
 {
-   char name[60];
    unsigned int vaddr;
-   char prefix[FILENAME_MAX];
+   unsigned int name; // offset of name in label_buf.names
 } asm_label;
 
 typedef struct
@@ -24,32 +27,34 @@ typedef struct
    asm_label *labels;
    int alloc;
    int count;
+   // open addressing hash of vaddr to first index in labels, -1 if empty
+   int *hash;
+   unsigned int hash_alloc;
+   unsigned int hash_bits; // log2(hash_alloc)
+   // string arena holding all label names
+   char *names;
+   unsigned int names_len;
+   unsigned int names_alloc;
 } label_buf;
 
+// flag for newline before instruction, stored with the R4300_* flags
+#define INSN_NEWLINE 0x80
+
+// instructions of a block in structure-of-arrays layout, all arrays share one allocation
+// immediates and text are regenerated from the raw word when needed
 typedef struct
 {
-   // copied from cs_insn structure
-   unsigned int id;
-   uint8_t bytes[4];
-   char op_str[32];
-   char mnemonic[16];
-   cs_mips_op operands[8];
-   uint8_t op_count;
-   // n64split-specific data
-   int is_jump;
-   int linked_insn;
-   union
-   {
-      unsigned int linked_value;
-      float linked_float;
-   };
-   int newline;
-} disasm_data;
+   unsigned int *words;        // raw instruction words
+   int *linked_insn;           // index of linked instruction, -1 if none
+   unsigned int *linked_value; // linked address, or float bits for LUI merged into LI
+   unsigned short *ids;        // r4300_id, pseudoinstructions replace the decoded id
+   unsigned char *flags;       // R4300_* flags and INSN_NEWLINE
+} insn_table;
 
 typedef struct _asm_block
 {
    label_buf locals;
-   disasm_data *instructions;
+   insn_table insns;
    int instruction_count;
    unsigned int offset;
    unsigned int length;
@@ -65,45 +70,129 @@ typedef struct _disasm_state
    int block_alloc;
    int block_count;
 
-   csh handle;
-
    asm_syntax syntax;
    int merge_pseudo;
 } disasm_state;
 
+// first pass context, one per block being disassembled
+typedef struct
+{
+   const label_buf *globals; // global labels known before this pass
+   label_buf *found;         // where newly discovered global labels are added
+} pass1_ctx;
+
 // default label buffer allocate
 static void labels_alloc(label_buf *buf)
 {
    buf->count = 0;
    buf->alloc = 128;
    buf->labels = malloc(sizeof(*buf->labels) * buf->alloc);
+   buf->hash_alloc = 256;
+   buf->hash_bits = 8;
+   buf->hash = malloc(sizeof(*buf->hash) * buf->hash_alloc);
+   memset(buf->hash, 0xFF, sizeof(*buf->hash) * buf->hash_alloc);
+   buf->names_len = 0;
+   buf->names_alloc = 4096;
+   buf->names = malloc(buf->names_alloc);
+}
+
+static void labels_free(label_buf *buf)
+{
+   free(buf->labels);
+   free(buf->hash);
+   free(buf->names);
+   buf->labels = NULL;
+   buf->hash = NULL;
+   buf->names = NULL;
+   buf->count = 0;
+}
+
+static inline const char *labels_name(const label_buf *buf, int idx)
+{
+   return &buf->names[buf->labels[idx].name];
+}
+
+static inline unsigned int labels_hash(const label_buf *buf, unsigned int vaddr)
+{
+   // Fibonacci hashing: the top hash_bits of the product are the best mixed
+   return (vaddr * 2654435761U) >> (32 - buf->hash_bits);
+}
+
+// insert label index into hash table unless vaddr is already present
+static void labels_hash_insert(label_buf *buf, int idx)
+{
+   unsigned int vaddr = buf->labels[idx].vaddr;
+   unsigned int h = labels_hash(buf, vaddr);
+   while (buf->hash[h] >= 0) {
+      if (buf->labels[buf->hash[h]].vaddr == vaddr) {
+         return;
+      }
+      h = (h + 1) & (buf->hash_alloc - 1);
+   }
+   buf->hash[h] = idx;
+}
+
+// rebuild hash table from labels in array order, so first index for each vaddr is kept
+static void labels_rehash(label_buf *buf)
+{
+   while (buf->hash_alloc < 2 * (unsigned int)buf->count) {
+      buf->hash_alloc *= 2;
+      buf->hash_bits++;
+      buf->hash = realloc(buf->hash, sizeof(*buf->hash) * buf->hash_alloc);
+   }
+   memset(buf->hash, 0xFF, sizeof(*buf->hash) * buf->hash_alloc);
+   for (int i = 0; i < buf->count; i++) {
+      labels_hash_insert(buf, i);
+   }
 }
 
 static void labels_add(label_buf *buf, const char *name, unsigned int vaddr)
 {
+   char gen_name[16];
+   unsigned int name_len;
    if (buf->count >= buf->alloc) {
       buf->alloc *= 2;
       buf->labels = realloc(buf->labels, sizeof(*buf->labels) * buf->alloc);
    }
-   asm_label *l = &buf->labels[buf->count];
    // if name is null, generate based on vaddr
    if (name == NULL) {
-      sprintf(l->name, "L%08X", vaddr);
-   } else {
-      strcpy(l->name, name);
+      sprintf(gen_name, "L%08X", vaddr);
+      name = gen_name;
    }
+   name_len = strlen(name) + 1;
+   if (buf->names_len + name_len > buf->names_alloc) {
+      buf->names_alloc = MAX(2 * buf->names_alloc, buf->names_len + name_len);
+      buf->names = realloc(buf->names, buf->names_alloc);
+   }
+   memcpy(&buf->names[buf->names_len], name, name_len);
+   asm_label *l = &buf->labels[buf->count];
+   l->name = buf->names_len;
    l->vaddr = vaddr;
+   buf->names_len += name_len;
    buf->count++;
+   // keep load factor at or below 1/2
+   if (2 * (unsigned int)buf->count > buf->hash_alloc) {
+      labels_rehash(buf);
+   } else {
+      labels_hash_insert(buf, buf->count - 1);
+   }
 }
 
+// sort key pointing into the name arena of the buffer being sorted
+typedef struct
+{
+   asm_label label;
+   const char *name;
+} label_key;
+
 static int label_cmp(const void *a, const void *b)
 {
-   const asm_label *ala = a;
-   const asm_label *alb = b;
+   const label_key *ala = a;
+   const label_key *alb = b;
    // first sort by vaddr, then by name
-   if (ala->vaddr > alb->vaddr) {
+   if (ala->label.vaddr > alb->label.vaddr) {
       return 1;
-   } else if (alb->vaddr > ala->vaddr) {
+   } else if (alb->label.vaddr > ala->label.vaddr) {
       return -1;
    } else {
       return strcmp(ala->name, alb->name);
@@ -112,7 +201,18 @@ static int label_cmp(const void *a, const void *b)
 
 static void labels_sort(label_buf *buf)
 {
-   qsort(buf->labels, buf->count, sizeof(buf->labels[0]), label_cmp);
+   label_key *keys = malloc(sizeof(*keys) * MAX(buf->count, 1));
+   for (int i = 0; i < buf->count; i++) {
+      keys[i].label = buf->labels[i];
+      keys[i].name = labels_name(buf, i);
+   }
+   qsort(keys, buf->count, sizeof(keys[0]), label_cmp);
+   for (int i = 0; i < buf->count; i++) {
+      buf->labels[i] = keys[i].label;
+   }
+   free(keys);
+   // indices moved, so hash table must be rebuilt
+   labels_rehash(buf);
 }
 
 // labels: label buffer to search in
@@ -120,60 +220,107 @@ static void labels_sort(label_buf *buf)
 // returns index in buf->labels if found, -1 otherwise
 static int labels_find(const label_buf *buf, unsigned int vaddr)
 {
-   for (int i = 0; i < buf->count; i++) {
-      if (buf->labels[i].vaddr == vaddr) {
-         return i;
+   unsigned int h = labels_hash(buf, vaddr);
+   while (buf->hash[h] >= 0) {
+      if (buf->labels[buf->hash[h]].vaddr == vaddr) {
+         return buf->hash[h];
       }
+      h = (h + 1) & (buf->hash_alloc - 1);
    }
    return -1;
 }
 
+// add generated global label for address unless one already exists
+// in parallel passes, 'found' is private to the block and merged in block order afterwards
+static void pass1_global_add(pass1_ctx *ctx, const char *prefix, unsigned int addr)
+{
+   if (labels_find(ctx->globals, addr) < 0 &&
+       (ctx->found == ctx->globals || labels_find(ctx->found, addr) < 0)) {
+      char label_name[32];
+      sprintf(label_name, "%s_%08X", prefix, addr);
+      labels_add(ctx->found, label_name, addr);
+   }
+}
+
+static void insns_alloc(insn_table *insns, int count)
+{
+   size_t n = MAX(count, 1);
+   char *mem = malloc(n * (sizeof(*insns->words) + sizeof(*insns->linked_insn) + sizeof(*insns->linked_value) +
+                           sizeof(*insns->ids) + sizeof(*insns->flags)));
+   // largest elements first to keep every array aligned
+   insns->words = (unsigned int *)mem;
+   insns->linked_insn = (int *)&insns->words[n];
+   insns->linked_value = (unsigned int *)&insns->linked_insn[n];
+   insns->ids = (unsigned short *)&insns->linked_value[n];
+   insns->flags = (unsigned char *)&insns->ids[n];
+}
+
+static void insns_free(insn_table *insns)
+{
+   free(insns->words);
+   insns->words = NULL;
+}
+
+// rebuild decoded instruction from the table, keeping any pseudoinstruction id
+static void insns_get(const insn_table *insns, int i, unsigned int vaddr, r4300_insn *insn)
+{
+   r4300_decode(insns->words[i], vaddr, insn);
+   insn->id = insns->ids[i];
+}
+
+// register written by instructions that stop the LUI search
+static unsigned int dest_reg(unsigned int id, unsigned int word)
+{
+   switch (id) {
+      case R4300_INS_ADD:
+      case R4300_INS_ADDU:
+      case R4300_INS_SUB:
+      case R4300_INS_SUBU:
+         return R4300_WORD_RD(word);
+      default:
+         return R4300_WORD_RT(word);
+   }
+}
+
 // try to find a matching LUI for a given register
-static void link_with_lui(disasm_state *state, int block_id, int offset, unsigned int reg, unsigned int mem_imm)
+static void link_with_lui(disasm_state *state, pass1_ctx *ctx, int block_id, int offset, unsigned int reg, unsigned int mem_imm)
 {
    asm_block *block = &state->blocks[block_id];
 #define MAX_LOOKBACK 128
-   disasm_data *insn = block->instructions;
+   insn_table *insns = &block->insns;
    // don't attempt to compute addresses for zero offset
    if (mem_imm != 0x0) {
       // end search after some sane max number of instructions
       int end_search = MAX(0, offset - MAX_LOOKBACK);
       for (int search = offset - 1; search >= end_search; search--) {
+         unsigned int id = insns->ids[search];
+         unsigned int word = insns->words[search];
          // use an `if` instead of `case` block to allow breaking out of the `for` loop
-         if (insn[search].id == MIPS_INS_LUI) {
-            unsigned int rd = insn[search].operands[0].reg;
-            if (reg == rd) {
-               unsigned int lui_imm = (unsigned int)insn[search].operands[1].imm;
-               unsigned int addr = ((lui_imm << 16) + mem_imm);
-               insn[search].linked_insn = offset;
-               insn[search].linked_value = addr;
-               insn[offset].linked_insn = search;
-               insn[offset].linked_value = addr;
+         if (id == R4300_INS_LUI) {
+            if (reg == R4300_WORD_RT(word)) {
+               unsigned int addr = (((word & 0xFFFF) << 16) + mem_imm);
+               insns->linked_insn[search] = offset;
+               insns->linked_value[search] = addr;
+               insns->linked_insn[offset] = search;
+               insns->linked_value[offset] = addr;
                // if not ORI, create global data label if one does not exist
-               if (insn[offset].id != MIPS_INS_ORI) {
-                  int label = labels_find(&state->globals, addr);
-                  if (label < 0) {
-                     char label_name[32];
-                     sprintf(label_name, "D_%08X", addr);
-                     labels_add(&state->globals, label_name, addr);
-                  }
+               if (insns->ids[offset] != R4300_INS_ORI) {
+                  pass1_global_add(ctx, "D", addr);
                }
                break;
             }
-         } else if (insn[search].id == MIPS_INS_LW ||
-                    insn[search].id == MIPS_INS_LD ||
-                    insn[search].id == MIPS_INS_ADDIU ||
-                    insn[search].id == MIPS_INS_ADDU ||
-                    insn[search].id == MIPS_INS_ADD ||
-                    insn[search].id == MIPS_INS_SUB ||
-                    insn[search].id == MIPS_INS_SUBU) {
-            unsigned int rd = insn[search].operands[0].reg;
-            if (reg == rd) {
+         } else if (id == R4300_INS_LW ||
+                    id == R4300_INS_LD ||
+                    id == R4300_INS_ADDIU ||
+                    id == R4300_INS_ADDU ||
+                    id == R4300_INS_ADD ||
+                    id == R4300_INS_SUB ||
+                    id == R4300_INS_SUBU) {
+            if (reg == dest_reg(id, word)) {
                // ignore: reg is pointer, offset is probably struct data member
                break;
             }
-         } else if (insn[search].id == MIPS_INS_JR &&
-               insn[search].operands[0].reg == MIPS_REG_RA) {
+         } else if (id == R4300_INS_JR && R4300_WORD_RS(word) == R4300_REG_RA) {
             // stop looking when previous `jr ra` is hit
             break;
          }
@@ -182,161 +329,120 @@ static void link_with_lui(disasm_state *state, int block_id, int offset, unsigne
 }
 
 // disassemble a block of code and collect JALs and local labels
-static void disassemble_block(unsigned char *data, unsigned int length, unsigned int vaddr, disasm_state *state, int block_id)
+static void disassemble_block(unsigned char *data, unsigned int length, unsigned int vaddr, disasm_state *state, int block_id, pass1_ctx *ctx)
 {
    asm_block *block = &state->blocks[block_id];
+   insn_table *insns = &block->insns;
 
-   // capstone structures require a lot of data, so only request a small block at a time and preserve the required data
-   int remaining = length;
-   int processed = 0;
-   block->instruction_count = 0;
-   block->instructions = calloc(length / 4, sizeof(*block->instructions));
-   while (remaining > 0) {
-      cs_insn *insn;
-      int current_len = MIN(remaining, 1024);
-      int count = cs_disasm(state->handle, &data[processed], current_len, vaddr + processed, 0, &insn);
-      for (int i = 0; i < count; i++) {
-         disasm_data *dis_insn = &block->instructions[block->instruction_count + i];
-         dis_insn->id = insn[i].id;
-         memcpy(dis_insn->bytes, insn[i].bytes, sizeof(dis_insn->bytes));
-         strcpy(dis_insn->mnemonic, insn[i].mnemonic);
-         strcpy(dis_insn->op_str,   insn[i].op_str);
-         if (insn[i].detail != NULL && insn[i].detail->mips.op_count > 0) {
-            dis_insn->op_count = insn[i].detail->mips.op_count;
-            memcpy(dis_insn->operands, insn[i].detail->mips.operands, sizeof(dis_insn->operands));
-         } else {
-            dis_insn->op_count = 0;
-         }
-         dis_insn->is_jump = cs_insn_group(state->handle, &insn[i], MIPS_GRP_JUMP) || insn[i].id == MIPS_INS_JAL || insn[i].id == MIPS_INS_BAL;
-      }
-      cs_free(insn, count);
-      block->instruction_count += count;
-      processed += count * 4;
-      remaining = length - processed;
-   }
+   block->instruction_count = length / 4;
+   insns_alloc(insns, block->instruction_count);
 
    if (block->instruction_count > 0) {
-      disasm_data *insn = block->instructions;
       for (int i = 0; i < block->instruction_count; i++) {
-         insn[i].linked_insn = -1;
-         if (insn[i].is_jump) {
+         r4300_insn cur;
+         r4300_decode(read_u32_be(&data[4 * i]), vaddr + 4 * i, &cur);
+         insns->words[i] = cur.word;
+         insns->ids[i] = cur.id;
+         insns->flags[i] = cur.flags;
+         insns->linked_insn[i] = -1;
+      }
+      for (int i = 0; i < block->instruction_count; i++) {
+         r4300_insn cur;
+         insns_get(insns, i, vaddr + 4 * i, &cur);
+         if (cur.flags & (R4300_JUMP | R4300_BRANCH)) {
             // flag for newline two instructions after `jr ra` or `j`
-            if ( ((insn[i].id == MIPS_INS_JR || insn[i].id == MIPS_INS_JALR) && insn[i].operands[0].reg == MIPS_REG_RA) ||
-                   insn[i].id == MIPS_INS_J) {
+            if ( ((cur.id == R4300_INS_JR || cur.id == R4300_INS_JALR) && R4300_RS(&cur) == R4300_REG_RA) ||
+                   cur.id == R4300_INS_J) {
                if (i + 2 < block->instruction_count) {
-                   insn[i + 2].newline = 1;
+                   insns->flags[i + 2] |= INSN_NEWLINE;
                }
             }
 
-            if (insn[i].id == MIPS_INS_JAL || insn[i].id == MIPS_INS_BAL || insn[i].id == MIPS_INS_J) {
-               unsigned int jal_target  = (unsigned int)insn[i].operands[0].imm;
+            if (cur.id == R4300_INS_JAL || cur.id == R4300_INS_BAL || cur.id == R4300_INS_J) {
                // create label if one does not exist
-               if (labels_find(&state->globals, jal_target) < 0) {
-                  char label_name[FILENAME_MAX];
-                  sprintf(label_name, "func_%08X", jal_target);
-                  labels_add(&state->globals, label_name, jal_target);
-               }
-            } else {
-               // all branches and jumps
-               for (int o = 0; o < insn[i].op_count; o++) {
-                  if (insn[i].operands[o].type == MIPS_OP_IMM) {
-                     char label_name[32];
-                     unsigned int branch_target = (unsigned int)insn[i].operands[o].imm;
-                     // create label if one does not exist
-                     int label = labels_find(&block->locals, branch_target);
-                     if (label < 0) {
-                        switch (state->syntax) {
-                           case ASM_GAS:    sprintf(label_name, ".L%08X", branch_target); break;
-                           case ASM_ARMIPS: sprintf(label_name, "@L%08X", branch_target); break;
-                        }
-                        labels_add(&block->locals, label_name, branch_target);
-                     }
+               pass1_global_add(ctx, "func", cur.imm);
+            } else if (cur.flags & R4300_BRANCH) {
+               char label_name[32];
+               unsigned int branch_target = cur.imm;
+               // create label if one does not exist
+               int label = labels_find(&block->locals, branch_target);
+               if (label < 0) {
+                  switch (state->syntax) {
+                     case ASM_GAS:    sprintf(label_name, ".L%08X", branch_target); break;
+                     case ASM_ARMIPS: sprintf(label_name, "@L%08X", branch_target); break;
                   }
+                  labels_add(&block->locals, label_name, branch_target);
                }
             }
          }
 
          if (state->merge_pseudo) {
-            switch (insn[i].id) {
+            switch (cur.id) {
                // find floating point LI
-               case MIPS_INS_MTC1:
+               case R4300_INS_MTC1:
                {
-                  unsigned int rt = insn[i].operands[0].reg;
+                  unsigned int rt = R4300_RT(&cur);
                   for (int s = i - 1; s >= 0; s--) {
-                     if (insn[s].id == MIPS_INS_LUI && insn[s].operands[0].reg == rt) {
-                        float f;
-                        uint32_t lui_imm = (uint32_t)(insn[s].operands[1].imm << 16);
-                        memcpy(&f, &lui_imm, sizeof(f));
-                        // link up the LUI with this instruction and the float
-                        insn[s].linked_insn = i;
-                        insn[s].linked_float = f;
+                     unsigned int id = insns->ids[s];
+                     unsigned int word = insns->words[s];
+                     if (id == R4300_INS_LUI && R4300_WORD_RT(word) == rt) {
+                        // link up the LUI with this instruction and the float bits
+                        insns->linked_insn[s] = i;
+                        insns->linked_value[s] = word << 16;
                         // rewrite LUI instruction to be LI
-                        insn[s].id = MIPS_INS_LI;
-                        strcpy(insn[s].mnemonic, "li");
+                        insns->ids[s] = R4300_INS_LI;
                         break;
-                     } else if (insn[s].id == MIPS_INS_LW ||
-                                insn[s].id == MIPS_INS_LD ||
-                                insn[s].id == MIPS_INS_LH ||
-                                insn[s].id == MIPS_INS_LHU ||
-                                insn[s].id == MIPS_INS_LB ||
-                                insn[s].id == MIPS_INS_LBU ||
-                                insn[s].id == MIPS_INS_ADDIU ||
-                                insn[s].id == MIPS_INS_ADD ||
-                                insn[s].id == MIPS_INS_SUB ||
-                                insn[s].id == MIPS_INS_SUBU) {
-                        unsigned int rd = insn[s].operands[0].reg;
-                        if (rt == rd) {
+                     } else if (id == R4300_INS_LW ||
+                                id == R4300_INS_LD ||
+                                id == R4300_INS_LH ||
+                                id == R4300_INS_LHU ||
+                                id == R4300_INS_LB ||
+                                id == R4300_INS_LBU ||
+                                id == R4300_INS_ADDIU ||
+                                id == R4300_INS_ADD ||
+                                id == R4300_INS_SUB ||
+                                id == R4300_INS_SUBU) {
+                        if (rt == dest_reg(id, word)) {
                            break;
                         }
-                     } else if (insn[s].id == MIPS_INS_JR &&
-                                insn[s].operands[0].reg == MIPS_REG_RA) {
+                     } else if (id == R4300_INS_JR && R4300_WORD_RS(word) == R4300_REG_RA) {
                         // stop looking when previous `jr ra` is hit
                         break;
                      }
                   }
                   break;
                }
-               case MIPS_INS_SD:
-               case MIPS_INS_SW:
-               case MIPS_INS_SH:
-               case MIPS_INS_SB:
-               case MIPS_INS_LB:
-               case MIPS_INS_LBU:
-               case MIPS_INS_LD:
-               case MIPS_INS_LDL:
-               case MIPS_INS_LDR:
-               case MIPS_INS_LH:
-               case MIPS_INS_LHU:
-               case MIPS_INS_LW:
-               case MIPS_INS_LWU:
-               case MIPS_INS_LWC1:
-               case MIPS_INS_LWC2:
-               case MIPS_INS_LWC3:
-               case MIPS_INS_SWC1:
-               case MIPS_INS_SWC2:
-               case MIPS_INS_SWC3:
-               {
-                  unsigned int mem_rs = insn[i].operands[1].mem.base;
-                  unsigned int mem_imm = (unsigned int)insn[i].operands[1].mem.disp;
-                  link_with_lui(state, block_id, i, mem_rs, mem_imm);
+               case R4300_INS_SD:
+               case R4300_INS_SW:
+               case R4300_INS_SH:
+               case R4300_INS_SB:
+               case R4300_INS_LB:
+               case R4300_INS_LBU:
+               case R4300_INS_LD:
+               case R4300_INS_LDL:
+               case R4300_INS_LDR:
+               case R4300_INS_LH:
+               case R4300_INS_LHU:
+               case R4300_INS_LW:
+               case R4300_INS_LWU:
+               case R4300_INS_LWC1:
+               case R4300_INS_SWC1:
+                  link_with_lui(state, ctx, block_id, i, R4300_RS(&cur), cur.imm);
                   break;
-               }
-               case MIPS_INS_ADDIU:
-               case MIPS_INS_ORI:
+               case R4300_INS_ADDIU:
+               case R4300_INS_ORI:
                {
-                  unsigned int rd = insn[i].operands[0].reg;
-                  unsigned int rs = insn[i].operands[1].reg;
-                  int64_t imm = insn[i].operands[2].imm;
-                  if (rs == MIPS_REG_ZERO) { // becomes LI
-                     insn[i].id = MIPS_INS_LI;
-                     strcpy(insn[i].mnemonic, "li");
-                     // TODO: is there allocation for this?
-                     sprintf(insn[i].op_str, "$%s, %" PRIi64, cs_reg_name(state->handle, rd), imm);
+                  unsigned int rd = R4300_RT(&cur);
+                  unsigned int rs = R4300_RS(&cur);
+                  if (rs == R4300_REG_ZERO) { // becomes LI
+                     insns->ids[i] = R4300_INS_LI;
                   } else if (rd == rs) { // only look for LUI if rd and rs are the same
-                     link_with_lui(state, block_id, i, rs, (unsigned int)imm);
+                     link_with_lui(state, ctx, block_id, i, rs, cur.imm);
                   }
                   break;
                }
+               default:
+                  break;
             }
          }
       }
@@ -357,31 +463,21 @@ disasm_state *disasm_state_init(asm_syntax syntax, int merge_pseudo)
    state->syntax = syntax;
    state->merge_pseudo = merge_pseudo;
 
-   // open capstone disassembler
-   if (cs_open(CS_ARCH_MIPS, CS_MODE_MIPS64 + CS_MODE_BIG_ENDIAN, &state->handle) != CS_ERR_OK) {
-      ERROR("Error initializing disassembler\n");
-      exit(EXIT_FAILURE);
-   }
-   cs_option(state->handle, CS_OPT_DETAIL, CS_OPT_ON);
-   cs_option(state->handle, CS_OPT_SKIPDATA, CS_OPT_ON);
-
    return state;
 }
 
 void disasm_state_free(disasm_state *state)
 {
    if (state) {
+      labels_free(&state->globals);
       for (int i = 0; i < state->block_count; i++) {
-         if (state->blocks[i].instructions) {
-            free(state->blocks[i].instructions);
-            state->blocks[i].instructions = NULL;
-         }
+         labels_free(&state->blocks[i].locals);
+         insns_free(&state->blocks[i].insns);
       }
       if (state->blocks) {
          free(state->blocks);
          state->blocks = NULL;
       }
-      cs_close(&state->handle);
    }
 }
 
@@ -395,14 +491,15 @@ int disasm_label_lookup(const disasm_state *state, unsigned int vaddr, char *nam
    int found = 0;
    int id = labels_find(&state->globals, vaddr);
    if (id >= 0) {
-      strcpy(name, state->globals.labels[id].name);
+      strcpy(name, labels_name(&state->globals, id));
       found = 1;
    }
    sprintf(name, "0x%08X", vaddr);
    return found;
 }
 
-void mipsdisasm_pass1(unsigned char *data, unsigned int offset, unsigned int length, unsigned int vaddr, disasm_state *state)
+// reserve and initialize the next block in the state
+static int block_add(disasm_state *state, unsigned int offset, unsigned int length, unsigned int vaddr)
 {
    if (state->block_count >= state->block_alloc) {
       state->block_alloc *= 2;
@@ -413,17 +510,112 @@ void mipsdisasm_pass1(unsigned char *data, unsigned int offset, unsigned int len
    block->offset = offset;
    block->length = length;
    block->vaddr = vaddr;
+   return state->block_count++;
+}
+
+void mipsdisasm_pass1(unsigned char *data, unsigned int offset, unsigned int length, unsigned int vaddr, disasm_state *state)
+{
+   pass1_ctx ctx;
+   int block_id = block_add(state, offset, length, vaddr);
+
+   // discovered global labels go straight into the state
+   ctx.globals = &state->globals;
+   ctx.found = &state->globals;
 
    // collect all branch and jump targets
-   disassemble_block(&data[offset], length, vaddr, state, state->block_count);
+   disassemble_block(&data[offset], length, vaddr, state, block_id, &ctx);
 
    // sort global and local labels
    labels_sort(&state->globals);
-   labels_sort(&state->blocks[state->block_count].locals);
-   state->block_count++;
+   labels_sort(&state->blocks[block_id].locals);
 }
 
-void mipsdisasm_pass2(FILE *out, disasm_state *state, unsigned int offset)
+typedef struct
+{
+   pthread_mutex_t lock;
+   int next;
+   int count;
+   int first_block;
+   unsigned char *data;
+   disasm_state *state;
+   label_buf *found;
+} pass1_queue;
+
+static void *pass1_worker(void *arg)
+{
+   pass1_queue *queue = arg;
+   disasm_state *state = queue->state;
+   pass1_ctx ctx;
+
+   ctx.globals = &state->globals;
+   while (1) {
+      int i;
+      pthread_mutex_lock(&queue->lock);
+      i = queue->next++;
+      pthread_mutex_unlock(&queue->lock);
+      if (i >= queue->count) {
+         break;
+      }
+      asm_block *block = &state->blocks[queue->first_block + i];
+      ctx.found = &queue->found[i];
+      disassemble_block(&queue->data[block->offset], block->length, block->vaddr, state, queue->first_block + i, &ctx);
+      labels_sort(&block->locals);
+   }
+   return NULL;
+}
+
+void mipsdisasm_pass1_multi(unsigned char *data, const disasm_range *ranges, int count, disasm_state *state, int threads)
+{
+   pass1_queue queue;
+   pthread_t *workers;
+   int i;
+
+   if (threads <= 0) {
+      threads = cpu_count();
+   }
+   threads = MAX(1, MIN(threads, count));
+
+   // reserve all blocks up front so the array doesn't move while workers run
+   queue.first_block = state->block_count;
+   for (i = 0; i < count; i++) {
+      block_add(state, ranges[i].offset, ranges[i].length, ranges[i].vaddr);
+   }
+   queue.next = 0;
+   queue.count = count;
+   queue.data = data;
+   queue.state = state;
+   queue.found = malloc(MAX(count, 1) * sizeof(*queue.found));
+   for (i = 0; i < count; i++) {
+      labels_alloc(&queue.found[i]);
+   }
+   pthread_mutex_init(&queue.lock, NULL);
+
+   // workers only read the existing global labels, new ones are collected per block
+   workers = malloc(threads * sizeof(*workers));
+   for (i = 0; i < threads; i++) {
+      pthread_create(&workers[i], NULL, pass1_worker, &queue);
+   }
+   for (i = 0; i < threads; i++) {
+      pthread_join(workers[i], NULL);
+   }
+   pthread_mutex_destroy(&queue.lock);
+   free(workers);
+
+   // merge in block order: first block to discover an address names it, as in serial passes
+   for (i = 0; i < count; i++) {
+      label_buf *found = &queue.found[i];
+      for (int l = 0; l < found->count; l++) {
+         if (labels_find(&state->globals, found->labels[l].vaddr) < 0) {
+            labels_add(&state->globals, labels_name(found, l), found->labels[l].vaddr);
+         }
+      }
+      labels_free(found);
+   }
+   free(queue.found);
+   labels_sort(&state->globals);
+}
+
+void mipsdisasm_pass2(outbuf *out, disasm_state *state, unsigned int offset)
 {
    asm_block *block = NULL;
    unsigned int vaddr;
@@ -450,251 +642,202 @@ void mipsdisasm_pass2(FILE *out, disasm_state *state, unsigned int offset)
    while ( (local_idx < block->locals.count) && (vaddr > block->locals.labels[local_idx].vaddr) ) {
       local_idx++;
    }
-   char previous_instruction[16];
    for (int i = 0; i < block->instruction_count; i++) {
-      disasm_data *insn = &block->instructions[i];
+      const insn_table *insns = &block->insns;
+      r4300_insn insn;
+      const r4300_insn *cur = &insn;
+      char mnemonic_buf[16];
+      // labels are short, target is at most one label name
+      char op_str[512];
+      insns_get(insns, i, vaddr, &insn);
+      const char *mnemonic = r4300_mnemonic(cur, mnemonic_buf);
+      const char *rt_name = (cur->flags & R4300_FPU) ? r4300_fpr_name(R4300_FT(cur)) : r4300_gpr_name(R4300_RT(cur));
       // newline between functions
-      if (insn->newline) {
-         fprintf(out, "\n");
+      if (insns->flags[i] & INSN_NEWLINE) {
+         outbuf_putc(out, '\n');
       }
       // insert all global labels at this address
       while ( (global_idx < state->globals.count) && (vaddr == state->globals.labels[global_idx].vaddr) ) {
-         fprintf(out, "%s:\n", state->globals.labels[global_idx].name);
+         outbuf_puts(out, labels_name(&state->globals, global_idx));
+         outbuf_puts(out, ":\n");
          global_idx++;
       }
       // insert all local labels at this address
       while ( (local_idx < block->locals.count) && (vaddr == block->locals.labels[local_idx].vaddr) ) {
-         fprintf(out, "%s:\n", block->locals.labels[local_idx].name);
+         outbuf_puts(out, labels_name(&block->locals, local_idx));
+         outbuf_puts(out, ":\n");
          local_idx++;
       }
       // write out bytes as comment
-      fprintf(out, "/* %06X %08X %02X%02X%02X%02X */  ", offset, vaddr, insn->bytes[0], insn->bytes[1], insn->bytes[2], insn->bytes[3]);
+      outbuf_puts(out, "/* ");
+      outbuf_hex(out, offset, 6);
+      outbuf_putc(out, ' ');
+      outbuf_hex(out, vaddr, 8);
+      outbuf_putc(out, ' ');
+      outbuf_hex(out, cur->word, 8);
+      outbuf_puts(out, " */  ");
       // indent the lines after a jump or branch
       if (indent) {
          indent = 0;
-         fputc(' ', out);
-      }
-      if (strncmp(insn->mnemonic,"movf",4) == 0 || strncmp(insn->mnemonic,"lsa",4) == 0 || strncmp(insn->mnemonic,"dlsa",4) == 0 
-            || strncmp(insn->mnemonic,"movn",4) == 0 || strncmp(insn->mnemonic,"ext",4) == 0 || strncmp(insn->mnemonic,"movt",4) == 0
-            || strncmp(insn->mnemonic,"movz",4) == 0 || strncmp(insn->mnemonic,"bbit",4) == 0 || strncmp(insn->mnemonic,"pref",4) == 0 
-            || strncmp(insn->mnemonic,"synci",5) == 0 || strncmp(insn->mnemonic,"ld.b",4) == 0 || strncmp(insn->mnemonic,"ori.b",4) == 0
-            || strncmp(insn->mnemonic,"pause",4) == 0 || strncmp(insn->mnemonic,"rotr",4) == 0 || strncmp(insn->mnemonic,"madd",4) == 0
-            || strncmp(insn->mnemonic,"nmsub",5) == 0 || strncmp(insn->mnemonic,"mz.",3) == 0
-            || strncmp(insn->mnemonic,"bc0",3) == 0 || strncmp(insn->mnemonic,"dmtc",4) == 0 || strncmp(insn->mnemonic,"sync",4) == 0
-            || strncmp(insn->mnemonic,"bseli",5) == 0 || strncmp(insn->mnemonic,"bnz.",4) == 0  || strncmp(insn->mnemonic,"snei",4) == 0
-            || strncmp(insn->mnemonic,"cle_s.",6) == 0 || strncmp(insn->mnemonic,"bz.",3) == 0 || strncmp(insn->mnemonic,"msub.",5) == 0
-            || strncmp(insn->mnemonic,"shrav.",5) == 0 || strncmp(insn->mnemonic,"din",3) == 0 || strncmp(insn->mnemonic,"cins",4) == 0
-            || strncmp(insn->mnemonic,"st.",3) == 0 || strncmp(insn->mnemonic,"shra",4) == 0 || strncmp(insn->mnemonic,"dextm",5) == 0
-            || strncmp(insn->mnemonic,"srl.",4) == 0 || strncmp(insn->mnemonic,"sra.",4) == 0
-            || strncmp(insn->mnemonic,"fmul.",4) == 0 || strncmp(insn->mnemonic,"dextu",5) == 0
-            )
-            {
-               // These instructions aren't supported on the N64 but capstone didn't know that
-               fprintf(out, ".byte 0x%02X,0x%02X,0x%02X,0x%02X /* Because of invalid n64 opcode %s */\n", insn->bytes[0], insn->bytes[1], insn->bytes[2], insn->bytes[3], insn->mnemonic);
-               strcpy(insn->mnemonic, ".byte");
-            }
-      else if (strncmp(previous_instruction,".byte",4) == 0 ) {
-         // fprintf(out, ".byte 0x%02X,0x%02X,0x%02X,0x%02X /* Because previous was .byte */\n", insn->bytes[0], insn->bytes[1], insn->bytes[2], insn->bytes[3]);
-         // strcpy(insn->mnemonic, ".byte");
+         outbuf_putc(out, ' ');
       }
-      else if (insn->is_jump) {
+      if (cur->id == R4300_INS_INVALID) {
+         // not a valid R4300i instruction
+         outbuf_puts(out, ".word 0x");
+         outbuf_hex(out, cur->word, 8);
+         outbuf_putc(out, '\n');
+      } else if (cur->flags & (R4300_JUMP | R4300_BRANCH)) {
+         const char *target = NULL;
+         char target_buf[16];
          indent = 1;
-         fprintf(out, "%-5s ", insn->mnemonic);
-         if (insn->id == MIPS_INS_JAL || insn->id == MIPS_INS_BAL || insn->id == MIPS_INS_J) {
-            unsigned int jal_target = (unsigned int)insn->operands[0].imm;
-            label = labels_find(&state->globals, jal_target);
+         if (cur->id == R4300_INS_JAL || cur->id == R4300_INS_BAL || cur->id == R4300_INS_J) {
+            label = labels_find(&state->globals, cur->imm);
             if (label >= 0) {
-               fprintf(out, "%s\n", state->globals.labels[label].name);
-            } else {
-               fprintf(out, "0x%08X\n", jal_target);
+               target = labels_name(&state->globals, label);
             }
          } else {
-            for (int o = 0; o < insn->op_count; o++) {
-               if (o > 0) {
-                  fprintf(out, ", ");
-               }
-               switch (insn->operands[o].type) {
-                  case MIPS_OP_REG:
-                     fprintf(out, "$%s", cs_reg_name(state->handle, insn->operands[o].reg));
-                     break;
-                  case MIPS_OP_IMM:
-                  {
-                     unsigned int branch_target = (unsigned int)insn->operands[o].imm;
-                     label = labels_find(&block->locals, branch_target);
-                     if (label >= 0) {
-                        fprintf(out, block->locals.labels[label].name);
-                     } else {
-                        fprintf(out, "0x%08X", branch_target);
-                     }
-                     break;
-                  }
-                  default:
-                     break;
-               }
+            label = labels_find(&block->locals, cur->imm);
+            if (label >= 0) {
+               target = labels_name(&block->locals, label);
             }
-            fprintf(out, "\n");
          }
-      } else if (insn->id == MIPS_INS_MTC0 || insn->id == MIPS_INS_MFC0) {
-         // workaround bug in capstone/LLVM
-         unsigned char rd;
-         // 31-24 23-16 15-8 7-0
-         // 0     1     2    3
-         //       31-26  25-21 20-16 15-11 10-0
-         // mfc0: 010000 00000   rt    rd  00000000000
-         // mtc0: 010000 00100   rt    rd  00000000000
-         //       010000 00100 00000 11101 000 0000 0000
-         // rt = insn->bytes[1] & 0x1F;
-         rd = (insn->bytes[2] & 0xF8) >> 3;
-         fprintf(out, "%-5s $%s, $%d\n", insn->mnemonic,
-                 cs_reg_name(state->handle, insn->operands[0].reg), rd);
+         if (target == NULL) {
+            sprintf(target_buf, "0x%08X", cur->imm);
+            target = target_buf;
+         }
+         r4300_operands(cur, op_str, target);
+         outbuf_puts_pad(out, mnemonic, 5);
+         outbuf_putc(out, ' ');
+         outbuf_puts(out, op_str);
+         outbuf_putc(out, '\n');
       } else {
-         int linked_insn = insn->linked_insn;
+         int linked_insn = insns->linked_insn[i];
+         unsigned int linked_value = insns->linked_value[i];
+         r4300_operands(cur, op_str, NULL);
          if (linked_insn >= 0) {
-            if (insn->id == MIPS_INS_LI) {
+            const char *rd_name = r4300_gpr_name(R4300_RT(cur));
+            if (cur->id == R4300_INS_LI) {
                // assume this is LUI converted to LI for matched MTC1
-               fprintf(out, "%-5s ", insn->mnemonic);
+               float linked_float;
+               memcpy(&linked_float, &linked_value, sizeof(linked_float));
+               outbuf_printf(out, "%-5s ", mnemonic);
                switch (state->syntax) {
                   case ASM_GAS:
-                     fprintf(out, "$%s, 0x%04X0000 # %f\n",
-                           cs_reg_name(state->handle, insn->operands[0].reg),
-                           (unsigned int)insn->operands[1].imm,
-                           insn->linked_float);
+                     outbuf_printf(out, "$%s, 0x%04X0000 # %f\n", rd_name, cur->imm, linked_float);
                      break;
                   case ASM_ARMIPS:
-                     fprintf(out, "$%s, 0x%04X0000 // %f\n",
-                           cs_reg_name(state->handle, insn->operands[0].reg),
-                           (unsigned int)insn->operands[1].imm,
-                           insn->linked_float);
+                     outbuf_printf(out, "$%s, 0x%04X0000 // %f\n", rd_name, cur->imm, linked_float);
                      break;
                   // TODO: this is ideal, but it doesn't work exactly for all floats since some emit imprecise float strings
                   /*
-                     fprintf(out, "$%s, %f // 0x%04X\n",
-                           cs_reg_name(state->handle, insn->operands[0].reg),
-                           insn->linked_float,
-                           (unsigned int)insn->operands[1].imm);
+                     outbuf_printf(out, "$%s, %f // 0x%04X\n", rd_name, linked_float, cur->imm);
                      break;
                    */
                }
-            } else if (insn->id == MIPS_INS_LUI) {
-               label = labels_find(&state->globals, insn->linked_value);
+            } else if (cur->id == R4300_INS_LUI) {
+               label = labels_find(&state->globals, linked_value);
                // assume matched LUI with ADDIU/LW/SW etc.
                switch (state->syntax) {
                   case ASM_GAS:
-                     switch (block->instructions[linked_insn].id) {
-                        case MIPS_INS_ADDIU:
-                           fprintf(out, "%-5s $%s, %%hi(%s) # %s\n", insn->mnemonic,
-                                 cs_reg_name(state->handle, insn->operands[0].reg),
-                                 state->globals.labels[label].name, insn->op_str);
+                     switch (block->insns.ids[linked_insn]) {
+                        case R4300_INS_ADDIU:
+                           outbuf_printf(out, "%-5s $%s, %%hi(%s) # %s\n", mnemonic, rd_name,
+                                 labels_name(&state->globals, label), op_str);
                            break;
-                        case MIPS_INS_ORI:
-                           fprintf(out, "%-5s $%s, (0x%08X >> 16) # %s %s\n", insn->mnemonic,
-                                 cs_reg_name(state->handle, insn->operands[0].reg),
-                                 insn->linked_value, insn->mnemonic, insn->op_str);
+                        case R4300_INS_ORI:
+                           outbuf_printf(out, "%-5s $%s, (0x%08X >> 16) # %s %s\n", mnemonic, rd_name,
+                                 linked_value, mnemonic, op_str);
                            break;
                         default: // LW/SW/etc.
-                           fprintf(out, "%-5s $%s, %%hi(%s) # %s\n", insn->mnemonic,
-                                 cs_reg_name(state->handle, insn->operands[0].reg),
-                                 state->globals.labels[label].name, insn->op_str);
+                           outbuf_printf(out, "%-5s $%s, %%hi(%s) # %s\n", mnemonic, rd_name,
+                                 labels_name(&state->globals, label), op_str);
                            break;
                      }
                      break;
                   case ASM_ARMIPS:
-                     switch (block->instructions[linked_insn].id) {
-                        case MIPS_INS_ADDIU:
-                           fprintf(out, "%-5s $%s, %s // %s %s\n", "la.u",
-                                 cs_reg_name(state->handle, insn->operands[0].reg),
-                                 state->globals.labels[label].name,
-                                 insn->mnemonic, insn->op_str);
+                     switch (block->insns.ids[linked_insn]) {
+                        case R4300_INS_ADDIU:
+                           outbuf_printf(out, "%-5s $%s, %s // %s %s\n", "la.u", rd_name,
+                                 labels_name(&state->globals, label), mnemonic, op_str);
                            break;
-                        case MIPS_INS_ORI:
-                           fprintf(out, "%-5s $%s, 0x%08X // %s %s\n", "li.u",
-                                 cs_reg_name(state->handle, insn->operands[0].reg),
-                                 insn->linked_value, insn->mnemonic, insn->op_str);
+                        case R4300_INS_ORI:
+                           outbuf_printf(out, "%-5s $%s, 0x%08X // %s %s\n", "li.u", rd_name,
+                                 linked_value, mnemonic, op_str);
                            break;
                         default: // LW/SW/etc.
-                           fprintf(out, "%-5s $%s, hi(%s) // %s\n", insn->mnemonic,
-                                 cs_reg_name(state->handle, insn->operands[0].reg),
-                                 state->globals.labels[label].name, insn->op_str);
+                           outbuf_printf(out, "%-5s $%s, hi(%s) // %s\n", mnemonic, rd_name,
+                                 labels_name(&state->globals, label), op_str);
                            break;
                      }
                      break;
                }
-            } else if (insn->id == MIPS_INS_ADDIU) {
-               label = labels_find(&state->globals, insn->linked_value);
+            } else if (cur->id == R4300_INS_ADDIU) {
+               label = labels_find(&state->globals, linked_value);
                switch (state->syntax) {
                   case ASM_GAS:
-                     fprintf(out, "%-5s $%s, %%lo(%s) # %s %s\n", insn->mnemonic,
-                           cs_reg_name(state->handle, insn->operands[0].reg),
-                           state->globals.labels[label].name,
-                           insn->mnemonic, insn->op_str);
+                     outbuf_printf(out, "%-5s $%s, %%lo(%s) # %s %s\n", mnemonic, rd_name,
+                           labels_name(&state->globals, label), mnemonic, op_str);
                      break;
                   case ASM_ARMIPS:
-                     fprintf(out, "%-5s $%s, %s // %s %s\n", "la.l",
-                           cs_reg_name(state->handle, insn->operands[0].reg),
-                           state->globals.labels[label].name,
-                           insn->mnemonic, insn->op_str);
+                     outbuf_printf(out, "%-5s $%s, %s // %s %s\n", "la.l", rd_name,
+                           labels_name(&state->globals, label), mnemonic, op_str);
                      break;
                }
-            } else if (insn->id == MIPS_INS_ORI) {
+            } else if (cur->id == R4300_INS_ORI) {
                switch (state->syntax) {
                   case ASM_GAS:
-                     fprintf(out, "%-5s $%s, (0x%08X & 0xFFFF) # %s %s\n", insn->mnemonic,
-                           cs_reg_name(state->handle, insn->operands[0].reg),
-                           insn->linked_value,
-                           insn->mnemonic, insn->op_str);
+                     outbuf_printf(out, "%-5s $%s, (0x%08X & 0xFFFF) # %s %s\n", mnemonic, rd_name,
+                           linked_value, mnemonic, op_str);
                      break;
                   case ASM_ARMIPS:
-                     fprintf(out, "%-5s $%s, 0x%08X // %s %s\n", "li.l",
-                           cs_reg_name(state->handle, insn->operands[0].reg),
-                           insn->linked_value,
-                           insn->mnemonic, insn->op_str);
+                     outbuf_printf(out, "%-5s $%s, 0x%08X // %s %s\n", "li.l", rd_name,
+                           linked_value, mnemonic, op_str);
                      break;
                }
             } else {
-               label = labels_find(&state->globals, insn->linked_value);
-               fprintf(out, "%-5s $%s, %slo(%s)($%s)\n", insn->mnemonic,
-                     cs_reg_name(state->handle, insn->operands[0].reg),
+               label = labels_find(&state->globals, linked_value);
+               outbuf_printf(out, "%-5s $%s, %slo(%s)($%s)\n", mnemonic, rt_name,
                      state->syntax == ASM_GAS ? "%" : "",
-                     state->globals.labels[label].name,
-                     cs_reg_name(state->handle, insn->operands[1].reg));
+                     labels_name(&state->globals, label),
+                     r4300_gpr_name(R4300_RS(cur)));
             }
          } else {
-            fprintf(out, "%-5s %s\n", insn->mnemonic, insn->op_str);
+            outbuf_puts_pad(out, mnemonic, 5);
+            outbuf_putc(out, ' ');
+            outbuf_puts(out, op_str);
+            outbuf_putc(out, '\n');
          }
       }
       vaddr += 4;
       offset += 4;
-      strcpy(previous_instruction, insn->mnemonic);
    }
 }
 
 const char *disasm_get_version(void)
 {
-   static char version[32];
+#ifdef USE_CAPSTONE
+   static char version[48];
    int major, minor;
    (void)cs_version(&major, &minor);
-   // TODO: manually keeping track of capstone revision number
-   sprintf(version, "capstone %d.%d.4", major, minor);
+   sprintf(version, "r4300 " MIPSDISASM_VERSION " (capstone %d.%d)", major, minor);
    return version;
+#else
+   return "r4300 " MIPSDISASM_VERSION;
+#endif
 }
 
 #ifdef MIPSDISASM_STANDALONE
 typedef struct
 {
-   unsigned int start;
-   unsigned int length;
-   unsigned int vaddr;
-} range;
-
-typedef struct
-{
-   range *ranges;
+   disasm_range *ranges;
    int range_count;
    unsigned int vaddr;
    char *input_file;
    char *output_file;
    int merge_pseudo;
    asm_syntax syntax;
+   int threads;
+   int cross_check;
 } arg_config;
 
 static arg_config default_args =
@@ -706,19 +849,29 @@ static arg_config default_args =
    NULL, // output_file
    0,    // merge_pseudo
    ASM_GAS, // GNU as
+   0,    // threads: number of processors
+   0,    // cross_check
 };
 
 static void print_usage(void)
 {
-   ERROR("Usage: mipsdisasm [-o OUTPUT] [-p] [-s ASSEMBLER] [-v] ROM [RANGES]\n"
+   ERROR("Usage: mipsdisasm [-j THREADS] [-o OUTPUT] [-p] [-s ASSEMBLER] [-v]"
+#ifdef USE_CAPSTONE
+         " [-x]"
+#endif
+         " ROM [RANGES]\n"
          "\n"
          "mipsdisasm v" MIPSDISASM_VERSION ": MIPS disassembler\n"
          "\n"
          "Optional arguments:\n"
+         " -j THREADS   number of threads for first pass (default: number of processors)\n"
          " -o OUTPUT    output filename (default: stdout)\n"
          " -p           emit pseudoinstructions for related instructions\n"
          " -s SYNTAX    assembler syntax to use [gas, armips] (default: gas)\n"
          " -v           verbose progress output\n"
+#ifdef USE_CAPSTONE
+         " -x           compare decoded instructions against capstone and exit\n"
+#endif
          "\n"
          "Arguments:\n"
          " FILE         input binary file to disassemble\n"
@@ -728,16 +881,16 @@ static void print_usage(void)
    exit(EXIT_FAILURE);
 }
 
-void range_parse(range *r, const char *arg)
+void range_parse(disasm_range *r, const char *arg)
 {
    char *colon = strchr(arg, ':');
    r->vaddr = strtoul(arg, NULL, 0);
    if (colon) {
       char *minus = strchr(colon+1, '-');
       char *plus = strchr(colon+1, '+');
-      r->start = strtoul(colon+1, NULL, 0);
+      r->offset = strtoul(colon+1, NULL, 0);
       if (minus) {
-         r->length = strtoul(minus+1, NULL, 0) - r->start;
+         r->length = strtoul(minus+1, NULL, 0) - r->offset;
       } else if (plus) {
          r->length = strtoul(plus+1, NULL, 0);
       }
@@ -757,6 +910,12 @@ static void parse_arguments(int argc, char *argv[], arg_config *config)
    for (int i = 1; i < argc; i++) {
       if (argv[i][0] == '-') {
          switch (argv[i][1]) {
+            case 'j':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->threads = strtol(argv[i], NULL, 0);
+               break;
             case 'o':
                if (++i >= argc) {
                   print_usage();
@@ -784,6 +943,11 @@ static void parse_arguments(int argc, char *argv[], arg_config *config)
             case 'v':
                g_verbosity = 1;
                break;
+#ifdef USE_CAPSTONE
+            case 'x':
+               config->cross_check = 1;
+               break;
+#endif
             default:
                print_usage();
                break;
@@ -803,22 +967,61 @@ static void parse_arguments(int argc, char *argv[], arg_config *config)
    }
 }
 
+#ifdef USE_CAPSTONE
+// compare native decoder text against capstone for one range
+// returns number of mismatched instructions
+static int cross_check_range(unsigned char *data, const disasm_range *r)
+{
+   csh handle;
+   int mismatches = 0;
+   if (cs_open(CS_ARCH_MIPS, CS_MODE_MIPS64 + CS_MODE_BIG_ENDIAN, &handle) != CS_ERR_OK) {
+      ERROR("Error initializing disassembler\n");
+      exit(EXIT_FAILURE);
+   }
+   for (unsigned int o = 0; o + 4 <= r->length; o += 4) {
+      cs_insn *insn;
+      r4300_insn native;
+      char mnemonic_buf[16];
+      char native_str[128];
+      char cs_str[192];
+      unsigned int vaddr = r->vaddr + o;
+      int len;
+      r4300_decode(read_u32_be(&data[r->offset + o]), vaddr, &native);
+      len = sprintf(native_str, "%s ", r4300_mnemonic(&native, mnemonic_buf));
+      r4300_operands(&native, &native_str[len], NULL);
+      if (cs_disasm(handle, &data[r->offset + o], 4, vaddr, 1, &insn) == 1) {
+         sprintf(cs_str, "%s %s", insn->mnemonic, insn->op_str);
+         cs_free(insn, 1);
+      } else {
+         strcpy(cs_str, "invalid ");
+      }
+      if (strcmp(native_str, cs_str) != 0) {
+         ERROR("%08X %08X: native \"%s\", capstone \"%s\"\n", vaddr, native.word, native_str, cs_str);
+         mismatches++;
+      }
+   }
+   cs_close(&handle);
+   return mismatches;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
    arg_config args;
    long file_len;
    disasm_state *state;
    unsigned char *data;
-   FILE *out;
+   FILE *fout;
+   outbuf *out;
 
    // load defaults and parse arguments
-   out = stdout;
+   fout = stdout;
    args = default_args;
    parse_arguments(argc, argv, &args);
 
    // read input file
    INFO("Reading input file '%s'\n", args.input_file);
-   file_len = read_file(args.input_file, &data);
+   file_len = map_file(args.input_file, &data);
    if (file_len <= 0) {
       ERROR("Error reading input file '%s'\n", args.input_file);
       return EXIT_FAILURE;
@@ -827,8 +1030,8 @@ int main(int argc, char *argv[])
    // if specified, open output file
    if (args.output_file != NULL) {
       INFO("Opening output file '%s'\n", args.output_file);
-      out = fopen(args.output_file, "w");
-      if (out == NULL) {
+      fout = fopen(args.output_file, "w");
+      if (fout == NULL) {
          ERROR("Error opening output file '%s'\n", args.output_file);
          return EXIT_FAILURE;
       }
@@ -839,16 +1042,32 @@ int main(int argc, char *argv[])
       if (args.range_count < 1) {
          args.ranges[0].vaddr = 0;
       }
-      args.ranges[0].start = 0;
+      args.ranges[0].offset = 0;
       args.ranges[0].length = file_len;
       args.range_count = 1;
    }
 
+#ifdef USE_CAPSTONE
+   if (args.cross_check) {
+      int mismatches = 0;
+      unsigned int total = 0;
+      for (int i = 0; i < args.range_count; i++) {
+         mismatches += cross_check_range(data, &args.ranges[i]);
+         total += args.ranges[i].length / 4;
+      }
+      printf("%d of %u instructions differ from capstone\n", mismatches, total);
+      unmap_file(data, file_len);
+      return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+   }
+#endif
+
+   out = outbuf_wrap(fout);
+
    // assembler header output
    switch (args.syntax) {
       case ASM_GAS:
-         fprintf(out, ".set noat      # allow manual use of $at\n");
-         fprintf(out, ".set noreorder # don't insert nops after branches\n\n");
+         outbuf_puts(out, ".set noat      # allow manual use of $at\n");
+         outbuf_puts(out, ".set noreorder # don't insert nops after branches\n\n");
          break;
       case ASM_ARMIPS:
       {
@@ -859,8 +1078,8 @@ int main(int argc, char *argv[])
             const char *base = basename(args.output_file);
             generate_filename(base, output_binary, "bin");
          }
-         fprintf(out, ".n64\n");
-         fprintf(out, ".create \"%s\", 0x%08X\n\n", output_binary, 0);
+         outbuf_puts(out, ".n64\n");
+         outbuf_printf(out, ".create \"%s\", 0x%08X\n\n", output_binary, 0);
          break;
       }
       default:
@@ -870,12 +1089,13 @@ int main(int argc, char *argv[])
    state = disasm_state_init(args.syntax, args.merge_pseudo);
 
    // run first pass disassembler on each section
+   double time_start = get_time();
    for (int i = 0; i < args.range_count; i++) {
-      range *r = &args.ranges[i];
-      INFO("Disassembling range 0x%X-0x%X at 0x%08X\n", r->start, r->start + r->length, r->vaddr);
-
-      (void)mipsdisasm_pass1(data, r->start, r->length, r->vaddr, state);
+      disasm_range *r = &args.ranges[i];
+      INFO("Disassembling range 0x%X-0x%X at 0x%08X\n", r->offset, r->offset + r->length, r->vaddr);
    }
+   mipsdisasm_pass1_multi(data, args.ranges, args.range_count, state, args.threads);
+   INFO("First pass: %.3f s, %d global labels\n", get_time() - time_start, state->globals.count);
 
    // output global labels not in asm sections
    if (args.syntax == ASM_ARMIPS) {
@@ -890,21 +1110,21 @@ int main(int argc, char *argv[])
             }
          }
          if (!global_in_asm) {
-            fprintf(out, ".definelabel %s, 0x%08X\n", state->globals.labels[i].name, vaddr);
+            outbuf_printf(out, ".definelabel %s, 0x%08X\n", labels_name(&state->globals, i), vaddr);
          }
       }
    }
-   fprintf(out, "\n");
+   outbuf_putc(out, '\n');
 
    // output each section
    for (int i = 0; i < args.range_count; i++) {
-      range *r = &args.ranges[i];
+      disasm_range *r = &args.ranges[i];
       if (args.syntax == ASM_ARMIPS) {
-         fprintf(out, ".headersize 0x%08X\n\n", r->vaddr);
+         outbuf_printf(out, ".headersize 0x%08X\n\n", r->vaddr);
       }
 
       // second pass, generate output
-      mipsdisasm_pass2(out, state, r->start);
+      mipsdisasm_pass2(out, state, r->offset);
    }
 
    disasm_state_free(state);
@@ -912,13 +1132,17 @@ int main(int argc, char *argv[])
    // assembler footer output
    switch (args.syntax) {
       case ASM_ARMIPS:
-         fprintf(out, "\n.close\n");
+         outbuf_puts(out, "\n.close\n");
          break;
       default:
          break;
    }
 
-   free(data);
+   outbuf_close(out);
+   if (fout != stdout) {
+      fclose(fout);
+   }
+   unmap_file(data, file_len);
 
    return EXIT_SUCCESS;
 }
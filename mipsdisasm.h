@@ -1,6 +1,8 @@
 #ifndef MIPSDISASM_H_
 #define MIPSDISASM_H_
 
+#include "strutils.h"
+
 // typedefs
 typedef struct _disasm_state disasm_state;
 
@@ -10,6 +12,14 @@ typedef enum
    ASM_ARMIPS, // armips
 } asm_syntax;
 
+// region of code to disassemble
+typedef struct
+{
+   unsigned int offset; // buffer offset to start at
+   unsigned int length; // length to disassemble starting at 'offset'
+   unsigned int vaddr;  // virtual address of first byte
+} disasm_range;
+
 // allocate and initialize disassembler state to be passed into disassembler routines
 // syntax: assembler syntax to use
 // merge_pseudo: if true, attempt to link pseudo instructions
@@ -42,11 +52,20 @@ int disasm_label_lookup(const disasm_state *state, unsigned int vaddr, char *nam
 // state: disassembler state. if NULL, is allocated, returned at end
 void mipsdisasm_pass1(unsigned char *data, unsigned int offset, unsigned int length, unsigned int vaddr, disasm_state *state);
 
-// disassemble a region of code, output to file stream
-// out: stream to output data to
+// first pass of disassembler on several regions in parallel
+// state is identical to calling mipsdisasm_pass1() on each range in order
+// data: buffer containing raw MIPS assembly
+// ranges: regions of 'data' to disassemble
+// count: number of entries in 'ranges'
+// state: disassembler state
+// threads: number of worker threads, 0 to use number of processors
+void mipsdisasm_pass1_multi(unsigned char *data, const disasm_range *ranges, int count, disasm_state *state, int threads);
+
+// disassemble a region of code, output to buffered stream
+// out: output buffer to write text to
 // state: disassembler state from pass1
 // offset: starting offset to match in disassembler state
-void mipsdisasm_pass2(FILE *out, disasm_state *state, unsigned int offset);
+void mipsdisasm_pass2(outbuf *out, disasm_state *state, unsigned int offset);
 
 // get version string of raw disassembler
 const char *disasm_get_version(void);
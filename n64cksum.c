@@ -1,52 +1,133 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
 #include "libsm64.h"
 #include "utils.h"
 
-#define N64CKSUM_VERSION "0.1"
+#define N64CKSUM_VERSION "0.2"
 
 static void print_usage(void)
 {
-   ERROR("Usage: n64cksum ROM [ROM_OUT]\n"
+   ERROR("Usage: n64cksum [--cic CIC] [-v] ROM [ROM_OUT]\n"
          "\n"
          "n64cksum v" N64CKSUM_VERSION ": N64 ROM checksum calculator\n"
          "\n"
+         "Optional arguments:\n"
+         " --cic CIC    boot chip: 6101, 6102, 6103, 6105 or 6106 (default: 6102)\n"
+         " -v           verbose output\n"
+         "\n"
          "File arguments:\n"
          " ROM          input ROM file\n"
          " ROM_OUT      output ROM file (default: overwrites input ROM)\n");
+   exit(EXIT_FAILURE);
+}
+
+static cic_type parse_cic(const char *name)
+{
+   static const struct {const char *name; cic_type cic;} cics[] = {
+      {"6101", CIC_6101},
+      {"6102", CIC_6102},
+      {"6103", CIC_6103},
+      {"6105", CIC_6105},
+      {"6106", CIC_6106},
+   };
+   for (unsigned i = 0; i < DIM(cics); i++) {
+      if (!strcmp(name, cics[i].name)) {
+         return cics[i].cic;
+      }
+   }
+   ERROR("Error: unknown CIC \"%s\"\n", name);
+   print_usage();
+   return CIC_6102;
+}
+
+// determine if two paths refer to the same file
+static int same_file(const char *a, const char *b)
+{
+   struct stat st_a, st_b;
+   if (!strcmp(a, b)) {
+      return 1;
+   }
+   if (stat(a, &st_a) != 0 || stat(b, &st_b) != 0) {
+      return 0;
+   }
+   // st_ino is always 0 on Windows
+   return st_a.st_ino != 0 && st_a.st_dev == st_b.st_dev && st_a.st_ino == st_b.st_ino;
+}
+
+// update checksums in ROM file without rewriting the rest of it
+// returns 8 on success
+static long write_checksums(const char *file_name, const unsigned char *rom_data)
+{
+   long write_length;
+   FILE *fp = fopen(file_name, "r+b");
+   if (fp == NULL) {
+      return -1;
+   }
+   fseek(fp, 0x10, SEEK_SET);
+   write_length = fwrite(&rom_data[0x10], 1, 8, fp);
+   fclose(fp);
+   return write_length;
 }
 
 int main(int argc, char *argv[])
 {
    unsigned char *rom_data;
-   char *file_in;
-   char *file_out;
+   char *file_in = NULL;
+   char *file_out = NULL;
+   cic_type cic = CIC_6102;
    long length;
    long write_length;
-   if (argc < 2) {
+
+   for (int i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "--cic")) {
+         if (++i >= argc) {
+            print_usage();
+         }
+         cic = parse_cic(argv[i]);
+      } else if (!strcmp(argv[i], "-v")) {
+         g_verbosity = 1;
+      } else if (argv[i][0] == '-') {
+         print_usage();
+      } else if (file_in == NULL) {
+         file_in = argv[i];
+      } else if (file_out == NULL) {
+         file_out = argv[i];
+      } else {
+         print_usage();
+      }
+   }
+   if (file_in == NULL) {
       print_usage();
-      return EXIT_FAILURE;
    }
-
-   file_in = argv[1];
-   if (argc > 2) {
-      file_out = argv[2];
-   } else {
-      file_out = argv[1];
+   if (file_out == NULL) {
+      file_out = file_in;
    }
 
-   length = read_file(file_in, &rom_data);
+   length = map_file(file_in, &rom_data);
    if (length < 0) {
       ERROR("Error reading input file \"%s\"\n", file_in);
       return EXIT_FAILURE;
    }
+   // checksums cover 0x1000-0x101000
+   if (length < 0x101000) {
+      ERROR("Error: input file \"%s\" is too small for a ROM (0x%lX bytes)\n", file_in, length);
+      unmap_file(rom_data, length);
+      return EXIT_FAILURE;
+   }
 
-   sm64_update_checksums(rom_data);
+   sm64_update_checksums(rom_data, cic);
 
-   write_length = write_file(file_out, rom_data, length);
+   if (same_file(file_in, file_out)) {
+      // overwriting the whole mapped file would truncate it while in use
+      write_length = write_checksums(file_out, rom_data) == 8 ? length : -1;
+   } else {
+      write_length = write_file(file_out, rom_data, length);
+   }
 
-   free(rom_data);
+   unmap_file(rom_data, length);
 
    if (write_length != length) {
       ERROR("Error writing to output file \"%s\"\n", file_out);
@@ -1,7 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define STBI_NO_LINEAR
 #define STBI_NO_HDR
 #define STBI_NO_TGA
@@ -9,6 +16,7 @@
 #include <stb/stb_image.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb/stb_image_write.h>
+#include <zlib.h>
 
 #include "n64graphics.h"
 #include "utils.h"
@@ -34,10 +42,642 @@ typedef struct
     int depth;
 } img_format;
 
+//---------------------------------------------------------
+// conversion kernels
+// each converts 'count' pixels, SIMD kernels are bit-exact with the scalar ones
+//---------------------------------------------------------
+
+typedef struct
+{
+   void (*raw2rgba16)(rgba *img, const uint8_t *raw, int count);
+   void (*raw2rgba32)(rgba *img, const uint8_t *raw, int count);
+   void (*raw2ia16)(ia *img, const uint8_t *raw, int count);
+   void (*raw2ia8)(ia *img, const uint8_t *raw, int count);
+   void (*raw2ia4)(ia *img, const uint8_t *raw, int count);
+   void (*raw2ia1)(ia *img, const uint8_t *raw, int count);
+   void (*raw2i8)(ia *img, const uint8_t *raw, int count);
+   void (*raw2i4)(ia *img, const uint8_t *raw, int count);
+   void (*rgba2raw16)(uint8_t *raw, const rgba *img, int count);
+   void (*rgba2raw32)(uint8_t *raw, const rgba *img, int count);
+   void (*ia2raw16)(uint8_t *raw, const ia *img, int count);
+   void (*ia2raw8)(uint8_t *raw, const ia *img, int count);
+   void (*ia2raw4)(uint8_t *raw, const ia *img, int count);
+   void (*ia2raw1)(uint8_t *raw, const ia *img, int count);
+   void (*i2raw8)(uint8_t *raw, const ia *img, int count);
+   void (*i2raw4)(uint8_t *raw, const ia *img, int count);
+} tex_kernels;
+
+static void raw2rgba16_scalar(rgba *img, const uint8_t *raw, int count)
+{
+   for (int i = 0; i < count; i++) {
+      img[i].red   = SCALE_5_8((raw[i*2] & 0xF8) >> 3);
+      img[i].green = SCALE_5_8(((raw[i*2] & 0x07) << 2) | ((raw[i*2+1] & 0xC0) >> 6));
+      img[i].blue  = SCALE_5_8((raw[i*2+1] & 0x3E) >> 1);
+      img[i].alpha = (raw[i*2+1] & 0x01) ? 0xFF : 0x00;
+   }
+}
+
+static void raw2rgba32_scalar(rgba *img, const uint8_t *raw, int count)
+{
+   for (int i = 0; i < count; i++) {
+      img[i].red   = raw[i*4];
+      img[i].green = raw[i*4+1];
+      img[i].blue  = raw[i*4+2];
+      img[i].alpha = raw[i*4+3];
+   }
+}
+
+static void raw2ia16_scalar(ia *img, const uint8_t *raw, int count)
+{
+   for (int i = 0; i < count; i++) {
+      img[i].intensity = raw[i*2];
+      img[i].alpha     = raw[i*2+1];
+   }
+}
+
+static void raw2ia8_scalar(ia *img, const uint8_t *raw, int count)
+{
+   for (int i = 0; i < count; i++) {
+      img[i].intensity = SCALE_4_8((raw[i] & 0xF0) >> 4);
+      img[i].alpha     = SCALE_4_8(raw[i] & 0x0F);
+   }
+}
+
+static void raw2ia4_scalar(ia *img, const uint8_t *raw, int count)
+{
+   for (int i = 0; i < count; i++) {
+      uint8_t bits;
+      bits = raw[i/2];
+      if (i % 2) {
+         bits &= 0xF;
+      } else {
+         bits >>= 4;
+      }
+      img[i].intensity = SCALE_3_8((bits >> 1) & 0x07);
+      img[i].alpha     = (bits & 0x01) ? 0xFF : 0x00;
+   }
+}
+
+static void raw2ia1_scalar(ia *img, const uint8_t *raw, int count)
+{
+   for (int i = 0; i < count; i++) {
+      uint8_t bits;
+      uint8_t mask;
+      bits = raw[i/8];
+      mask = 1 << (7 - (i % 8)); // MSb->LSb
+      bits = (bits & mask) ? 0xFF : 0x00;
+      img[i].intensity = bits;
+      img[i].alpha     = bits;
+   }
+}
+
+static void raw2i8_scalar(ia *img, const uint8_t *raw, int count)
+{
+   for (int i = 0; i < count; i++) {
+      img[i].intensity = raw[i];
+      img[i].alpha     = 0xFF;
+   }
+}
+
+static void raw2i4_scalar(ia *img, const uint8_t *raw, int count)
+{
+   for (int i = 0; i < count; i++) {
+      uint8_t bits;
+      bits = raw[i/2];
+      if (i % 2) {
+         bits &= 0xF;
+      } else {
+         bits >>= 4;
+      }
+      img[i].intensity = SCALE_4_8(bits);
+      img[i].alpha     = 0xFF;
+   }
+}
+
+static void rgba2raw16_scalar(uint8_t *raw, const rgba *img, int count)
+{
+   for (int i = 0; i < count; i++) {
+      uint8_t r, g, b, a;
+      r = SCALE_8_5(img[i].red);
+      g = SCALE_8_5(img[i].green);
+      b = SCALE_8_5(img[i].blue);
+      a = img[i].alpha ? 0x1 : 0x0;
+      raw[i*2]   = (r << 3) | (g >> 2);
+      raw[i*2+1] = ((g & 0x3) << 6) | (b << 1) | a;
+   }
+}
+
+static void rgba2raw32_scalar(uint8_t *raw, const rgba *img, int count)
+{
+   for (int i = 0; i < count; i++) {
+      raw[i*4]   = img[i].red;
+      raw[i*4+1] = img[i].green;
+      raw[i*4+2] = img[i].blue;
+      raw[i*4+3] = img[i].alpha;
+   }
+}
+
+static void ia2raw16_scalar(uint8_t *raw, const ia *img, int count)
+{
+   for (int i = 0; i < count; i++) {
+      raw[i*2]   = img[i].intensity;
+      raw[i*2+1] = img[i].alpha;
+   }
+}
+
+static void ia2raw8_scalar(uint8_t *raw, const ia *img, int count)
+{
+   for (int i = 0; i < count; i++) {
+      uint8_t val = SCALE_8_4(img[i].intensity);
+      uint8_t alpha = SCALE_8_4(img[i].alpha);
+      raw[i] = (val << 4) | alpha;
+   }
+}
+
+static void ia2raw4_scalar(uint8_t *raw, const ia *img, int count)
+{
+   for (int i = 0; i < count; i++) {
+      uint8_t val = SCALE_8_3(img[i].intensity);
+      uint8_t alpha = img[i].alpha ? 0x01 : 0x00;
+      uint8_t old = raw[i/2];
+      if (i % 2) {
+         raw[i/2] = (old & 0xF0) | (val << 1) | alpha;
+      } else {
+         raw[i/2] = (old & 0x0F) | (((val << 1) | alpha) << 4);
+      }
+   }
+}
+
+static void ia2raw1_scalar(uint8_t *raw, const ia *img, int count)
+{
+   for (int i = 0; i < count; i++) {
+      uint8_t val = img[i].intensity;
+      uint8_t old = raw[i/8];
+      uint8_t bit = 1 << (7 - (i % 8));
+      if (val) {
+         raw[i/8] = old | bit;
+      } else {
+         raw[i/8] = old & (~bit);
+      }
+   }
+}
+
+static void i2raw8_scalar(uint8_t *raw, const ia *img, int count)
+{
+   for (int i = 0; i < count; i++) {
+      raw[i] = img[i].intensity;
+   }
+}
+
+static void i2raw4_scalar(uint8_t *raw, const ia *img, int count)
+{
+   for (int i = 0; i < count; i++) {
+      uint8_t val = SCALE_8_4(img[i].intensity);
+      uint8_t old = raw[i/2];
+      if (i % 2) {
+         raw[i/2] = (old & 0xF0) | val;
+      } else {
+         raw[i/2] = (old & 0x0F) | (val << 4);
+      }
+   }
+}
+
+static const tex_kernels kernels_scalar =
+{
+   raw2rgba16_scalar, raw2rgba32_scalar,
+   raw2ia16_scalar, raw2ia8_scalar, raw2ia4_scalar, raw2ia1_scalar,
+   raw2i8_scalar, raw2i4_scalar,
+   rgba2raw16_scalar, rgba2raw32_scalar,
+   ia2raw16_scalar, ia2raw8_scalar, ia2raw4_scalar, ia2raw1_scalar,
+   i2raw8_scalar, i2raw4_scalar,
+};
+
+#if defined(__SSE2__)
+// formats that are plain byte copies of the intermediate layout
+static void raw2rgba32_copy(rgba *img, const uint8_t *raw, int count)
+{
+   memcpy(img, raw, count * sizeof(*img));
+}
+
+static void raw2ia16_copy(ia *img, const uint8_t *raw, int count)
+{
+   memcpy(img, raw, count * sizeof(*img));
+}
+
+static void rgba2raw32_copy(uint8_t *raw, const rgba *img, int count)
+{
+   memcpy(raw, img, count * sizeof(*img));
+}
+
+static void ia2raw16_copy(uint8_t *raw, const ia *img, int count)
+{
+   memcpy(raw, img, count * sizeof(*img));
+}
+
+// 16-bit lane helpers; scale factors are multiply/shift forms of SCALE_M_N, exact over their input range
+#define SSE_BSWAP16(V_)   _mm_or_si128(_mm_slli_epi16(V_, 8), _mm_srli_epi16(V_, 8))
+// SCALE_5_8(v) == (v * 1053) >> 7 for v < 32
+#define SSE_SCALE_5_8(V_) _mm_srli_epi16(_mm_mullo_epi16(V_, _mm_set1_epi16(1053)), 7)
+// SCALE_8_5(v) == (((v + 4) * 31) * 4113) >> 20 for v < 256
+#define SSE_SCALE_8_5(V_) _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(_mm_add_epi16(V_, _mm_set1_epi16(4)), \
+                                         _mm_set1_epi16(31)), _mm_set1_epi16(4113)), 4)
+// SCALE_8_4(v) == (v * 3856) >> 16 and SCALE_8_3(v) == (v * 1821) >> 16 for v < 256
+#define SSE_SCALE_8_4(V_) _mm_mulhi_epu16(V_, _mm_set1_epi16(3856))
+#define SSE_SCALE_8_3(V_) _mm_mulhi_epu16(V_, _mm_set1_epi16(1821))
+
+// split 16 bytes into their high and low nibbles in pixel order (high nibble first)
+static inline void sse_nibbles(__m128i bytes, __m128i *lo_px, __m128i *hi_px)
+{
+   const __m128i mask = _mm_set1_epi8(0x0F);
+   __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+   __m128i lo = _mm_and_si128(bytes, mask);
+   *lo_px = _mm_unpacklo_epi8(hi, lo);
+   *hi_px = _mm_unpackhi_epi8(hi, lo);
+}
+
+// pack 16-bit nibble lanes of 16 pixels into 8 bytes, even pixels in the high nibble
+static inline __m128i sse_pack_nibbles(__m128i n0, __m128i n1)
+{
+   const __m128i mask = _mm_set1_epi32(0xFFFF);
+   __m128i b0 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(n0, mask), 4), _mm_srli_epi32(n0, 16));
+   __m128i b1 = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(n1, mask), 4), _mm_srli_epi32(n1, 16));
+   __m128i w = _mm_packs_epi32(b0, b1);
+   return _mm_packus_epi16(w, w);
+}
+
+static void raw2rgba16_sse2(rgba *img, const uint8_t *raw, int count)
+{
+   const __m128i mask5 = _mm_set1_epi16(0x1F);
+   const __m128i one = _mm_set1_epi16(1);
+   int i;
+   for (i = 0; i + 8 <= count; i += 8) {
+      __m128i p = _mm_loadu_si128((const __m128i *)&raw[i*2]);
+      p = SSE_BSWAP16(p);
+      __m128i r = SSE_SCALE_5_8(_mm_srli_epi16(p, 11));
+      __m128i g = SSE_SCALE_5_8(_mm_and_si128(_mm_srli_epi16(p, 6), mask5));
+      __m128i b = SSE_SCALE_5_8(_mm_and_si128(_mm_srli_epi16(p, 1), mask5));
+      __m128i a = _mm_mullo_epi16(_mm_and_si128(p, one), _mm_set1_epi16(0xFF));
+      __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+      __m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+      _mm_storeu_si128((__m128i *)&img[i], _mm_unpacklo_epi16(rg, ba));
+      _mm_storeu_si128((__m128i *)&img[i+4], _mm_unpackhi_epi16(rg, ba));
+   }
+   raw2rgba16_scalar(&img[i], &raw[i*2], count - i);
+}
+
+static void raw2ia8_sse2(ia *img, const uint8_t *raw, int count)
+{
+   const __m128i mask = _mm_set1_epi8(0x0F);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m128i p = _mm_loadu_si128((const __m128i *)&raw[i]);
+      __m128i in = _mm_and_si128(_mm_srli_epi16(p, 4), mask);
+      __m128i al = _mm_and_si128(p, mask);
+      // SCALE_4_8: replicate nibble
+      in = _mm_or_si128(in, _mm_slli_epi16(in, 4));
+      al = _mm_or_si128(al, _mm_slli_epi16(al, 4));
+      _mm_storeu_si128((__m128i *)&img[i], _mm_unpacklo_epi8(in, al));
+      _mm_storeu_si128((__m128i *)&img[i+8], _mm_unpackhi_epi8(in, al));
+   }
+   raw2ia8_scalar(&img[i], &raw[i], count - i);
+}
+
+static void raw2ia4_sse2(ia *img, const uint8_t *raw, int count)
+{
+   const __m128i mask3 = _mm_set1_epi8(0x07);
+   const __m128i one = _mm_set1_epi8(0x01);
+   int i;
+   for (i = 0; i + 32 <= count; i += 32) {
+      __m128i n[2];
+      sse_nibbles(_mm_loadu_si128((const __m128i *)&raw[i/2]), &n[0], &n[1]);
+      for (int k = 0; k < 2; k++) {
+         // SCALE_3_8: v * 36 = (v << 5) + (v << 2)
+         __m128i v = _mm_and_si128(_mm_srli_epi16(n[k], 1), mask3);
+         __m128i in = _mm_add_epi8(_mm_slli_epi16(v, 5), _mm_slli_epi16(v, 2));
+         __m128i al = _mm_cmpeq_epi8(_mm_and_si128(n[k], one), one);
+         _mm_storeu_si128((__m128i *)&img[i+16*k], _mm_unpacklo_epi8(in, al));
+         _mm_storeu_si128((__m128i *)&img[i+16*k+8], _mm_unpackhi_epi8(in, al));
+      }
+   }
+   raw2ia4_scalar(&img[i], &raw[i/2], count - i);
+}
+
+static void raw2ia1_sse2(ia *img, const uint8_t *raw, int count)
+{
+   const __m128i bits = _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                     0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      // broadcast each of 2 bytes to 8 lanes, then test one bit per lane
+      __m128i p = _mm_cvtsi32_si128(raw[i/8] | (raw[i/8+1] << 8));
+      p = _mm_unpacklo_epi8(p, p);
+      p = _mm_unpacklo_epi16(p, p);
+      p = _mm_unpacklo_epi32(p, p);
+      p = _mm_cmpeq_epi8(_mm_and_si128(p, bits), bits);
+      _mm_storeu_si128((__m128i *)&img[i], _mm_unpacklo_epi8(p, p));
+      _mm_storeu_si128((__m128i *)&img[i+8], _mm_unpackhi_epi8(p, p));
+   }
+   raw2ia1_scalar(&img[i], &raw[i/8], count - i);
+}
+
+static void raw2i8_sse2(ia *img, const uint8_t *raw, int count)
+{
+   const __m128i ff = _mm_set1_epi8((char)0xFF);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m128i p = _mm_loadu_si128((const __m128i *)&raw[i]);
+      _mm_storeu_si128((__m128i *)&img[i], _mm_unpacklo_epi8(p, ff));
+      _mm_storeu_si128((__m128i *)&img[i+8], _mm_unpackhi_epi8(p, ff));
+   }
+   raw2i8_scalar(&img[i], &raw[i], count - i);
+}
+
+static void raw2i4_sse2(ia *img, const uint8_t *raw, int count)
+{
+   const __m128i ff = _mm_set1_epi8((char)0xFF);
+   int i;
+   for (i = 0; i + 32 <= count; i += 32) {
+      __m128i n[2];
+      sse_nibbles(_mm_loadu_si128((const __m128i *)&raw[i/2]), &n[0], &n[1]);
+      for (int k = 0; k < 2; k++) {
+         __m128i in = _mm_or_si128(n[k], _mm_slli_epi16(n[k], 4));
+         _mm_storeu_si128((__m128i *)&img[i+16*k], _mm_unpacklo_epi8(in, ff));
+         _mm_storeu_si128((__m128i *)&img[i+16*k+8], _mm_unpackhi_epi8(in, ff));
+      }
+   }
+   raw2i4_scalar(&img[i], &raw[i/2], count - i);
+}
+
+static void rgba2raw16_sse2(uint8_t *raw, const rgba *img, int count)
+{
+   const __m128i mask8 = _mm_set1_epi32(0xFF);
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i one = _mm_set1_epi16(1);
+   int i;
+   for (i = 0; i + 8 <= count; i += 8) {
+      __m128i p0 = _mm_loadu_si128((const __m128i *)&img[i]);
+      __m128i p1 = _mm_loadu_si128((const __m128i *)&img[i+4]);
+      // deinterleave channels to 16-bit lanes
+      __m128i r = _mm_packs_epi32(_mm_and_si128(p0, mask8), _mm_and_si128(p1, mask8));
+      __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask8), _mm_and_si128(_mm_srli_epi32(p1, 8), mask8));
+      __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask8), _mm_and_si128(_mm_srli_epi32(p1, 16), mask8));
+      __m128i a = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+      a = _mm_andnot_si128(_mm_cmpeq_epi16(a, zero), one);
+      __m128i p = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(SSE_SCALE_8_5(r), 11), _mm_slli_epi16(SSE_SCALE_8_5(g), 6)),
+                               _mm_or_si128(_mm_slli_epi16(SSE_SCALE_8_5(b), 1), a));
+      _mm_storeu_si128((__m128i *)&raw[i*2], SSE_BSWAP16(p));
+   }
+   rgba2raw16_scalar(&raw[i*2], &img[i], count - i);
+}
+
+static void ia2raw8_sse2(uint8_t *raw, const ia *img, int count)
+{
+   const __m128i mask8 = _mm_set1_epi16(0xFF);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m128i b[2];
+      for (int k = 0; k < 2; k++) {
+         __m128i p = _mm_loadu_si128((const __m128i *)&img[i+8*k]);
+         __m128i in = SSE_SCALE_8_4(_mm_and_si128(p, mask8));
+         __m128i al = SSE_SCALE_8_4(_mm_srli_epi16(p, 8));
+         b[k] = _mm_or_si128(_mm_slli_epi16(in, 4), al);
+      }
+      _mm_storeu_si128((__m128i *)&raw[i], _mm_packus_epi16(b[0], b[1]));
+   }
+   ia2raw8_scalar(&raw[i], &img[i], count - i);
+}
+
+static void ia2raw4_sse2(uint8_t *raw, const ia *img, int count)
+{
+   const __m128i mask8 = _mm_set1_epi16(0xFF);
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i one = _mm_set1_epi16(1);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m128i n[2];
+      for (int k = 0; k < 2; k++) {
+         __m128i p = _mm_loadu_si128((const __m128i *)&img[i+8*k]);
+         __m128i in = SSE_SCALE_8_3(_mm_and_si128(p, mask8));
+         __m128i al = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_srli_epi16(p, 8), zero), one);
+         n[k] = _mm_or_si128(_mm_slli_epi16(in, 1), al);
+      }
+      _mm_storel_epi64((__m128i *)&raw[i/2], sse_pack_nibbles(n[0], n[1]));
+   }
+   ia2raw4_scalar(&raw[i/2], &img[i], count - i);
+}
+
+static uint8_t reverse_bits8(uint8_t b)
+{
+   b = (b >> 4) | (b << 4);
+   b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2);
+   b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
+   return b;
+}
+
+static void ia2raw1_sse2(uint8_t *raw, const ia *img, int count)
+{
+   const __m128i mask8 = _mm_set1_epi16(0xFF);
+   const __m128i zero = _mm_setzero_si128();
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m128i p0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)&img[i]), mask8);
+      __m128i p1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)&img[i+8]), mask8);
+      // lane k set -> bit k, then reverse to MSb first
+      int set = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_packus_epi16(p0, p1), zero));
+      raw[i/8]   = reverse_bits8(set & 0xFF);
+      raw[i/8+1] = reverse_bits8((set >> 8) & 0xFF);
+   }
+   ia2raw1_scalar(&raw[i/8], &img[i], count - i);
+}
+
+static void i2raw8_sse2(uint8_t *raw, const ia *img, int count)
+{
+   const __m128i mask8 = _mm_set1_epi16(0xFF);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m128i p0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)&img[i]), mask8);
+      __m128i p1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)&img[i+8]), mask8);
+      _mm_storeu_si128((__m128i *)&raw[i], _mm_packus_epi16(p0, p1));
+   }
+   i2raw8_scalar(&raw[i], &img[i], count - i);
+}
+
+static void i2raw4_sse2(uint8_t *raw, const ia *img, int count)
+{
+   const __m128i mask8 = _mm_set1_epi16(0xFF);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m128i n0 = SSE_SCALE_8_4(_mm_and_si128(_mm_loadu_si128((const __m128i *)&img[i]), mask8));
+      __m128i n1 = SSE_SCALE_8_4(_mm_and_si128(_mm_loadu_si128((const __m128i *)&img[i+8]), mask8));
+      _mm_storel_epi64((__m128i *)&raw[i/2], sse_pack_nibbles(n0, n1));
+   }
+   i2raw4_scalar(&raw[i/2], &img[i], count - i);
+}
+
+static const tex_kernels kernels_sse2 =
+{
+   raw2rgba16_sse2, raw2rgba32_copy,
+   raw2ia16_copy, raw2ia8_sse2, raw2ia4_sse2, raw2ia1_sse2,
+   raw2i8_sse2, raw2i4_sse2,
+   rgba2raw16_sse2, rgba2raw32_copy,
+   ia2raw16_copy, ia2raw8_sse2, ia2raw4_sse2, ia2raw1_sse2,
+   i2raw8_sse2, i2raw4_sse2,
+};
+#endif // __SSE2__
+
+#if defined(__AVX2__)
+#define AVX_BSWAP16(V_)   _mm256_or_si256(_mm256_slli_epi16(V_, 8), _mm256_srli_epi16(V_, 8))
+#define AVX_SCALE_5_8(V_) _mm256_srli_epi16(_mm256_mullo_epi16(V_, _mm256_set1_epi16(1053)), 7)
+#define AVX_SCALE_8_5(V_) _mm256_srli_epi16(_mm256_mulhi_epu16(_mm256_mullo_epi16(_mm256_add_epi16(V_, _mm256_set1_epi16(4)), \
+                                            _mm256_set1_epi16(31)), _mm256_set1_epi16(4113)), 4)
+
+// RGBA16 is the most common texture format, so it gets 256-bit kernels; the rest use SSE2
+static void raw2rgba16_avx2(rgba *img, const uint8_t *raw, int count)
+{
+   const __m256i mask5 = _mm256_set1_epi16(0x1F);
+   const __m256i one = _mm256_set1_epi16(1);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m256i p = _mm256_loadu_si256((const __m256i *)&raw[i*2]);
+      p = AVX_BSWAP16(p);
+      __m256i r = AVX_SCALE_5_8(_mm256_srli_epi16(p, 11));
+      __m256i g = AVX_SCALE_5_8(_mm256_and_si256(_mm256_srli_epi16(p, 6), mask5));
+      __m256i b = AVX_SCALE_5_8(_mm256_and_si256(_mm256_srli_epi16(p, 1), mask5));
+      __m256i a = _mm256_mullo_epi16(_mm256_and_si256(p, one), _mm256_set1_epi16(0xFF));
+      __m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+      __m256i ba = _mm256_or_si256(b, _mm256_slli_epi16(a, 8));
+      // unpack works within 128-bit lanes: lo = pixels 0-3, 8-11; hi = 4-7, 12-15
+      __m256i lo = _mm256_unpacklo_epi16(rg, ba);
+      __m256i hi = _mm256_unpackhi_epi16(rg, ba);
+      _mm256_storeu_si256((__m256i *)&img[i], _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256((__m256i *)&img[i+8], _mm256_permute2x128_si256(lo, hi, 0x31));
+   }
+   raw2rgba16_sse2(&img[i], &raw[i*2], count - i);
+}
+
+static void rgba2raw16_avx2(uint8_t *raw, const rgba *img, int count)
+{
+   const __m256i mask8 = _mm256_set1_epi32(0xFF);
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i one = _mm256_set1_epi16(1);
+   int i;
+   for (i = 0; i + 16 <= count; i += 16) {
+      __m256i p0 = _mm256_loadu_si256((const __m256i *)&img[i]);
+      __m256i p1 = _mm256_loadu_si256((const __m256i *)&img[i+8]);
+      // pack works within 128-bit lanes, leaving pixels in order 0-3, 8-11, 4-7, 12-15
+      __m256i r = _mm256_packs_epi32(_mm256_and_si256(p0, mask8), _mm256_and_si256(p1, mask8));
+      __m256i g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask8), _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask8));
+      __m256i b = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask8), _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask8));
+      __m256i a = _mm256_packs_epi32(_mm256_srli_epi32(p0, 24), _mm256_srli_epi32(p1, 24));
+      a = _mm256_andnot_si256(_mm256_cmpeq_epi16(a, zero), one);
+      __m256i p = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(AVX_SCALE_8_5(r), 11), _mm256_slli_epi16(AVX_SCALE_8_5(g), 6)),
+                                  _mm256_or_si256(_mm256_slli_epi16(AVX_SCALE_8_5(b), 1), a));
+      p = _mm256_permute4x64_epi64(p, 0xD8);
+      _mm256_storeu_si256((__m256i *)&raw[i*2], AVX_BSWAP16(p));
+   }
+   rgba2raw16_sse2(&raw[i*2], &img[i], count - i);
+}
+
+static const tex_kernels kernels_avx2 =
+{
+   raw2rgba16_avx2, raw2rgba32_copy,
+   raw2ia16_copy, raw2ia8_sse2, raw2ia4_sse2, raw2ia1_sse2,
+   raw2i8_sse2, raw2i4_sse2,
+   rgba2raw16_avx2, rgba2raw32_copy,
+   ia2raw16_copy, ia2raw8_sse2, ia2raw4_sse2, ia2raw1_sse2,
+   i2raw8_sse2, i2raw4_sse2,
+};
+#endif // __AVX2__
+
+static const tex_kernels *kernel_table[] =
+{
+   &kernels_scalar,
+#if defined(__SSE2__)
+   &kernels_sse2,
+#else
+   NULL,
+#endif
+#if defined(__AVX2__)
+   &kernels_avx2,
+#else
+   NULL,
+#endif
+};
+
+static const char *kernel_names[] = {"scalar", "SSE2", "AVX2"};
+
+// fastest kernels built in
+#if defined(__AVX2__)
+static const tex_kernels *kernels = &kernels_avx2;
+#elif defined(__SSE2__)
+static const tex_kernels *kernels = &kernels_sse2;
+#else
+static const tex_kernels *kernels = &kernels_scalar;
+#endif
+
+int n64graphics_select_kernels(n64graphics_kernels kern)
+{
+   if ((unsigned)kern >= DIM(kernel_table) || kernel_table[kern] == NULL) {
+      return -1;
+   }
+   kernels = kernel_table[kern];
+   return 0;
+}
+
+const char *n64graphics_kernels_name(n64graphics_kernels kern)
+{
+   if ((unsigned)kern >= DIM(kernel_names)) {
+      return "";
+   }
+   return kernel_names[kern];
+}
+
 //---------------------------------------------------------
 // N64 RGBA/IA/I/CI -> internal RGBA/IA
 //---------------------------------------------------------
 
+// intermediate formats are passed to the PNG writer as-is, so must match its packed layout
+typedef char rgba_matches_png_layout[(sizeof(rgba) == 4) ? 1 : -1];
+typedef char ia_matches_png_layout[(sizeof(ia) == 2) ? 1 : -1];
+
+int raw2rgba_buf(rgba *img, const uint8_t *raw, int count, int depth)
+{
+   switch (depth) {
+      case 16: kernels->raw2rgba16(img, raw, count); break;
+      case 32: kernels->raw2rgba32(img, raw, count); break;
+      default:
+         ERROR("Error invalid depth %d\n", depth);
+         return -1;
+   }
+   return 0;
+}
+
+int raw2ia_buf(ia *img, const uint8_t *raw, int count, int depth)
+{
+   switch (depth) {
+      case 16: kernels->raw2ia16(img, raw, count); break;
+      case 8:  kernels->raw2ia8(img, raw, count); break;
+      case 4:  kernels->raw2ia4(img, raw, count); break;
+      case 1:  kernels->raw2ia1(img, raw, count); break;
+      default:
+         ERROR("Error invalid depth %d\n", depth);
+         return -1;
+   }
+   return 0;
+}
+
+int raw2i_buf(ia *img, const uint8_t *raw, int count, int depth)
+{
+   switch (depth) {
+      case 8: kernels->raw2i8(img, raw, count); break;
+      case 4: kernels->raw2i4(img, raw, count); break;
+      default:
+         ERROR("Error invalid depth %d\n", depth);
+         return -1;
+   }
+   return 0;
+}
+
 rgba *raw2rgba(const uint8_t *raw, int width, int height, int depth)
 {
    rgba *img;
@@ -50,21 +690,7 @@ rgba *raw2rgba(const uint8_t *raw, int width, int height, int depth)
       return NULL;
    }
 
-   if (depth == 16) {
-      for (int i = 0; i < width * height; i++) {
-         img[i].red   = SCALE_5_8((raw[i*2] & 0xF8) >> 3);
-         img[i].green = SCALE_5_8(((raw[i*2] & 0x07) << 2) | ((raw[i*2+1] & 0xC0) >> 6));
-         img[i].blue  = SCALE_5_8((raw[i*2+1] & 0x3E) >> 1);
-         img[i].alpha = (raw[i*2+1] & 0x01) ? 0xFF : 0x00;
-      }
-   } else if (depth == 32) {
-      for (int i = 0; i < width * height; i++) {
-         img[i].red   = raw[i*4];
-         img[i].green = raw[i*4+1];
-         img[i].blue  = raw[i*4+2];
-         img[i].alpha = raw[i*4+3];
-      }
-   }
+   raw2rgba_buf(img, raw, width * height, depth);
 
    return img;
 }
@@ -81,47 +707,7 @@ ia *raw2ia(const uint8_t *raw, int width, int height, int depth)
       return NULL;
    }
 
-   switch (depth) {
-      case 16:
-         for (int i = 0; i < width * height; i++) {
-            img[i].intensity = raw[i*2];
-            img[i].alpha     = raw[i*2+1];
-         }
-         break;
-      case 8:
-         for (int i = 0; i < width * height; i++) {
-            img[i].intensity = SCALE_4_8((raw[i] & 0xF0) >> 4);
-            img[i].alpha     = SCALE_4_8(raw[i] & 0x0F);
-         }
-         break;
-      case 4:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t bits;
-            bits = raw[i/2];
-            if (i % 2) {
-               bits &= 0xF;
-            } else {
-               bits >>= 4;
-            }
-            img[i].intensity = SCALE_3_8((bits >> 1) & 0x07);
-            img[i].alpha     = (bits & 0x01) ? 0xFF : 0x00;
-         }
-         break;
-      case 1:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t bits;
-            uint8_t mask;
-            bits = raw[i/8];
-            mask = 1 << (7 - (i % 8)); // MSb->LSb
-            bits = (bits & mask) ? 0xFF : 0x00;
-            img[i].intensity = bits;
-            img[i].alpha     = bits;
-         }
-         break;
-      default:
-         ERROR("Error invalid depth %d\n", depth);
-         break;
-   }
+   raw2ia_buf(img, raw, width * height, depth);
 
    return img;
 }
@@ -138,30 +724,7 @@ ia *raw2i(const uint8_t *raw, int width, int height, int depth)
       return NULL;
    }
 
-   switch (depth) {
-      case 8:
-         for (int i = 0; i < width * height; i++) {
-            img[i].intensity = raw[i];
-            img[i].alpha     = 0xFF;
-         }
-         break;
-      case 4:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t bits;
-            bits = raw[i/2];
-            if (i % 2) {
-               bits &= 0xF;
-            } else {
-               bits >>= 4;
-            }
-            img[i].intensity = SCALE_4_8(bits);
-            img[i].alpha     = 0xFF;
-         }
-         break;
-      default:
-         ERROR("Error invalid depth %d\n", depth);
-         break;
-   }
+   raw2i_buf(img, raw, width * height, depth);
 
    return img;
 }
@@ -181,12 +744,14 @@ uint8_t *ci2raw(const uint8_t *rawci, const uint8_t *palette, int width, int hei
    }
 
    for (int i = 0; i < width * height; i++) {
-      int pal_idx = rawci[i];
+      int pal_idx;
       if (ci_depth == 4) {
          int byte_idx = i / 2;
          int nibble = 1 - (i % 2);
          int shift = 4 * nibble;
          pal_idx = (rawci[byte_idx] >> shift) & 0xF;
+      } else {
+         pal_idx = rawci[i];
       }
       raw[2*i]   = palette[2*pal_idx];
       raw[2*i+1] = palette[2*pal_idx+1];
@@ -207,22 +772,9 @@ int rgba2raw(uint8_t *raw, const rgba *img, int width, int height, int depth)
    INFO("Converting RGBA%d %dx%d to raw\n", depth, width, height);
 
    if (depth == 16) {
-      for (int i = 0; i < width * height; i++) {
-         uint8_t r, g, b, a;
-         r = SCALE_8_5(img[i].red);
-         g = SCALE_8_5(img[i].green);
-         b = SCALE_8_5(img[i].blue);
-         a = img[i].alpha ? 0x1 : 0x0;
-         raw[i*2]   = (r << 3) | (g >> 2);
-         raw[i*2+1] = ((g & 0x3) << 6) | (b << 1) | a;
-      }
+      kernels->rgba2raw16(raw, img, width * height);
    } else if (depth == 32) {
-      for (int i = 0; i < width * height; i++) {
-         raw[i*4]   = img[i].red;
-         raw[i*4+1] = img[i].green;
-         raw[i*4+2] = img[i].blue;
-         raw[i*4+3] = img[i].alpha;
-      }
+      kernels->rgba2raw32(raw, img, width * height);
    } else {
       ERROR("Error invalid depth %d\n", depth);
       size = -1;
@@ -237,43 +789,10 @@ int ia2raw(uint8_t *raw, const ia *img, int width, int height, int depth)
    INFO("Converting IA%d %dx%d to raw\n", depth, width, height);
 
    switch (depth) {
-      case 16:
-         for (int i = 0; i < width * height; i++) {
-            raw[i*2]   = img[i].intensity;
-            raw[i*2+1] = img[i].alpha;
-         }
-         break;
-      case 8:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t val = SCALE_8_4(img[i].intensity);
-            uint8_t alpha = SCALE_8_4(img[i].alpha);
-            raw[i] = (val << 4) | alpha;
-         }
-         break;
-      case 4:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t val = SCALE_8_3(img[i].intensity);
-            uint8_t alpha = img[i].alpha ? 0x01 : 0x00;
-            uint8_t old = raw[i/2];
-            if (i % 2) {
-               raw[i/2] = (old & 0xF0) | (val << 1) | alpha;
-            } else {
-               raw[i/2] = (old & 0x0F) | (((val << 1) | alpha) << 4);
-            }
-         }
-         break;
-      case 1:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t val = img[i].intensity;
-            uint8_t old = raw[i/8];
-            uint8_t bit = 1 << (7 - (i % 8));
-            if (val) {
-               raw[i/8] = old | bit;
-            } else {
-               raw[i/8] = old & (~bit);
-            }
-         }
-         break;
+      case 16: kernels->ia2raw16(raw, img, width * height); break;
+      case 8:  kernels->ia2raw8(raw, img, width * height); break;
+      case 4:  kernels->ia2raw4(raw, img, width * height); break;
+      case 1:  kernels->ia2raw1(raw, img, width * height); break;
       default:
          ERROR("Error invalid depth %d\n", depth);
          size = -1;
@@ -289,31 +808,260 @@ int i2raw(uint8_t *raw, const ia *img, int width, int height, int depth)
    INFO("Converting I%d %dx%d to raw\n", depth, width, height);
 
    switch (depth) {
-      case 8:
-         for (int i = 0; i < width * height; i++) {
-            raw[i] = img[i].intensity;
-         }
-         break;
-      case 4:
-         for (int i = 0; i < width * height; i++) {
-            uint8_t val = SCALE_8_4(img[i].intensity);
-            uint8_t old = raw[i/2];
-            if (i % 2) {
-               raw[i/2] = (old & 0xF0) | val;
-            } else {
-               raw[i/2] = (old & 0x0F) | (val << 4);
-            }
-         }
-         break;
+      case 8: kernels->i2raw8(raw, img, width * height); break;
+      case 4: kernels->i2raw4(raw, img, width * height); break;
       default:
          ERROR("Error invalid depth %d\n", depth);
          size = -1;
          break;
    }
-
-   return size;
+
+   return size;
+}
+
+
+//---------------------------------------------------------
+// PNG writers
+//---------------------------------------------------------
+
+static struct
+{
+   n64graphics_png_writer writer;
+   int level;
+   n64graphics_png_filter filter;
+} png_writer = {N64GRAPHICS_PNG_STB, Z_DEFAULT_COMPRESSION, N64GRAPHICS_PNG_FILTER_ADAPTIVE};
+
+static const char *png_filter_names[] = {"none", "sub", "up", "avg", "paeth", "adaptive"};
+
+int n64graphics_set_png_writer(n64graphics_png_writer writer, int level, n64graphics_png_filter filter)
+{
+   if (writer < N64GRAPHICS_PNG_STB || writer > N64GRAPHICS_PNG_STORE ||
+       level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION ||
+       filter < N64GRAPHICS_PNG_FILTER_NONE || filter > N64GRAPHICS_PNG_FILTER_ADAPTIVE) {
+      return -1;
+   }
+   png_writer.writer = writer;
+   png_writer.level = level;
+   png_writer.filter = filter;
+   if (writer == N64GRAPHICS_PNG_STORE) {
+      png_writer.level = Z_NO_COMPRESSION;
+      png_writer.filter = N64GRAPHICS_PNG_FILTER_NONE;
+   }
+   return 0;
+}
+
+int n64graphics_parse_png_writer(const char *spec)
+{
+   char name[16];
+   const char *sep = strchr(spec, ':');
+   int level = Z_DEFAULT_COMPRESSION;
+   int filter = N64GRAPHICS_PNG_FILTER_ADAPTIVE;
+   size_t len = sep ? (size_t)(sep - spec) : strlen(spec);
+   if (len >= sizeof(name)) {
+      return -1;
+   }
+   memcpy(name, spec, len);
+   name[len] = '\0';
+   if (!strcmp(name, "stb") && !sep) {
+      return n64graphics_set_png_writer(N64GRAPHICS_PNG_STB, level, filter);
+   } else if (!strcmp(name, "store") && !sep) {
+      return n64graphics_set_png_writer(N64GRAPHICS_PNG_STORE, level, filter);
+   } else if (!strcmp(name, "zlib")) {
+      if (sep) {
+         char *end;
+         level = strtol(sep + 1, &end, 0);
+         if (end == sep + 1) {
+            return -1;
+         }
+         if (*end == ':') {
+            filter = -1;
+            for (unsigned i = 0; i < DIM(png_filter_names); i++) {
+               if (!strcmp(end + 1, png_filter_names[i])) {
+                  filter = i;
+               }
+            }
+         } else if (*end != '\0') {
+            return -1;
+         }
+      }
+      return n64graphics_set_png_writer(N64GRAPHICS_PNG_ZLIB, level, filter);
+   }
+   return -1;
+}
+
+static uint8_t png_paeth(int a, int b, int c)
+{
+   int p = a + b - c;
+   int pa = abs(p - a);
+   int pb = abs(p - b);
+   int pc = abs(p - c);
+   if (pa <= pb && pa <= pc) {
+      return a;
+   }
+   return (pb <= pc) ? b : c;
+}
+
+// write filter type byte and filtered row to 'out'
+// prev: previous row or NULL for first row
+static void png_filter_row(uint8_t *out, const uint8_t *row, const uint8_t *prev, int row_len, int bpp, int filter)
+{
+   out[0] = filter;
+   out++;
+   for (int i = 0; i < row_len; i++) {
+      int a = (i >= bpp) ? row[i - bpp] : 0;
+      int b = prev ? prev[i] : 0;
+      int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+      switch (filter) {
+         case N64GRAPHICS_PNG_FILTER_NONE:  out[i] = row[i]; break;
+         case N64GRAPHICS_PNG_FILTER_SUB:   out[i] = row[i] - a; break;
+         case N64GRAPHICS_PNG_FILTER_UP:    out[i] = row[i] - b; break;
+         case N64GRAPHICS_PNG_FILTER_AVG:   out[i] = row[i] - ((a + b) >> 1); break;
+         case N64GRAPHICS_PNG_FILTER_PAETH: out[i] = row[i] - png_paeth(a, b, c); break;
+      }
+   }
+}
+
+static int png_write_chunk(FILE *fp, const char *type, const uint8_t *data, uint32_t len)
+{
+   uint8_t buf[8];
+   uLong crc;
+   write_u32_be(buf, len);
+   memcpy(&buf[4], type, 4);
+   crc = crc32(0, &buf[4], 4);
+   if (len) {
+      crc = crc32(crc, data, len);
+   }
+   if (fwrite(buf, 1, 8, fp) != 8 || (len && fwrite(data, 1, len, fp) != len)) {
+      return -1;
+   }
+   write_u32_be(buf, (uint32_t)crc);
+   return (fwrite(buf, 1, 4, fp) == 4) ? 0 : -1;
+}
+
+// PNG writer using zlib deflate, also used for uncompressed store mode
+// returns 1 on success, 0 on failure like stbi_write_png()
+// feed pending input to deflate, growing idat whenever the output fills
+// deflateBound() is only an estimate for tiny stored streams, so don't rely on it
+// returns 0 on success (Z_STREAM_END reached for Z_FINISH), -1 on error
+static int png_deflate(z_stream *zs, uint8_t **idat, uLong *idat_size, int flush)
+{
+   while (1) {
+      int zret;
+      if (zs->avail_out == 0) {
+         uLong used = zs->total_out;
+         uint8_t *grown = realloc(*idat, *idat_size * 2);
+         if (!grown) {
+            return -1;
+         }
+         *idat = grown;
+         *idat_size *= 2;
+         zs->next_out = grown + used;
+         zs->avail_out = *idat_size - used;
+      }
+      zret = deflate(zs, flush);
+      if (zret == Z_STREAM_END) {
+         return 0;
+      }
+      if (zret != Z_OK && zret != Z_BUF_ERROR) {
+         return -1;
+      }
+      if (flush != Z_FINISH && zs->avail_in == 0 && zs->avail_out != 0) {
+         return 0;
+      }
+   }
+}
+
+static int png_write_zlib(const char *png_filename, int width, int height, int comp, const uint8_t *pixels)
+{
+   static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+   uint8_t ihdr[13];
+   int row_len = width * comp;
+   int filter_count = (png_writer.filter == N64GRAPHICS_PNG_FILTER_ADAPTIVE) ? N64GRAPHICS_PNG_FILTER_ADAPTIVE : 1;
+   uint8_t *filtered;
+   uint8_t *idat;
+   uLong idat_size;
+   z_stream zs;
+   FILE *fp;
+   int ret = 0;
+
+   memset(&zs, 0, sizeof(zs));
+   if (deflateInit2(&zs, png_writer.level, Z_DEFLATED, 15, 9,
+                    png_writer.filter == N64GRAPHICS_PNG_FILTER_NONE ? Z_DEFAULT_STRATEGY : Z_FILTERED) != Z_OK) {
+      ERROR("Error initializing deflate for \"%s\"\n", png_filename);
+      return 0;
+   }
+   idat_size = deflateBound(&zs, (uLong)(row_len + 1) * height);
+   idat = malloc(idat_size);
+   filtered = malloc((size_t)(row_len + 1) * filter_count);
+   zs.next_out = idat;
+   zs.avail_out = idat_size;
+   for (int y = 0; y < height; y++) {
+      const uint8_t *row = &pixels[(size_t)y * row_len];
+      const uint8_t *prev = y ? row - row_len : NULL;
+      uint8_t *best = filtered;
+      if (filter_count == 1) {
+         png_filter_row(filtered, row, prev, row_len, comp, png_writer.filter);
+      } else {
+         // pick the filter with the smallest sum of absolute signed bytes
+         unsigned int best_sum = 0xFFFFFFFF;
+         for (int f = 0; f < filter_count; f++) {
+            uint8_t *out = &filtered[(size_t)f * (row_len + 1)];
+            unsigned int sum = 0;
+            png_filter_row(out, row, prev, row_len, comp, f);
+            for (int i = 1; i <= row_len; i++) {
+               sum += abs((int8_t)out[i]);
+            }
+            if (sum < best_sum) {
+               best_sum = sum;
+               best = out;
+            }
+         }
+      }
+      zs.next_in = best;
+      zs.avail_in = row_len + 1;
+      if (png_deflate(&zs, &idat, &idat_size, Z_NO_FLUSH) < 0) {
+         break;
+      }
+   }
+   if (zs.avail_in != 0 || png_deflate(&zs, &idat, &idat_size, Z_FINISH) < 0) {
+      ERROR("Error compressing \"%s\"\n", png_filename);
+   } else {
+      fp = fopen(png_filename, "wb");
+      if (!fp) {
+         ERROR("Error opening \"%s\"\n", png_filename);
+      } else {
+         write_u32_be(&ihdr[0], width);
+         write_u32_be(&ihdr[4], height);
+         ihdr[8] = 8;                     // bit depth
+         ihdr[9] = (comp == 4) ? 6 : 4;   // RGBA or grey+alpha
+         ihdr[10] = 0;                    // deflate
+         ihdr[11] = 0;                    // adaptive filtering
+         ihdr[12] = 0;                    // no interlace
+         ret = fwrite(signature, 1, sizeof(signature), fp) == sizeof(signature) &&
+               png_write_chunk(fp, "IHDR", ihdr, sizeof(ihdr)) == 0 &&
+               png_write_chunk(fp, "IDAT", idat, zs.total_out) == 0 &&
+               png_write_chunk(fp, "IEND", NULL, 0) == 0;
+         if (fclose(fp) != 0) {
+            ret = 0;
+         }
+         if (!ret) {
+            ERROR("Error writing \"%s\"\n", png_filename);
+         }
+      }
+   }
+   deflateEnd(&zs);
+   free(filtered);
+   free(idat);
+   return ret;
 }
 
+static int png_write(const char *png_filename, int width, int height, int comp, const void *pixels)
+{
+   if (png_writer.writer == N64GRAPHICS_PNG_STB) {
+      return stbi_write_png(png_filename, width, height, comp, pixels, 0);
+   }
+   return png_write_zlib(png_filename, width, height, comp, pixels);
+}
 
 //---------------------------------------------------------
 // internal RGBA/IA -> PNG
@@ -321,52 +1069,18 @@ int i2raw(uint8_t *raw, const ia *img, int width, int height, int depth)
 
 int rgba2png(const char *png_filename, const rgba *img, int width, int height)
 {
-   int ret = 0;
    INFO("Saving RGBA %dx%d to \"%s\"\n", width, height, png_filename);
 
-   // convert to format stb_image_write expects
-   uint8_t *data = malloc(4*width*height);
-   if (data) {
-      for (int j = 0; j < height; j++) {
-         for (int i = 0; i < width; i++) {
-            int idx = j*width + i;
-            data[4*idx]     = img[idx].red;
-            data[4*idx + 1] = img[idx].green;
-            data[4*idx + 2] = img[idx].blue;
-            data[4*idx + 3] = img[idx].alpha;
-         }
-      }
-
-      ret = stbi_write_png(png_filename, width, height, 4, data, 0);
-
-      free(data);
-   }
-
-   return ret;
+   // RGBA is already packed 4-channel scanlines
+   return png_write(png_filename, width, height, 4, img);
 }
 
 int ia2png(const char *png_filename, const ia *img, int width, int height)
 {
-   int ret = 0;
    INFO("Saving IA %dx%d to \"%s\"\n", width, height, png_filename);
 
-   // convert to format stb_image_write expects
-   uint8_t *data = malloc(2*width*height);
-   if (data) {
-      for (int j = 0; j < height; j++) {
-         for (int i = 0; i < width; i++) {
-            int idx = j*width + i;
-            data[2*idx]     = img[idx].intensity;
-            data[2*idx + 1] = img[idx].alpha;
-         }
-      }
-
-      ret = stbi_write_png(png_filename, width, height, 2, data, 0);
-
-      free(data);
-   }
-
-   return ret;
+   // IA is already packed grey+alpha scanlines
+   return png_write(png_filename, width, height, 2, img);
 }
 
 //---------------------------------------------------------
@@ -498,47 +1212,70 @@ ia *png2ia(const char *png_filename, int *width, int *height)
    return img;
 }
 
-// find index of palette color
-// return -1 if not found
-static int pal_find_color(const palette_t *pal, uint16_t val)
+#define PAL_HASH_BITS 9
+typedef char pal_hash_matches_size[(PAL_HASH_SIZE == (1 << PAL_HASH_BITS)) ? 1 : -1];
+
+static inline unsigned pal_hash(uint16_t val)
+{
+   // Fibonacci hash, top bits select the slot
+   return ((uint32_t)val * 0x9E3779B1u) >> (32 - PAL_HASH_BITS);
+}
+
+void pal_init(palette_t *pal, int max)
+{
+   pal->max = MIN(max, (int)DIM(pal->data));
+   pal->used = 0;
+   memset(pal->data, 0, sizeof(pal->data));
+   memset(pal->hash, 0, sizeof(pal->hash));
+}
+
+int pal_find_color(const palette_t *pal, uint16_t val)
 {
-   for (int i = 0; i < pal->used; i++) {
-      if (pal->data[i] == val) {
-         return i;
+   for (unsigned h = pal_hash(val); pal->hash[h]; h = (h + 1) & (PAL_HASH_SIZE - 1)) {
+      int idx = pal->hash[h] - 1;
+      if (pal->data[idx] == val) {
+         return idx;
       }
    }
    return -1;
 }
 
-// find value in palette, or add if not there
-// returns palette index entered or -1 if palette full
-static int pal_add_color(palette_t *pal, uint16_t val)
+int pal_add_color(palette_t *pal, uint16_t val)
 {
-   int idx;
-   idx = pal_find_color(pal, val);
-   if (idx < 0) {
-      if (pal->used == pal->max) {
-         ERROR("Error: trying to use more than %d\n", pal->max);
-      } else {
-         idx = pal->used;
-         pal->data[pal->used] = val;
-         pal->used++;
+   unsigned h;
+   for (h = pal_hash(val); pal->hash[h]; h = (h + 1) & (PAL_HASH_SIZE - 1)) {
+      int idx = pal->hash[h] - 1;
+      if (pal->data[idx] == val) {
+         return idx;
       }
    }
-   return idx;
+   if (pal->used >= pal->max) {
+      ERROR("Error: trying to use more than %d\n", pal->max);
+      return -1;
+   }
+   pal->data[pal->used] = val;
+   pal->used++;
+   pal->hash[h] = pal->used;
+   return pal->used - 1;
 }
 
-// convert from raw (RGBA16 or IA16) format to CI + palette
-// returns 1 on success
 int raw2ci(uint8_t *rawci, palette_t *pal, const uint8_t *raw, int raw_len, int ci_depth)
 {
-   // assign colors to palette
-   pal->used = 0;
-   memset(pal->data, 0, sizeof(pal->data));
+   pal_init(pal, pal->max);
+   return raw2ci_shared(rawci, pal, raw, raw_len, ci_depth);
+}
+
+int raw2ci_shared(uint8_t *rawci, palette_t *pal, const uint8_t *raw, int raw_len, int ci_depth)
+{
+   // assign colors to palette, textures are mostly runs so check the previous color first
+   uint16_t last_val = 0;
+   int last_idx = -1;
    int ci_idx = 0;
    for (int i = 0; i < raw_len; i += sizeof(uint16_t)) {
       uint16_t val = read_u16_be(&raw[i]);
-      int pal_idx = pal_add_color(pal, val);
+      int pal_idx = (last_idx >= 0 && val == last_val) ? last_idx : pal_add_color(pal, val);
+      last_val = val;
+      last_idx = pal_idx;
       if (pal_idx < 0) {
          ERROR("Error adding color @ (%d): %d (used: %d/%d)\n", i, pal_idx, pal->used, pal->max);
          return 0;
@@ -569,12 +1306,21 @@ const char *n64graphics_get_read_version(void)
 
 const char *n64graphics_get_write_version(void)
 {
-   return "stb_image_write 1.09";
+   static char version[32];
+   if (png_writer.writer == N64GRAPHICS_PNG_STB) {
+      return "stb_image_write 1.09";
+   }
+   sprintf(version, "zlib %s", zlibVersion());
+   return version;
 }
 
 #ifdef N64GRAPHICS_STANDALONE
 #define N64GRAPHICS_VERSION "0.4"
+#include <pthread.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#define MANIFEST_MAX_ARGS 32
 
 typedef enum
 {
@@ -598,6 +1344,14 @@ typedef struct
    int pal_truncate;
 } graphics_config;
 
+// batch mode options, only valid on the command line
+typedef struct
+{
+   char *manifest_filename;
+   char *dep_filename;
+   int threads;
+} batch_config;
+
 static const graphics_config default_config =
 {
    .img_filename = NULL,
@@ -614,6 +1368,13 @@ static const graphics_config default_config =
    .pal_truncate = 1,
 };
 
+static const batch_config default_batch =
+{
+   .manifest_filename = NULL,
+   .dep_filename = NULL,
+   .threads = 0,
+};
+
 typedef struct
 {
    const char *name;
@@ -658,7 +1419,8 @@ static int parse_format(img_format *format, const char *str)
 
 static void print_usage(void)
 {
-   ERROR("Usage: n64graphics -e/-i BIN_FILE -g IMG_FILE [-p PAL_FILE] [-o BIN_OFFSET] [-P PAL_OFFSET] [-f FORMAT] [-c CI_FORMAT] [-w WIDTH] [-h HEIGHT] [-V]\n"
+   ERROR("Usage: n64graphics -e/-i BIN_FILE -g IMG_FILE [-p PAL_FILE] [-o BIN_OFFSET] [-P PAL_OFFSET] [-f FORMAT] [-c CI_FORMAT] [-w WIDTH] [-h HEIGHT] [-z PNG_WRITER] [-V]\n"
+         "       n64graphics -b MANIFEST [-d DEPFILE] [-j THREADS] [-z PNG_WRITER] [-v]\n"
          "\n"
          "n64graphics v" N64GRAPHICS_VERSION ": N64 graphics manipulator\n"
          "\n"
@@ -675,7 +1437,15 @@ static void print_usage(void)
          " -c CI_FORMAT  CI palette format: rgba16, ia16 (default: %s)\n"
          " -p PAL_FILE   palette binary file to import/export from/to\n"
          " -P PAL_OFFSET starting offset in PAL_FILE (prevents truncation during import)\n"
+         "Batch arguments:\n"
+         " -b MANIFEST   convert every entry in MANIFEST, one per line using the arguments above\n"
+         "               (e.g. \"-i tex.bin -o 0x800 -f ia8 -g tex/foo.png\"), '#' starts a comment.\n"
+         "               entries whose outputs are newer than their inputs are skipped\n"
+         " -d DEPFILE    write make dependencies of all manifest outputs to DEPFILE\n"
+         " -j THREADS    number of conversion threads (default: number of processors)\n"
          "Other arguments:\n"
+         " -z PNG_WRITER export PNG writer: stb, store or zlib[:LEVEL[:FILTER]] (default: stb)\n"
+         "               FILTER: none, sub, up, avg, paeth, adaptive (default)\n"
          " -v            verbose logging\n"
          " -V            print version information\n",
          format2str(&default_config.format),
@@ -693,17 +1463,26 @@ static void print_version(void)
 }
 
 // parse command line arguments
-static int parse_arguments(int argc, char *argv[], graphics_config *config)
+// batch: batch and global options are accepted if non-NULL, manifest entries pass NULL
+static int parse_arguments(int argc, char *argv[], graphics_config *config, batch_config *batch)
 {
    for (int i = 1; i < argc; i++) {
       if (argv[i][0] == '-') {
          switch (argv[i][1]) {
+            case 'b':
+               if (!batch || ++i >= argc) return 0;
+               batch->manifest_filename = argv[i];
+               break;
             case 'c':
                if (++i >= argc) return 0;
                if (!parse_format(&config->pal_format, argv[i])) {
                   return 0;
                }
                break;
+            case 'd':
+               if (!batch || ++i >= argc) return 0;
+               batch->dep_filename = argv[i];
+               break;
             case 'e':
                if (++i >= argc) return 0;
                config->bin_filename = argv[i];
@@ -728,6 +1507,10 @@ static int parse_arguments(int argc, char *argv[], graphics_config *config)
                config->bin_filename = argv[i];
                config->mode = MODE_IMPORT;
                break;
+            case 'j':
+               if (!batch || ++i >= argc) return 0;
+               batch->threads = strtol(argv[i], NULL, 0);
+               break;
             case 'o':
                if (++i >= argc) return 0;
                config->bin_offset = strtoul(argv[i], NULL, 0);
@@ -743,9 +1526,11 @@ static int parse_arguments(int argc, char *argv[], graphics_config *config)
                config->pal_truncate = 0;
                break;
             case 'v':
+               if (!batch) return 0;
                g_verbosity = 1;
                break;
             case 'V':
+               if (!batch) return 0;
                print_version();
                exit(0);
                break;
@@ -753,6 +1538,12 @@ static int parse_arguments(int argc, char *argv[], graphics_config *config)
                if (++i >= argc) return 0;
                config->width = strtoul(argv[i], NULL, 0);
                break;
+            case 'z':
+               if (!batch || ++i >= argc) return 0;
+               if (n64graphics_parse_png_writer(argv[i]) < 0) {
+                  return 0;
+               }
+               break;
             default:
                return 0;
                break;
@@ -779,240 +1570,685 @@ static int valid_config(const graphics_config *config)
    return 1;
 }
 
-int main(int argc, char *argv[])
+// import PNG into raw binary and optional CI palette
+// config: entry to convert, width and height are updated from the PNG
+// returns EXIT_SUCCESS or EXIT_FAILURE
+static int import_image(graphics_config *config)
 {
-   graphics_config config = default_config;
-   rgba *imgr;
-   ia   *imgi;
+   rgba *imgr = NULL;
+   ia   *imgi = NULL;
    FILE *bin_fp;
-   uint8_t *raw;
+   uint8_t *raw = NULL;
    int raw_size;
    int length = 0;
    int flength;
-   int res;
+   int ret = EXIT_FAILURE;
 
-   int valid = parse_arguments(argc, argv, &config);
-   if (!valid || !valid_config(&config)) {
-      print_usage();
-      exit(EXIT_FAILURE);
+   if (config->bin_truncate) {
+      bin_fp = fopen(config->bin_filename, "w");
+   } else {
+      bin_fp = fopen(config->bin_filename, "r+");
+   }
+   if (!bin_fp) {
+      ERROR("Error opening \"%s\"\n", config->bin_filename);
+      return EXIT_FAILURE;
+   }
+   if (!config->bin_truncate) {
+      fseek(bin_fp, config->bin_offset, SEEK_SET);
    }
+   switch (config->format.format) {
+      case IMG_FORMAT_RGBA:
+      case IMG_FORMAT_IA:
+      case IMG_FORMAT_I:
+         if (config->format.format == IMG_FORMAT_RGBA) {
+            imgr = png2rgba(config->img_filename, &config->width, &config->height);
+         } else {
+            imgi = png2ia(config->img_filename, &config->width, &config->height);
+         }
+         if (!imgr && !imgi) {
+            ERROR("Error reading \"%s\"\n", config->img_filename);
+            goto import_done;
+         }
+         raw_size = config->width * config->height * config->format.depth / 8;
+         raw = malloc(raw_size);
+         if (!raw) {
+            ERROR("Error allocating %u bytes\n", raw_size);
+            goto import_done;
+         }
+         switch (config->format.format) {
+            case IMG_FORMAT_RGBA: length = rgba2raw(raw, imgr, config->width, config->height, config->format.depth); break;
+            case IMG_FORMAT_IA:   length = ia2raw(raw, imgi, config->width, config->height, config->format.depth); break;
+            default:              length = i2raw(raw, imgi, config->width, config->height, config->format.depth); break;
+         }
+         break;
+      case IMG_FORMAT_CI:
+      {
+         palette_t pal;
+         FILE *pal_fp;
+         uint8_t *raw16;
+         int raw16_size;
+         int raw16_length;
+         int pal_success;
+         int pal_length;
+
+         if (config->pal_format.format == IMG_FORMAT_RGBA) {
+            imgr = png2rgba(config->img_filename, &config->width, &config->height);
+         } else {
+            imgi = png2ia(config->img_filename, &config->width, &config->height);
+         }
+         if (!imgr && !imgi) {
+            ERROR("Error reading \"%s\"\n", config->img_filename);
+            goto import_done;
+         }
 
-   if (config.mode == MODE_IMPORT) {
-      if (config.bin_truncate) {
-         bin_fp = fopen(config.bin_filename, "w");
-      } else {
-         bin_fp = fopen(config.bin_filename, "r+");
-      }
-      if (!bin_fp) {
-         ERROR("Error opening \"%s\"\n", config.bin_filename);
-         return -1;
+         raw16_size = config->width * config->height * config->pal_format.depth / 8;
+         raw16 = malloc(raw16_size);
+         if (!raw16) {
+            ERROR("Error allocating %d bytes\n", raw16_size);
+            goto import_done;
+         }
+         if (config->pal_format.format == IMG_FORMAT_RGBA) {
+            raw16_length = rgba2raw(raw16, imgr, config->width, config->height, config->pal_format.depth);
+         } else {
+            raw16_length = ia2raw(raw16, imgi, config->width, config->height, config->pal_format.depth);
+         }
+
+         // convert raw to palette
+         pal.max = (1 << config->format.depth);
+         raw_size = config->width * config->height * config->format.depth / 8;
+         raw = malloc(raw_size);
+         pal_success = raw2ci(raw, &pal, raw16, raw16_length, config->format.depth);
+         free(raw16);
+         if (!pal_success) {
+            ERROR("Error converting palette for \"%s\"\n", config->img_filename);
+            goto import_done;
+         }
+         length = raw_size;
+
+         if (config->pal_truncate) {
+            pal_fp = fopen(config->pal_filename, "w");
+         } else {
+            pal_fp = fopen(config->pal_filename, "r+");
+         }
+         if (!pal_fp) {
+            ERROR("Error opening \"%s\"\n", config->pal_filename);
+            goto import_done;
+         }
+         if (!config->pal_truncate) {
+            fseek(pal_fp, config->pal_offset, SEEK_SET);
+         }
+
+         pal_length = pal.max * sizeof(pal.data[0]);
+         INFO("Writing 0x%X bytes to offset 0x%X of \"%s\"\n", pal_length, config->pal_offset, config->pal_filename);
+         flength = 0;
+         for (int i = 0; i < pal.max; i++) {
+            uint8_t entry[2];
+            write_u16_be(entry, pal.data[i]);
+            flength += fwrite(entry, 1, sizeof(entry), pal_fp);
+         }
+         fclose(pal_fp);
+         if (flength != pal_length) {
+            ERROR("Error writing %d bytes to \"%s\"\n", pal_length, config->pal_filename);
+            goto import_done;
+         }
+         break;
       }
-      if (!config.bin_truncate) {
-         fseek(bin_fp, config.bin_offset, SEEK_SET);
+      default:
+         goto import_done;
+   }
+   if (length <= 0) {
+      ERROR("Error converting to raw format\n");
+      goto import_done;
+   }
+   INFO("Writing 0x%X bytes to offset 0x%X of \"%s\"\n", length, config->bin_offset, config->bin_filename);
+   flength = fwrite(raw, 1, length, bin_fp);
+   if (flength != length) {
+      ERROR("Error writing %d bytes to \"%s\"\n", length, config->bin_filename);
+      goto import_done;
+   }
+   ret = EXIT_SUCCESS;
+
+import_done:
+   fclose(bin_fp);
+   free(raw);
+   free(imgr);
+   free(imgi);
+   return ret;
+}
+
+// export raw binary and optional CI palette to PNG
+// returns EXIT_SUCCESS or EXIT_FAILURE
+static int export_image(const graphics_config *config)
+{
+   rgba *imgr = NULL;
+   ia   *imgi = NULL;
+   FILE *bin_fp;
+   uint8_t *raw;
+   int raw_size;
+   int flength;
+   int res = 0;
+
+   if (config->width <= 0 || config->height <= 0 || config->format.depth <= 0) {
+      ERROR("Error: must set position width and height for export\n");
+      return EXIT_FAILURE;
+   }
+   bin_fp = fopen(config->bin_filename, "r");
+   if (!bin_fp) {
+      ERROR("Error opening \"%s\"\n", config->bin_filename);
+      return EXIT_FAILURE;
+   }
+   raw_size = config->width * config->height * config->format.depth / 8;
+   raw = malloc(raw_size);
+   if (config->bin_offset > 0) {
+      fseek(bin_fp, config->bin_offset, SEEK_SET);
+   }
+   flength = fread(raw, 1, raw_size, bin_fp);
+   fclose(bin_fp);
+   if (flength != raw_size) {
+      ERROR("Error reading %d bytes from \"%s\"\n", raw_size, config->bin_filename);
+   }
+   switch (config->format.format) {
+      case IMG_FORMAT_RGBA:
+         imgr = raw2rgba(raw, config->width, config->height, config->format.depth);
+         res = rgba2png(config->img_filename, imgr, config->width, config->height);
+         break;
+      case IMG_FORMAT_IA:
+         imgi = raw2ia(raw, config->width, config->height, config->format.depth);
+         res = ia2png(config->img_filename, imgi, config->width, config->height);
+         break;
+      case IMG_FORMAT_I:
+         imgi = raw2i(raw, config->width, config->height, config->format.depth);
+         res = ia2png(config->img_filename, imgi, config->width, config->height);
+         break;
+      case IMG_FORMAT_CI:
+      {
+         FILE *pal_fp;
+         uint8_t *pal;
+         uint8_t *raw_fmt;
+         int pal_size;
+
+         INFO("Extracting %s offset 0x%X, pal.offset 0x%0X, pal.format %s\n", format2str(&config->format),
+              config->bin_offset, config->pal_offset, format2str(&config->pal_format));
+
+         pal_fp = fopen(config->pal_filename, "r");
+         if (!pal_fp) {
+            ERROR("Error opening \"%s\"\n", config->pal_filename);
+            free(raw);
+            return EXIT_FAILURE;
+         }
+         if (config->pal_offset > 0) {
+            fseek(pal_fp, config->pal_offset, SEEK_SET);
+         }
+
+         pal_size = sizeof(uint16_t) * (1 << config->format.depth);
+         INFO("Palette size: %d\n", pal_size);
+         pal = malloc(pal_size);
+         flength = fread(pal, 1, pal_size, pal_fp);
+         fclose(pal_fp);
+         if (flength != pal_size) {
+            ERROR("Error reading %d bytes from \"%s\"\n", pal_size, config->pal_filename);
+         }
+         raw_fmt = ci2raw(raw, pal, config->width, config->height, config->format.depth);
+         switch (config->pal_format.format) {
+            case IMG_FORMAT_RGBA:
+               INFO("Converting raw to RGBA16\n");
+               imgr = raw2rgba(raw_fmt, config->width, config->height, config->pal_format.depth);
+               res = rgba2png(config->img_filename, imgr, config->width, config->height);
+               break;
+            case IMG_FORMAT_IA:
+               INFO("Converting raw to IA16\n");
+               imgi = raw2ia(raw_fmt, config->width, config->height, config->pal_format.depth);
+               res = ia2png(config->img_filename, imgi, config->width, config->height);
+               break;
+            default:
+               ERROR("Unsupported palette format: %s\n", format2str(&config->pal_format));
+               break;
+         }
+         free(raw_fmt);
+         free(pal);
+         break;
       }
-      switch (config.format.format) {
-         case IMG_FORMAT_RGBA:
-            imgr = png2rgba(config.img_filename, &config.width, &config.height);
-            raw_size = config.width * config.height * config.format.depth / 8;
-            raw = malloc(raw_size);
-            if (!raw) {
-               ERROR("Error allocating %u bytes\n", raw_size);
-            }
-            length = rgba2raw(raw, imgr, config.width, config.height, config.format.depth);
-            break;
-         case IMG_FORMAT_IA:
-            imgi = png2ia(config.img_filename, &config.width, &config.height);
-            raw_size = config.width * config.height * config.format.depth / 8;
-            raw = malloc(raw_size);
-            if (!raw) {
-               ERROR("Error allocating %u bytes\n", raw_size);
-            }
-            length = ia2raw(raw, imgi, config.width, config.height, config.format.depth);
-            break;
-         case IMG_FORMAT_I:
-            imgi = png2ia(config.img_filename, &config.width, &config.height);
-            raw_size = config.width * config.height * config.format.depth / 8;
-            raw = malloc(raw_size);
-            if (!raw) {
-               ERROR("Error allocating %u bytes\n", raw_size);
-            }
-            length = i2raw(raw, imgi, config.width, config.height, config.format.depth);
-            break;
-         case IMG_FORMAT_CI:
-         {
-            palette_t pal;
-            FILE *pal_fp;
-            uint8_t *raw16;
-            int raw16_size;
-            int raw16_length;
-            uint8_t *ci;
-            int ci_length;
-            int pal_success;
-            int pal_length;
-
-            if (config.pal_truncate) {
-               pal_fp = fopen(config.pal_filename, "w");
-            } else {
-               pal_fp = fopen(config.pal_filename, "r+");
-            }
-            if (!pal_fp) {
-               ERROR("Error opening \"%s\"\n", config.pal_filename);
-               return EXIT_FAILURE;
-            }
-            if (!config.pal_truncate) {
-               fseek(pal_fp, config.bin_offset, SEEK_SET);
-            }
+      default:
+         break;
+   }
+   free(raw);
+   free(imgr);
+   free(imgi);
+   if (!res) {
+      ERROR("Error writing to \"%s\"\n", config->img_filename);
+      return EXIT_FAILURE;
+   }
+   return EXIT_SUCCESS;
+}
 
-            raw16_size = config.width * config.height * config.pal_format.depth / 8;
-            raw16 = malloc(raw16_size);
-            if (!raw16) {
-               ERROR("Error allocating %d bytes\n", raw16_size);
-               return EXIT_FAILURE;
-            }
-            switch (config.pal_format.format) {
-               case IMG_FORMAT_RGBA:
-                  imgr = png2rgba(config.img_filename, &config.width, &config.height);
-                  raw16_length = rgba2raw(raw16, imgr, config.width, config.height, config.pal_format.depth);
-                  break;
-               case IMG_FORMAT_IA:
-                  imgi = png2ia(config.img_filename, &config.width, &config.height);
-                  raw16_length = ia2raw(raw16, imgi, config.width, config.height, config.pal_format.depth);
-                  break;
-               default:
-                  ERROR("Unsupported palette format: %s\n", format2str(&config.pal_format));
-                  exit(EXIT_FAILURE);
-            }
+static int convert_image(graphics_config *config)
+{
+   if (config->mode == MODE_IMPORT) {
+      return import_image(config);
+   }
+   return export_image(config);
+}
 
-            // convert raw to palette
-            pal.max = (1 << config.format.depth);
-            ci_length = config.width * config.height * config.format.depth / 8;
-            ci = malloc(ci_length);
-            pal_success = raw2ci(ci, &pal, raw16, raw16_length, config.format.depth);
-            if (!pal_success) {
-               ERROR("Error converting palette\n");
-               exit(EXIT_FAILURE);
-            }
+//---------------------------------------------------------
+// batch manifest mode
+//---------------------------------------------------------
 
-            pal_length = pal.max * sizeof(pal.data[0]);
-            INFO("Writing 0x%X bytes to offset 0x%X of \"%s\"\n", pal_length, config.pal_offset, config.pal_filename);
-            flength = 0;
-            for (int i = 0; i < pal.max; i++) {
-               uint8_t entry[2];
-               write_u16_be(entry, pal.data[i]);
-               flength += fwrite(entry, 1, sizeof(entry), pal_fp);
-            }
-            if (flength != pal_length) {
-               ERROR("Error writing %d bytes to \"%s\"\n", pal_length, config.pal_filename);
-            }
+typedef struct
+{
+   graphics_config config;
+   int line;   // manifest line number for messages
+   int stale;  // outputs are missing or older than inputs
+   int pass;   // runs after all entries in earlier passes
+   int result; // EXIT_SUCCESS or EXIT_FAILURE once converted
+} batch_entry;
+
+// one output file written by an entry
+typedef struct
+{
+   const char *filename;
+   int entry;
+   int truncate; // file is truncated rather than written at an offset
+} batch_write;
 
-            raw = ci;
-            length = ci_length;
+typedef struct
+{
+   pthread_mutex_t lock;
+   int next;
+   int count;
+   batch_entry **entries;
+} batch_queue;
+
+// get input and output file names of entry, returns count of inputs
+static int entry_files(const graphics_config *config, const char **inputs, const char **outputs, int *out_count)
+{
+   int is_ci = config->format.format == IMG_FORMAT_CI;
+   if (config->mode == MODE_IMPORT) {
+      inputs[0] = config->img_filename;
+      outputs[0] = config->bin_filename;
+      outputs[1] = config->pal_filename;
+      *out_count = is_ci ? 2 : 1;
+      return 1;
+   }
+   inputs[0] = config->bin_filename;
+   inputs[1] = config->pal_filename;
+   outputs[0] = config->img_filename;
+   *out_count = 1;
+   return is_ci ? 2 : 1;
+}
 
-            free(raw16);
-            fclose(pal_fp);
-            break;
-         }
-         default:
-            return EXIT_FAILURE;
+// returns 1 if any output is missing or not newer than any input
+// manifest_mtime: modification time of the manifest, which is an input of every entry
+static int entry_stale(const graphics_config *config, time_t manifest_mtime)
+{
+   const char *inputs[2], *outputs[2];
+   int in_count, out_count;
+   struct stat st;
+   time_t newest_in = manifest_mtime;
+
+   in_count = entry_files(config, inputs, outputs, &out_count);
+   for (int i = 0; i < in_count; i++) {
+      if (stat(inputs[i], &st) != 0) {
+         // let the conversion report it
+         return 1;
       }
-      if (length <= 0) {
-         ERROR("Error converting to raw format\n");
-         return EXIT_FAILURE;
+      newest_in = MAX(newest_in, st.st_mtime);
+   }
+   for (int i = 0; i < out_count; i++) {
+      if (stat(outputs[i], &st) != 0 || st.st_mtime <= newest_in) {
+         return 1;
       }
-      INFO("Writing 0x%X bytes to offset 0x%X of \"%s\"\n", length, config.bin_offset, config.bin_filename);
-      flength = fwrite(raw, 1, length, bin_fp);
-      if (flength != length) {
-         ERROR("Error writing %d bytes to \"%s\"\n", length, config.bin_filename);
+   }
+   return 0;
+}
+
+// parse manifest into entries, tokens are NUL terminated in place so 'text' must outlive the entries
+// text: manifest contents with room for a terminator at text[length]
+// returns entry count or negative on error
+static int parse_manifest(char *text, long length, batch_entry **entries)
+{
+   batch_entry *list = NULL;
+   int count = 0;
+   int capacity = 0;
+   int line = 0;
+   char *p = text;
+   char *end = text + length;
+
+   while (p < end) {
+      char *argv[MANIFEST_MAX_ARGS];
+      int argc = 1;
+      char *eol = memchr(p, '\n', end - p);
+      if (!eol) {
+         eol = end;
       }
-      fclose(bin_fp);
+      *eol = '\0';
+      line++;
 
-   } else {
-      if (config.width <= 0 || config.height <= 0 || config.format.depth <= 0) {
-         ERROR("Error: must set position width and height for export\n");
-         return EXIT_FAILURE;
+      argv[0] = "n64graphics";
+      while (p < eol) {
+         while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            *p++ = '\0';
+         }
+         if (p >= eol || *p == '#') {
+            break;
+         }
+         if (argc >= MANIFEST_MAX_ARGS) {
+            ERROR("Error: too many arguments on manifest line %d\n", line);
+            free(list);
+            return -1;
+         }
+         argv[argc++] = p;
+         while (p < eol && *p != ' ' && *p != '\t' && *p != '\r') {
+            p++;
+         }
       }
-      bin_fp = fopen(config.bin_filename, "r");
-      if (!bin_fp) {
-         ERROR("Error opening \"%s\"\n", config.bin_filename);
-         return -1;
+      p = eol + 1;
+
+      if (argc > 1) {
+         batch_entry *entry;
+         if (count >= capacity) {
+            capacity = capacity ? 2 * capacity : 256;
+            list = realloc(list, capacity * sizeof(*list));
+         }
+         entry = &list[count];
+         entry->config = default_config;
+         entry->line = line;
+         entry->stale = 0;
+         entry->pass = 0;
+         entry->result = EXIT_SUCCESS;
+         if (!parse_arguments(argc, argv, &entry->config, NULL) || !valid_config(&entry->config)) {
+            ERROR("Error: invalid manifest entry on line %d\n", line);
+            free(list);
+            return -1;
+         }
+         count++;
       }
-      raw_size = config.width * config.height * config.format.depth / 8;
-      raw = malloc(raw_size);
-      if (config.bin_offset > 0) {
-         fseek(bin_fp, config.bin_offset, SEEK_SET);
+   }
+   *entries = list;
+   return count;
+}
+
+static void *batch_worker(void *arg)
+{
+   batch_queue *queue = arg;
+   while (1) {
+      int i;
+      pthread_mutex_lock(&queue->lock);
+      i = queue->next++;
+      pthread_mutex_unlock(&queue->lock);
+      if (i >= queue->count) {
+         break;
       }
-      flength = fread(raw, 1, raw_size, bin_fp);
-      if (flength != raw_size) {
-         ERROR("Error reading %d bytes from \"%s\"\n", raw_size, config.bin_filename);
+      batch_entry *entry = queue->entries[i];
+      entry->result = convert_image(&entry->config);
+      if (entry->result != EXIT_SUCCESS) {
+         ERROR("Error: manifest line %d failed\n", entry->line);
       }
-      switch (config.format.format) {
-         case IMG_FORMAT_RGBA:
-            imgr = raw2rgba(raw, config.width, config.height, config.format.depth);
-            res = rgba2png(config.img_filename, imgr, config.width, config.height);
-            break;
-         case IMG_FORMAT_IA:
-            imgi = raw2ia(raw, config.width, config.height, config.format.depth);
-            res = ia2png(config.img_filename, imgi, config.width, config.height);
-            break;
-         case IMG_FORMAT_I:
-            imgi = raw2i(raw, config.width, config.height, config.format.depth);
-            res = ia2png(config.img_filename, imgi, config.width, config.height);
-            break;
-         case IMG_FORMAT_CI:
-         {
-            FILE *pal_fp;
-            uint8_t *pal;
-            uint8_t *raw_fmt;
-            int pal_size;
-
-            INFO("Extracting %s offset 0x%X, pal.offset 0x%0X, pal.format %s\n", format2str(&config.format),
-                 config.bin_offset, config.pal_offset, format2str(&config.pal_format));
-
-            pal_fp = fopen(config.pal_filename, "r");
-            if (!pal_fp) {
-               ERROR("Error opening \"%s\"\n", config.bin_filename);
-               return EXIT_FAILURE;
-            }
-            if (config.pal_offset > 0) {
-               fseek(pal_fp, config.pal_offset, SEEK_SET);
+   }
+   return NULL;
+}
+
+static void run_batch_queue(batch_entry **entries, int count, int threads)
+{
+   batch_queue queue;
+   pthread_t *workers;
+   int i;
+
+   if (count == 0) {
+      return;
+   }
+   threads = MAX(1, MIN(threads, count));
+   queue.next = 0;
+   queue.count = count;
+   queue.entries = entries;
+   pthread_mutex_init(&queue.lock, NULL);
+   workers = malloc(threads * sizeof(*workers));
+   for (i = 0; i < threads; i++) {
+      pthread_create(&workers[i], NULL, batch_worker, &queue);
+   }
+   for (i = 0; i < threads; i++) {
+      pthread_join(workers[i], NULL);
+   }
+   pthread_mutex_destroy(&queue.lock);
+   free(workers);
+}
+
+// writes to the same file sort together, truncating writes first
+static int batch_write_cmp(const void *a, const void *b)
+{
+   const batch_write *wa = a;
+   const batch_write *wb = b;
+   int cmp = strcmp(wa->filename, wb->filename);
+   if (cmp == 0) {
+      cmp = wb->truncate - wa->truncate;
+   }
+   if (cmp == 0) {
+      cmp = wa->entry - wb->entry;
+   }
+   return cmp;
+}
+
+// collect output files of all entries sorted by file name
+// returns count of writes
+static int collect_writes(const batch_entry *entries, int count, batch_write **writes)
+{
+   batch_write *list = malloc(MAX(2 * count, 1) * sizeof(*list));
+   int write_count = 0;
+   for (int i = 0; i < count; i++) {
+      const graphics_config *config = &entries[i].config;
+      const char *inputs[2], *outputs[2];
+      int out_count;
+      entry_files(config, inputs, outputs, &out_count);
+      for (int j = 0; j < out_count; j++) {
+         list[write_count].filename = outputs[j];
+         list[write_count].entry = i;
+         // exported images are always rewritten whole
+         list[write_count].truncate = config->mode != MODE_IMPORT ||
+            (j == 0 ? config->bin_truncate : config->pal_truncate);
+         write_count++;
+      }
+   }
+   qsort(list, write_count, sizeof(*list), batch_write_cmp);
+   *writes = list;
+   return write_count;
+}
+
+// a stale entry that truncates a file invalidates everything written at offsets into it, which may
+// in turn truncate other files. then assign passes so that every entry writing at an offset into a
+// file runs after the entries that truncate it
+// returns number of passes or negative if entries depend on each other's truncation in a cycle
+static int order_entries(batch_entry *entries, int count)
+{
+   batch_write *writes;
+   int write_count = collect_writes(entries, count, &writes);
+   int changed = 1;
+   int passes = 0;
+   int rounds;
+
+   while (changed) {
+      changed = 0;
+      for (int s = 0, e; s < write_count; s = e) {
+         int truncated = 0;
+         for (e = s; e < write_count && !strcmp(writes[s].filename, writes[e].filename); e++) {
+            truncated |= writes[e].truncate && entries[writes[e].entry].stale;
+         }
+         for (int k = s; truncated && k < e; k++) {
+            if (!entries[writes[k].entry].stale) {
+               entries[writes[k].entry].stale = 1;
+               changed = 1;
             }
+         }
+      }
+   }
 
-            pal_size = sizeof(uint16_t) * (1 << config.format.depth);
-            INFO("Palette size: %d\n", pal_size);
-            pal = malloc(pal_size);
-            flength = fread(pal, 1, pal_size, pal_fp);
-            if (flength != pal_size) {
-               ERROR("Error reading %d bytes from \"%s\"\n", pal_size, config.pal_filename);
+   for (int i = 0; i < count; i++) {
+      entries[i].pass = 0;
+   }
+   // pass numbers only grow, and without a cycle they are settled after at most 'count' rounds
+   changed = 1;
+   for (rounds = 0; changed && rounds <= count; rounds++) {
+      changed = 0;
+      for (int s = 0, e; s < write_count; s = e) {
+         int after = -1;
+         for (e = s; e < write_count && !strcmp(writes[s].filename, writes[e].filename); e++) {
+            const batch_entry *entry = &entries[writes[e].entry];
+            if (writes[e].truncate && entry->stale) {
+               after = MAX(after, entry->pass);
             }
-            raw_fmt = ci2raw(raw, pal, config.width, config.height, config.format.depth);
-            switch (config.pal_format.format) {
-               case IMG_FORMAT_RGBA:
-                  INFO("Converting raw to RGBA16\n");
-                  imgr = raw2rgba(raw_fmt, config.width, config.height, config.pal_format.depth);
-                  res = rgba2png(config.img_filename, imgr, config.width, config.height);
-                  break;
-               case IMG_FORMAT_IA:
-                  INFO("Converting raw to IA16\n");
-                  imgi = raw2ia(raw_fmt, config.width, config.height, config.pal_format.depth);
-                  res = ia2png(config.img_filename, imgi, config.width, config.height);
-                  break;
-               default:
-                  ERROR("Unsupported palette format: %s\n", format2str(&config.pal_format));
-                  return EXIT_FAILURE;
+         }
+         for (int k = s; after >= 0 && k < e; k++) {
+            batch_entry *entry = &entries[writes[k].entry];
+            if (!writes[k].truncate && entry->stale && entry->pass <= after) {
+               entry->pass = after + 1;
+               changed = 1;
             }
-            free(raw_fmt);
-            free(pal);
-            break;
          }
-         default:
-            return EXIT_FAILURE;
       }
-      if (!res) {
-         ERROR("Error writing to \"%s\"\n", config.img_filename);
-         return EXIT_FAILURE;
+   }
+   free(writes);
+   if (changed) {
+      ERROR("Error: manifest entries write at offsets into files truncated by each other\n");
+      return -1;
+   }
+   for (int i = 0; i < count; i++) {
+      passes = MAX(passes, entries[i].pass + 1);
+   }
+   return passes;
+}
+
+static int write_depfile(const char *dep_filename, const char *manifest_filename, const batch_entry *entries, int count)
+{
+   FILE *fp = fopen(dep_filename, "w");
+   if (!fp) {
+      ERROR("Error opening \"%s\"\n", dep_filename);
+      return -1;
+   }
+   for (int i = 0; i < count; i++) {
+      const char *inputs[2], *outputs[2];
+      int out_count;
+      int in_count = entry_files(&entries[i].config, inputs, outputs, &out_count);
+      for (int j = 0; j < out_count; j++) {
+         fprintf(fp, "%s%s", j ? " " : "", outputs[j]);
+      }
+      fprintf(fp, ":");
+      for (int j = 0; j < in_count; j++) {
+         fprintf(fp, " %s", inputs[j]);
+      }
+      fprintf(fp, " %s\n", manifest_filename);
+   }
+   // empty rules so make doesn't fail when an input is removed from the manifest
+   for (int i = 0; i < count; i++) {
+      const char *inputs[2], *outputs[2];
+      int out_count;
+      int in_count = entry_files(&entries[i].config, inputs, outputs, &out_count);
+      for (int j = 0; j < in_count; j++) {
+         fprintf(fp, "%s:\n", inputs[j]);
+      }
+   }
+   fclose(fp);
+   return 0;
+}
+
+// convert all entries of manifest
+// entries which truncate a file run before entries which write at offsets into it
+// returns EXIT_SUCCESS if all entries converted
+static int run_batch(const batch_config *batch)
+{
+   batch_entry *entries;
+   batch_entry **queue;
+   unsigned char *text;
+   long length;
+   int count;
+   int queued;
+   int skipped = 0;
+   int failed = 0;
+   int threads;
+   int passes;
+   struct stat st;
+   double start = get_time();
+
+   length = read_file(batch->manifest_filename, &text);
+   if (length < 0) {
+      ERROR("Error reading manifest \"%s\"\n", batch->manifest_filename);
+      return EXIT_FAILURE;
+   }
+   // room to terminate a last line without newline
+   text = realloc(text, length + 1);
+   text[length] = '\0';
+   count = parse_manifest((char *)text, length, &entries);
+   if (count < 0) {
+      free(text);
+      return EXIT_FAILURE;
+   }
+
+   // decide up front so entries converted this run don't make their neighbors look fresh
+   if (stat(batch->manifest_filename, &st) != 0) {
+      ERROR("Error reading manifest \"%s\"\n", batch->manifest_filename);
+      free(entries);
+      free(text);
+      return EXIT_FAILURE;
+   }
+   for (int i = 0; i < count; i++) {
+      entries[i].stale = entry_stale(&entries[i].config, st.st_mtime);
+   }
+   passes = order_entries(entries, count);
+   if (passes < 0) {
+      free(entries);
+      free(text);
+      return EXIT_FAILURE;
+   }
+
+   threads = batch->threads > 0 ? batch->threads : cpu_count();
+   queue = malloc(MAX(count, 1) * sizeof(*queue));
+   for (int pass = 0; pass < passes; pass++) {
+      queued = 0;
+      for (int i = 0; i < count; i++) {
+         if (entries[i].stale && entries[i].pass == pass) {
+            queue[queued++] = &entries[i];
+         }
       }
+      run_batch_queue(queue, queued, threads);
    }
+   free(queue);
 
-   return EXIT_SUCCESS;
+   for (int i = 0; i < count; i++) {
+      if (!entries[i].stale) {
+         skipped++;
+      } else if (entries[i].result != EXIT_SUCCESS) {
+         failed++;
+      }
+   }
+   INFO("Converted %d of %d entries in %.3f s (%d up to date, %d failed)\n",
+        count - skipped - failed, count, get_time() - start, skipped, failed);
+
+   if (!failed && batch->dep_filename) {
+      if (write_depfile(batch->dep_filename, batch->manifest_filename, entries, count) < 0) {
+         failed++;
+      }
+   }
+
+   free(entries);
+   free(text);
+   return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+   graphics_config config = default_config;
+   batch_config batch = default_batch;
+
+   int valid = parse_arguments(argc, argv, &config, &batch);
+   if (valid && batch.manifest_filename) {
+      if (config.bin_filename || config.img_filename) {
+         print_usage();
+         exit(EXIT_FAILURE);
+      }
+      return run_batch(&batch);
+   }
+   if (!valid || !valid_config(&config) || batch.dep_filename) {
+      print_usage();
+      exit(EXIT_FAILURE);
+   }
+
+   return convert_image(&config);
 }
 #endif // N64GRAPHICS_STANDALONE
@@ -19,17 +19,52 @@ typedef struct _ia
 } ia;
 
 // CI palette
+#define PAL_HASH_SIZE 512 // power of two, at least twice the max entries
+
 typedef struct
 {
    uint16_t data[256];
    int max; // max number of entries
    int used; // number of entries used
+   uint16_t hash[PAL_HASH_SIZE]; // open addressed color lookup: data[] index + 1, 0 if empty
 } palette_t;
 
+// conversion kernels used by raw2*() and *2raw()
+typedef enum
+{
+   N64GRAPHICS_KERNELS_SCALAR,
+   N64GRAPHICS_KERNELS_SSE2,
+   N64GRAPHICS_KERNELS_AVX2,
+} n64graphics_kernels;
+
+// select conversion kernels, the fastest built in are used by default
+// all kernels produce identical output, the scalar ones are the reference
+// returns 0 on success, -1 if not built in (AVX2 requires building with -mavx2)
+int n64graphics_select_kernels(n64graphics_kernels kern);
+
+// get display name of conversion kernels
+const char *n64graphics_kernels_name(n64graphics_kernels kern);
+
 //---------------------------------------------------------
 // N64 RGBA/IA/I/CI -> intermediate RGBA/IA
+// intermediate RGBA/IA are laid out as packed PNG RGBA/grey+alpha scanlines,
+// so converted buffers are written by rgba2png()/ia2png() without repacking
 //---------------------------------------------------------
 
+// N64 raw RGBA16/RGBA32 -> caller buffer of 'count' pixels
+// returns 0 on success, -1 on invalid depth
+int raw2rgba_buf(rgba *img, const uint8_t *raw, int count, int depth);
+
+// N64 raw IA1/IA4/IA8/IA16 -> caller buffer of 'count' pixels
+// raw must start on a byte boundary for IA1/IA4
+// returns 0 on success, -1 on invalid depth
+int raw2ia_buf(ia *img, const uint8_t *raw, int count, int depth);
+
+// N64 raw I4/I8 -> caller buffer of 'count' pixels
+// raw must start on a byte boundary for I4
+// returns 0 on success, -1 on invalid depth
+int raw2i_buf(ia *img, const uint8_t *raw, int count, int depth);
+
 // N64 raw RGBA16/RGBA32 -> intermediate RGBA
 rgba *raw2rgba(const uint8_t *raw, int width, int height, int depth);
 
@@ -61,14 +96,61 @@ int i2raw(uint8_t *raw, const ia *img, int width, int height, int depth);
 // N64 CI raw data and palette to raw data (either RGBA16 or IA16)
 uint8_t *ci2raw(const uint8_t *rawci, const uint8_t *palette, int width, int height, int ci_depth);
 
+// empty palette and set max number of entries (at most 256)
+void pal_init(palette_t *pal, int max);
+
+// find index of palette color
+// returns -1 if not found
+int pal_find_color(const palette_t *pal, uint16_t val);
+
+// find color in palette, or add if not there
+// returns palette index entered or -1 if palette full
+int pal_add_color(palette_t *pal, uint16_t val);
+
 // convert from raw (RGBA16 or IA16) format to CI + palette
+// pal->max must be set, palette is emptied first
+// returns 1 on success
 int raw2ci(uint8_t *rawci, palette_t *pal, const uint8_t *raw, int raw_len, int ci_depth);
 
+// convert from raw (RGBA16 or IA16) format to CI, using and extending existing palette
+// for several textures sharing one palette; initialize it once with pal_init()
+// returns 1 on success
+int raw2ci_shared(uint8_t *rawci, palette_t *pal, const uint8_t *raw, int raw_len, int ci_depth);
+
 
 //---------------------------------------------------------
 // intermediate RGBA/IA -> PNG
 //---------------------------------------------------------
 
+typedef enum
+{
+   N64GRAPHICS_PNG_STB,    // stb_image_write (default)
+   N64GRAPHICS_PNG_ZLIB,   // zlib deflate with configurable level and filter
+   N64GRAPHICS_PNG_STORE,  // uncompressed deflate blocks, fastest and largest
+} n64graphics_png_writer;
+
+// PNG row filters, values match the PNG filter types
+typedef enum
+{
+   N64GRAPHICS_PNG_FILTER_NONE,
+   N64GRAPHICS_PNG_FILTER_SUB,
+   N64GRAPHICS_PNG_FILTER_UP,
+   N64GRAPHICS_PNG_FILTER_AVG,
+   N64GRAPHICS_PNG_FILTER_PAETH,
+   N64GRAPHICS_PNG_FILTER_ADAPTIVE, // choose per row
+} n64graphics_png_filter;
+
+// select PNG writer used by rgba2png() and ia2png()
+// level: zlib compression level 0-9, or -1 for zlib default (zlib writer only)
+// filter: row filter (zlib writer only)
+// returns 0 on success, -1 on invalid parameters
+int n64graphics_set_png_writer(n64graphics_png_writer writer, int level, n64graphics_png_filter filter);
+
+// select PNG writer from command line string: "stb", "store" or "zlib[:LEVEL[:FILTER]]"
+// FILTER is one of none, sub, up, avg, paeth, adaptive (default)
+// returns 0 on success, -1 if invalid
+int n64graphics_parse_png_writer(const char *spec);
+
 // intermediate RGBA write to PNG file
 int rgba2png(const char *png_filename, const rgba *img, int width, int height);
 
@@ -1,3 +1,6 @@
+#include <pthread.h>
+#include <sys/stat.h>
+
 #include "n64split.h"
 
 // static files
@@ -16,6 +19,9 @@ static const arg_config default_args =
    .large_texture_depth = 16,
    .keep_going = false,
    .merge_pseudo = false,
+   .incremental = false,
+   .threads = 0,
+   .png_writer = "stb",
 };
 
 const char asm_header[] = 
@@ -32,11 +38,11 @@ const char asm_header[] =
 
 
 
-void print_spaces(FILE *fp, int count)
+void print_spaces(outbuf *out, int count)
 {
    int i;
    for (i = 0; i < count; i++) {
-      fputc(' ', fp);
+      outbuf_putc(out, ' ');
    }
 }
 
@@ -55,43 +61,100 @@ n64_rom_format n64_rom_type(unsigned char *buf, unsigned int length)
    return N64_ROM_INVALID;
 }
 
-void gzip_decode_file(char *gzfilename, int offset, char *binfilename)
+long gzip_decode(unsigned char *in, unsigned int in_len, unsigned char **out)
 {
 #define CHUNK 0x4000
-   FILE *file;
-   FILE *fout;
    z_stream strm = {0};
-   unsigned char in[CHUNK];
-   unsigned char out[CHUNK];
+   unsigned char *buf;
+   unsigned long buf_len = MAX(4 * in_len, CHUNK);
+   int ret;
 
-   // TODO: add some error checking
    strm.zalloc = Z_NULL;
    strm.zfree = Z_NULL;
    strm.opaque = Z_NULL;
-   strm.avail_in = 0;
-   inflateInit2(&strm, 16+MAX_WBITS);
+   strm.next_in = in;
+   strm.avail_in = in_len;
+   if (inflateInit2(&strm, 16+MAX_WBITS) != Z_OK) {
+      return -1;
+   }
 
-   file = fopen(gzfilename, "rb");
-   fout = fopen(binfilename, "wb");
-   fseek(file, offset, SEEK_SET);
-   while (1) {
-      int bytes_read;
-      bytes_read = fread(in, sizeof(char), sizeof(in), file);
-      strm.avail_in = bytes_read;
-      strm.next_in = in;
-      do {
-         strm.avail_out = CHUNK;
-         strm.next_out = out;
-         inflate(&strm, Z_NO_FLUSH);
-         fwrite(out, sizeof(char), CHUNK - strm.avail_out, fout);
-      } while (strm.avail_out == 0);
-      if (feof(file)) {
-         inflateEnd(&strm);
+   buf = malloc(buf_len);
+   do {
+      // grow output buffer until the whole stream fits
+      if (strm.total_out == buf_len) {
+         buf_len *= 2;
+         buf = realloc(buf, buf_len);
+      }
+      strm.next_out = &buf[strm.total_out];
+      strm.avail_out = buf_len - strm.total_out;
+      ret = inflate(&strm, Z_NO_FLUSH);
+   } while (ret == Z_OK);
+   if (ret != Z_STREAM_END) {
+      ERROR("Error inflating GZIP data: %s\n", strm.msg ? strm.msg : "truncated input");
+   }
+   inflateEnd(&strm);
+
+   *out = buf;
+   return strm.total_out;
+}
+
+// decompress a MIO0, GZIP, or Blast section directly from the ROM
+// returns length of uncompressed data allocated in 'out' or negative on error
+static long decompress_section(unsigned char *data, split_section *sec, unsigned char **out)
+{
+   unsigned char *in = &data[sec->start];
+   unsigned int in_len = sec->end - sec->start;
+   long out_len = -1;
+
+   *out = NULL;
+   switch (sec->type) {
+      case TYPE_BLAST:
+      {
+         unsigned char *lut;
+         // TODO: make this configurable?
+         switch (sec->subtype) {
+            case 4: lut = &data[0x047480]; break;
+            case 5: lut = &data[0x0998E0]; break; // TODO: fix this
+            default: lut = data; break;
+         }
+         // estimate worst case size
+         *out = malloc(BLAST_MAX_RATIO * in_len);
+         out_len = blast_decode(in, in_len, sec->subtype, *out, lut);
          break;
       }
+      case TYPE_MIO0:
+      {
+         mio0_header_t head;
+         mio0_stream stream;
+         int len;
+         if (!mio0_decode_header(in, &head)) {
+            break;
+         }
+         // bounded decode: corrupt sections can't read past their end in the ROM
+         *out = malloc(head.dest_size);
+         mio0_stream_init(&stream);
+         mio0_stream_feed(&stream, in, in_len);
+         out_len = 0;
+         while ((len = mio0_stream_drain(&stream, &(*out)[out_len], head.dest_size - out_len)) > 0) {
+            out_len += len;
+         }
+         if (len < 0) {
+            out_len = -1;
+         }
+         break;
+      }
+      case TYPE_GZIP:
+         out_len = gzip_decode(in, in_len, out);
+         break;
+      default:
+         break;
+   }
+   if (out_len < 0) {
+      ERROR("Error decompressing section %s %X-%X\n", sec->label, sec->start, sec->end);
+      free(*out);
+      *out = NULL;
    }
-   fclose(file);
-   fclose(fout);
+   return out_len;
 }
 
 int config_section_lookup(rom_config *config, unsigned int addr, char *label, int is_end)
@@ -100,30 +163,28 @@ int config_section_lookup(rom_config *config, unsigned int addr, char *label, in
    // check for ROM offsets
    switch (is_end) {
       case 0:
-         for (i = 0; i < config->section_count; i++) {
-            // TODO: hack until mario_animation gets moved or AT() is used
-            if (config->sections[i].start == addr && addr != 0x4EC000) {
-               if (config->sections[i].label[0] != '\0') {
-                  sprintf(label, "%s", config->sections[i].label);
-               } else {
-                  sprintf(label, "%s_%06X", config_section2str(config->sections[i].type), addr);
-               }
-               INFO("Found 0 %06X: %s\n", addr, label);
-               return 0;
+         // TODO: hack until mario_animation gets moved or AT() is used
+         i = (addr != 0x4EC000) ? config_find_section(config, addr, 0) : -1;
+         if (i >= 0) {
+            if (config->sections[i].label[0] != '\0') {
+               sprintf(label, "%s", config->sections[i].label);
+            } else {
+               sprintf(label, "%s_%06X", config_section2str(config->sections[i].type), addr);
             }
+            INFO("Found 0 %06X: %s\n", addr, label);
+            return 0;
          }
          break;
       case 1:
-         for (i = 0; i < config->section_count; i++) {
-            if (config->sections[i].end == addr) {
-               if (config->sections[i].label[0] != '\0') {
-                  sprintf(label, "%s_end", config->sections[i].label);
-               } else {
-                  sprintf(label, "%s_%06X", config_section2str(config->sections[i].type), addr);
-               }
-               INFO("Found 1 %06X: %s\n", addr, label);
-               return 0;
+         i = config_find_section(config, addr, 1);
+         if (i >= 0) {
+            if (config->sections[i].label[0] != '\0') {
+               sprintf(label, "%s_end", config->sections[i].label);
+            } else {
+               sprintf(label, "%s_%06X", config_section2str(config->sections[i].type), addr);
             }
+            INFO("Found 1 %06X: %s\n", addr, label);
+            return 0;
          }
          break;
       default:
@@ -133,7 +194,7 @@ int config_section_lookup(rom_config *config, unsigned int addr, char *label, in
    return -1;
 }
 
-void write_level(FILE *out, unsigned char *data, rom_config *config, int s, disasm_state *state)
+void write_level(outbuf *out, unsigned char *data, rom_config *config, int s, disasm_state *state)
 {
    char start_label[128];
    char end_label[128];
@@ -172,28 +233,26 @@ void write_level(FILE *out, unsigned char *data, rom_config *config, int s, disa
             ptr_end = read_u32_be(&data[a+8]);
             config_section_lookup(config, ptr_start, start_label, 0);
             config_section_lookup(config,   ptr_end,   end_label, 1);
-            fprintf(out, ".word 0x");
-            for (i = 0; i < 4; i++) {
-               fprintf(out, "%02X", data[a+i]);
-            }
+            outbuf_puts(out, ".word 0x");
+            outbuf_hex(out, read_u32_be(&data[a]), 8);
             if (0 == strcmp("behavior_data", start_label)) {
-               fprintf(out, ", __load_%s, __load_%s", start_label, end_label);
+               outbuf_printf(out, ", __load_%s, __load_%s", start_label, end_label);
             } else {
-               fprintf(out, ", %s, %s", start_label, end_label);
+               outbuf_printf(out, ", %s, %s", start_label, end_label);
             }
             for (i = 12; i < data[a+1]; i++) {
                if ((i & 0x3) == 0) {
-                  fprintf(out, ", 0x");
+                  outbuf_puts(out, ", 0x");
                }
-               fprintf(out, "%02X", data[a+i]);
+               outbuf_hex(out, data[a+i], 2);
             }
-            fprintf(out, "\n");
+            outbuf_putc(out, '\n');
             break;
          case 0x11: // call function
          case 0x12: // call function
             ptr_start = read_u32_be(&data[a+0x4]);
             disasm_label_lookup(state, ptr_start, start_label);
-            fprintf(out, ".word 0x%08X, %s # %08X\n", read_u32_be(&data[a]), start_label, ptr_start);
+            outbuf_printf(out, ".word 0x%08X, %s # %08X\n", read_u32_be(&data[a]), start_label, ptr_start);
             break;
          case 0x16: // load ASM into RAM
             dst       = read_u32_be(&data[a+0x4]);
@@ -203,17 +262,17 @@ void write_level(FILE *out, unsigned char *data, rom_config *config, int s, disa
             disasm_label_lookup(state, dst, dst_label);
             config_section_lookup(config, ptr_start, start_label, 0);
             config_section_lookup(config, ptr_end, end_label, 1);
-            fprintf(out, ".word 0x");
-            for (i = 0; i < 4; i++) {
-               fprintf(out, "%02X", data[a+i]);
-            }
-            fprintf(out, ", %s, %s, %s\n", dst_label, start_label, end_label);
+            outbuf_puts(out, ".word 0x");
+            outbuf_hex(out, read_u32_be(&data[a]), 8);
+            outbuf_printf(out, ", %s, %s, %s\n", dst_label, start_label, end_label);
             break;
          case 0x25: // load mario object with behavior
          case 0x24: // load object with behavior
-            fprintf(out, ".word 0x%08X", read_u32_be(&data[a]));
+            outbuf_puts(out, ".word 0x");
+            outbuf_hex(out, read_u32_be(&data[a]), 8);
             for (i = 4; i < data[a+1]-4; i+=4) {
-               fprintf(out, ", 0x%08X", read_u32_be(&data[a+i]));
+               outbuf_puts(out, ", 0x");
+               outbuf_hex(out, read_u32_be(&data[a+i]), 8);
             }
             dst = read_u32_be(&data[a+i]);
             if (beh_i >= 0) {
@@ -221,7 +280,7 @@ void write_level(FILE *out, unsigned char *data, rom_config *config, int s, disa
                split_section *beh = config->sections[beh_i].children;
                for (i = 0; i < config->sections[beh_i].child_count; i++) {
                   if (offset == beh[i].start) {
-                     fprintf(out, ", %s", beh[i].label);
+                     outbuf_printf(out, ", %s", beh[i].label);
                      break;
                   }
                }
@@ -229,84 +288,104 @@ void write_level(FILE *out, unsigned char *data, rom_config *config, int s, disa
                   ERROR("Error: cannot find behavior %04X needed at offset %X\n", offset, a);
                }
             } else {
-               fprintf(out, ", 0x%08X", dst);
+               outbuf_printf(out, ", 0x%08X", dst);
             }
-            fprintf(out, "\n");
+            outbuf_putc(out, '\n');
             break;
          default:
-            fprintf(out, ".word 0x%08X", read_u32_be(&data[a]));
+            outbuf_puts(out, ".word 0x");
+            outbuf_hex(out, read_u32_be(&data[a]), 8);
             for (i = 4; i < data[a+1]; i+=4) {
-               fprintf(out, ", 0x%08X", read_u32_be(&data[a+i]));
+               outbuf_puts(out, ", 0x");
+               outbuf_hex(out, read_u32_be(&data[a+i]), 8);
             }
-            fprintf(out, "\n");
+            outbuf_putc(out, '\n');
             break;
       }
       a += data[a+1];
    }
    // align to next 16-byte boundary
    if (a & 0x0F) {
-      fprintf(out, "# begin %s alignment 0x%X\n", sec->label, a);
-      fprintf(out, ".byte ");
-      fprint_hex_source(out, &data[a], ALIGN(a, 16) - a);
-      fprintf(out, "\n");
+      outbuf_printf(out, "# begin %s alignment 0x%X\n", sec->label, a);
+      outbuf_puts(out, ".byte ");
+      outbuf_hex_bytes(out, &data[a], ALIGN(a, 16) - a);
+      outbuf_putc(out, '\n');
       a = ALIGN(a, 16);
    }
    // remaining is geo layout script
-   fprintf(out, "# begin %s geo 0x%X\n", sec->label, a);
+   outbuf_printf(out, "# begin %s geo 0x%X\n", sec->label, a);
    write_geolayout(out, &data[sec->start], a - sec->start, sec->end - sec->start, state);
 }
 
+// files written by the split job running on this thread, NULL outside of jobs
+static _Thread_local strbuf *job_outputs;
+
+void output_record(const char *filename)
+{
+   if (job_outputs) {
+      strbuf_sprintf(job_outputs, "%s\n", filename);
+   }
+}
+
+outbuf *output_open(const arg_config *args, const char *filename)
+{
+   if (args->incremental) {
+      return outbuf_fopen_update(filename);
+   }
+   return outbuf_fopen(filename);
+}
+
 void generate_globals(arg_config *args, rom_config *config)
 {
    char globalfilename[FILENAME_MAX];
-   FILE *fglobal;
+   outbuf *fglobal;
    sprintf(globalfilename, "%s/%s", args->output_dir, GLOBALS_FILE);
-   fglobal = fopen(globalfilename, "w");
+   fglobal = output_open(args, globalfilename);
    if (fglobal == NULL) {
       ERROR("Error opening %s\n", globalfilename);
       exit(3);
    }
-   fprintf(fglobal, "# globally accessible functions and data\n"
-                    "# these will be accessible by C code and show up in the .map file\n\n");
+   outbuf_puts(fglobal, "# globally accessible functions and data\n"
+                        "# these will be accessible by C code and show up in the .map file\n\n");
    for (int i = 0; i < config->label_count; i++) {
-      fprintf(fglobal, ".global %s\n", config->labels[i].name);
+      outbuf_printf(fglobal, ".global %s\n", config->labels[i].name);
    }
-   fprintf(fglobal, "\n");
+   outbuf_putc(fglobal, '\n');
 
-   fclose(fglobal);
+   outbuf_close(fglobal);
 }
 
 void generate_macros(arg_config *args)
 {
    char incfilename[FILENAME_MAX];
-   FILE *finc;
+   outbuf *finc;
    sprintf(incfilename, "%s/%s", args->output_dir, MACROS_FILE);
-   finc = fopen(incfilename, "w");
+   finc = output_open(args, incfilename);
    if (finc == NULL) {
       ERROR("Error opening %s\n", incfilename);
       exit(3);
    }
-   fprintf(finc, "# common macros\n"
-                 "\n"
-                 "# F3D vertex\n"
-                 ".macro vertex \\x, \\y, \\z, \\u, \\v, \\r=0xFF, \\g=0xFF, \\b=0xFF, \\a=0xFF\n"
-                 "   .hword \\x, \\y, \\z, 0, \\u, \\v\n   .byte \\r, \\g, \\b, \\a\n"
-                 ".endm\n");
-   fclose(finc);
+   outbuf_puts(finc, "# common macros\n"
+                     "\n"
+                     "# F3D vertex\n"
+                     ".macro vertex \\x, \\y, \\z, \\u, \\v, \\r=0xFF, \\g=0xFF, \\b=0xFF, \\a=0xFF\n"
+                     "   .hword \\x, \\y, \\z, 0, \\u, \\v\n   .byte \\r, \\g, \\b, \\a\n"
+                     ".endm\n");
+   outbuf_close(finc);
 }
 
 
 void generate_ld_script(arg_config *args, rom_config *config)
 {
    char ldfilename[FILENAME_MAX];
-   FILE *fld;
+   outbuf *fld;
    sprintf(ldfilename, "%s/%s.ld", args->output_dir, config->basename);
-   fld = fopen(ldfilename, "w");
+   fld = output_open(args, ldfilename);
    if (fld == NULL) {
       ERROR("Error opening %s\n", ldfilename);
       exit(3);
    }
-   fprintf(fld,
+   outbuf_printf(fld,
 "/* %s linker script\n"
 " * generated by n64split v%s - N64 ROM splitter */\n"
 "SECTIONS\n"
@@ -323,7 +402,7 @@ void generate_ld_script(arg_config *args, rom_config *config)
       unsigned int ram_start = s->vaddr;
       unsigned int length = rom_end - rom_start;
       if (s->type == TYPE_ASM) {
-         fprintf(fld,
+         outbuf_printf(fld,
                   "   /* 0x%08X %06X-%06X [%X] */\n"
                   "   .text%08X 0x%08X : AT(0x%06X) {\n"
                   "      build/%s/%s.o(.text%08X);\n"
@@ -335,7 +414,7 @@ void generate_ld_script(arg_config *args, rom_config *config)
       else if(s->type != TYPE_HEADER)
       {
          if (s->label == NULL || s->label[0] == '\0') {
-            fprintf(fld,
+            outbuf_printf(fld,
                      "   /* 0x%08X %06X-%06X [%X] */\n"
                      "   .data%08X 0x%08X : AT(0x%06X) {\n"
                      "      build/%s/%s.%06X.%s%s.o(.data);\n"
@@ -344,7 +423,7 @@ void generate_ld_script(arg_config *args, rom_config *config)
                      rom_start, rom_start, rom_start, s->section_name,
                      config->basename, s->start, s->label, s->section_name);
          } else {
-            fprintf(fld,
+            outbuf_printf(fld,
                      "   /* 0x%08X %06X-%06X [%X] */\n"
                      "   .data%08X 0x%08X : AT(0x%06X) {\n"
                      "      build/%s/%s.%06X.%s.o(.data);\n"
@@ -355,20 +434,20 @@ void generate_ld_script(arg_config *args, rom_config *config)
          }
       }
    }
-   fprintf(fld,
+   outbuf_puts(fld,
 "   /* Discard everything not specifically mentioned above. */\n"
 "   /DISCARD/ :\n"
 "   {\n"
 "      *(*);\n"
 "   }\n");
-   fprintf(fld, "}\n");
+   outbuf_puts(fld, "}\n");
 
-   fclose(fld);
+   outbuf_close(fld);
 }
 
-void section_sm64_geo(unsigned char *data, arg_config *args, rom_config *config, disasm_state *state, split_section *sec, char* start_label, char* outfilename, char* outfilepath, FILE *fasm, strbuf *makeheader_level) {
+void section_sm64_geo(unsigned char *data, arg_config *args, rom_config *config, disasm_state *state, split_section *sec, char* start_label, char* outfilename, char* outfilepath, outbuf *fasm, strbuf *makeheader_level) {
    char geofilename[FILENAME_MAX];
-   FILE *fgeo;
+   outbuf *fgeo;
    if (sec->label == NULL || sec->label[0] == '\0') {
       sprintf(geofilename, "%s.%06X.geo.s", config->basename, sec->start);
       sprintf(start_label, "L%06X", sec->start);
@@ -380,25 +459,26 @@ void section_sm64_geo(unsigned char *data, arg_config *args, rom_config *config,
    sprintf(outfilepath, "%s/%s", args->output_dir, outfilename);
 
    // decode and write level data out
-   fgeo = fopen(outfilepath, "w");
+   fgeo = outbuf_fopen(outfilepath);
+   output_record(outfilepath);
    if (fgeo == NULL) {
       perror(outfilepath);
       exit(1);
    }
    write_geolayout(fgeo, &data[sec->start], 0, sec->end - sec->start, state);
-   fclose(fgeo);
+   outbuf_close(fgeo);
 
-   fprintf(fasm, "\n.align 4, 0x01\n");
-   fprintf(fasm, ".global %s\n", start_label);
-   fprintf(fasm, "%s:\n", start_label);
-   fprintf(fasm, ".include \"%s\"\n", outfilename);
-   fprintf(fasm, "%s_end:\n", start_label);
+   outbuf_puts(fasm, "\n.align 4, 0x01\n");
+   outbuf_printf(fasm, ".global %s\n", start_label);
+   outbuf_printf(fasm, "%s:\n", start_label);
+   outbuf_printf(fasm, ".include \"%s\"\n", outfilename);
+   outbuf_printf(fasm, "%s_end:\n", start_label);
    // append to Makefile
    strbuf_sprintf(makeheader_level, " \\\n$(GEO_DIR)/%s", geofilename);
 }
 
-void write_bin_type(split_section *sec, char* outfilename, char* start_label, FILE* fasm, unsigned char *data, char* outfilepath, arg_config * args, rom_config *config) {
-   char* output_dir=BIN_SUBDIR;
+void write_bin_type(split_section *sec, char* outfilename, char* start_label, outbuf *fasm, unsigned char *data, char* outfilepath, arg_config * args, rom_config *config) {
+   const char* output_dir=BIN_SUBDIR;
    char bin_dir[FILENAME_MAX];
    if (sec->section_name != NULL) {
       output_dir=sec->section_name;
@@ -413,75 +493,980 @@ void write_bin_type(split_section *sec, char* outfilename, char* start_label, FI
    }
    sprintf(outfilepath, "%s/%s", args->output_dir, outfilename);
    write_file(outfilepath, &data[sec->start], sec->end - sec->start);
+   output_record(outfilepath);
    if (sec->label == NULL || sec->label[0] == '\0') {
       sprintf(start_label, "L%06X", sec->start);
    } else {
       strcpy(start_label, sec->label);
    }
-   fprintf(fasm, "%s:\n", start_label);
-   fprintf(fasm, ".incbin \"%s\"\n", outfilename);
-   fprintf(fasm, "%s_end:\n", start_label);
+   outbuf_printf(fasm, "%s:\n", start_label);
+   outbuf_printf(fasm, ".incbin \"%s\"\n", outfilename);
+   outbuf_printf(fasm, "%s_end:\n", start_label);
 }
 
-void split_file(unsigned char *data, unsigned int length, arg_config *args, rom_config *config, disasm_state *state)
+// shared state for section workers, read-only while they run
+typedef struct
 {
-
-   char makefile_name[FILENAME_MAX];
-   char bin_dir[FILENAME_MAX];
+   unsigned char *data;
+   arg_config *args;
+   rom_config *config;
+   disasm_state *state;
    char asm_dir[FILENAME_MAX];
+   char bin_dir[FILENAME_MAX];
    char mio0_dir[FILENAME_MAX];
    char texture_dir[FILENAME_MAX];
-   char geo_dir[FILENAME_MAX];
-   char level_dir[FILENAME_MAX];
    char model_dir[FILENAME_MAX];
-   char behavior_dir[FILENAME_MAX];
-   char asmfilename[FILENAME_MAX];
+} split_context;
+
+// sections are split in two passes: main text, then the relocated .mio0 section
+typedef enum
+{
+   SPLIT_PASS_MAIN,
+   SPLIT_PASS_MIO0,
+} split_pass;
+
+// work for one section in one pass
+// sections don't depend on each other's output, only the order of their text in the main
+// assembly file and Makefile lists matters, so each job collects that in its own buffers
+typedef struct
+{
+   int s;                   // section index
+   split_pass pass;
+   split_section *sfx_pair; // first of the SFX CTL/TBL pair if this section completes it
+   outbuf *fasm;            // text for main assembly file
+   strbuf makeheader;       // text for Makefile file list
+   strbuf *makeheader_dst;  // Makefile list 'makeheader' is appended to
+   strbuf outputs;          // newline separated files the job wrote
+   unsigned long long hash; // hash of everything the job's output depends on
+   int cached;              // output taken from previous split, don't run
+} split_job;
+
+typedef struct
+{
+   pthread_mutex_t lock;
+   int next;
+   int count;
+   split_job *jobs;
+   split_context *ctx;
+} split_queue;
+
+static void split_section_main(split_context *ctx, split_job *job)
+{
+   unsigned char *data = ctx->data;
+   arg_config *args = ctx->args;
+   rom_config *config = ctx->config;
+   disasm_state *state = ctx->state;
+   const char *asm_dir = ctx->asm_dir;
    char outfilename[FILENAME_MAX];
    char outfilepath[FILENAME_MAX];
-   char mio0filename[FILENAME_MAX];
    char headerfilepath[FILENAME_MAX];
    char start_label[256];
+   outbuf *fasm = job->fasm;
+   strbuf *makeheader = &job->makeheader;
+   int s = job->s;
+   split_section *sec = &config->sections[s];
+   unsigned int prev_end = (s > 0) ? config->sections[s-1].end : 0;
+   unsigned int a;
+   unsigned int ptr;
+   int i;
+
+   // fill gaps between regions
+   if (sec->start != prev_end) {
+      int gap_len = sec->start - prev_end;
+      INFO("Filling gap before region %d (%d bytes)\n", s, gap_len);
+      outbuf_printf(fasm, "# Unknown region %06X-%06X [%X]\n", prev_end, sec->start, gap_len);
+      // for small gaps, just output bytes
+      if (gap_len <= 0x80) {
+         unsigned int group_offset = prev_end;
+         while (gap_len > 0) {
+            int group_len = MIN(gap_len, 0x10);
+            outbuf_puts(fasm, ".byte ");
+            outbuf_hex_bytes(fasm, &data[group_offset], group_len);
+            outbuf_putc(fasm, '\n');
+            gap_len -= group_len;
+            group_offset += group_len;
+         }
+      } else {
+         // TODO move gap fillers into a different subdirectory
+         sprintf(outfilename, "%s/%s.%06X.bin", BIN_SUBDIR, config->basename, prev_end);
+         sprintf(outfilepath, "%s/%s", args->output_dir, outfilename);
+         write_file(outfilepath, &data[prev_end], gap_len);
+         output_record(outfilepath);
+         outbuf_printf(fasm, ".incbin \"%s\"\n", outfilename);
+      }
+      outbuf_putc(fasm, '\n');
+   }
+
+   switch (sec->type)
+   {
+      case TYPE_HEADER:
+         sprintf(headerfilepath, "%s/%s", asm_dir, "header.s");
+         outbuf *header = outbuf_fopen(headerfilepath);
+         output_record(headerfilepath);
+         INFO("Section header: %X-%X\n", sec->start, sec->end);
+         outbuf_printf(header, ".section .header, \"a\"\n"
+                       ".byte  0x%02X", data[sec->start]);
+         for (i = 1; i < 4; i++) {
+            outbuf_printf(header, ", 0x%02X", data[sec->start + i]);
+         }
+         outbuf_puts(header, " # PI BSD Domain 1 register\n");
+         outbuf_printf(header, ".word  0x%08X # clock rate setting\n", read_u32_be(&data[sec->start + 0x4]));
+         outbuf_printf(header, ".word  0x%08X # entry point\n", read_u32_be(&data[sec->start + 0x8]));
+         outbuf_printf(header, ".word  0x%08X # release\n", read_u32_be(&data[sec->start + 0xc]));
+         outbuf_printf(header, ".word  0x%08X # checksum1\n", read_u32_be(&data[sec->start + 0x10]));
+         outbuf_printf(header, ".word  0x%08X # checksum2\n", read_u32_be(&data[sec->start + 0x14]));
+         outbuf_printf(header, ".word  0x%08X # unknown\n", read_u32_be(&data[sec->start + 0x18]));
+         outbuf_printf(header, ".word  0x%08X # unknown\n", read_u32_be(&data[sec->start + 0x1C]));
+         outbuf_printf(header, ".ascii \"");
+         outbuf_write(header, &data[sec->start + 0x20], 20);
+         outbuf_printf(header, "\" # ROM name: 20 bytes\n");
+         outbuf_printf(header, ".word  0x%08X # unknown\n", read_u32_be(&data[sec->start + 0x34]));
+         outbuf_printf(header, ".word  0x%08X # cartridge\n", read_u32_be(&data[sec->start + 0x38]));
+         outbuf_printf(header, ".ascii \"");
+         outbuf_write(header, &data[sec->start + 0x3C], 2);
+         outbuf_printf(header, "\"       # cartridge ID\n");
+         outbuf_printf(header, ".ascii \"");
+         outbuf_write(header, &data[sec->start + 0x3E], 1);
+         outbuf_printf(header, "\"        # country\n");
+         outbuf_printf(header, ".byte  0x%02X       # version\n\n", data[sec->start + 0x3F]);
+         outbuf_close(header);
+         break;
+      case TYPE_BIN:
+         write_bin_type(sec, outfilename, start_label, fasm, data, outfilepath, args, config);
+         break;
+      case TYPE_BLAST:
+      case TYPE_MIO0:
+      case TYPE_GZIP:
+      case TYPE_SM64_GEO:
+         // fill previous geometry and MIO0 blocks
+         outbuf_printf(fasm, ".space 0x%05x, 0x01 # %s\n", sec->end - sec->start, sec->label);
+         break;
+      case TYPE_PTR:
+         INFO("Section ptr: %X-%X\n", sec->start, sec->end);
+         if (sec->label == NULL || sec->label[0] == '\0') {
+            sprintf(start_label, "Ptr%06X", sec->start);
+         } else {
+            strcpy(start_label, sec->label);
+         }
+         outbuf_printf(fasm, "%s:\n", start_label);
+         for (a = sec->start; a < sec->end; a += 4) {
+            ptr = read_u32_be(&data[a]);
+            disasm_label_lookup(state, ptr, start_label);
+            outbuf_printf(fasm, ".word %s", start_label);
+            if (sec->child_count > 0) {
+               for (i = 1; i < sec->child_count; i++) {
+                  a += 4;
+                  ptr = read_u32_be(&data[a]);
+                  disasm_label_lookup(state, ptr, start_label);
+                  outbuf_printf(fasm, ", %s", start_label);
+               }
+            }
+            outbuf_putc(fasm, '\n');
+         }
+         outbuf_putc(fasm, '\n');
+         break;
+      case TYPE_ASM:
+         INFO("Section asm: %X-%X\n", sec->start, sec->end);
+         char section_asmfilename[FILENAME_MAX];
+         sprintf(section_asmfilename, "%s/asm/%s.s", args->output_dir, sec->label);
+         // Include in main .s file
+         outbuf_printf(fasm, ".include \"asm/%s.s\" \n", sec->label);
+
+         // Open seperate .s file for this section
+         outbuf *section_fasm = outbuf_fopen(section_asmfilename);
+         output_record(section_asmfilename);
+         outbuf_printf(section_fasm, "%s", asm_header);
+         outbuf_printf(section_fasm, "\n.section .text%08X, \"ax\"\n\n", sec->vaddr);
+         mipsdisasm_pass2(section_fasm, state, sec->start);
+         outbuf_close(section_fasm);
+         break;
+      case TYPE_SM64_LEVEL:
+         // relocate level scripts to .mio0 area
+         // TODO: these shouldn't need to be relocated if load offset can be computed
+         outbuf_printf(fasm, ".space 0x%05x, 0x01 # %s\n", sec->end - sec->start, sec->label);
+         break;
+      case TYPE_SM64_BEHAVIOR:
+         // behaviors are done below
+         outbuf_printf(fasm, ".space 0x%05x, 0x01 # %s\n", sec->end - sec->start, sec->label);
+         break;
+      case TYPE_M64:
+         parse_music_sequences(fasm, data, sec, args, makeheader);
+         break;
+      case TYPE_SFX_CTL:
+         // banks are parsed by whichever of the CTL/TBL pair comes second
+         if (job->sfx_pair)
+            parse_sound_banks(fasm, data, sec, job->sfx_pair, args, makeheader); //Fix header later
+         break;
+      case TYPE_SFX_TBL:
+         if (job->sfx_pair)
+            parse_sound_banks(fasm, data, job->sfx_pair, sec, args, makeheader); //Fix header later
+         break;
+      case TYPE_INSTRUMENT_SET:
+         parse_instrument_set(fasm, data, sec);
+         break;
+      default:
+         // printf("Treating custom file format as binary %s %s %s\n", sec->section_name, outfilepath, outfilename);
+         // ERROR("Don't know what to do with type %d\n", sec->type);
+         write_bin_type(sec, outfilename, start_label, fasm, data, outfilepath, args, config);
+         break;
+   }
+}
+
+// per-worker texture conversion buffer, grown to fit the largest texture
+typedef struct
+{
+   void *data;
+   size_t size;
+} tex_buffer;
+
+static void *tex_buffer_reserve(tex_buffer *buf, size_t size)
+{
+   if (size > buf->size) {
+      free(buf->data);
+      buf->data = malloc(size);
+      buf->size = size;
+   }
+   return buf->data;
+}
+
+static void split_section_mio0(split_context *ctx, split_job *job, tex_buffer *texbuf)
+{
+   unsigned char *data = ctx->data;
+   arg_config *args = ctx->args;
+   rom_config *config = ctx->config;
+   disasm_state *state = ctx->state;
+   const char *bin_dir = ctx->bin_dir;
+   const char *mio0_dir = ctx->mio0_dir;
+   const char *texture_dir = ctx->texture_dir;
+   const char *model_dir = ctx->model_dir;
+   char outfilename[FILENAME_MAX];
+   char outfilepath[FILENAME_MAX];
+   char mio0filename[FILENAME_MAX];
+   char start_label[256];
+   outbuf *fasm = job->fasm;
+   strbuf *makeheader = &job->makeheader;
+   int s = job->s;
+   split_section *sec = &config->sections[s];
+   unsigned int w, h;
+
+   switch (sec->type) {
+      case TYPE_SM64_GEO:
+      {
+         section_sm64_geo(data, args, config, state, sec, start_label, outfilename, outfilepath, fasm, makeheader);
+         break;
+      }
+      case TYPE_BLAST:
+      case TYPE_GZIP:
+      case TYPE_MIO0:
+      {
+         char binfilename[FILENAME_MAX];
+         char extension[8] = {0};
+         char binasmfilename[FILENAME_MAX];
+         outbuf *binasm;
+         unsigned char *binfilecontents = NULL;
+         long binfilelen = 0;
+         if (sec->label == NULL || sec->label[0] == '\0') {
+            sprintf(start_label, "L%06X", sec->start);
+         } else {
+            strcpy(start_label, sec->label);
+         }
+         sprintf(binfilename, "%s.s", start_label);
+         sprintf(binasmfilename, "%s/%s", bin_dir, binfilename);
+         // decode and write
+         binasm = outbuf_fopen(binasmfilename);
+         output_record(binasmfilename);
+         if (binasm == NULL) {
+            perror(binasmfilename);
+            exit(1);
+         }
+         outbuf_printf(binasm, "# generated by n64split\n.section .rodata\n\n.include \"%s\"\n", MACROS_FILE);
+         switch (sec->type) {
+            case TYPE_BLAST:
+               INFO("Section Blast: %d %s %X-%X\n", sec->subtype, sec->label, sec->start, sec->end);
+               sprintf(extension, "bc%d", sec->subtype);
+               break;
+            case TYPE_MIO0:
+               INFO("Section MIO0: %s %X-%X\n", sec->label, sec->start, sec->end);
+               strcpy(extension, "mio0");
+               break;
+            case TYPE_GZIP:
+               INFO("Section GZIP: %s %X-%X\n", sec->label, sec->start, sec->end);
+               strcpy(extension, "gz");
+               break;
+            default:
+               break;
+         }
+         sprintf(outfilename, "%s.%s", start_label, extension);
+         sprintf(binfilename, "%s/%s.bin", bin_dir, start_label);
+         sprintf(mio0filename, "%s/%s", mio0_dir, outfilename);
+
+         outbuf_puts(fasm, "\n.align 4, 0x01\n");
+         outbuf_printf(fasm, ".global %s\n", start_label);
+         outbuf_printf(fasm, "%s:\n", start_label);
+         outbuf_printf(fasm, ".incbin \"%s/%s\"\n", MIO0_SUBDIR, outfilename);
+         outbuf_printf(fasm, "%s_end:\n", start_label);
+
+         // append to Makefile
+         strbuf_sprintf(makeheader, " \\\n$(MIO0_DIR)/%s", outfilename);
+
+         // extract compressed data straight from the ROM, then write the
+         // uncompressed file before the compressed one so 'make' doesn't rebuild it
+         binfilelen = decompress_section(data, sec, &binfilecontents);
+         if (binfilelen < 0) {
+            binfilelen = 0;
+         }
+         write_file(binfilename, binfilecontents, binfilelen);
+         output_record(binfilename);
+         write_file(mio0filename, &data[sec->start], sec->end - sec->start);
+         output_record(mio0filename);
+
+         // extract texture data
+         if (sec->children) {
+            unsigned int offset = 0;
+            unsigned int next_offset = 0;
+            // TODO: add segment base to config file
+            const unsigned int segment_base = 0x07000000;
+            unsigned int seg_address = segment_base + offset;
+            //fprintf(fmake, "$(MIO0_DIR)/%s.bin:", start_label);
+            INFO("Extracting textures from %s\n", start_label);
+            for (int t = 0; t < sec->child_count; t++) {
+               split_section *child = &sec->children[t];
+               texture *tex = &child->tex;
+               w = tex->width;
+               h = tex->height;
+               if (next_offset > child->start) {
+                  ERROR("Error section overlap region %d (%X > %X)\n", t, next_offset, child->start);
+                  exit(1);
+               }
+               if (next_offset != child->start) {
+                  unsigned int gap_len = child->start - next_offset;
+                  INFO("Filling gap before region %d (%d bytes)\n", t, gap_len);
+                  outbuf_printf(binasm, "# Unknown region %06X-%06X [%X]\n", next_offset, child->start, gap_len);
+                  while (gap_len > 0) {
+                     int group_len = MIN(gap_len, 0x10);
+                     outbuf_puts(binasm, ".byte ");
+                     outbuf_hex_bytes(binasm, &binfilecontents[next_offset], group_len);
+                     outbuf_putc(binasm, '\n');
+                     gap_len -= group_len;
+                     next_offset += group_len;
+                  }
+               }
+               offset = tex->offset;
+               seg_address = segment_base + offset;
+               if (child->end) {
+                  next_offset = child->end;
+               } else if (tex->format == TYPE_F3D_LIGHT) {
+                  next_offset = child->start + 0x18;
+               } else { // assume texture
+                  next_offset = child->start + w * h * tex->depth / 8;
+               }
+               outbuf_putc(binasm, '\n');
+               switch (tex->format) {
+                  case TYPE_TEX_IA:
+                  {
+                     sprintf(outfilename, "%s.%05X.ia%d", start_label, offset, tex->depth);
+                     ia *img = tex_buffer_reserve(texbuf, w * h * sizeof(*img));
+                     if (img && raw2ia_buf(img, &binfilecontents[offset], w * h, tex->depth) == 0) {
+                        sprintf(outfilepath, "%s/%s.png", texture_dir, outfilename);
+                        ia2png(outfilepath, img, w, h);
+                        output_record(outfilepath);
+                        //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
+                     }
+                     if (args->raw_texture && binfilelen > 0) {
+                        INFO("Saving raw texture for %s\n", start_label);
+                        int len = w*h*tex->depth/8;
+                        sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
+                        write_file(outfilepath, &binfilecontents[offset], len);
+                        output_record(outfilepath);
+                     }
+                     outbuf_printf(binasm, "texture_%08X: # 0x%08X\n", seg_address, seg_address);
+                     outbuf_printf(binasm, ".incbin \"%s\"\n", outfilename);
+                     break;
+                  }
+                  case TYPE_TEX_I:
+                  {
+                     sprintf(outfilename, "%s.%05X.i%d", start_label, offset, tex->depth);
+                     ia *img = tex_buffer_reserve(texbuf, w * h * sizeof(*img));
+                     if (img && raw2i_buf(img, &binfilecontents[offset], w * h, tex->depth) == 0) {
+                        sprintf(outfilepath, "%s/%s.png", texture_dir, outfilename);
+                        ia2png(outfilepath, img, w, h);
+                        output_record(outfilepath);
+                        //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
+                     }
+                     if (args->raw_texture && binfilelen > 0) {
+                        INFO("Saving raw texture for %s\n", start_label);
+                        int len = w*h*tex->depth/8;
+                        sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
+                        write_file(outfilepath, &binfilecontents[offset], len);
+                        output_record(outfilepath);
+                     }
+                     outbuf_printf(binasm, "texture_%08X: # 0x%08X\n", seg_address, seg_address);
+                     outbuf_printf(binasm, ".incbin \"%s\"\n", outfilename);
+                     break;
+                  }
+                  case TYPE_TEX_RGBA:
+                  {
+                     sprintf(outfilename, "%s.%05X.rgba%d", start_label, offset, tex->depth);
+                     rgba *img = tex_buffer_reserve(texbuf, w * h * sizeof(*img));
+                     if (img && raw2rgba_buf(img, &binfilecontents[offset], w * h, tex->depth) == 0) {
+                        sprintf(outfilepath, "%s/%s.png", texture_dir, outfilename);
+                        rgba2png(outfilepath, img, w, h);
+                        output_record(outfilepath);
+                        //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
+                     }
+                     if (args->raw_texture && binfilelen > 0) {
+                        INFO("Saving raw texture for %s\n", start_label);
+                        int len = w*h*tex->depth/8;
+                        sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
+                        write_file(outfilepath, &binfilecontents[offset], len);
+                        output_record(outfilepath);
+                     }
+                     outbuf_printf(binasm, "texture_%08X: # 0x%08X\n", seg_address, seg_address);
+                     outbuf_printf(binasm, ".incbin \"%s\"\n", outfilename);
+                     break;
+                  }
+                  case TYPE_TEX_SKYBOX:
+                  {
+                     // read in grid of MxN 32x32 tiles and save them as M*31xN*31 image
+                     rgba *img;
+                     unsigned int sky_offset = offset;
+                     int m, n;
+                     int tx, ty;
+                     m = w/32;
+                     n = h/32;
+                     img = tex_buffer_reserve(texbuf, w * h * sizeof(*img));
+                     w -= m; // adjust for overlap
+                     h -= n;
+                     for (ty = 0; ty < n; ty++) {
+                        for (tx = 0; tx < m; tx++) {
+                           // convert the first 31 pixels of each tile row straight into place
+                           int cy;
+                           for (cy = 0; cy < 31; cy++) {
+                              int out_off = 31*w*ty + 31*tx + w*cy;
+                              raw2rgba_buf(&img[out_off], &binfilecontents[sky_offset + 32*cy*tex->depth/8], 31, tex->depth);
+                           }
+                           sky_offset += 32*32*2;
+                        }
+                     }
+                     sprintf(outfilename, "%s.%05X.skybox.png", start_label, offset);
+                     sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
+                     rgba2png(outfilepath, img, w, h);
+                     output_record(outfilepath);
+                     //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
+                     break;
+                  }
+                  case TYPE_F3D_DL:
+                  {
+                     int sec_len = child->end - child->start;
+                     outbuf_printf(binasm, "f3d_%08X: # 0x%08X\n", seg_address, seg_address);
+                     for (int o = 0; o < sec_len; o += 8) {
+                        unsigned char cmd = binfilecontents[offset + o];
+                        unsigned int second = read_u32_be(&binfilecontents[offset + o + 4]);
+                        outbuf_puts(binasm, ".word 0x");
+                        outbuf_hex(binasm, read_u32_be(&binfilecontents[offset + o]), 8);
+                        switch (cmd) {
+                           case 0x03: outbuf_puts(binasm, ", light_");   break;
+                           case 0x04: outbuf_puts(binasm, ", vertex_");  break;
+                           case 0x06: outbuf_puts(binasm, ", f3d_");     break;
+                           case 0xFD: outbuf_puts(binasm, ", texture_"); break;
+                           default:   outbuf_puts(binasm, ", 0x");       break;
+                        }
+                        outbuf_hex(binasm, second, 8);
+                        outbuf_putc(binasm, '\n');
+                     }
+                     break;
+                  }
+                  case TYPE_F3D_LIGHT:
+                  {
+                     outbuf_printf(binasm, "light_%08X: # 0x%08X\n", seg_address, seg_address);
+                     outbuf_puts(binasm, ".byte ");
+                     outbuf_hex_bytes(binasm, &binfilecontents[offset], 8);
+                     outbuf_putc(binasm, '\n');
+                     outbuf_printf(binasm, "light_%08X: # 0x%08X\n", seg_address + 8, seg_address + 8);
+                     outbuf_puts(binasm, ".byte ");
+                     outbuf_hex_bytes(binasm, &binfilecontents[offset + 8], 8);
+                     outbuf_puts(binasm, "\n.byte ");
+                     outbuf_hex_bytes(binasm, &binfilecontents[offset + 16], 8);
+                     outbuf_putc(binasm, '\n');
+                     break;
+                  }
+                  case TYPE_F3D_VERTEX:
+                  {
+                     int sec_len = child->end - child->start;
+                     outbuf_printf(binasm, "vertex_%08X: # 0x%08X\n", seg_address, seg_address);
+                     for (int o = 0; o < sec_len; o += 16) {
+                        outbuf_puts(binasm, "vertex ");
+                        for (int h = 0; h < 6; h++) {
+                           // X, Y, Z, UNUSED, U, V
+                           if (h != 3) {
+                              outbuf_dec(binasm, read_s16_be(&binfilecontents[offset + o + h*2]), 6);
+                              outbuf_puts(binasm, ", ");
+                           }
+                        }
+                        // R, G, B, A
+                        outbuf_hex_bytes(binasm, &binfilecontents[offset + o + 12], 4);
+                        outbuf_putc(binasm, '\n');
+                     }
+                     break;
+                  }
+                  case TYPE_SM64_COLLISION:
+                  {
+                     int sec_len = 0;
+                     sprintf(outfilename, "%s.%05X.collision", start_label, offset);
+                     sprintf(outfilepath, "%s/%s.obj", model_dir, outfilename);
+                     INFO("Generating collision model %s\n", outfilename);
+                     sec_len = collision2obj(binfilecontents, binfilelen, offset, outfilepath, start_label, args->model_scale);
+                     output_record(outfilepath);
+                     if (args->raw_texture && binfilelen > 0) {
+                        INFO("Saving raw collision for %s\n", start_label);
+                        sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
+                        write_file(outfilepath, &binfilecontents[offset], sec_len);
+                        output_record(outfilepath);
+                     }
+                     outbuf_printf(binasm, "collision_%06X: # 0x%08X\n", seg_address, seg_address);
+                     outbuf_printf(binasm, ".incbin \"%s\"\n", outfilename);
+                     break;
+                  }
+                  default:
+                     ERROR("Don't know what to do with format %d\n", tex->format);
+                     exit(1);
+               }
+            }
+            //fprintf(fmake, "\n\t$(N64GRAPHICS) $@ $^\n\n");
+         }
+
+         // extract texture data
+         if (args->large_texture) {
+            INFO("Generating large texture for %s\n", start_label);
+            w = 32;
+            h = binfilelen / (w * (args->large_texture_depth / 8));
+            rgba *img = tex_buffer_reserve(texbuf, w * h * sizeof(*img));
+            if (img && raw2rgba_buf(img, binfilecontents, w * h, args->large_texture_depth) == 0) {
+               sprintf(outfilename, "%s.ALL.png", start_label);
+               sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
+               rgba2png(outfilepath, img, w, h);
+               output_record(outfilepath);
+               //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
+            }
+         }
+         free(binfilecontents);
+         outbuf_close(binasm);
+         break;
+      }
+      case TYPE_SM64_LEVEL:
+      {
+         outbuf *flevel;
+         char levelfilename[FILENAME_MAX];
+         if (sec->label == NULL || sec->label[0] == '\0') {
+            sprintf(start_label, "L%06X", sec->start);
+         } else {
+            strcpy(start_label, sec->label);
+         }
+         INFO("Section relocated level: %s %X-%X\n", start_label, sec->start, sec->end);
+         sprintf(levelfilename, "%s.s", start_label);
+         sprintf(outfilename, "%s/%s", LEVEL_SUBDIR, levelfilename);
+         sprintf(outfilepath, "%s/%s", args->output_dir, outfilename);
+
+         // decode and write level data out
+         flevel = outbuf_fopen(outfilepath);
+         output_record(outfilepath);
+         if (flevel == NULL) {
+            perror(outfilepath);
+            exit(1);
+         }
+         outbuf_printf(flevel, "# level script %s from %X-%X\n\n", start_label, sec->start, sec->end);
+         outbuf_puts(flevel, ".section .mio0\n\n");
+         outbuf_printf(flevel, ".global %s\n", start_label);
+         outbuf_puts(flevel, ".align 4, 0x01\n");
+         outbuf_printf(flevel, "%s:\n", start_label);
+         write_level(flevel, data, config, s, state);
+         outbuf_printf(flevel, "%s_end:\n", start_label);
+         outbuf_close(flevel);
+
+         if (sec->label == NULL || sec->label[0] == '\0') {
+            sprintf(start_label, "L%06X", sec->start);
+         } else {
+            strcpy(start_label, sec->label);
+         }
+         outbuf_printf(fasm, "\n.include \"%s\"\n", outfilename);
+         // append to Makefile
+         strbuf_sprintf(makeheader, " \\\n$(LEVEL_DIR)/%s", levelfilename);
+         break;
+      }
+      case TYPE_SM64_BEHAVIOR:
+      {
+         outbuf *f_beh;
+         char beh_filename[FILENAME_MAX];
+         INFO("Section relocated behavior: %s %X-%X\n", sec->label, sec->start, sec->end);
+         if (sec->label == NULL || sec->label[0] == '\0') {
+            sprintf(beh_filename, "%06X.s", sec->start);
+         } else {
+            sprintf(beh_filename, "%s.s", sec->label);
+         }
+         sprintf(outfilename, "%s/%s", BEHAVIOR_SUBDIR, beh_filename);
+         sprintf(outfilepath, "%s/%s", args->output_dir, outfilename);
+         // decode and write level data out
+         f_beh = outbuf_fopen(outfilepath);
+         output_record(outfilepath);
+         if (f_beh == NULL) {
+            perror(outfilepath);
+            exit(1);
+         }
+         write_behavior(f_beh, data, config, s, state);
+         outbuf_close(f_beh);
+
+         outbuf_printf(fasm, "\n.section .behavior, \"a\"\n");
+         outbuf_printf(fasm, "\n.global %s\n", sec->label);
+         outbuf_printf(fasm, ".global %s_end\n", sec->label);
+         outbuf_printf(fasm, "%s:\n", sec->label);
+         outbuf_printf(fasm, ".include \"%s\"\n", outfilename);
+         outbuf_printf(fasm, "%s_end:\n", sec->label);
+         outbuf_puts(fasm, "\n\n.section .mio0\n");
+
+         // append to Makefile
+         strbuf_sprintf(makeheader, " \\\n%s/%s", BEHAVIOR_SUBDIR, beh_filename);
+         break;
+      }
+      default:
+         break;
+   }
+}
+
+static void *split_worker(void *arg)
+{
+   split_queue *queue = arg;
+   tex_buffer texbuf = {NULL, 0};
+   while (1) {
+      int i;
+      pthread_mutex_lock(&queue->lock);
+      i = queue->next++;
+      pthread_mutex_unlock(&queue->lock);
+      if (i >= queue->count) {
+         break;
+      }
+      split_job *job = &queue->jobs[i];
+      if (job->cached) {
+         continue;
+      }
+      job_outputs = &job->outputs;
+      if (job->pass == SPLIT_PASS_MAIN) {
+         split_section_main(queue->ctx, job);
+      } else {
+         split_section_mio0(queue->ctx, job, &texbuf);
+      }
+      job_outputs = NULL;
+   }
+   free(texbuf.data);
+   return NULL;
+}
+
+// incremental split cache: text each job added to the main assembly file and Makefile
+// lists and the files it wrote, keyed by the hash of its inputs. files a cached job wrote
+// are left alone, unless one was removed or modified since, which reruns the job
+#define CACHE_MAGIC "N64SPLT2"
+#define CACHE_ENTRY_HEADER 20
+
+typedef struct
+{
+   unsigned long long hash;
+   unsigned int fasm_len;
+   unsigned int make_len;
+   unsigned int out_len;
+   const char *text; // fasm text, Makefile text, then newline separated output files
+} cache_entry;
+
+typedef struct
+{
+   unsigned char *data; // cache file contents
+   cache_entry *entries; // sorted by hash
+   int count;
+   time_t mtime; // when the cache was written
+} split_cache;
+
+static unsigned long long hash_uint(unsigned int val, unsigned long long hash)
+{
+   return fnv1a(&val, sizeof(val), hash);
+}
+
+static unsigned long long hash_str(const char *str, unsigned long long hash)
+{
+   return fnv1a(str, strlen(str) + 1, hash);
+}
+
+static unsigned long long hash_section(const split_section *sec, unsigned long long hash)
+{
+   hash = hash_str(sec->label, hash);
+   hash = hash_uint(sec->start, hash);
+   hash = hash_uint(sec->end, hash);
+   hash = hash_uint(sec->vaddr, hash);
+   hash = hash_uint(sec->type, hash);
+   hash = hash_str(sec->section_name, hash);
+   hash = hash_uint(sec->subtype, hash);
+   hash = hash_uint(sec->tex.offset, hash);
+   hash = hash_uint(sec->tex.palette, hash);
+   hash = hash_uint(sec->tex.width, hash);
+   hash = hash_uint(sec->tex.height, hash);
+   hash = hash_uint(sec->tex.depth, hash);
+   hash = hash_uint(sec->tex.format, hash);
+   hash = hash_uint(sec->child_count, hash);
+   // ptr and instrset sections store a count in child_count without any children
+   if (sec->children) {
+      for (int i = 0; i < sec->child_count; i++) {
+         hash = hash_section(&sec->children[i], hash);
+      }
+   }
+   return hash;
+}
+
+// hash of options and configuration shared by all jobs
+// any section may reference labels and addresses of any other, so the whole config is included
+static unsigned long long hash_config(const arg_config *args, const rom_config *config)
+{
+   unsigned long long hash = hash_str(N64SPLIT_VERSION, FNV1A_INIT);
+   hash = fnv1a(&args->model_scale, sizeof(args->model_scale), hash);
+   hash = hash_uint(args->raw_texture, hash);
+   hash = hash_uint(args->large_texture, hash);
+   hash = hash_uint(args->large_texture_depth, hash);
+   hash = hash_uint(args->merge_pseudo, hash);
+   hash = hash_str(args->png_writer, hash);
+   hash = hash_str(config->name, hash);
+   hash = hash_str(config->basename, hash);
+   for (int i = 0; i < config->section_count; i++) {
+      hash = hash_section(&config->sections[i], hash);
+   }
+   for (int i = 0; i < config->label_count; i++) {
+      hash = hash_uint(config->labels[i].ram_addr, hash);
+      hash = hash_str(config->labels[i].name, hash);
+   }
+   return hash;
+}
+
+// hash of the ROM data a job reads
+// code_hash: hash of all ASM sections, which the disassembler labels are derived from
+// rom_hash: hash of the whole ROM for Blast sections, whose lookup tables have no known bounds
+static unsigned long long hash_job(const split_context *ctx, const split_job *job, unsigned long long config_hash,
+                                   unsigned long long code_hash, unsigned long long rom_hash)
+{
+   const split_section *sec = &ctx->config->sections[job->s];
+   unsigned long long hash = hash_uint(job->pass, config_hash);
+   hash = hash_uint(job->s, hash);
+   if (job->pass == SPLIT_PASS_MAIN) {
+      // gap before this section is output with it
+      unsigned int prev_end = (job->s > 0) ? ctx->config->sections[job->s - 1].end : 0;
+      if (prev_end < sec->start) {
+         hash = fnv1a(&ctx->data[prev_end], sec->start - prev_end, hash);
+      }
+   }
+   hash = fnv1a(&ctx->data[sec->start], sec->end - sec->start, hash);
+   if (job->sfx_pair) {
+      hash = fnv1a(&ctx->data[job->sfx_pair->start], job->sfx_pair->end - job->sfx_pair->start, hash);
+   }
+   switch (sec->type) {
+      case TYPE_ASM:
+      case TYPE_PTR:
+      case TYPE_SM64_GEO:
+      case TYPE_SM64_LEVEL:
+      case TYPE_SM64_BEHAVIOR:
+         hash = fnv1a(&code_hash, sizeof(code_hash), hash);
+         break;
+      case TYPE_BLAST:
+         hash = fnv1a(&rom_hash, sizeof(rom_hash), hash);
+         break;
+      default:
+         break;
+   }
+   return hash;
+}
+
+static int cache_entry_cmp(const void *a, const void *b)
+{
+   const cache_entry *ea = a;
+   const cache_entry *eb = b;
+   return (ea->hash > eb->hash) - (ea->hash < eb->hash);
+}
+
+// load cache from previous split, empty if missing or invalid
+static void cache_load(split_cache *cache, const char *filename)
+{
+   long len = read_file(filename, &cache->data);
+   long offset = sizeof(CACHE_MAGIC) - 1;
+   int alloc = 64;
+   struct stat st;
+
+   cache->count = 0;
+   cache->mtime = (stat(filename, &st) == 0) ? st.st_mtime : 0;
+   cache->entries = malloc(alloc * sizeof(*cache->entries));
+   if (len < offset || memcmp(cache->data, CACHE_MAGIC, offset)) {
+      if (len >= 0) {
+         free(cache->data);
+      }
+      cache->data = NULL;
+      return;
+   }
+   while (offset + CACHE_ENTRY_HEADER <= len) {
+      cache_entry *entry;
+      if (cache->count >= alloc) {
+         alloc *= 2;
+         cache->entries = realloc(cache->entries, alloc * sizeof(*cache->entries));
+      }
+      entry = &cache->entries[cache->count];
+      memcpy(&entry->hash, &cache->data[offset], 8);
+      memcpy(&entry->fasm_len, &cache->data[offset + 8], 4);
+      memcpy(&entry->make_len, &cache->data[offset + 12], 4);
+      memcpy(&entry->out_len, &cache->data[offset + 16], 4);
+      offset += CACHE_ENTRY_HEADER;
+      if ((unsigned long long)(len - offset) < (unsigned long long)entry->fasm_len + entry->make_len + entry->out_len) {
+         break;
+      }
+      entry->text = (const char *)&cache->data[offset];
+      offset += entry->fasm_len + entry->make_len + entry->out_len;
+      cache->count++;
+   }
+   qsort(cache->entries, cache->count, sizeof(*cache->entries), cache_entry_cmp);
+}
+
+static const cache_entry *cache_find(const split_cache *cache, unsigned long long hash)
+{
+   cache_entry key;
+   key.hash = hash;
+   return bsearch(&key, cache->entries, cache->count, sizeof(*cache->entries), cache_entry_cmp);
+}
+
+// returns 1 if every file the entry's job wrote still exists and wasn't modified after the cache was saved
+static int cache_outputs_valid(const split_cache *cache, const cache_entry *entry)
+{
+   char filename[FILENAME_MAX];
+   const char *out = &entry->text[entry->fasm_len + entry->make_len];
+   const char *end = out + entry->out_len;
+   while (out < end) {
+      const char *eol = memchr(out, '\n', end - out);
+      struct stat st;
+      size_t len;
+      if (!eol) {
+         return 0;
+      }
+      len = eol - out;
+      if (len >= sizeof(filename)) {
+         return 0;
+      }
+      memcpy(filename, out, len);
+      filename[len] = '\0';
+      if (stat(filename, &st) != 0 || st.st_mtime > cache->mtime) {
+         INFO("Rerunning section job, \"%s\" was removed or modified\n", filename);
+         return 0;
+      }
+      out = eol + 1;
+   }
+   return 1;
+}
+
+static void cache_free(split_cache *cache)
+{
+   free(cache->data);
+   free(cache->entries);
+}
+
+// save output of all jobs for the next split
+static void cache_save(const split_job *jobs, int count, const char *filename)
+{
+   outbuf *out = outbuf_fopen(filename);
+   if (out == NULL) {
+      ERROR("Error opening %s\n", filename);
+      return;
+   }
+   outbuf_puts(out, CACHE_MAGIC);
+   for (int i = 0; i < count; i++) {
+      const split_job *job = &jobs[i];
+      unsigned int fasm_len = job->fasm->index;
+      unsigned int make_len = job->makeheader.index;
+      unsigned int out_len = job->outputs.index;
+      outbuf_write(out, &job->hash, 8);
+      outbuf_write(out, &fasm_len, 4);
+      outbuf_write(out, &make_len, 4);
+      outbuf_write(out, &out_len, 4);
+      outbuf_write(out, job->fasm->buf, fasm_len);
+      outbuf_write(out, job->makeheader.buf, make_len);
+      outbuf_write(out, job->outputs.buf, out_len);
+   }
+   outbuf_close(out);
+}
+
+// append output of jobs [first, last) and free their buffers
+static void split_merge(outbuf *fasm, split_job *jobs, int first, int last)
+{
+   for (int i = first; i < last; i++) {
+      split_job *job = &jobs[i];
+      outbuf_write(fasm, job->fasm->buf, job->fasm->index);
+      if (job->makeheader.index > 0) {
+         strbuf_sprintf(job->makeheader_dst, "%s", job->makeheader.buf);
+      }
+      outbuf_close(job->fasm);
+      strbuf_free(&job->makeheader);
+      strbuf_free(&job->outputs);
+   }
+}
+
+void split_file(unsigned char *data, unsigned int length, arg_config *args, rom_config *config, disasm_state *state)
+{
+   char makefile_name[FILENAME_MAX];
+   char geo_dir[FILENAME_MAX];
+   char level_dir[FILENAME_MAX];
+   char behavior_dir[FILENAME_MAX];
+   char asmfilename[FILENAME_MAX];
+   char cachefilename[FILENAME_MAX];
    strbuf makeheader_mio0;
    strbuf makeheader_level;
    strbuf makeheader_music;
-   FILE *fasm;
+   outbuf *fasm;
    //FILE *fmake;
+   split_context ctx;
+   split_queue queue;
+   split_job *jobs;
+   split_cache cache;
+   unsigned long long config_hash;
+   unsigned long long code_hash;
+   unsigned long long rom_hash;
+   pthread_t *workers;
+   int job_count;
+   int cached_count = 0;
+   int threads;
    int s;
    int i;
-   unsigned int a;
-   unsigned int w, h;
-   unsigned int prev_end = 0;
-   unsigned int ptr;
    split_section *sections = config->sections;
 
+   ctx.data = data;
+   ctx.args = args;
+   ctx.config = config;
+   ctx.state = state;
+
    // create directories
    sprintf(makefile_name, "%s/Makefile.split", args->output_dir);
-   sprintf(bin_dir, "%s/%s", args->output_dir, BIN_SUBDIR);
-   sprintf(asm_dir, "%s/%s", args->output_dir, ASM_SUBDIR);
-   sprintf(mio0_dir, "%s/%s", args->output_dir, MIO0_SUBDIR);
-   sprintf(texture_dir, "%s/%s", args->output_dir, TEXTURE_SUBDIR);
+   sprintf(ctx.bin_dir, "%s/%s", args->output_dir, BIN_SUBDIR);
+   sprintf(ctx.asm_dir, "%s/%s", args->output_dir, ASM_SUBDIR);
+   sprintf(ctx.mio0_dir, "%s/%s", args->output_dir, MIO0_SUBDIR);
+   sprintf(ctx.texture_dir, "%s/%s", args->output_dir, TEXTURE_SUBDIR);
    sprintf(geo_dir, "%s/%s", args->output_dir, GEO_SUBDIR);
    sprintf(level_dir, "%s/%s", args->output_dir, LEVEL_SUBDIR);
-   sprintf(model_dir, "%s/%s", args->output_dir, MODEL_SUBDIR);
+   sprintf(ctx.model_dir, "%s/%s", args->output_dir, MODEL_SUBDIR);
    sprintf(behavior_dir, "%s/%s", args->output_dir, BEHAVIOR_SUBDIR);
    make_dir(args->output_dir);
-   make_dir(bin_dir);
-   make_dir(asm_dir);
-   make_dir(mio0_dir);
-   make_dir(texture_dir);
+   make_dir(ctx.bin_dir);
+   make_dir(ctx.asm_dir);
+   make_dir(ctx.mio0_dir);
+   make_dir(ctx.texture_dir);
    make_dir(geo_dir);
    make_dir(level_dir);
-   make_dir(model_dir);
+   make_dir(ctx.model_dir);
    make_dir(behavior_dir);
 
    // open main assembly file and write header
    sprintf(asmfilename, "%s/%s.s", args->output_dir, config->basename);
-   fasm = fopen(asmfilename, "w");
+   fasm = output_open(args, asmfilename);
    if (fasm == NULL) {
       ERROR("Error opening %s\n", asmfilename);
       exit(3);
    }
-   fprintf(fasm, asm_header, config->name, N64SPLIT_VERSION);
+   outbuf_printf(fasm, asm_header, config->name, N64SPLIT_VERSION);
 
    // generate globals include file
    generate_globals(args, config);
@@ -491,9 +1476,26 @@ void split_file(unsigned char *data, unsigned int length, arg_config *args, rom_
    strbuf_alloc(&makeheader_music, 256);
    strbuf_sprintf(&makeheader_music, "MUSIC_FILES =");
 
+   strbuf_alloc(&makeheader_mio0, 1024);
+   strbuf_sprintf(&makeheader_mio0, "MIO0_FILES =");
+
+   strbuf_alloc(&makeheader_level, 1024);
+   strbuf_sprintf(&makeheader_level, "LEVEL_FILES =");
+
+   //fmake = fopen(makefile_name, "w");
+   //fprintf(fmake, "TARGET = %s\n", config->basename);
+   //fprintf(fmake, "LD_SCRIPT = $(TARGET).ld\n");
+   //fprintf(fmake, "MIO0_DIR = %s\n", MIO0_SUBDIR);
+   //fprintf(fmake, "TEXTURE_DIR = %s\n", TEXTURE_SUBDIR);
+   //fprintf(fmake, "GEO_DIR = %s\n", GEO_SUBDIR);
+   //fprintf(fmake, "LEVEL_DIR = %s\n\n", LEVEL_SUBDIR);
+   //fprintf(fmake, "MUSIC_DIR = %s\n\n", MUSIC_SUBDIR);
+
+   // queue every section for both passes, in the order their text is output
+   jobs = malloc(2 * MAX(config->section_count, 1) * sizeof(*jobs));
+   job_count = 0;
    //Need both sfx sections to parse
    split_section *sfxSec = NULL;
-   
    for (s = 0; s < config->section_count; s++) {
       split_section *sec = &sections[s];
 
@@ -504,569 +1506,114 @@ void split_file(unsigned char *data, unsigned int length, arg_config *args, rom_
          exit(4);
       }
 
-      // fill gaps between regions
-      if (sec->start != prev_end) {
-         int gap_len = sec->start - prev_end;
-         INFO("Filling gap before region %d (%d bytes)\n", s, gap_len);
-         fprintf(fasm, "# Unknown region %06X-%06X [%X]\n", prev_end, sec->start, gap_len);
-         // for small gaps, just output bytes
-         if (gap_len <= 0x80) {
-            unsigned int group_offset = prev_end;
-            while (gap_len > 0) {
-               int group_len = MIN(gap_len, 0x10);
-               fprintf(fasm, ".byte ");
-               fprint_hex_source(fasm, &data[group_offset], group_len);
-               fprintf(fasm, "\n");
-               gap_len -= group_len;
-               group_offset += group_len;
-            }
+      split_job *job = &jobs[job_count++];
+      job->s = s;
+      job->pass = SPLIT_PASS_MAIN;
+      job->sfx_pair = NULL;
+      job->makeheader_dst = &makeheader_music;
+      if (sec->type == TYPE_SFX_CTL || sec->type == TYPE_SFX_TBL) {
+         if (sfxSec == NULL) {
+            sfxSec = sec;
          } else {
-            // TODO move gap fillers into a different subdirectory
-            sprintf(outfilename, "%s/%s.%06X.bin", BIN_SUBDIR, config->basename, prev_end);
-            sprintf(outfilepath, "%s/%s", args->output_dir, outfilename);
-            write_file(outfilepath, &data[prev_end], gap_len);
-            fprintf(fasm, ".incbin \"%s\"\n", outfilename);
+            job->sfx_pair = sfxSec;
          }
-         fprintf(fasm, "\n");
       }
-
-      switch (sec->type)
-      {
-         case TYPE_HEADER:
-            sprintf(headerfilepath, "%s/%s", asm_dir, "header.s");
-            FILE *header = fopen(headerfilepath, "w");
-            INFO("Section header: %X-%X\n", sec->start, sec->end);
-            fprintf(header, ".section .header, \"a\"\n"
-                          ".byte  0x%02X", data[sec->start]);
-            for (i = 1; i < 4; i++) {
-               fprintf(header, ", 0x%02X", data[sec->start + i]);
-            }
-            fprintf(header, " # PI BSD Domain 1 register\n");
-            fprintf(header, ".word  0x%08X # clock rate setting\n", read_u32_be(&data[sec->start + 0x4]));
-            fprintf(header, ".word  0x%08X # entry point\n", read_u32_be(&data[sec->start + 0x8]));
-            fprintf(header, ".word  0x%08X # release\n", read_u32_be(&data[sec->start + 0xc]));
-            fprintf(header, ".word  0x%08X # checksum1\n", read_u32_be(&data[sec->start + 0x10]));
-            fprintf(header, ".word  0x%08X # checksum2\n", read_u32_be(&data[sec->start + 0x14]));
-            fprintf(header, ".word  0x%08X # unknown\n", read_u32_be(&data[sec->start + 0x18]));
-            fprintf(header, ".word  0x%08X # unknown\n", read_u32_be(&data[sec->start + 0x1C]));
-            fprintf(header, ".ascii \"");
-            fwrite(&data[sec->start + 0x20], 1, 20, header);
-            fprintf(header, "\" # ROM name: 20 bytes\n");
-            fprintf(header, ".word  0x%08X # unknown\n", read_u32_be(&data[sec->start + 0x34]));
-            fprintf(header, ".word  0x%08X # cartridge\n", read_u32_be(&data[sec->start + 0x38]));
-            fprintf(header, ".ascii \"");
-            fwrite(&data[sec->start + 0x3C], 1, 2, header);
-            fprintf(header, "\"       # cartridge ID\n");
-            fprintf(header, ".ascii \"");
-            fwrite(&data[sec->start + 0x3E], 1, 1, header);
-            fprintf(header, "\"        # country\n");
-            fprintf(header, ".byte  0x%02X       # version\n\n", data[sec->start + 0x3F]);
-            fclose(header);
-            break;
-         case TYPE_BIN:
-            write_bin_type(sec, outfilename, start_label, fasm, data, outfilepath, args, config);
-            break;
-         case TYPE_BLAST:
-         case TYPE_MIO0:
-         case TYPE_GZIP:
+   }
+   for (s = 0; s < config->section_count; s++) {
+      split_job *job;
+      switch (sections[s].type) {
          case TYPE_SM64_GEO:
-            // fill previous geometry and MIO0 blocks
-            fprintf(fasm, ".space 0x%05x, 0x01 # %s\n", sec->end - sec->start, sec->label);
-            break;
-         case TYPE_PTR:
-            INFO("Section ptr: %X-%X\n", sec->start, sec->end);
-            if (sec->label == NULL || sec->label[0] == '\0') {
-               sprintf(start_label, "Ptr%06X", sec->start);
-            } else {
-               strcpy(start_label, sec->label);
-            }
-            fprintf(fasm, "%s:\n", start_label);
-            for (a = sec->start; a < sec->end; a += 4) {
-               ptr = read_u32_be(&data[a]);
-               disasm_label_lookup(state, ptr, start_label);
-               fprintf(fasm, ".word %s", start_label);
-               if (sec->child_count > 0) {
-                  for (i = 1; i < sec->child_count; i++) {
-                     a += 4;
-                     ptr = read_u32_be(&data[a]);
-                     disasm_label_lookup(state, ptr, start_label);
-                     fprintf(fasm, ", %s", start_label);
-                  }
-               }
-               fprintf(fasm, "\n");
-            }
-            fprintf(fasm, "\n");
-            break;
-         case TYPE_ASM:
-            INFO("Section asm: %X-%X\n", sec->start, sec->end);
-            char section_asmfilename[FILENAME_MAX];
-            sprintf(section_asmfilename, "%s/asm/%s.s", args->output_dir, sec->label);
-            // Include in main .s file
-            fprintf(fasm, ".include \"asm/%s.s\" \n", sec->label);
-
-            // Open seperate .s file for this section
-            FILE *section_fasm = fopen(section_asmfilename, "w");
-            fprintf(section_fasm, "%s", asm_header);
-            fprintf(section_fasm, "\n.section .text%08X, \"ax\"\n\n", sec->vaddr);
-            mipsdisasm_pass2(section_fasm, state, sec->start);
-            fclose(section_fasm);
-            break;
          case TYPE_SM64_LEVEL:
-            // relocate level scripts to .mio0 area
-            // TODO: these shouldn't need to be relocated if load offset can be computed
-            fprintf(fasm, ".space 0x%05x, 0x01 # %s\n", sec->end - sec->start, sec->label);
-            break;
          case TYPE_SM64_BEHAVIOR:
-            // behaviors are done below
-            fprintf(fasm, ".space 0x%05x, 0x01 # %s\n", sec->end - sec->start, sec->label);
-            break;
-         case TYPE_M64:
-            parse_music_sequences(fasm, data, sec, args, &makeheader_music);
-            break;
-         case TYPE_SFX_CTL:
-            if (sfxSec == NULL)
-               sfxSec = sec;
-            else
-               parse_sound_banks(fasm, data, sec, sfxSec, args, &makeheader_music); //Fix header later
+            job = &jobs[job_count++];
+            job->makeheader_dst = &makeheader_level;
             break;
-         case TYPE_SFX_TBL:
-            if (sfxSec == NULL)
-               sfxSec = sec;
-            else
-               parse_sound_banks(fasm, data, sfxSec, sec, args, &makeheader_music); //Fix header later
-            break;
-         case TYPE_INSTRUMENT_SET:
-            parse_instrument_set(fasm, data, sec);
+         case TYPE_BLAST:
+         case TYPE_GZIP:
+         case TYPE_MIO0:
+            job = &jobs[job_count++];
+            job->makeheader_dst = &makeheader_mio0;
             break;
          default:
-            // printf("Treating custom file format as binary %s %s %s\n", sec->section_name, outfilepath, outfilename);
-            // ERROR("Don't know what to do with type %d\n", sec->type);
-            write_bin_type(sec, outfilename, start_label, fasm, data, outfilepath, args, config);
-            break;
+            continue;
       }
-      prev_end = sec->end;
+      job->s = s;
+      job->pass = SPLIT_PASS_MIO0;
+      job->sfx_pair = NULL;
+   }
+   for (i = 0; i < job_count; i++) {
+      jobs[i].fasm = outbuf_mem(0);
+      strbuf_alloc(&jobs[i].makeheader, 0);
+      strbuf_alloc(&jobs[i].outputs, 0);
+      jobs[i].cached = 0;
    }
 
-   strbuf_alloc(&makeheader_mio0, 1024);
-   strbuf_sprintf(&makeheader_mio0, "MIO0_FILES =");
-
-   strbuf_alloc(&makeheader_level, 1024);
-   strbuf_sprintf(&makeheader_level, "LEVEL_FILES =");
-
-   //fmake = fopen(makefile_name, "w");
-   //fprintf(fmake, "TARGET = %s\n", config->basename);
-   //fprintf(fmake, "LD_SCRIPT = $(TARGET).ld\n");
-   //fprintf(fmake, "MIO0_DIR = %s\n", MIO0_SUBDIR);
-   //fprintf(fmake, "TEXTURE_DIR = %s\n", TEXTURE_SUBDIR);
-   //fprintf(fmake, "GEO_DIR = %s\n", GEO_SUBDIR);
-   //fprintf(fmake, "LEVEL_DIR = %s\n\n", LEVEL_SUBDIR);
-   //fprintf(fmake, "MUSIC_DIR = %s\n\n", MUSIC_SUBDIR);
-
-   fprintf(fasm, "\n.section .mio0\n");
+   // hash job inputs and reuse output of unchanged sections from the last split
+   config_hash = hash_config(args, config);
+   code_hash = FNV1A_INIT;
+   rom_hash = FNV1A_INIT;
    for (s = 0; s < config->section_count; s++) {
-      split_section *sec = &sections[s];
-      switch (sec->type) {
-         case TYPE_SM64_GEO:
-         {
-            section_sm64_geo(data, args, config, state, sec, start_label, outfilename, outfilepath, fasm, &makeheader_level);
-            break;
-         }
-         case TYPE_BLAST:
-         case TYPE_GZIP:
-         case TYPE_MIO0:
-         {
-            char binfilename[FILENAME_MAX];
-            char extension[8] = {0};
-            unsigned char *lut;
-            char binasmfilename[FILENAME_MAX];
-            FILE *binasm;
-            unsigned char *binfilecontents = NULL;
-            long binfilelen = 0;
-            if (sec->label == NULL || sec->label[0] == '\0') {
-               sprintf(start_label, "L%06X", sec->start);
-            } else {
-               strcpy(start_label, sec->label);
-            }
-            sprintf(binfilename, "%s.s", start_label);
-            sprintf(binasmfilename, "%s/%s", bin_dir, binfilename);
-            // decode and write
-            binasm = fopen(binasmfilename, "w");
-            if (binasm == NULL) {
-               perror(binasmfilename);
-               exit(1);
-            }
-            fprintf(binasm, "# generated by n64split\n.section .rodata\n\n.include \"%s\"\n", MACROS_FILE);
-            switch (sec->type) {
-               case TYPE_BLAST:
-                  INFO("Section Blast: %d %s %X-%X\n", sec->subtype, sec->label, sec->start, sec->end);
-                  sprintf(extension, "bc%d", sec->subtype);
-                  break;
-               case TYPE_MIO0:
-                  INFO("Section MIO0: %s %X-%X\n", sec->label, sec->start, sec->end);
-                  strcpy(extension, "mio0");
-                  break;
-               case TYPE_GZIP:
-                  INFO("Section GZIP: %s %X-%X\n", sec->label, sec->start, sec->end);
-                  strcpy(extension, "gz");
-                  break;
-               default:
-                  break;
-            }
-            sprintf(outfilename, "%s.%s", start_label, extension);
-            sprintf(binfilename, "%s/%s.bin", bin_dir, start_label);
-            sprintf(mio0filename, "%s/%s", mio0_dir, outfilename);
-            write_file(mio0filename, &data[sec->start], sec->end - sec->start);
-
-            fprintf(fasm, "\n.align 4, 0x01\n");
-            fprintf(fasm, ".global %s\n", start_label);
-            fprintf(fasm, "%s:\n", start_label);
-            fprintf(fasm, ".incbin \"%s/%s\"\n", MIO0_SUBDIR, outfilename);
-            fprintf(fasm, "%s_end:\n", start_label);
-
-            // append to Makefile
-            strbuf_sprintf(&makeheader_mio0, " \\\n$(MIO0_DIR)/%s", outfilename);
-
-            // TODO: use in-memory decompression?
-            // extract compressed data
-            switch (sec->type) {
-               case TYPE_BLAST:
-                  // TODO: make this configurable?
-                  switch (sec->subtype) {
-                     case 4: lut = &data[0x047480]; break;
-                     case 5: lut = &data[0x0998E0]; break; // TODO: fix this
-                     default: lut = data; break;
-                  }
-                  blast_decode_file(mio0filename, sec->subtype, binfilename, lut);
-                  break;
-               case TYPE_MIO0:
-                  mio0_decode_file(mio0filename, 0, binfilename);
-                  break;
-               case TYPE_GZIP:
-                  gzip_decode_file(mio0filename, 0, binfilename);
-                  break;
-               default:
-                  break;
-            }
-            binfilelen = read_file(binfilename, &binfilecontents);
-
-            // extract texture data
-            if (sec->children) {
-               unsigned int offset = 0;
-               unsigned int next_offset = 0;
-               // TODO: add segment base to config file
-               const unsigned int segment_base = 0x07000000;
-               unsigned int seg_address = segment_base + offset;
-               //fprintf(fmake, "$(MIO0_DIR)/%s.bin:", start_label);
-               INFO("Extracting textures from %s\n", start_label);
-               for (int t = 0; t < sec->child_count; t++) {
-                  split_section *child = &sec->children[t];
-                  texture *tex = &child->tex;
-                  w = tex->width;
-                  h = tex->height;
-                  if (next_offset > child->start) {
-                     ERROR("Error section overlap region %d (%X > %X)\n", t, next_offset, child->start);
-                     exit(1);
-                  }
-                  if (next_offset != child->start) {
-                     unsigned int gap_len = child->start - next_offset;
-                     INFO("Filling gap before region %d (%d bytes)\n", t, gap_len);
-                     fprintf(binasm, "# Unknown region %06X-%06X [%X]\n", next_offset, child->start, gap_len);
-                     while (gap_len > 0) {
-                        int group_len = MIN(gap_len, 0x10);
-                        fprintf(binasm, ".byte ");
-                        fprint_hex_source(binasm, &binfilecontents[next_offset], group_len);
-                        fprintf(binasm, "\n");
-                        gap_len -= group_len;
-                        next_offset += group_len;
-                     }
-                  }
-                  offset = tex->offset;
-                  seg_address = segment_base + offset;
-                  if (child->end) {
-                     next_offset = child->end;
-                  } else if (tex->format == TYPE_F3D_LIGHT) {
-                     next_offset = child->start + 0x18;
-                  } else { // assume texture
-                     next_offset = child->start + w * h * tex->depth / 8;
-                  }
-                  fprintf(binasm, "\n");
-                  switch (tex->format) {
-                     case TYPE_TEX_IA:
-                     {
-                        sprintf(outfilename, "%s.%05X.ia%d", start_label, offset, tex->depth);
-                        ia *img = raw2ia(&binfilecontents[offset], w, h, tex->depth);
-                        if (img) {
-                           sprintf(outfilepath, "%s/%s.png", texture_dir, outfilename);
-                           ia2png(outfilepath, img, w, h);
-                           free(img);
-                           //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
-                        }
-                        if (args->raw_texture && binfilelen > 0) {
-                           INFO("Saving raw texture for %s\n", start_label);
-                           int len = w*h*tex->depth/8;
-                           sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
-                           write_file(outfilepath, &binfilecontents[offset], len);
-                        }
-                        fprintf(binasm, "texture_%08X: # 0x%08X\n", seg_address, seg_address);
-                        fprintf(binasm, ".incbin \"%s\"\n", outfilename);
-                        break;
-                     }
-                     case TYPE_TEX_I:
-                     {
-                        sprintf(outfilename, "%s.%05X.i%d", start_label, offset, tex->depth);
-                        ia *img = raw2i(&binfilecontents[offset], w, h, tex->depth);
-                        if (img) {
-                           sprintf(outfilepath, "%s/%s.png", texture_dir, outfilename);
-                           ia2png(outfilepath, img, w, h);
-                           free(img);
-                           //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
-                        }
-                        if (args->raw_texture && binfilelen > 0) {
-                           INFO("Saving raw texture for %s\n", start_label);
-                           int len = w*h*tex->depth/8;
-                           sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
-                           write_file(outfilepath, &binfilecontents[offset], len);
-                        }
-                        fprintf(binasm, "texture_%08X: # 0x%08X\n", seg_address, seg_address);
-                        fprintf(binasm, ".incbin \"%s\"\n", outfilename);
-                        break;
-                     }
-                     case TYPE_TEX_RGBA:
-                     {
-                        sprintf(outfilename, "%s.%05X.rgba%d", start_label, offset, tex->depth);
-                        rgba *img = raw2rgba(&binfilecontents[offset], w, h, tex->depth);
-                        if (img) {
-                           sprintf(outfilepath, "%s/%s.png", texture_dir, outfilename);
-                           rgba2png(outfilepath, img, w, h);
-                           free(img);
-                           //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
-                        }
-                        if (args->raw_texture && binfilelen > 0) {
-                           INFO("Saving raw texture for %s\n", start_label);
-                           int len = w*h*tex->depth/8;
-                           sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
-                           write_file(outfilepath, &binfilecontents[offset], len);
-                        }
-                        fprintf(binasm, "texture_%08X: # 0x%08X\n", seg_address, seg_address);
-                        fprintf(binasm, ".incbin \"%s\"\n", outfilename);
-                        break;
-                     }
-                     case TYPE_TEX_SKYBOX:
-                     {
-                        // read in grid of MxN 32x32 tiles and save them as M*31xN*31 image
-                        rgba *img;
-                        unsigned int sky_offset = offset;
-                        int m, n;
-                        int tx, ty;
-                        m = w/32;
-                        n = h/32;
-                        img = malloc(w*h*sizeof(rgba));
-                        w -= m; // adjust for overlap
-                        h -= n;
-                        for (ty = 0; ty < n; ty++) {
-                           for (tx = 0; tx < m; tx++) {
-                              rgba *tile = raw2rgba(&binfilecontents[sky_offset], 32, 32, tex->depth);
-                              int cx, cy;
-                              for (cy = 0; cy < 31; cy++) {
-                                 for (cx = 0; cx < 31; cx++) {
-                                    int out_off = 31*w*ty + 31*tx + w*cy + cx;
-                                    int in_off = 32*cy+cx;
-                                    img[out_off] = tile[in_off];
-                                 }
-                              }
-                              free(tile);
-                              sky_offset += 32*32*2;
-                           }
-                        }
-                        sprintf(outfilename, "%s.%05X.skybox.png", start_label, offset);
-                        sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
-                        rgba2png(outfilepath, img, w, h);
-                        free(img);
-                        //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
-                        break;
-                     }
-                     case TYPE_F3D_DL:
-                     {
-                        int sec_len = child->end - child->start;
-                        fprintf(binasm, "f3d_%08X: # 0x%08X\n", seg_address, seg_address);
-                        for (int o = 0; o < sec_len; o += 8) {
-                           unsigned char cmd = binfilecontents[offset + o];
-                           unsigned int second = read_u32_be(&binfilecontents[offset + o + 4]);
-                           fprintf(binasm, ".word 0x%08X, ", read_u32_be(&binfilecontents[offset + o]));
-                           switch (cmd) {
-                              case 0x03: // light
-                                 fprintf(binasm, "light_%08X\n", second);
-                                 break;
-                              case 0x04: // vertex
-                                 fprintf(binasm, "vertex_%08X\n", second);
-                                 break;
-                              case 0x06: // f3d
-                                 fprintf(binasm, "f3d_%08X\n", second);
-                                 break;
-                              case 0xFD: // texture
-                                 fprintf(binasm, "texture_%08X\n", second);
-                                 break;
-                              default:
-                                 fprintf(binasm, "0x%08X\n", second);
-                                 break;
-                           }
-                        }
-                        break;
-                     }
-                     case TYPE_F3D_LIGHT:
-                     {
-                        fprintf(binasm, "light_%08X: # 0x%08X\n", seg_address, seg_address);
-                        fprintf(binasm, ".byte ");
-                        fprint_hex_source(binasm, &binfilecontents[offset], 8);
-                        fprintf(binasm, "\n");
-                        fprintf(binasm, "light_%08X: # 0x%08X\n", seg_address + 8, seg_address + 8);
-                        fprintf(binasm, ".byte ");
-                        fprint_hex_source(binasm, &binfilecontents[offset + 8], 8);
-                        fprintf(binasm, "\n.byte ");
-                        fprint_hex_source(binasm, &binfilecontents[offset + 16], 8);
-                        fprintf(binasm, "\n");
-                        break;
-                     }
-                     case TYPE_F3D_VERTEX:
-                     {
-                        int sec_len = child->end - child->start;
-                        fprintf(binasm, "vertex_%08X: # 0x%08X\n", seg_address, seg_address);
-                        for (int o = 0; o < sec_len; o += 16) {
-                           fprintf(binasm, "vertex ");
-                           for (int h = 0; h < 6; h++) {
-                              // X, Y, Z, UNUSED, U, V
-                              if (h != 3) {
-                                 fprintf(binasm, "%6d, ", read_s16_be(&binfilecontents[offset + o + h*2]));
-                              }
-                           }
-                           // R, G, B, A
-                           fprint_hex_source(binasm, &binfilecontents[offset + o + 12], 4);
-                           fprintf(binasm, "\n");
-                        }
-                        break;
-                     }
-                     case TYPE_SM64_COLLISION:
-                     {
-                        int sec_len = 0;
-                        sprintf(outfilename, "%s.%05X.collision", start_label, offset);
-                        sprintf(outfilepath, "%s/%s.obj", model_dir, outfilename);
-                        INFO("Generating collision model %s\n", outfilename);
-                        sec_len = collision2obj(binfilename, offset, outfilepath, start_label, args->model_scale);
-                        if (args->raw_texture && binfilelen > 0) {
-                           INFO("Saving raw collision for %s\n", start_label);
-                           sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
-                           write_file(outfilepath, &binfilecontents[offset], sec_len);
-                        }
-                        fprintf(binasm, "collision_%06X: # 0x%08X\n", seg_address, seg_address);
-                        fprintf(binasm, ".incbin \"%s\"\n", outfilename);
-                        break;
-                     }
-                     default:
-                        ERROR("Don't know what to do with format %d\n", tex->format);
-                        exit(1);
-                  }
-               }
-               //fprintf(fmake, "\n\t$(N64GRAPHICS) $@ $^\n\n");
-            }
-
-            // extract texture data
-            if (args->large_texture) {
-               INFO("Generating large texture for %s\n", start_label);
-               w = 32;
-               h = filesize(binfilename) / (w * (args->large_texture_depth / 8));
-               rgba *img = raw2rgba(binfilecontents, w, h, args->large_texture_depth);
-               if (img) {
-                  sprintf(outfilename, "%s.ALL.png", start_label);
-                  sprintf(outfilepath, "%s/%s", texture_dir, outfilename);
-                  rgba2png(outfilepath, img, w, h);
-                  free(img);
-                  //fprintf(fmake, " $(TEXTURE_DIR)/%s", outfilename);
-                  img = NULL;
-               }
-            }
-            // TODO: write files in correct order to avoid this
-            // touch bin, then mio0 files so 'make' doesn't rebuild them right away
-            touch_file(binfilename);
-            touch_file(mio0filename);
-            fclose(binasm);
-            break;
-         }
-         case TYPE_SM64_LEVEL:
-         {
-            FILE *flevel;
-            char levelfilename[FILENAME_MAX];
-            if (sec->label == NULL || sec->label[0] == '\0') {
-               sprintf(start_label, "L%06X", sec->start);
-            } else {
-               strcpy(start_label, sec->label);
-            }
-            INFO("Section relocated level: %s %X-%X\n", start_label, sec->start, sec->end);
-            sprintf(levelfilename, "%s.s", start_label);
-            sprintf(outfilename, "%s/%s", LEVEL_SUBDIR, levelfilename);
-            sprintf(outfilepath, "%s/%s", args->output_dir, outfilename);
-
-            // decode and write level data out
-            flevel = fopen(outfilepath, "w");
-            if (flevel == NULL) {
-               perror(outfilepath);
-               exit(1);
-            }
-            fprintf(flevel, "# level script %s from %X-%X\n\n", start_label, sec->start, sec->end);
-            fprintf(flevel, ".section .mio0\n\n");
-            fprintf(flevel, ".global %s\n", start_label);
-            fprintf(flevel, ".align 4, 0x01\n");
-            fprintf(flevel, "%s:\n", start_label);
-            write_level(flevel, data, config, s, state);
-            fprintf(flevel, "%s_end:\n", start_label);
-            fclose(flevel);
-
-            if (sec->label == NULL || sec->label[0] == '\0') {
-               sprintf(start_label, "L%06X", sec->start);
-            } else {
-               strcpy(start_label, sec->label);
-            }
-            fprintf(fasm, "\n.include \"%s\"\n", outfilename);
-            // append to Makefile
-            strbuf_sprintf(&makeheader_level, " \\\n$(LEVEL_DIR)/%s", levelfilename);
-            break;
+      if (sections[s].type == TYPE_ASM) {
+         code_hash = fnv1a(&data[sections[s].start], sections[s].end - sections[s].start, code_hash);
+      } else if (sections[s].type == TYPE_BLAST && rom_hash == FNV1A_INIT) {
+         rom_hash = fnv1a(data, length, rom_hash);
+      }
+   }
+   sprintf(cachefilename, "%s/%s", args->output_dir, CACHE_FILE);
+   cache.count = 0;
+   if (args->incremental) {
+      cache_load(&cache, cachefilename);
+   }
+   for (i = 0; i < job_count; i++) {
+      split_job *job = &jobs[i];
+      job->hash = hash_job(&ctx, job, config_hash, code_hash, rom_hash);
+      const cache_entry *entry = cache.count ? cache_find(&cache, job->hash) : NULL;
+      if (entry && cache_outputs_valid(&cache, entry)) {
+         outbuf_write(job->fasm, entry->text, entry->fasm_len);
+         if (entry->make_len) {
+            strbuf_sprintf(&job->makeheader, "%.*s", (int)entry->make_len, &entry->text[entry->fasm_len]);
          }
-         case TYPE_SM64_BEHAVIOR:
-         {
-            FILE *f_beh;
-            char beh_filename[FILENAME_MAX];
-            INFO("Section relocated behavior: %s %X-%X\n", sec->label, sec->start, sec->end);
-            if (sec->label == NULL || sec->label[0] == '\0') {
-               sprintf(beh_filename, "%06X.s", sec->start);
-            } else {
-               sprintf(beh_filename, "%s.s", sec->label);
-            }
-            sprintf(outfilename, "%s/%s", BEHAVIOR_SUBDIR, beh_filename);
-            sprintf(outfilepath, "%s/%s", args->output_dir, outfilename);
-            // decode and write level data out
-            f_beh = fopen(outfilepath, "w");
-            if (f_beh == NULL) {
-               perror(outfilepath);
-               exit(1);
-            }
-            write_behavior(f_beh, data, config, s, state);
-            fclose(f_beh);
-
-            fprintf(fasm, "\n.section .behavior, \"a\"\n");
-            fprintf(fasm, "\n.global %s\n", sec->label);
-            fprintf(fasm, ".global %s_end\n", sec->label);
-            fprintf(fasm, "%s:\n", sec->label);
-            fprintf(fasm, ".include \"%s\"\n", outfilename);
-            fprintf(fasm, "%s_end:\n", sec->label);
-            fprintf(fasm, "\n\n.section .mio0\n");
-
-            // append to Makefile
-            strbuf_sprintf(&makeheader_level, " \\\n%s/%s", BEHAVIOR_SUBDIR, beh_filename);
-            break;
+         if (entry->out_len) {
+            strbuf_sprintf(&job->outputs, "%.*s", (int)entry->out_len, &entry->text[entry->fasm_len + entry->make_len]);
          }
-         default:
-            break;
+         job->cached = 1;
+         cached_count++;
       }
    }
+   if (args->incremental) {
+      INFO("Reusing %d of %d unchanged section jobs\n", cached_count, job_count);
+      cache_free(&cache);
+   }
+
+   // sections are independent: run them on a worker pool
+   threads = args->threads;
+   if (threads <= 0) {
+      threads = cpu_count();
+   }
+   threads = MAX(1, MIN(threads, job_count));
+   queue.next = 0;
+   queue.count = job_count;
+   queue.jobs = jobs;
+   queue.ctx = &ctx;
+   pthread_mutex_init(&queue.lock, NULL);
+   workers = malloc(threads * sizeof(*workers));
+   for (i = 0; i < threads; i++) {
+      pthread_create(&workers[i], NULL, split_worker, &queue);
+   }
+   for (i = 0; i < threads; i++) {
+      pthread_join(workers[i], NULL);
+   }
+   pthread_mutex_destroy(&queue.lock);
+   free(workers);
+
+   cache_save(jobs, job_count, cachefilename);
+
+   // merge results in config order
+   split_merge(fasm, jobs, 0, config->section_count);
+   outbuf_puts(fasm, "\n.section .mio0\n");
+   split_merge(fasm, jobs, config->section_count, job_count);
+   free(jobs);
+
    //fprintf(fmake, "\n\n%s", makeheader_mio0.buf);
    //fprintf(fmake, "\n\n%s", makeheader_level.buf);
    //fprintf(fmake, "\n\n%s", makeheader_music.buf);
@@ -1076,7 +1623,7 @@ void split_file(unsigned char *data, unsigned int length, arg_config *args, rom_
    strbuf_free(&makeheader_level);
    strbuf_free(&makeheader_music);
    //fclose(fmake);
-   fclose(fasm);
+   outbuf_close(fasm);
 
    // output top-level makefile
    //sprintf(makefile_name, "%s/Makefile", args->output_dir);
@@ -1085,7 +1632,7 @@ void split_file(unsigned char *data, unsigned int length, arg_config *args, rom_
    //fclose(fmake);
 
    // output collision model material file
-   sprintf(makefile_name, "%s/collision.mtl", model_dir);
+   sprintf(makefile_name, "%s/collision.mtl", ctx.model_dir);
    //fmake = fopen(makefile_name, "w");
    //fprintf(fmake, collision_mtl_data);
    //fclose(fmake);
@@ -1096,12 +1643,14 @@ void split_file(unsigned char *data, unsigned int length, arg_config *args, rom_
 
 void print_usage(void)
 {
-   ERROR("Usage: n64split [-c CONFIG] [-k] [-m] [-o OUTPUT_DIR] [-s SCALE] [-t] [-v] [-V] ROM\n"
+   ERROR("Usage: n64split [-c CONFIG] [-i] [-j THREADS] [-k] [-m] [-o OUTPUT_DIR] [-s SCALE] [-t] [-v] [-V] [-z PNG_WRITER] ROM\n"
          "\n"
          "n64split v" N64SPLIT_VERSION ": N64 ROM splitter, resource ripper, disassembler\n"
          "\n"
          "Optional arguments:\n"
          " -c CONFIG     ROM configuration file (default: determine from checksum)\n"
+         " -i            incremental: skip sections unchanged since last split into OUTPUT_DIR\n"
+         " -j THREADS    number of threads for disassembly and splitting (default: number of processors)\n"
          " -k            keep going as much as possible after error\n"
          " -m            merge related instructions in to pseudoinstructions\n"
          " -o OUTPUT_DIR output directory (default: {CONFIG.basename}.split)\n"
@@ -1110,10 +1659,12 @@ void print_usage(void)
          " -t            generate large texture for MIO0 blocks\n"
          " -v            verbose progress output\n"
          " -V            print version information\n"
+         " -z PNG_WRITER PNG writer for textures: stb, store or zlib[:LEVEL[:FILTER]] (default: %s)\n"
+         "               FILTER: none, sub, up, avg, paeth, adaptive (default)\n"
          "\n"
          "File arguments:\n"
          " ROM        input ROM file\n",
-         default_args.model_scale);
+         default_args.model_scale, default_args.png_writer);
    exit(1);
 }
 
@@ -1145,6 +1696,15 @@ void parse_arguments(int argc, char *argv[], arg_config *config)
                }
                strcpy(config->config_file, argv[i]);
                break;
+            case 'i':
+               config->incremental = true;
+               break;
+            case 'j':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->threads = strtol(argv[i], NULL, 0);
+               break;
             case 'k':
                config->keep_going = true;
                break;
@@ -1176,6 +1736,13 @@ void parse_arguments(int argc, char *argv[], arg_config *config)
                print_version();
                exit(0);
                break;
+            case 'z':
+               if (++i >= argc || strlen(argv[i]) >= sizeof(config->png_writer) ||
+                   n64graphics_parse_png_writer(argv[i]) < 0) {
+                  print_usage();
+               }
+               strcpy(config->png_writer, argv[i]);
+               break;
             default:
                print_usage();
                break;
@@ -1196,7 +1763,9 @@ void parse_arguments(int argc, char *argv[], arg_config *config)
 }
 
 // Auto detect a config file based on the 2 checksums
-int detect_config_file(unsigned int c1, unsigned int c2, rom_config *config)
+// config_file: receives file name of detected config
+// returns 1 if found, 0 if not
+int detect_config_file(unsigned int c1, unsigned int c2, rom_config *config, char *config_file)
 {
 #define CONFIGS_DIR "configs"
    dir_list list;
@@ -1206,14 +1775,21 @@ int detect_config_file(unsigned int c1, unsigned int c2, rom_config *config)
 
    dir_list_ext(CONFIGS_DIR, ".yaml", &list);
 
+   // only fully parse the config whose checksums match
    for (i = 0; i < list.count; i++) {
-      config_ret = config_parse_file(list.files[i], config);
-      INFO("Checking config file '%s' (%X, %X)\n", list.files[i], config->checksum1, config->checksum2);
-      if (config_ret == 0 && c1 == config->checksum1 && c2 == config->checksum2) {
-         ERROR("Using config file: %s\n", list.files[i]);
-         ret_val = 1;
-         break;
-      } else {
+      unsigned int checksum1, checksum2;
+      if (config_read_checksums(list.files[i], &checksum1, &checksum2) < 0) {
+         continue;
+      }
+      INFO("Checking config file '%s' (%X, %X)\n", list.files[i], checksum1, checksum2);
+      if (c1 == checksum1 && c2 == checksum2) {
+         config_ret = config_load(list.files[i], config);
+         if (config_ret >= 0) {
+            ERROR("Using config file: %s\n", list.files[i]);
+            strcpy(config_file, list.files[i]);
+            ret_val = 1;
+            break;
+         }
          config_free(config);
       }
    }
@@ -1230,16 +1806,18 @@ int main(int argc, char *argv[])
    disasm_state *state;
    long len;
    unsigned char *data;
-   int ret_val;
    unsigned int size;
    float percent;
    int i;
    n64_rom_format rom_type;
+   double time_start, time_config, time_pass1, time_split;
+   disasm_range *asm_ranges;
+   int asm_count;
 
    args = default_args;
    parse_arguments(argc, argv, &args);
 
-   len = read_file(args.input_file, &data);
+   len = map_file(args.input_file, &data);
 
    if (len <= 0) {
       return 2;
@@ -1264,15 +1842,14 @@ int main(int argc, char *argv[])
    }
 
    // if no config file supplied, find the right one
+   time_start = get_time();
    if (0 == strcmp(args.config_file, "")) {
-      ret_val = detect_config_file(read_u32_be(data+0x10), read_u32_be(data+0x14), &config);
-      if (!ret_val) {
+      if (!detect_config_file(read_u32_be(data+0x10), read_u32_be(data+0x14), &config, args.config_file)) {
          ERROR("Error: could not find valid config file for '%s'\n", args.input_file);
          return 1;
       }
    } else {
-      ret_val = config_parse_file(args.config_file, &config);
-      if (ret_val != 0) {
+      if (config_load(args.config_file, &config) < 0) {
          return 1;
       }
    }
@@ -1280,6 +1857,13 @@ int main(int argc, char *argv[])
    if (config_validate(&config, len)) {
       return 3;
    }
+   // compile YAML configs so later runs can skip parsing
+   if (config.mapped == NULL && config_compile(args.config_file, &config) < 0) {
+      INFO("Could not write compiled config for %s\n", args.config_file);
+   }
+   // validation may adjust section ranges, so index after
+   config_index_sections(&config);
+   time_config = get_time() - time_start;
 
    // if no output directory specified, construct one from config file
    if (0 == strcmp(args.output_dir, "")) {
@@ -1295,24 +1879,35 @@ int main(int argc, char *argv[])
 
    // first pass disassembler on each asm section
    INFO("Running first pass disassembler...\n");
+   time_start = get_time();
+   asm_ranges = malloc(MAX(config.section_count, 1) * sizeof(*asm_ranges));
+   asm_count = 0;
    for (i = 0; i < config.section_count; i++) {
       if (config.sections[i].type == TYPE_ASM) {
          unsigned int start = config.sections[i].start;
          unsigned int end = config.sections[i].end;
-         unsigned int vaddr = config.sections[i].vaddr;
          printf("First pass of section:%s\n",  config.sections[i].label);
          if (end <= (unsigned int)len) {
-            mipsdisasm_pass1(data, start, end - start, vaddr, state);
+            asm_ranges[asm_count].offset = start;
+            asm_ranges[asm_count].length = end - start;
+            asm_ranges[asm_count].vaddr = config.sections[i].vaddr;
+            asm_count++;
          } else {
             ERROR("Trying to disassemble past end of file (%X > %X)\n", end, (unsigned int)len);
             exit(1);
          }
       }
    }
+   mipsdisasm_pass1_multi(data, asm_ranges, asm_count, state, args.threads);
+   free(asm_ranges);
+
+   time_pass1 = get_time() - time_start;
 
    // split the ROM
    INFO("Splitting ROM...\n");
+   time_start = get_time();
    split_file(data, len, &args, &config, state);
+   time_split = get_time() - time_start;
 
    // print some stats
    printf("\nROM split statistics:\n");
@@ -1324,7 +1919,12 @@ int main(int argc, char *argv[])
    }
    percent = (float)(100 * size) / (float)(len);
    printf("Total decoded section size:  %X/%lX (%.2f%%) (i.e sections that are not .bin)\n", size, len, percent);
+   printf("Config load and validation:  %.3f s (%d sections, %d labels)\n", time_config, config.section_count, config.label_count);
+   printf("First pass disassembly:      %.3f s\n", time_pass1);
+   printf("Split time:                  %.3f s\n", time_split);
    size = 0;
 
+   unmap_file(data, len);
+
    return 0;
 }
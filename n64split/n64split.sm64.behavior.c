@@ -1,6 +1,6 @@
 #include "n64split.h"
 
-void write_behavior(FILE *out, unsigned char *data, rom_config *config, int s, disasm_state *state)
+void write_behavior(outbuf *out, unsigned char *data, rom_config *config, int s, disasm_state *state)
 {
    char label[128];
    unsigned int a, i;
@@ -17,7 +17,7 @@ void write_behavior(FILE *out, unsigned char *data, rom_config *config, int s, d
       if (beh_i < sec->child_count) {
          unsigned int offset = a - sec->start;
          if (offset == beh[beh_i].start) {
-            fprintf(out, "%s: # %04X\n", beh[beh_i].label, beh[beh_i].start);
+            outbuf_printf(out, "%s: # %04X\n", beh[beh_i].label, beh[beh_i].start);
             beh_i++;
          } else if (offset > beh[beh_i].start) {
             ERROR("Warning: skipped behavior %04X \"%s\"\n", beh[beh_i].start, beh[beh_i].label);
@@ -58,12 +58,13 @@ void write_behavior(FILE *out, unsigned char *data, rom_config *config, int s, d
             break;
       }
       val = read_u32_be(&data[a]);
-      fprintf(out, ".word 0x%08X", val);
+      outbuf_puts(out, ".word 0x");
+      outbuf_hex(out, val, 8);
       switch(data[a]) {
          case 0x0C: // behavior 0x0C is a function pointer
             val = read_u32_be(&data[a+4]);
             disasm_label_lookup(state, val, label);
-            fprintf(out, ", %s\n", label);
+            outbuf_printf(out, ", %s\n", label);
             break;
          case 0x02: // jump to another behavior
          case 0x04: // jump to segmented address
@@ -72,18 +73,20 @@ void write_behavior(FILE *out, unsigned char *data, rom_config *config, int s, d
          case 0x2C: // sub-objects
             for (i = 4; i < len-4; i += 4) {
                val = read_u32_be(&data[a+i]);
-               fprintf(out, ", 0x%08X", val);
+               outbuf_puts(out, ", 0x");
+               outbuf_hex(out, val, 8);
             }
             val = read_u32_be(&data[a+len-4]);
             disasm_label_lookup(state, val, label);
-            fprintf(out, ", %s\n", label);
+            outbuf_printf(out, ", %s\n", label);
             break;
          default:
             for (i = 4; i < len; i += 4) {
                val = read_u32_be(&data[a+i]);
-               fprintf(out, ", 0x%08X", val);
+               outbuf_puts(out, ", 0x");
+               outbuf_hex(out, val, 8);
             }
-            fprintf(out, "\n");
+            outbuf_putc(out, '\n');
             break;
       }
       a += len;
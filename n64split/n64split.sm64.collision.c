@@ -24,10 +24,9 @@ const terrain_t terrain_table[] =
    {0x00FD, "pool_warp"},
 };
 
-char *terrain2str(unsigned int type)
+char *terrain2str(unsigned int type, char *retval)
 {
    unsigned int i;
-   static char retval[16];
    if (0x1B <= type && type <= 0x1E) {
       sprintf(retval, "switch%02X", type);
       return retval;
@@ -49,11 +48,9 @@ char *terrain2str(unsigned int type)
 
 
 
-int collision2obj(char *binfilename, unsigned int binoffset, char *objfilename, char *name, float scale)
+int collision2obj(unsigned char *data, unsigned int data_len, unsigned int binoffset, char *objfilename, char *name, float scale)
 {
-   unsigned char *data;
    FILE *fobj;
-   long in_size;
    unsigned int vcount;
    unsigned int tcount;
    unsigned int cur_tcount;
@@ -63,6 +60,7 @@ int collision2obj(char *binfilename, unsigned int binoffset, char *objfilename,
    unsigned int offset;
    unsigned int i;
    unsigned int vidx[3];
+   char terrain_name[16];
    short x, y, z;
    int ret_len = 0;
 
@@ -72,13 +70,12 @@ int collision2obj(char *binfilename, unsigned int binoffset, char *objfilename,
       exit(EXIT_FAILURE);
    }
 
-   in_size = read_file(binfilename, &data);
-   if (in_size <= 0) {
-      ERROR("Error reading input file \"%s\"\n", binfilename);
-      exit(EXIT_FAILURE);
-   }
-
    offset = binoffset;
+   if (offset + 4 > data_len) {
+      ERROR("Collision data %s.%X out of range (%X)\n", name, offset, data_len);
+      fclose(fobj);
+      return 0;
+   }
    if (data[offset] != 0x00 || data[offset+1] != 0x40) {
       ERROR("Unknown collision data %s.%X: %08X\n", name, offset, read_u32_be(data));
       return 0;
@@ -121,8 +118,8 @@ int collision2obj(char *binfilename, unsigned int binoffset, char *objfilename,
             v_per_t = 3;
             break;
       }
-      fprintf(fobj, "\ng %s_%05X_%s\n", name, binoffset, terrain2str(terrain));
-      fprintf(fobj, "usemtl %s\n", terrain2str(terrain));
+      fprintf(fobj, "\ng %s_%05X_%s\n", name, binoffset, terrain2str(terrain, terrain_name));
+      fprintf(fobj, "usemtl %s\n", terrain2str(terrain, terrain_name));
 
       INFO("Loading %u triangles of terrain %02X\n", cur_tcount, terrain);
       offset += 4;
@@ -137,7 +134,6 @@ int collision2obj(char *binfilename, unsigned int binoffset, char *objfilename,
    }
 
    fclose(fobj);
-   free(data);
 
    ret_len = offset - binoffset;
    return ret_len;
@@ -2,7 +2,7 @@
 
 #define MUSIC_SUBDIR "music"
 
-void parse_music_sequences(FILE *out, unsigned char *data, split_section *sec, arg_config *args, strbuf *makeheader)
+void parse_music_sequences(outbuf *out, unsigned char *data, split_section *sec, arg_config *args, strbuf *makeheader)
 {
    typedef struct {
       unsigned int start;
@@ -34,31 +34,32 @@ void parse_music_sequences(FILE *out, unsigned char *data, split_section *sec, a
       }
    }
 
-   fprintf(out, "\n# music sequence table\n");
-   fprintf(out, "music_sequence_table_header:\n");
-   fprintf(out, ".hword %d, (music_sequence_table_end - music_sequence_table) / 8\n", seq_bank.revision);
-   fprintf(out, "music_sequence_table:\n");
+   outbuf_puts(out, "\n# music sequence table\n");
+   outbuf_puts(out, "music_sequence_table_header:\n");
+   outbuf_printf(out, ".hword %d, (music_sequence_table_end - music_sequence_table) / 8\n", seq_bank.revision);
+   outbuf_puts(out, "music_sequence_table:\n");
    for (i = 0; i < seq_bank.count; i++) {
       sprintf(seq_name, "seq_%02X", i);
-      fprintf(out, ".word (%s - music_sequence_table_header), (%s_end - %s) # 0x%05X, 0x%04X\n",
+      outbuf_printf(out, ".word (%s - music_sequence_table_header), (%s_end - %s) # 0x%05X, 0x%04X\n",
               seq_name, seq_name, seq_name, seq_bank.seq[i].start, seq_bank.seq[i].length);
    }
-   fprintf(out, "music_sequence_table_end:\n");
-   fprintf(out, "\n.align 4, 0x01\n");
+   outbuf_puts(out, "music_sequence_table_end:\n");
+   outbuf_puts(out, "\n.align 4, 0x01\n");
    for (i = 0; i < seq_bank.count; i++) {
       sprintf(seq_name, "seq_%02X", i);
-      fprintf(out, "\n%s:", seq_name);
+      outbuf_printf(out, "\n%s:", seq_name);
 
       sprintf(m64_file, "%s/%s.m64", music_dir, seq_name);
       write_file(m64_file, &data[sec->start + seq_bank.seq[i].start], seq_bank.seq[i].length);
+      output_record(m64_file);
 
       sprintf(m64_file_rel, "%s/%s.m64", MUSIC_SUBDIR, seq_name);
-      fprintf(out, "\n.incbin \"%s\"\n", m64_file_rel);
+      outbuf_printf(out, "\n.incbin \"%s\"\n", m64_file_rel);
 
       // append to Makefile
       strbuf_sprintf(makeheader, " \\\n$(MUSIC_DIR)/%s.m64", seq_name);
 
-      fprintf(out, "%s_end:\n", seq_name);
+      outbuf_printf(out, "%s_end:\n", seq_name);
    }
 
    // free used memory
@@ -67,7 +68,7 @@ void parse_music_sequences(FILE *out, unsigned char *data, split_section *sec, a
    }
 }
 
-void parse_instrument_set(FILE *out, unsigned char *data, split_section *sec)
+void parse_instrument_set(outbuf *out, unsigned char *data, split_section *sec)
 {
    unsigned int *instrument_set;
    unsigned int count;
@@ -79,9 +80,9 @@ void parse_instrument_set(FILE *out, unsigned char *data, split_section *sec)
    for (i = 0; i < count; i++) {
       instrument_set[i] = read_u16_be(&data[sec->start + 2*i]);
    }
-   fprintf(out, "\ninstrument_sets:\n");
+   outbuf_puts(out, "\ninstrument_sets:\n");
    for (i = 0; i < count; i++) {
-      fprintf(out, ".hword instrument_set_%02X - instrument_sets # 0x%04X\n", i, instrument_set[i]);
+      outbuf_printf(out, ".hword instrument_set_%02X - instrument_sets # 0x%04X\n", i, instrument_set[i]);
    }
 
    // output each instrument set
@@ -89,16 +90,24 @@ void parse_instrument_set(FILE *out, unsigned char *data, split_section *sec)
    for (i = 2*count; sec->start + i < sec->end; i++) {
       unsigned char val = data[sec->start + i];
       if (instrument_set[cur] == i) {
-         fprintf(out, "\ninstrument_set_%02X:\n.byte 0x%02X", cur, val);
+         outbuf_printf(out, "\ninstrument_set_%02X:\n.byte 0x%02X", cur, val);
          cur++;
       } else {
-         fprintf(out, ", 0x%02X", val);
+         outbuf_printf(out, ", 0x%02X", val);
       }
    }
-   fprintf(out, "\ninstrument_sets_end:\n");
+   outbuf_puts(out, "\ninstrument_sets_end:\n");
 }
 
-void parse_sound_banks(FILE *out, unsigned char *data, split_section *secCtl, split_section *secTbl, arg_config *args, strbuf *makeheader)
+// note a .wav written by extract_raw_sound()
+static void record_wav(const char *sound_dir, const char *sfx_file)
+{
+   char wav_file[FILENAME_MAX];
+   sprintf(wav_file, "%s/%s.wav", sound_dir, sfx_file);
+   output_record(wav_file);
+}
+
+void parse_sound_banks(outbuf *out, unsigned char *data, split_section *secCtl, split_section *secTbl, arg_config *args, strbuf *makeheader)
 {
    // TODO: unused parameters
    (void)out;
@@ -123,16 +132,19 @@ void parse_sound_banks(FILE *out, unsigned char *data, split_section *secCtl, sp
         if(sound_banks.banks[i].sounds[j].wav_prev != NULL) {
           sprintf(sfx_file, "Bank%uSound%uPrev", i, j);
           extract_raw_sound(sound_dir, sfx_file, sound_banks.banks[i].sounds[j].wav_prev, sound_banks.banks[i].sounds[j].key_base_prev, sound_data.data[i], 16000);
+          record_wav(sound_dir, sfx_file);
           sound_count++;
        }
         if(sound_banks.banks[i].sounds[j].wav != NULL) {
           sprintf(sfx_file, "Bank%uSound%u", i, j);
           extract_raw_sound(sound_dir, sfx_file, sound_banks.banks[i].sounds[j].wav, sound_banks.banks[i].sounds[j].key_base, sound_data.data[i], 16000);
+          record_wav(sound_dir, sfx_file);
           sound_count++;
        }
         if(sound_banks.banks[i].sounds[j].wav_sec != NULL) {
           sprintf(sfx_file, "Bank%uSound%uSec", i, j);
           extract_raw_sound(sound_dir, sfx_file, sound_banks.banks[i].sounds[j].wav_sec, sound_banks.banks[i].sounds[j].key_base_sec, sound_data.data[i], 16000);
+          record_wav(sound_dir, sfx_file);
           sound_count++;
        }
      }
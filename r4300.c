@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "r4300.h"
+
+// operand syntax of each instruction
+typedef enum
+{
+   F_NONE,       // no operands
+   F_RD_RS_RT,   // add rd, rs, rt
+   F_RD_RT_RS,   // sllv rd, rt, rs
+   F_RD_RT_SA,   // sll rd, rt, sa
+   F_RD_RS,      // move rd, rs
+   F_RD_RT,      // negu rd, rt
+   F_RS_RT,      // mult rs, rt
+   F_ZERO_RS_RT, // div $zero, rs, rt
+   F_RD,         // mfhi rd
+   F_RS,         // jr rs
+   F_JALR,       // jalr rs or jalr rd, rs
+   F_RT_RS_IMM,  // addiu rt, rs, simm
+   F_RT_RS_UIMM, // ori rt, rs, uimm
+   F_RT_UIMM,    // lui rt, uimm
+   F_RT_IMM,     // li rt, imm (decimal)
+   F_RS_IMM,     // tgei rs, simm
+   F_RT_MEM,     // lw rt, offset(rs)
+   F_FT_MEM,     // lwc1 ft, offset(rs)
+   F_CACHE,      // cache op, offset(rs)
+   F_JUMP,       // j target
+   F_RS_RT_BR,   // beq rs, rt, target
+   F_RS_BR,      // bgez rs, target
+   F_BR,         // b target
+   F_CODE,       // syscall [code]
+   F_BREAK,      // break [code1[, code2]]
+   F_RT_C0,      // mfc0 rt, $rd
+   F_RT_FS,      // mfc1 rt, fs
+   F_RT_FCR,     // cfc1 rt, $rd
+   F_FD_FS_FT,   // add.s fd, fs, ft
+   F_FD_FS,      // mov.s fd, fs
+   F_FS_FT,      // c.eq.s fs, ft
+} operand_format;
+
+typedef struct
+{
+   const char *name;
+   unsigned char format;
+   unsigned char flags;
+} insn_info;
+
+static const insn_info info_table[R4300_INS_COUNT] =
+{
+   [R4300_INS_INVALID] = {"invalid", F_NONE,       0},
+   [R4300_INS_LB]      = {"lb",      F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LBU]     = {"lbu",     F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LH]      = {"lh",      F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LHU]     = {"lhu",     F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LW]      = {"lw",      F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LWU]     = {"lwu",     F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LWL]     = {"lwl",     F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LWR]     = {"lwr",     F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LD]      = {"ld",      F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LDL]     = {"ldl",     F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LDR]     = {"ldr",     F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LL]      = {"ll",      F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_LLD]     = {"lld",     F_RT_MEM,     R4300_LOAD},
+   [R4300_INS_SB]      = {"sb",      F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SH]      = {"sh",      F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SW]      = {"sw",      F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SWL]     = {"swl",     F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SWR]     = {"swr",     F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SD]      = {"sd",      F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SDL]     = {"sdl",     F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SDR]     = {"sdr",     F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SC]      = {"sc",      F_RT_MEM,     R4300_STORE},
+   [R4300_INS_SCD]     = {"scd",     F_RT_MEM,     R4300_STORE},
+   [R4300_INS_ADDI]    = {"addi",    F_RT_RS_IMM,  0},
+   [R4300_INS_ADDIU]   = {"addiu",   F_RT_RS_IMM,  0},
+   [R4300_INS_SLTI]    = {"slti",    F_RT_RS_IMM,  0},
+   [R4300_INS_SLTIU]   = {"sltiu",   F_RT_RS_IMM,  0},
+   [R4300_INS_ANDI]    = {"andi",    F_RT_RS_UIMM, 0},
+   [R4300_INS_ORI]     = {"ori",     F_RT_RS_UIMM, 0},
+   [R4300_INS_XORI]    = {"xori",    F_RT_RS_UIMM, 0},
+   [R4300_INS_LUI]     = {"lui",     F_RT_UIMM,    0},
+   [R4300_INS_DADDI]   = {"daddi",   F_RT_RS_IMM,  0},
+   [R4300_INS_DADDIU]  = {"daddiu",  F_RT_RS_IMM,  0},
+   [R4300_INS_ADD]     = {"add",     F_RD_RS_RT,   0},
+   [R4300_INS_ADDU]    = {"addu",    F_RD_RS_RT,   0},
+   [R4300_INS_SUB]     = {"sub",     F_RD_RS_RT,   0},
+   [R4300_INS_SUBU]    = {"subu",    F_RD_RS_RT,   0},
+   [R4300_INS_AND]     = {"and",     F_RD_RS_RT,   0},
+   [R4300_INS_OR]      = {"or",      F_RD_RS_RT,   0},
+   [R4300_INS_XOR]     = {"xor",     F_RD_RS_RT,   0},
+   [R4300_INS_NOR]     = {"nor",     F_RD_RS_RT,   0},
+   [R4300_INS_SLT]     = {"slt",     F_RD_RS_RT,   0},
+   [R4300_INS_SLTU]    = {"sltu",    F_RD_RS_RT,   0},
+   [R4300_INS_DADD]    = {"dadd",    F_RD_RS_RT,   0},
+   [R4300_INS_DADDU]   = {"daddu",   F_RD_RS_RT,   0},
+   [R4300_INS_DSUB]    = {"dsub",    F_RD_RS_RT,   0},
+   [R4300_INS_DSUBU]   = {"dsubu",   F_RD_RS_RT,   0},
+   [R4300_INS_SLL]     = {"sll",     F_RD_RT_SA,   0},
+   [R4300_INS_SRL]     = {"srl",     F_RD_RT_SA,   0},
+   [R4300_INS_SRA]     = {"sra",     F_RD_RT_SA,   0},
+   [R4300_INS_SLLV]    = {"sllv",    F_RD_RT_RS,   0},
+   [R4300_INS_SRLV]    = {"srlv",    F_RD_RT_RS,   0},
+   [R4300_INS_SRAV]    = {"srav",    F_RD_RT_RS,   0},
+   [R4300_INS_DSLL]    = {"dsll",    F_RD_RT_SA,   0},
+   [R4300_INS_DSRL]    = {"dsrl",    F_RD_RT_SA,   0},
+   [R4300_INS_DSRA]    = {"dsra",    F_RD_RT_SA,   0},
+   [R4300_INS_DSLL32]  = {"dsll32",  F_RD_RT_SA,   0},
+   [R4300_INS_DSRL32]  = {"dsrl32",  F_RD_RT_SA,   0},
+   [R4300_INS_DSRA32]  = {"dsra32",  F_RD_RT_SA,   0},
+   [R4300_INS_DSLLV]   = {"dsllv",   F_RD_RT_RS,   0},
+   [R4300_INS_DSRLV]   = {"dsrlv",   F_RD_RT_RS,   0},
+   [R4300_INS_DSRAV]   = {"dsrav",   F_RD_RT_RS,   0},
+   [R4300_INS_MULT]    = {"mult",    F_RS_RT,      0},
+   [R4300_INS_MULTU]   = {"multu",   F_RS_RT,      0},
+   [R4300_INS_DIV]     = {"div",     F_ZERO_RS_RT, 0},
+   [R4300_INS_DIVU]    = {"divu",    F_ZERO_RS_RT, 0},
+   [R4300_INS_DMULT]   = {"dmult",   F_RS_RT,      0},
+   [R4300_INS_DMULTU]  = {"dmultu",  F_RS_RT,      0},
+   [R4300_INS_DDIV]    = {"ddiv",    F_ZERO_RS_RT, 0},
+   [R4300_INS_DDIVU]   = {"ddivu",   F_ZERO_RS_RT, 0},
+   [R4300_INS_MFHI]    = {"mfhi",    F_RD,         0},
+   [R4300_INS_MTHI]    = {"mthi",    F_RS,         0},
+   [R4300_INS_MFLO]    = {"mflo",    F_RD,         0},
+   [R4300_INS_MTLO]    = {"mtlo",    F_RS,         0},
+   [R4300_INS_J]       = {"j",       F_JUMP,       R4300_JUMP},
+   [R4300_INS_JAL]     = {"jal",     F_JUMP,       R4300_JUMP},
+   [R4300_INS_JR]      = {"jr",      F_RS,         R4300_JUMP},
+   [R4300_INS_JALR]    = {"jalr",    F_JALR,       R4300_JUMP},
+   [R4300_INS_BEQ]     = {"beq",     F_RS_RT_BR,   R4300_BRANCH},
+   [R4300_INS_BNE]     = {"bne",     F_RS_RT_BR,   R4300_BRANCH},
+   [R4300_INS_BLEZ]    = {"blez",    F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BGTZ]    = {"bgtz",    F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BEQL]    = {"beql",    F_RS_RT_BR,   R4300_BRANCH},
+   [R4300_INS_BNEL]    = {"bnel",    F_RS_RT_BR,   R4300_BRANCH},
+   [R4300_INS_BLEZL]   = {"blezl",   F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BGTZL]   = {"bgtzl",   F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BLTZ]    = {"bltz",    F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BGEZ]    = {"bgez",    F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BLTZL]   = {"bltzl",   F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BGEZL]   = {"bgezl",   F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BLTZAL]  = {"bltzal",  F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BGEZAL]  = {"bgezal",  F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BLTZALL] = {"bltzall", F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BGEZALL] = {"bgezall", F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_SYSCALL] = {"syscall", F_CODE,       0},
+   [R4300_INS_BREAK]   = {"break",   F_BREAK,      0},
+   [R4300_INS_SYNC]    = {"sync",    F_NONE,       0},
+   [R4300_INS_TGE]     = {"tge",     F_RS_RT,      0},
+   [R4300_INS_TGEU]    = {"tgeu",    F_RS_RT,      0},
+   [R4300_INS_TLT]     = {"tlt",     F_RS_RT,      0},
+   [R4300_INS_TLTU]    = {"tltu",    F_RS_RT,      0},
+   [R4300_INS_TEQ]     = {"teq",     F_RS_RT,      0},
+   [R4300_INS_TNE]     = {"tne",     F_RS_RT,      0},
+   [R4300_INS_TGEI]    = {"tgei",    F_RS_IMM,     0},
+   [R4300_INS_TGEIU]   = {"tgeiu",   F_RS_IMM,     0},
+   [R4300_INS_TLTI]    = {"tlti",    F_RS_IMM,     0},
+   [R4300_INS_TLTIU]   = {"tltiu",   F_RS_IMM,     0},
+   [R4300_INS_TEQI]    = {"teqi",    F_RS_IMM,     0},
+   [R4300_INS_TNEI]    = {"tnei",    F_RS_IMM,     0},
+   [R4300_INS_CACHE]   = {"cache",   F_CACHE,      0},
+   [R4300_INS_MFC0]    = {"mfc0",    F_RT_C0,      0},
+   [R4300_INS_MTC0]    = {"mtc0",    F_RT_C0,      0},
+   [R4300_INS_DMFC0]   = {"dmfc0",   F_RT_C0,      0},
+   [R4300_INS_DMTC0]   = {"dmtc0",   F_RT_C0,      0},
+   [R4300_INS_TLBR]    = {"tlbr",    F_NONE,       0},
+   [R4300_INS_TLBWI]   = {"tlbwi",   F_NONE,       0},
+   [R4300_INS_TLBWR]   = {"tlbwr",   F_NONE,       0},
+   [R4300_INS_TLBP]    = {"tlbp",    F_NONE,       0},
+   [R4300_INS_ERET]    = {"eret",    F_NONE,       0},
+   [R4300_INS_MFC1]    = {"mfc1",    F_RT_FS,      0},
+   [R4300_INS_DMFC1]   = {"dmfc1",   F_RT_FS,      0},
+   [R4300_INS_CFC1]    = {"cfc1",    F_RT_FCR,     0},
+   [R4300_INS_MTC1]    = {"mtc1",    F_RT_FS,      0},
+   [R4300_INS_DMTC1]   = {"dmtc1",   F_RT_FS,      0},
+   [R4300_INS_CTC1]    = {"ctc1",    F_RT_FCR,     0},
+   [R4300_INS_LWC1]    = {"lwc1",    F_FT_MEM,     R4300_LOAD | R4300_FPU},
+   [R4300_INS_LDC1]    = {"ldc1",    F_FT_MEM,     R4300_LOAD | R4300_FPU},
+   [R4300_INS_SWC1]    = {"swc1",    F_FT_MEM,     R4300_STORE | R4300_FPU},
+   [R4300_INS_SDC1]    = {"sdc1",    F_FT_MEM,     R4300_STORE | R4300_FPU},
+   [R4300_INS_BC1F]    = {"bc1f",    F_BR,         R4300_BRANCH},
+   [R4300_INS_BC1T]    = {"bc1t",    F_BR,         R4300_BRANCH},
+   [R4300_INS_BC1FL]   = {"bc1fl",   F_BR,         R4300_BRANCH},
+   [R4300_INS_BC1TL]   = {"bc1tl",   F_BR,         R4300_BRANCH},
+   [R4300_INS_ADD_FMT]     = {"add",     F_FD_FS_FT, R4300_FPU},
+   [R4300_INS_SUB_FMT]     = {"sub",     F_FD_FS_FT, R4300_FPU},
+   [R4300_INS_MUL_FMT]     = {"mul",     F_FD_FS_FT, R4300_FPU},
+   [R4300_INS_DIV_FMT]     = {"div",     F_FD_FS_FT, R4300_FPU},
+   [R4300_INS_SQRT_FMT]    = {"sqrt",    F_FD_FS,    R4300_FPU},
+   [R4300_INS_ABS_FMT]     = {"abs",     F_FD_FS,    R4300_FPU},
+   [R4300_INS_MOV_FMT]     = {"mov",     F_FD_FS,    R4300_FPU},
+   [R4300_INS_NEG_FMT]     = {"neg",     F_FD_FS,    R4300_FPU},
+   [R4300_INS_ROUND_L_FMT] = {"round.l", F_FD_FS,    R4300_FPU},
+   [R4300_INS_TRUNC_L_FMT] = {"trunc.l", F_FD_FS,    R4300_FPU},
+   [R4300_INS_CEIL_L_FMT]  = {"ceil.l",  F_FD_FS,    R4300_FPU},
+   [R4300_INS_FLOOR_L_FMT] = {"floor.l", F_FD_FS,    R4300_FPU},
+   [R4300_INS_ROUND_W_FMT] = {"round.w", F_FD_FS,    R4300_FPU},
+   [R4300_INS_TRUNC_W_FMT] = {"trunc.w", F_FD_FS,    R4300_FPU},
+   [R4300_INS_CEIL_W_FMT]  = {"ceil.w",  F_FD_FS,    R4300_FPU},
+   [R4300_INS_FLOOR_W_FMT] = {"floor.w", F_FD_FS,    R4300_FPU},
+   [R4300_INS_CVT_S_FMT]   = {"cvt.s",   F_FD_FS,    R4300_FPU},
+   [R4300_INS_CVT_D_FMT]   = {"cvt.d",   F_FD_FS,    R4300_FPU},
+   [R4300_INS_CVT_W_FMT]   = {"cvt.w",   F_FD_FS,    R4300_FPU},
+   [R4300_INS_CVT_L_FMT]   = {"cvt.l",   F_FD_FS,    R4300_FPU},
+   [R4300_INS_C_FMT]       = {"c",       F_FS_FT,    R4300_FPU},
+   [R4300_INS_NOP]     = {"nop",     F_NONE,       0},
+   [R4300_INS_MOVE]    = {"move",    F_RD_RS,      0},
+   [R4300_INS_NEGU]    = {"negu",    F_RD_RT,      0},
+   [R4300_INS_NOT]     = {"not",     F_RD_RS,      0},
+   [R4300_INS_B]       = {"b",       F_BR,         R4300_BRANCH},
+   [R4300_INS_BEQZ]    = {"beqz",    F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BNEZ]    = {"bnez",    F_RS_BR,      R4300_BRANCH},
+   [R4300_INS_BAL]     = {"bal",     F_BR,         R4300_BRANCH},
+   [R4300_INS_LI]      = {"li",      F_RT_IMM,     0},
+};
+
+// decode tables, indexed by instruction fields
+static const unsigned char opcode_table[64] =
+{
+   [0x02] = R4300_INS_J,      [0x03] = R4300_INS_JAL,    [0x04] = R4300_INS_BEQ,    [0x05] = R4300_INS_BNE,
+   [0x06] = R4300_INS_BLEZ,   [0x07] = R4300_INS_BGTZ,   [0x08] = R4300_INS_ADDI,   [0x09] = R4300_INS_ADDIU,
+   [0x0A] = R4300_INS_SLTI,   [0x0B] = R4300_INS_SLTIU,  [0x0C] = R4300_INS_ANDI,   [0x0D] = R4300_INS_ORI,
+   [0x0E] = R4300_INS_XORI,   [0x0F] = R4300_INS_LUI,    [0x14] = R4300_INS_BEQL,   [0x15] = R4300_INS_BNEL,
+   [0x16] = R4300_INS_BLEZL,  [0x17] = R4300_INS_BGTZL,  [0x18] = R4300_INS_DADDI,  [0x19] = R4300_INS_DADDIU,
+   [0x1A] = R4300_INS_LDL,    [0x1B] = R4300_INS_LDR,    [0x20] = R4300_INS_LB,     [0x21] = R4300_INS_LH,
+   [0x22] = R4300_INS_LWL,    [0x23] = R4300_INS_LW,     [0x24] = R4300_INS_LBU,    [0x25] = R4300_INS_LHU,
+   [0x26] = R4300_INS_LWR,    [0x27] = R4300_INS_LWU,    [0x28] = R4300_INS_SB,     [0x29] = R4300_INS_SH,
+   [0x2A] = R4300_INS_SWL,    [0x2B] = R4300_INS_SW,     [0x2C] = R4300_INS_SDL,    [0x2D] = R4300_INS_SDR,
+   [0x2E] = R4300_INS_SWR,    [0x2F] = R4300_INS_CACHE,  [0x30] = R4300_INS_LL,     [0x31] = R4300_INS_LWC1,
+   [0x34] = R4300_INS_LLD,    [0x35] = R4300_INS_LDC1,   [0x37] = R4300_INS_LD,     [0x38] = R4300_INS_SC,
+   [0x39] = R4300_INS_SWC1,   [0x3C] = R4300_INS_SCD,    [0x3D] = R4300_INS_SDC1,   [0x3F] = R4300_INS_SD,
+};
+
+static const unsigned char special_table[64] =
+{
+   [0x00] = R4300_INS_SLL,    [0x02] = R4300_INS_SRL,    [0x03] = R4300_INS_SRA,    [0x04] = R4300_INS_SLLV,
+   [0x06] = R4300_INS_SRLV,   [0x07] = R4300_INS_SRAV,   [0x08] = R4300_INS_JR,     [0x09] = R4300_INS_JALR,
+   [0x0C] = R4300_INS_SYSCALL,[0x0D] = R4300_INS_BREAK,  [0x0F] = R4300_INS_SYNC,   [0x10] = R4300_INS_MFHI,
+   [0x11] = R4300_INS_MTHI,   [0x12] = R4300_INS_MFLO,   [0x13] = R4300_INS_MTLO,   [0x14] = R4300_INS_DSLLV,
+   [0x16] = R4300_INS_DSRLV,  [0x17] = R4300_INS_DSRAV,  [0x18] = R4300_INS_MULT,   [0x19] = R4300_INS_MULTU,
+   [0x1A] = R4300_INS_DIV,    [0x1B] = R4300_INS_DIVU,   [0x1C] = R4300_INS_DMULT,  [0x1D] = R4300_INS_DMULTU,
+   [0x1E] = R4300_INS_DDIV,   [0x1F] = R4300_INS_DDIVU,  [0x20] = R4300_INS_ADD,    [0x21] = R4300_INS_ADDU,
+   [0x22] = R4300_INS_SUB,    [0x23] = R4300_INS_SUBU,   [0x24] = R4300_INS_AND,    [0x25] = R4300_INS_OR,
+   [0x26] = R4300_INS_XOR,    [0x27] = R4300_INS_NOR,    [0x2A] = R4300_INS_SLT,    [0x2B] = R4300_INS_SLTU,
+   [0x2C] = R4300_INS_DADD,   [0x2D] = R4300_INS_DADDU,  [0x2E] = R4300_INS_DSUB,   [0x2F] = R4300_INS_DSUBU,
+   [0x30] = R4300_INS_TGE,    [0x31] = R4300_INS_TGEU,   [0x32] = R4300_INS_TLT,    [0x33] = R4300_INS_TLTU,
+   [0x34] = R4300_INS_TEQ,    [0x36] = R4300_INS_TNE,    [0x38] = R4300_INS_DSLL,   [0x3A] = R4300_INS_DSRL,
+   [0x3B] = R4300_INS_DSRA,   [0x3C] = R4300_INS_DSLL32, [0x3E] = R4300_INS_DSRL32, [0x3F] = R4300_INS_DSRA32,
+};
+
+static const unsigned char regimm_table[32] =
+{
+   [0x00] = R4300_INS_BLTZ,   [0x01] = R4300_INS_BGEZ,   [0x02] = R4300_INS_BLTZL,  [0x03] = R4300_INS_BGEZL,
+   [0x08] = R4300_INS_TGEI,   [0x09] = R4300_INS_TGEIU,  [0x0A] = R4300_INS_TLTI,   [0x0B] = R4300_INS_TLTIU,
+   [0x0C] = R4300_INS_TEQI,   [0x0E] = R4300_INS_TNEI,   [0x10] = R4300_INS_BLTZAL, [0x11] = R4300_INS_BGEZAL,
+   [0x12] = R4300_INS_BLTZALL,[0x13] = R4300_INS_BGEZALL,
+};
+
+static const unsigned char cop0_table[32] =
+{
+   [0x00] = R4300_INS_MFC0,   [0x01] = R4300_INS_DMFC0,  [0x04] = R4300_INS_MTC0,   [0x05] = R4300_INS_DMTC0,
+};
+
+static const unsigned char cop0_co_table[64] =
+{
+   [0x01] = R4300_INS_TLBR,   [0x02] = R4300_INS_TLBWI,  [0x06] = R4300_INS_TLBWR,  [0x08] = R4300_INS_TLBP,
+   [0x18] = R4300_INS_ERET,
+};
+
+static const unsigned char cop1_table[32] =
+{
+   [0x00] = R4300_INS_MFC1,   [0x01] = R4300_INS_DMFC1,  [0x02] = R4300_INS_CFC1,   [0x04] = R4300_INS_MTC1,
+   [0x05] = R4300_INS_DMTC1,  [0x06] = R4300_INS_CTC1,
+};
+
+static const unsigned char bc1_table[4] =
+{
+   R4300_INS_BC1F, R4300_INS_BC1T, R4300_INS_BC1FL, R4300_INS_BC1TL,
+};
+
+// COP1 arithmetic for .s and .d formats, .w and .l only allow cvt.s and cvt.d
+static const unsigned char fpu_table[64] =
+{
+   [0x00] = R4300_INS_ADD_FMT,     [0x01] = R4300_INS_SUB_FMT,     [0x02] = R4300_INS_MUL_FMT,     [0x03] = R4300_INS_DIV_FMT,
+   [0x04] = R4300_INS_SQRT_FMT,    [0x05] = R4300_INS_ABS_FMT,     [0x06] = R4300_INS_MOV_FMT,     [0x07] = R4300_INS_NEG_FMT,
+   [0x08] = R4300_INS_ROUND_L_FMT, [0x09] = R4300_INS_TRUNC_L_FMT, [0x0A] = R4300_INS_CEIL_L_FMT,  [0x0B] = R4300_INS_FLOOR_L_FMT,
+   [0x0C] = R4300_INS_ROUND_W_FMT, [0x0D] = R4300_INS_TRUNC_W_FMT, [0x0E] = R4300_INS_CEIL_W_FMT,  [0x0F] = R4300_INS_FLOOR_W_FMT,
+   [0x20] = R4300_INS_CVT_S_FMT,   [0x21] = R4300_INS_CVT_D_FMT,   [0x24] = R4300_INS_CVT_W_FMT,   [0x25] = R4300_INS_CVT_L_FMT,
+   [0x30] = R4300_INS_C_FMT,       [0x31] = R4300_INS_C_FMT,       [0x32] = R4300_INS_C_FMT,       [0x33] = R4300_INS_C_FMT,
+   [0x34] = R4300_INS_C_FMT,       [0x35] = R4300_INS_C_FMT,       [0x36] = R4300_INS_C_FMT,       [0x37] = R4300_INS_C_FMT,
+   [0x38] = R4300_INS_C_FMT,       [0x39] = R4300_INS_C_FMT,       [0x3A] = R4300_INS_C_FMT,       [0x3B] = R4300_INS_C_FMT,
+   [0x3C] = R4300_INS_C_FMT,       [0x3D] = R4300_INS_C_FMT,       [0x3E] = R4300_INS_C_FMT,       [0x3F] = R4300_INS_C_FMT,
+};
+
+#define BREAK_CODE2(insn_) (((insn_)->word >> 6) & 0x3FF)
+
+#define FMT_S 0x10
+#define FMT_D 0x11
+#define FMT_W 0x14
+#define FMT_L 0x15
+
+static const char * const gpr_names[32] =
+{
+   "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+   "t0",   "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+   "s0",   "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+   "t8",   "t9", "k0", "k1", "gp", "sp", "fp", "ra",
+};
+
+static const char * const fpr_names[32] =
+{
+   "f0",  "f1",  "f2",  "f3",  "f4",  "f5",  "f6",  "f7",
+   "f8",  "f9",  "f10", "f11", "f12", "f13", "f14", "f15",
+   "f16", "f17", "f18", "f19", "f20", "f21", "f22", "f23",
+   "f24", "f25", "f26", "f27", "f28", "f29", "f30", "f31",
+};
+
+static const char * const cond_names[16] =
+{
+   "f", "un", "eq", "ueq", "olt", "ult", "ole", "ule",
+   "sf", "ngle", "seq", "ngl", "lt", "nge", "le", "ngt",
+};
+
+// decode COP1 arithmetic instruction, validating the format
+static r4300_id decode_fpu(unsigned int word)
+{
+   unsigned int fmt = (word >> 21) & 0x1F;
+   r4300_id id = fpu_table[word & 0x3F];
+   switch (fmt) {
+      case FMT_S:
+         return (id == R4300_INS_CVT_S_FMT) ? R4300_INS_INVALID : id;
+      case FMT_D:
+         return (id == R4300_INS_CVT_D_FMT) ? R4300_INS_INVALID : id;
+      case FMT_W:
+      case FMT_L:
+         return (id == R4300_INS_CVT_S_FMT || id == R4300_INS_CVT_D_FMT) ? id : R4300_INS_INVALID;
+      default:
+         return R4300_INS_INVALID;
+   }
+}
+
+void r4300_decode(unsigned int word, unsigned int vaddr, r4300_insn *insn)
+{
+   unsigned int rs = (word >> 21) & 0x1F;
+   unsigned int rt = (word >> 16) & 0x1F;
+   r4300_id id;
+
+   switch (word >> 26) {
+      case 0x00: id = special_table[word & 0x3F]; break;
+      case 0x01: id = regimm_table[rt]; break;
+      case 0x10: id = (rs & 0x10) ? cop0_co_table[word & 0x3F] : cop0_table[rs]; break;
+      case 0x11:
+         if (rs == 0x08) {
+            id = bc1_table[rt & 0x3];
+         } else if (rs & 0x10) {
+            id = decode_fpu(word);
+         } else {
+            id = cop1_table[rs];
+         }
+         break;
+      default: id = opcode_table[word >> 26]; break;
+   }
+
+   // aliases
+   switch (id) {
+      case R4300_INS_SLL:
+         if (word == 0) {
+            id = R4300_INS_NOP;
+         }
+         break;
+      case R4300_INS_OR:
+      case R4300_INS_ADDU:
+      case R4300_INS_DADDU:
+         if (rt == R4300_REG_ZERO) {
+            id = R4300_INS_MOVE;
+         }
+         break;
+      case R4300_INS_SUBU:
+         if (rs == R4300_REG_ZERO) {
+            id = R4300_INS_NEGU;
+         }
+         break;
+      case R4300_INS_NOR:
+         if (rt == R4300_REG_ZERO) {
+            id = R4300_INS_NOT;
+         }
+         break;
+      case R4300_INS_BEQ:
+         if (rt == R4300_REG_ZERO) {
+            id = (rs == R4300_REG_ZERO) ? R4300_INS_B : R4300_INS_BEQZ;
+         }
+         break;
+      case R4300_INS_BNE:
+         if (rt == R4300_REG_ZERO) {
+            id = R4300_INS_BNEZ;
+         }
+         break;
+      case R4300_INS_BGEZAL:
+         if (rs == R4300_REG_ZERO) {
+            id = R4300_INS_BAL;
+         }
+         break;
+      default:
+         break;
+   }
+
+   insn->word = word;
+   insn->id = id;
+   insn->flags = info_table[id].flags;
+   insn->pad = 0;
+   switch (info_table[id].format) {
+      case F_RD_RT_SA:
+         insn->imm = (word >> 6) & 0x1F;
+         break;
+      case F_RT_RS_IMM:
+      case F_RS_IMM:
+      case F_RT_MEM:
+      case F_FT_MEM:
+      case F_CACHE:
+         insn->imm = (unsigned int)(int)(short)(word & 0xFFFF);
+         break;
+      case F_RT_RS_UIMM:
+      case F_RT_UIMM:
+         insn->imm = word & 0xFFFF;
+         break;
+      case F_JUMP:
+         insn->imm = ((vaddr + 4) & 0xF0000000) | ((word & 0x03FFFFFF) << 2);
+         break;
+      case F_RS_RT_BR:
+      case F_RS_BR:
+      case F_BR:
+         insn->imm = vaddr + 4 + ((unsigned int)(int)(short)(word & 0xFFFF) << 2);
+         break;
+      case F_CODE:
+         insn->imm = (word >> 6) & 0xFFFFF;
+         break;
+      case F_BREAK:
+         insn->imm = (word >> 16) & 0x3FF;
+         break;
+      default:
+         insn->imm = 0;
+         break;
+   }
+}
+
+const char *r4300_mnemonic(const r4300_insn *insn, char *buf)
+{
+   const char *name = info_table[insn->id].name;
+   if (insn->id >= R4300_INS_ADD_FMT && insn->id <= R4300_INS_C_FMT) {
+      const char *fmt;
+      switch ((insn->word >> 21) & 0x1F) {
+         case FMT_S: fmt = "s"; break;
+         case FMT_D: fmt = "d"; break;
+         case FMT_W: fmt = "w"; break;
+         default:    fmt = "l"; break;
+      }
+      if (insn->id == R4300_INS_C_FMT) {
+         sprintf(buf, "c.%s.%s", cond_names[insn->word & 0xF], fmt);
+      } else {
+         sprintf(buf, "%s.%s", name, fmt);
+      }
+      return buf;
+   }
+   return name;
+}
+
+// print immediate the same way capstone does: small values in decimal, others in hex
+static int print_imm(char *buf, int val)
+{
+#define HEX_THRESHOLD 9
+   if (val >= 0) {
+      return sprintf(buf, val > HEX_THRESHOLD ? "0x%x" : "%u", (unsigned int)val);
+   }
+   return sprintf(buf, val < -HEX_THRESHOLD ? "-0x%x" : "-%u", -(unsigned int)val);
+}
+
+static int print_target(char *buf, unsigned int addr, const char *target)
+{
+   if (target) {
+      return sprintf(buf, "%s", target);
+   }
+   return sprintf(buf, "0x%x", addr);
+}
+
+int r4300_operands(const r4300_insn *insn, char *buf, const char *target)
+{
+   const char *rs = gpr_names[R4300_RS(insn)];
+   const char *rt = gpr_names[R4300_RT(insn)];
+   const char *rd = gpr_names[R4300_RD(insn)];
+   int len = 0;
+   buf[0] = '\0';
+   switch (info_table[insn->id].format) {
+      case F_NONE:
+         break;
+      case F_RD_RS_RT:   len = sprintf(buf, "$%s, $%s, $%s", rd, rs, rt); break;
+      case F_RD_RT_RS:   len = sprintf(buf, "$%s, $%s, $%s", rd, rt, rs); break;
+      case F_RD_RT_SA:
+         len = sprintf(buf, "$%s, $%s, ", rd, rt);
+         len += print_imm(&buf[len], insn->imm);
+         break;
+      case F_RD_RS:      len = sprintf(buf, "$%s, $%s", rd, rs); break;
+      case F_RD_RT:      len = sprintf(buf, "$%s, $%s", rd, rt); break;
+      case F_RS_RT:      len = sprintf(buf, "$%s, $%s", rs, rt); break;
+      case F_ZERO_RS_RT: len = sprintf(buf, "$zero, $%s, $%s", rs, rt); break;
+      case F_RD:         len = sprintf(buf, "$%s", rd); break;
+      case F_RS:         len = sprintf(buf, "$%s", rs); break;
+      case F_JALR:
+         if (R4300_RD(insn) == R4300_REG_RA) {
+            len = sprintf(buf, "$%s", rs);
+         } else {
+            len = sprintf(buf, "$%s, $%s", rd, rs);
+         }
+         break;
+      case F_RT_RS_IMM:
+      case F_RT_RS_UIMM:
+         len = sprintf(buf, "$%s, $%s, ", rt, rs);
+         len += print_imm(&buf[len], insn->imm);
+         break;
+      case F_RT_UIMM:
+         len = sprintf(buf, "$%s, ", rt);
+         len += print_imm(&buf[len], insn->imm);
+         break;
+      case F_RT_IMM:     len = sprintf(buf, "$%s, %d", rt, (int)insn->imm); break;
+      case F_RS_IMM:
+         len = sprintf(buf, "$%s, ", rs);
+         len += print_imm(&buf[len], insn->imm);
+         break;
+      case F_RT_MEM:
+      case F_FT_MEM:
+      case F_CACHE:
+         if (info_table[insn->id].format == F_RT_MEM) {
+            len = sprintf(buf, "$%s, ", rt);
+         } else if (info_table[insn->id].format == F_FT_MEM) {
+            len = sprintf(buf, "$%s, ", fpr_names[R4300_FT(insn)]);
+         } else {
+            len = print_imm(buf, R4300_RT(insn));
+            len += sprintf(&buf[len], ", ");
+         }
+         len += print_imm(&buf[len], insn->imm);
+         len += sprintf(&buf[len], "($%s)", rs);
+         break;
+      case F_JUMP:
+      case F_BR:
+         len = print_target(buf, insn->imm, target);
+         break;
+      case F_RS_RT_BR:
+         len = sprintf(buf, "$%s, $%s, ", rs, rt);
+         len += print_target(&buf[len], insn->imm, target);
+         break;
+      case F_RS_BR:
+         len = sprintf(buf, "$%s, ", rs);
+         len += print_target(&buf[len], insn->imm, target);
+         break;
+      case F_CODE:
+         if (insn->imm) {
+            len = print_imm(buf, insn->imm);
+         }
+         break;
+      case F_BREAK:
+         if (insn->imm || BREAK_CODE2(insn)) {
+            len = print_imm(buf, insn->imm);
+         }
+         if (BREAK_CODE2(insn)) {
+            len += sprintf(&buf[len], ", ");
+            len += print_imm(&buf[len], BREAK_CODE2(insn));
+         }
+         break;
+      case F_RT_C0:
+      case F_RT_FCR:
+         len = sprintf(buf, "$%s, $%d", rt, R4300_RD(insn));
+         break;
+      case F_RT_FS:      len = sprintf(buf, "$%s, $%s", rt, fpr_names[R4300_FS(insn)]); break;
+      case F_FD_FS_FT:
+         len = sprintf(buf, "$%s, $%s, $%s", fpr_names[R4300_FD(insn)], fpr_names[R4300_FS(insn)], fpr_names[R4300_FT(insn)]);
+         break;
+      case F_FD_FS:      len = sprintf(buf, "$%s, $%s", fpr_names[R4300_FD(insn)], fpr_names[R4300_FS(insn)]); break;
+      case F_FS_FT:      len = sprintf(buf, "$%s, $%s", fpr_names[R4300_FS(insn)], fpr_names[R4300_FT(insn)]); break;
+   }
+   return len;
+}
+
+const char *r4300_gpr_name(unsigned int reg)
+{
+   return gpr_names[reg & 0x1F];
+}
+
+const char *r4300_fpr_name(unsigned int reg)
+{
+   return fpr_names[reg & 0x1F];
+}
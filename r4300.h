@@ -0,0 +1,122 @@
+#ifndef R4300_H_
+#define R4300_H_
+
+// instruction ids
+// aliases (NOP, MOVE, B, ...) are decoded as their own ids to match the text that is emitted
+typedef enum
+{
+   R4300_INS_INVALID,
+   // CPU load/store
+   R4300_INS_LB, R4300_INS_LBU, R4300_INS_LH, R4300_INS_LHU, R4300_INS_LW, R4300_INS_LWU,
+   R4300_INS_LWL, R4300_INS_LWR, R4300_INS_LD, R4300_INS_LDL, R4300_INS_LDR, R4300_INS_LL,
+   R4300_INS_LLD, R4300_INS_SB, R4300_INS_SH, R4300_INS_SW, R4300_INS_SWL, R4300_INS_SWR,
+   R4300_INS_SD, R4300_INS_SDL, R4300_INS_SDR, R4300_INS_SC, R4300_INS_SCD,
+   // CPU immediate arithmetic
+   R4300_INS_ADDI, R4300_INS_ADDIU, R4300_INS_SLTI, R4300_INS_SLTIU, R4300_INS_ANDI,
+   R4300_INS_ORI, R4300_INS_XORI, R4300_INS_LUI, R4300_INS_DADDI, R4300_INS_DADDIU,
+   // CPU register arithmetic
+   R4300_INS_ADD, R4300_INS_ADDU, R4300_INS_SUB, R4300_INS_SUBU, R4300_INS_AND, R4300_INS_OR,
+   R4300_INS_XOR, R4300_INS_NOR, R4300_INS_SLT, R4300_INS_SLTU, R4300_INS_DADD, R4300_INS_DADDU,
+   R4300_INS_DSUB, R4300_INS_DSUBU,
+   // shifts
+   R4300_INS_SLL, R4300_INS_SRL, R4300_INS_SRA, R4300_INS_SLLV, R4300_INS_SRLV, R4300_INS_SRAV,
+   R4300_INS_DSLL, R4300_INS_DSRL, R4300_INS_DSRA, R4300_INS_DSLL32, R4300_INS_DSRL32,
+   R4300_INS_DSRA32, R4300_INS_DSLLV, R4300_INS_DSRLV, R4300_INS_DSRAV,
+   // multiply/divide
+   R4300_INS_MULT, R4300_INS_MULTU, R4300_INS_DIV, R4300_INS_DIVU, R4300_INS_DMULT,
+   R4300_INS_DMULTU, R4300_INS_DDIV, R4300_INS_DDIVU, R4300_INS_MFHI, R4300_INS_MTHI,
+   R4300_INS_MFLO, R4300_INS_MTLO,
+   // jumps and branches
+   R4300_INS_J, R4300_INS_JAL, R4300_INS_JR, R4300_INS_JALR, R4300_INS_BEQ, R4300_INS_BNE,
+   R4300_INS_BLEZ, R4300_INS_BGTZ, R4300_INS_BEQL, R4300_INS_BNEL, R4300_INS_BLEZL,
+   R4300_INS_BGTZL, R4300_INS_BLTZ, R4300_INS_BGEZ, R4300_INS_BLTZL, R4300_INS_BGEZL,
+   R4300_INS_BLTZAL, R4300_INS_BGEZAL, R4300_INS_BLTZALL, R4300_INS_BGEZALL,
+   // exceptions and traps
+   R4300_INS_SYSCALL, R4300_INS_BREAK, R4300_INS_SYNC, R4300_INS_TGE, R4300_INS_TGEU,
+   R4300_INS_TLT, R4300_INS_TLTU, R4300_INS_TEQ, R4300_INS_TNE, R4300_INS_TGEI, R4300_INS_TGEIU,
+   R4300_INS_TLTI, R4300_INS_TLTIU, R4300_INS_TEQI, R4300_INS_TNEI, R4300_INS_CACHE,
+   // COP0
+   R4300_INS_MFC0, R4300_INS_MTC0, R4300_INS_DMFC0, R4300_INS_DMTC0, R4300_INS_TLBR,
+   R4300_INS_TLBWI, R4300_INS_TLBWR, R4300_INS_TLBP, R4300_INS_ERET,
+   // COP1 moves, load/store and branches
+   R4300_INS_MFC1, R4300_INS_DMFC1, R4300_INS_CFC1, R4300_INS_MTC1, R4300_INS_DMTC1,
+   R4300_INS_CTC1, R4300_INS_LWC1, R4300_INS_LDC1, R4300_INS_SWC1, R4300_INS_SDC1,
+   R4300_INS_BC1F, R4300_INS_BC1T, R4300_INS_BC1FL, R4300_INS_BC1TL,
+   // COP1 arithmetic, format (.s/.d/.w/.l) comes from the instruction word
+   R4300_INS_ADD_FMT, R4300_INS_SUB_FMT, R4300_INS_MUL_FMT, R4300_INS_DIV_FMT,
+   R4300_INS_SQRT_FMT, R4300_INS_ABS_FMT, R4300_INS_MOV_FMT, R4300_INS_NEG_FMT,
+   R4300_INS_ROUND_L_FMT, R4300_INS_TRUNC_L_FMT, R4300_INS_CEIL_L_FMT, R4300_INS_FLOOR_L_FMT,
+   R4300_INS_ROUND_W_FMT, R4300_INS_TRUNC_W_FMT, R4300_INS_CEIL_W_FMT, R4300_INS_FLOOR_W_FMT,
+   R4300_INS_CVT_S_FMT, R4300_INS_CVT_D_FMT, R4300_INS_CVT_W_FMT, R4300_INS_CVT_L_FMT,
+   R4300_INS_C_FMT, // c.cond.fmt, condition from the instruction word
+   // aliases
+   R4300_INS_NOP,  // sll $zero, $zero, 0
+   R4300_INS_MOVE, // or/addu/daddu rd, rs, $zero
+   R4300_INS_NEGU, // subu rd, $zero, rt
+   R4300_INS_NOT,  // nor rd, rs, $zero
+   R4300_INS_B,    // beq $zero, $zero
+   R4300_INS_BEQZ, // beq rs, $zero
+   R4300_INS_BNEZ, // bne rs, $zero
+   R4300_INS_BAL,  // bgezal $zero
+   // pseudoinstructions only produced by the disassembler
+   R4300_INS_LI,
+   R4300_INS_COUNT
+} r4300_id;
+
+// instruction flags
+#define R4300_JUMP   0x01 // J, JAL, JR, JALR
+#define R4300_BRANCH 0x02 // PC-relative branch, target in 'imm'
+#define R4300_LOAD   0x04 // memory load, offset in 'imm'
+#define R4300_STORE  0x08 // memory store, offset in 'imm'
+#define R4300_FPU    0x10 // rt/ft or destination operand is a floating point register
+
+// decoded instruction, text is only generated on request
+typedef struct
+{
+   unsigned int word;   // raw instruction word
+   unsigned int imm;    // immediate (extended as the instruction uses it), shift amount, or jump/branch target
+   unsigned short id;   // r4300_id
+   unsigned char flags; // R4300_* flags
+   unsigned char pad;
+} r4300_insn;
+
+// register fields of a raw instruction word
+#define R4300_WORD_RS(word_) (((word_) >> 21) & 0x1F)
+#define R4300_WORD_RT(word_) (((word_) >> 16) & 0x1F)
+#define R4300_WORD_RD(word_) (((word_) >> 11) & 0x1F)
+#define R4300_WORD_SA(word_) (((word_) >>  6) & 0x1F)
+
+// register fields of a decoded instruction
+#define R4300_RS(insn_) R4300_WORD_RS((insn_)->word)
+#define R4300_RT(insn_) R4300_WORD_RT((insn_)->word)
+#define R4300_RD(insn_) R4300_WORD_RD((insn_)->word)
+#define R4300_SA(insn_) R4300_WORD_SA((insn_)->word)
+#define R4300_FS(insn_) R4300_RD(insn_)
+#define R4300_FT(insn_) R4300_RT(insn_)
+#define R4300_FD(insn_) R4300_SA(insn_)
+
+#define R4300_REG_ZERO 0
+#define R4300_REG_RA   31
+
+// decode a single instruction
+// word: instruction word (big-endian value read from ROM)
+// vaddr: virtual address of the instruction, used to compute jump and branch targets
+// insn: decoded instruction output
+void r4300_decode(unsigned int word, unsigned int vaddr, r4300_insn *insn);
+
+// get instruction mnemonic
+// buf: buffer of at least 16 bytes, used for mnemonics that depend on the instruction format
+// returns mnemonic string, which may be 'buf'
+const char *r4300_mnemonic(const r4300_insn *insn, char *buf);
+
+// format instruction operands
+// buf: buffer of at least 64 bytes plus length of 'target'
+// target: text to use for jump/branch target, or NULL to print the address
+// returns length of operand string written to 'buf'
+int r4300_operands(const r4300_insn *insn, char *buf, const char *target);
+
+// general purpose and floating point register names without '$'
+const char *r4300_gpr_name(unsigned int reg);
+const char *r4300_fpr_name(unsigned int reg);
+
+#endif // R4300_H_
@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +10,7 @@
 #define SM64COMPRESS_VERSION "0.2a"
 
 #define MAX_REFS 64
+#define EXT_ROM_OFFSET 0x800000
 
 typedef struct
 {
@@ -26,6 +28,10 @@ typedef struct
    block_ref refs[MAX_REFS];  // references to this block
    int          ref_count;    // number of references
    char         compressible; // if block is not currenlty, but potentially compressible
+   unsigned char *cmp;        // MIO0 compressed data, NULL if block is copied as-is
+   int          cmp_len;      // length of compressed data
+   int          raw_len;      // length of data before compression
+   int          greedy_len;   // length of greedy compressed data, for reporting savings
    enum {
       BLOCK_LEVEL,
       BLOCK_MIO0,
@@ -42,6 +48,8 @@ typedef struct
    char dump;
    char fix_f3d;
    char fix_geo;
+   mio0_encode_mode mode;
+   int threads;
 } compress_config;
 
 // default configuration
@@ -54,11 +62,13 @@ static const compress_config default_config =
    0,    // dump
    0,    // f3d
    0,    // geo
+   MIO0_ENCODE_EXACT, // MIO0 compression mode
+   0,    // threads: number of processors
 };
 
 static void print_usage(void)
 {
-   ERROR("Usage: sm64compress [-a ALIGNMENT] [-c] [-d] [-f] [-g] [-v] FILE [OUT_FILE]\n"
+   ERROR("Usage: sm64compress [-a ALIGNMENT] [-c] [-d] [-f] [-g] [-j THREADS] [-p] [-v] FILE [OUT_FILE]\n"
          "\n"
          "sm64compress v" SM64COMPRESS_VERSION ": Super Mario 64 ROM compressor and fixer\n"
          "\n"
@@ -68,6 +78,8 @@ static void print_usage(void)
          " -d           dump blocks to 'dump' directory\n"
          " -f           fix F3D combine blending parameters\n"
          " -g           fix geo layout display list layers\n"
+         " -j THREADS   number of compression threads (default: number of processors)\n"
+         " -p           use optimal parse MIO0 compression: smaller, slower, reports savings\n"
          " -v           verbose progress output\n"
          "\n"
          "File arguments:\n"
@@ -111,6 +123,15 @@ static void parse_arguments(int argc, char *argv[], compress_config *config)
             case 'g':
                config->fix_geo = 1;
                break;
+            case 'j':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->threads = strtoul(argv[i], NULL, 0);
+               break;
+            case 'p':
+               config->mode = MIO0_ENCODE_OPTIMAL;
+               break;
             case 'v':
                g_verbosity = 1;
                break;
@@ -333,6 +354,97 @@ static void fix_geo(unsigned char *buf, int len)
    }
 }
 
+// compress a block using the configured MIO0 mode
+// greedy_len: returned greedy compressed size so optimal parse savings can be reported
+// returns compressed length in out
+static int compress_block(const compress_config *config, const unsigned char *in, int length, unsigned char *out, int *greedy_len)
+{
+   *greedy_len = mio0_encode(in, length, out, MIO0_ENCODE_EXACT);
+   if (config->mode == MIO0_ENCODE_EXACT) {
+      return *greedy_len;
+   }
+   return mio0_encode(in, length, out, config->mode);
+}
+
+typedef struct
+{
+   const compress_config *config;
+   const unsigned char *in_buf;
+   block *blocks;
+   int block_count;
+   int next;             // next block index to be claimed by a worker
+   pthread_mutex_t lock;
+} compress_queue;
+
+// worker thread: claims blocks in turn and stores compressed data in each block
+// every block is written by one worker only so results do not depend on scheduling
+static void *compress_worker(void *arg)
+{
+   compress_queue *queue = arg;
+   const compress_config *config = queue->config;
+   // scratch buffers are per thread
+   unsigned char *tmp_raw = malloc(512*KB);
+   unsigned char *tmp_cmp = malloc(512*KB);
+   for (;;) {
+      int i;
+      pthread_mutex_lock(&queue->lock);
+      i = queue->next++;
+      pthread_mutex_unlock(&queue->lock);
+      if (i >= queue->block_count) {
+         break;
+      }
+      block *blk = &queue->blocks[i];
+      int block_len = blk->old_end - blk->old;
+      // only extended data is relocated
+      if (blk->old < EXT_ROM_OFFSET) {
+         continue;
+      }
+      if (blk->type == BLOCK_MIO0) {
+         // decompress to remove fake header and recompress
+         blk->raw_len = mio0_decode(&queue->in_buf[blk->old], tmp_raw, NULL);
+         blk->cmp_len = compress_block(config, tmp_raw, blk->raw_len, tmp_cmp, &blk->greedy_len);
+      } else if (blk->compressible) {
+         // compress blocks that don't have a fake header and are compressible
+         blk->raw_len = block_len;
+         blk->cmp_len = compress_block(config, &queue->in_buf[blk->old], block_len, tmp_cmp, &blk->greedy_len);
+      } else {
+         continue;
+      }
+      blk->cmp = malloc(blk->cmp_len);
+      memcpy(blk->cmp, tmp_cmp, blk->cmp_len);
+   }
+   free(tmp_raw);
+   free(tmp_cmp);
+   return NULL;
+}
+
+// compress all relocatable blocks using a pool of worker threads
+static void compress_blocks(const compress_config *config, const unsigned char *in_buf, block *blocks, int block_count)
+{
+   compress_queue queue;
+   pthread_t *threads;
+   int thread_count = config->threads > 0 ? config->threads : cpu_count();
+
+   queue.config = config;
+   queue.in_buf = in_buf;
+   queue.blocks = blocks;
+   queue.block_count = block_count;
+   queue.next = 0;
+   pthread_mutex_init(&queue.lock, NULL);
+
+   thread_count = MIN(thread_count, block_count);
+   threads = malloc(thread_count * sizeof(*threads));
+   for (int t = 0; t < thread_count; t++) {
+      pthread_create(&threads[t], NULL, compress_worker, &queue);
+   }
+   for (int t = 0; t < thread_count; t++) {
+      pthread_join(threads[t], NULL);
+   }
+
+   free(threads);
+   pthread_mutex_destroy(&queue.lock);
+}
+
 // find and compact/compress all MIO0 blocks
 // config: configuration to determine alignment and compression
 // in_buf: buffer containing entire contents of SM64 data in big endian
@@ -349,8 +461,8 @@ static int sm64_compress_mio0(const compress_config *config,
 #define SEGMENT2_ROM_OFFSET 0x800000
 #define SEGMENT2_ROM_END    0x81BB64
    block block_table[MAX_BLOCKS];
-   unsigned char *tmp_raw = NULL;
-   unsigned char *tmp_cmp = NULL;
+   int greedy_total = 0;
+   int cmp_total = 0;
    int block_count = 0;
    int out_length;
    int cur_offset;
@@ -386,13 +498,27 @@ static int sm64_compress_mio0(const compress_config *config,
    }
 #endif
 
-   // allocate 1MB buffer for MIO0 compression
+   // implement fixes
+   // TODO: this is liberally applied to all data
+   // TODO: this assumes fake MIO0 headers
+   for (int i = 0; i < block_count; i++) {
+      block *blk = &block_table[i];
+      if (blk->old >= EXT_ROM_OFFSET) {
+         int block_len = blk->old_end - blk->old;
+         if (config->fix_f3d) {
+            fix_f3d(&in_buf[blk->old], block_len);
+         }
+         if (config->fix_geo) {
+            fix_geo(&in_buf[blk->old], block_len);
+         }
+      }
+   }
+
+   // blocks are independent, so compress them all in parallel before layout
    if (config->compress) {
-      tmp_raw = malloc(512*KB);
-      tmp_cmp = malloc(512*KB);
+      compress_blocks(config, in_buf, block_table, block_count);
    }
 
-#define EXT_ROM_OFFSET 0x800000
    cur_offset = EXT_ROM_OFFSET;
    for (int i = 0; i < block_count; i++) {
       block *blk = &block_table[i];
@@ -404,28 +530,18 @@ static int sm64_compress_mio0(const compress_config *config,
          unsigned char *src;
          int src_len;
          int block_len = blk->old_end - blk->old;
-         // implement fixes
-         // TODO: this is liberally applied to all data
-         // TODO: this assumes fake MIO0 headers
-         if (config->fix_f3d) {
-            fix_f3d(&in_buf[blk->old], block_len);
-         }
-         if (config->fix_geo) {
-            fix_geo(&in_buf[blk->old], block_len);
-         }
-         if (config->compress && blk->type == BLOCK_MIO0) {
-            // decompress to remove fake header and recompress
-            int raw_len = mio0_decode(&in_buf[blk->old], tmp_raw, NULL);
-            int cmp_len = mio0_encode(tmp_raw, raw_len, tmp_cmp);
-            src = tmp_cmp;
-            src_len = cmp_len;
-            INFO("Compressed %08X[%06X=%06X] => %08X[%06X]\n", blk->old, block_len, raw_len, cur_offset, cmp_len);
-         } else if(config->compress && blk->compressible) {
-            // compress blocks that don't have a fake header and are compressible
-            int cmp_len = mio0_encode(&in_buf[blk->old], block_len, tmp_cmp);
-            src = tmp_cmp;
-            src_len = cmp_len;
-            INFO("Compressed %08X[%06X] => %08X[%06X]\n", blk->old, block_len, cur_offset, cmp_len);
+         if (blk->cmp && blk->type == BLOCK_MIO0) {
+            src = blk->cmp;
+            src_len = blk->cmp_len;
+            greedy_total += blk->greedy_len;
+            cmp_total += blk->cmp_len;
+            INFO("Compressed %08X[%06X=%06X] => %08X[%06X]\n", blk->old, block_len, blk->raw_len, cur_offset, blk->cmp_len);
+         } else if (blk->cmp) {
+            src = blk->cmp;
+            src_len = blk->cmp_len;
+            greedy_total += blk->greedy_len;
+            cmp_total += blk->cmp_len;
+            INFO("Compressed %08X[%06X] => %08X[%06X]\n", blk->old, block_len, cur_offset, blk->cmp_len);
             for (int r = 0; r < blk->ref_count; r++) {
                if (blk->refs[r].type == 0x17) {
                   blk->refs[r].type = 0x18;
@@ -449,6 +565,10 @@ static int sm64_compress_mio0(const compress_config *config,
       }
    }
 
+   if (config->compress && config->mode != MIO0_ENCODE_EXACT) {
+      printf("MIO0 greedy: %d bytes, optimal: %d bytes (%+d)\n", greedy_total, cmp_total, cmp_total - greedy_total);
+   }
+
    // update references
    for (int i = 0; i < block_count; i++) {
       block *blk = &block_table[i];
@@ -570,9 +690,10 @@ static int sm64_compress_mio0(const compress_config *config,
       }
    }
 
-   if (tmp_raw != NULL) {
-      free(tmp_raw);
-      free(tmp_cmp);
+   for (int i = 0; i < block_count; i++) {
+      if (block_table[i].cmp != NULL) {
+         free(block_table[i].cmp);
+      }
    }
 
    // align output length to nearest MB
@@ -601,7 +722,7 @@ int main(int argc, char *argv[])
    }
 
    // read input file into memory
-   in_size = read_file(config.in_filename, &in_buf);
+   in_size = map_file(config.in_filename, &in_buf);
    if (in_size <= 0) {
       ERROR("Error reading input file \"%s\"\n", config.in_filename);
       exit(1);
@@ -618,9 +739,10 @@ int main(int argc, char *argv[])
 
    // compact the SM64 blocks and adjust pointers
    out_size = sm64_compress_mio0(&config, in_buf, in_size, out_buf);
+   unmap_file(in_buf, in_size);
 
    // update N64 header CRC
-   sm64_update_checksums(out_buf);
+   sm64_update_checksums(out_buf, CIC_6102);
 
    // write to output file
    bytes_written = write_file(config.out_filename, out_buf, out_size);
@@ -5,7 +5,7 @@
 #include "libsm64.h"
 #include "utils.h"
 
-#define SM64EXTEND_VERSION "0.3.2"
+#define SM64EXTEND_VERSION "0.4"
 
 // default configuration
 static const sm64_config default_config =
@@ -17,11 +17,12 @@ static const sm64_config default_config =
    1,    // MIO0 alignment
    0,    // fill old MIO0 blocks
    0,    // dump MIO0 blocks to files
+   0,    // threads: number of processors
 };
 
 static void print_usage(void)
 {
-   ERROR("Usage: sm64extend [-a ALIGNMENT] [-p PADDING] [-s SIZE] [-d] [-f] [-v] FILE [OUT_FILE]\n"
+   ERROR("Usage: sm64extend [-a ALIGNMENT] [-p PADDING] [-s SIZE] [-d] [-f] [-j THREADS] [-v] FILE [OUT_FILE]\n"
          "\n"
          "sm64extend v" SM64EXTEND_VERSION ": Super Mario 64 ROM extender\n"
          "Supports (E), (J), (U), Shindou, and iQue ROMs in .n64, .v64, or .z64 formats\n"
@@ -32,6 +33,7 @@ static void print_usage(void)
          " -s SIZE      size of the extended ROM in MB (default: %d)\n"
          " -d           dump MIO0 blocks to files in 'mio0files' directory\n"
          " -f           fill old MIO0 blocks with 0x01\n"
+         " -j THREADS   number of threads used to decode MIO0 blocks (default: number of processors)\n"
          " -v           verbose progress output\n"
          "\n"
          "File arguments:\n"
@@ -64,6 +66,12 @@ static void parse_arguments(int argc, char *argv[], sm64_config *config)
             case 'f':
                config->fill = 1;
                break;
+            case 'j':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->threads = strtoul(argv[i], NULL, 0);
+               break;
             case 'p':
                if (++i >= argc) {
                   print_usage();
@@ -142,7 +150,7 @@ int main(int argc, char *argv[])
    }
 
    // read input file into memory
-   in_size = read_file(config.in_filename, &in_buf);
+   in_size = map_file(config.in_filename, &in_buf);
    if (in_size <= 0) {
       ERROR("Error reading input file \"%s\"\n", config.in_filename);
       exit(EXIT_FAILURE);
@@ -188,9 +196,10 @@ int main(int argc, char *argv[])
 
    // decode SM64 MIO0 files and adjust pointers
    sm64_decompress_mio0(&config, in_buf, in_size, out_buf);
+   unmap_file(in_buf, in_size);
 
    // update N64 header CRC
-   sm64_update_checksums(out_buf);
+   sm64_update_checksums(out_buf, CIC_6102);
 
    // write to output file
    bytes_written = write_file(config.ext_filename, out_buf, config.ext_size);
@@ -191,7 +191,7 @@ int main(int argc, char *argv[])
    }
 
    // operation
-   size = read_file(config.in_filename, &data);
+   size = map_file(config.in_filename, &data);
    if (size < 0) {
       perror("Error opening input file");
       return EXIT_FAILURE;
@@ -210,7 +210,7 @@ int main(int argc, char *argv[])
       config.length = size - config.offset;
    }
    print_geo(fout, data, config.offset, config.length);
-   free(data);
+   unmap_file(data, size);
 
    if (fout != stdout) {
       fclose(fout);
@@ -260,7 +260,7 @@ int main(int argc, char *argv[])
    parse_arguments(argc, argv, &offset, &region, in_filename);
 
    // read input file into memory
-   in_size = read_file(in_filename, &in_buf);
+   in_size = map_file(in_filename, &in_buf);
    if (in_size <= 0) {
       ERROR("Error reading input file \"%s\"\n", in_filename);
       exit(EXIT_FAILURE);
@@ -288,7 +288,7 @@ int main(int argc, char *argv[])
    walk_scripts(in_buf, offset);
 
    // cleanup
-   free(in_buf);
+   unmap_file(in_buf, in_size);
 
    return EXIT_SUCCESS;
 }
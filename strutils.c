@@ -4,9 +4,7 @@
 #include <string.h>
 
 #include "strutils.h"
-
-// buffer for local sprintf
-static char tmpbuf[4096];
+#include "utils.h"
 
 void strbuf_alloc(strbuf *sbuf, size_t allocate)
 {
@@ -15,6 +13,7 @@ void strbuf_alloc(strbuf *sbuf, size_t allocate)
       allocate = 512;
    }
    sbuf->buf = malloc(allocate);
+   sbuf->buf[0] = '\0';
    sbuf->allocated = allocate;
    sbuf->index = 0;
 }
@@ -23,15 +22,23 @@ void strbuf_sprintf(strbuf *sbuf, const char *format, ...)
 {
    va_list args;
 
+   // format in place so separate strbufs can be used from separate threads
    va_start(args, format);
-   int len = vsprintf(tmpbuf, format, args);
+   int len = vsnprintf(&sbuf->buf[sbuf->index], sbuf->allocated - sbuf->index, format, args);
    va_end(args);
 
-   while (sbuf->allocated <= sbuf->index + len) {
-      sbuf->allocated *= 2;
+   if (len < 0) {
+      return;
+   }
+   if (sbuf->allocated <= sbuf->index + len) {
+      while (sbuf->allocated <= sbuf->index + len) {
+         sbuf->allocated *= 2;
+      }
       sbuf->buf = realloc(sbuf->buf, sbuf->allocated);
+      va_start(args, format);
+      vsnprintf(&sbuf->buf[sbuf->index], sbuf->allocated - sbuf->index, format, args);
+      va_end(args);
    }
-   memcpy(&sbuf->buf[sbuf->index], tmpbuf, len + 1);
    sbuf->index += len;
 }
 
@@ -42,3 +49,225 @@ void strbuf_free(strbuf *sbuf)
       sbuf->allocated = 0;
    }
 }
+
+// flush threshold for file buffers
+#define OUTBUF_FILE_SIZE (256 * 1024)
+
+static outbuf *outbuf_new(FILE *fp, int owns_fp, size_t allocate)
+{
+   outbuf *ob = malloc(sizeof(*ob));
+   ob->buf = malloc(allocate);
+   ob->allocated = allocate;
+   ob->index = 0;
+   ob->fp = fp;
+   ob->owns_fp = owns_fp;
+   ob->filename = NULL;
+   return ob;
+}
+
+outbuf *outbuf_fopen(const char *filename)
+{
+   FILE *fp = fopen(filename, "w");
+   if (fp == NULL) {
+      return NULL;
+   }
+   return outbuf_new(fp, 1, OUTBUF_FILE_SIZE);
+}
+
+outbuf *outbuf_fopen_update(const char *filename)
+{
+   outbuf *ob = outbuf_new(NULL, 0, 4096);
+   ob->filename = strdup(filename);
+   return ob;
+}
+
+outbuf *outbuf_wrap(FILE *fp)
+{
+   return outbuf_new(fp, 0, OUTBUF_FILE_SIZE);
+}
+
+outbuf *outbuf_mem(size_t allocate)
+{
+   // some sane default allocation
+   if (allocate <= 0) {
+      allocate = 4096;
+   }
+   return outbuf_new(NULL, 0, allocate);
+}
+
+void outbuf_flush(outbuf *ob)
+{
+   if (ob->fp && ob->index > 0) {
+      fwrite(ob->buf, 1, ob->index, ob->fp);
+      ob->index = 0;
+   }
+}
+
+// compare buffered contents against existing file
+static int outbuf_matches_file(const outbuf *ob)
+{
+   unsigned char *contents;
+   long len;
+   int match = 0;
+   if (filesize(ob->filename) != (long)ob->index) {
+      return 0;
+   }
+   len = read_file(ob->filename, &contents);
+   if (len >= 0) {
+      match = ((size_t)len == ob->index && 0 == memcmp(contents, ob->buf, len));
+      free(contents);
+   }
+   return match;
+}
+
+int outbuf_close(outbuf *ob)
+{
+   int ret = 0;
+   if (ob) {
+      outbuf_flush(ob);
+      if (ob->owns_fp) {
+         fclose(ob->fp);
+      }
+      if (ob->filename) {
+         if (!outbuf_matches_file(ob)) {
+            if (write_file(ob->filename, (unsigned char *)ob->buf, ob->index) < 0) {
+               ret = -1;
+            }
+         }
+         free(ob->filename);
+      }
+      free(ob->buf);
+      free(ob);
+   }
+   return ret;
+}
+
+// make room for 'len' more bytes, flushing files or growing memory buffers
+static void outbuf_reserve(outbuf *ob, size_t len)
+{
+   if (ob->index + len <= ob->allocated) {
+      return;
+   }
+   outbuf_flush(ob);
+   while (ob->index + len > ob->allocated) {
+      ob->allocated *= 2;
+   }
+   ob->buf = realloc(ob->buf, ob->allocated);
+}
+
+void outbuf_write(outbuf *ob, const void *data, size_t len)
+{
+   // large blocks bypass the file buffer
+   if (ob->fp && len >= ob->allocated) {
+      outbuf_flush(ob);
+      fwrite(data, 1, len, ob->fp);
+      return;
+   }
+   outbuf_reserve(ob, len);
+   memcpy(&ob->buf[ob->index], data, len);
+   ob->index += len;
+}
+
+void outbuf_puts(outbuf *ob, const char *str)
+{
+   outbuf_write(ob, str, strlen(str));
+}
+
+void outbuf_putc(outbuf *ob, char c)
+{
+   outbuf_reserve(ob, 1);
+   ob->buf[ob->index++] = c;
+}
+
+void outbuf_puts_pad(outbuf *ob, const char *str, int width)
+{
+   size_t len = strlen(str);
+   outbuf_write(ob, str, len);
+   if ((int)len < width) {
+      outbuf_reserve(ob, width - len);
+      memset(&ob->buf[ob->index], ' ', width - len);
+      ob->index += width - len;
+   }
+}
+
+void outbuf_printf(outbuf *ob, const char *format, ...)
+{
+   va_list args;
+   int len;
+
+   va_start(args, format);
+   len = vsnprintf(&ob->buf[ob->index], ob->allocated - ob->index, format, args);
+   va_end(args);
+
+   if (len >= 0 && ob->index + len >= ob->allocated) {
+      // didn't fit including terminator: make room and format again
+      outbuf_reserve(ob, len + 1);
+      va_start(args, format);
+      vsnprintf(&ob->buf[ob->index], ob->allocated - ob->index, format, args);
+      va_end(args);
+   }
+   if (len > 0) {
+      ob->index += len;
+   }
+}
+
+void outbuf_hex(outbuf *ob, unsigned int val, int digits)
+{
+   static const char hex[] = "0123456789ABCDEF";
+   int needed = 1;
+   while (needed < 8 && (val >> (4 * needed))) {
+      needed++;
+   }
+   if (needed < digits) {
+      needed = digits;
+   }
+   outbuf_reserve(ob, needed);
+   ob->index += needed;
+   char *out = &ob->buf[ob->index];
+   while (needed-- > 0) {
+      *--out = hex[val & 0xF];
+      val >>= 4;
+   }
+}
+
+void outbuf_dec(outbuf *ob, int val, int width)
+{
+   char tmp[12];
+   int len = 0;
+   unsigned int uval = (val < 0) ? -(unsigned int)val : (unsigned int)val;
+   do {
+      tmp[len++] = '0' + uval % 10;
+      uval /= 10;
+   } while (uval);
+   if (val < 0) {
+      tmp[len++] = '-';
+   }
+   outbuf_reserve(ob, MAX(len, width));
+   while (width-- > len) {
+      ob->buf[ob->index++] = ' ';
+   }
+   while (len > 0) {
+      ob->buf[ob->index++] = tmp[--len];
+   }
+}
+
+void outbuf_hex_bytes(outbuf *ob, const unsigned char *buf, int length)
+{
+   static const char hex[] = "0123456789ABCDEF";
+   if (length <= 0) {
+      return;
+   }
+   outbuf_reserve(ob, 6 * length);
+   for (int i = 0; i < length; i++) {
+      char *out = &ob->buf[ob->index];
+      if (i > 0) {
+         *out++ = ',';
+         *out++ = ' ';
+      }
+      *out++ = '0';
+      *out++ = 'x';
+      *out++ = hex[buf[i] >> 4];
+      *out++ = hex[buf[i] & 0xF];
+      ob->index = out - ob->buf;
+   }
+}
@@ -1,6 +1,8 @@
 #ifndef STRUTILS_H
 #define STRUTILS_H
 
+#include <stdio.h>
+
 typedef struct
 {
    char *buf;
@@ -15,4 +17,57 @@ void strbuf_sprintf(strbuf *sbuf, const char *format, ...);
 
 void strbuf_free(strbuf *sbuf);
 
+// buffered text output, either flushed to a file in large blocks or accumulated in memory
+typedef struct
+{
+   char *buf;
+   size_t allocated;
+   size_t index;
+   FILE *fp;     // destination file, NULL when buffering in memory
+   int owns_fp;  // close 'fp' in outbuf_close()
+   char *filename; // file written by outbuf_close() if contents changed, NULL otherwise
+} outbuf;
+
+// open file for writing through an output buffer
+// returns NULL if the file could not be opened
+outbuf *outbuf_fopen(const char *filename);
+
+// accumulate output in memory and only write 'filename' in outbuf_close() if its contents
+// differ, leaving the timestamp of unchanged files alone so 'make' doesn't rebuild from them
+outbuf *outbuf_fopen_update(const char *filename);
+
+// buffer output to an already open stream, which is left open by outbuf_close()
+outbuf *outbuf_wrap(FILE *fp);
+
+// accumulate output in memory, contents are in buf[0..index)
+// allocate: initial size, 0 for default
+outbuf *outbuf_mem(size_t allocate);
+
+// write buffered data to the file, no-op for memory buffers
+void outbuf_flush(outbuf *ob);
+
+// flush, close file if opened by outbuf_fopen() and free the buffer
+// returns 0 on success, -1 if outbuf_fopen_update() file could not be written
+int outbuf_close(outbuf *ob);
+
+// raw output
+void outbuf_write(outbuf *ob, const void *data, size_t len);
+void outbuf_puts(outbuf *ob, const char *str);
+void outbuf_putc(outbuf *ob, char c);
+
+// string left-justified in 'width' columns, like "%-*s"
+void outbuf_puts_pad(outbuf *ob, const char *str, int width);
+
+// formatted output, for lines that are not performance critical
+void outbuf_printf(outbuf *ob, const char *format, ...);
+
+// upper case hex of at least 'digits' digits without prefix, like "%0*X"
+void outbuf_hex(outbuf *ob, unsigned int val, int digits);
+
+// signed decimal right-justified in at least 'width' columns, like "%*d"
+void outbuf_dec(outbuf *ob, int val, int width);
+
+// comma separated bytes: "0x12, 0x34, ..."
+void outbuf_hex_bytes(outbuf *ob, const unsigned char *buf, int length);
+
 #endif /* STRUTILS_H */
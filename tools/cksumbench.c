@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libsm64.h"
+#include "../utils.h"
+
+#define CKSUMBENCH_VERSION "0.1"
+
+// original CIC-NUS-6102 checksum: transliterated boot code, byte-wise read per word
+static void calc_checksums_original(const unsigned char *buf, unsigned int cksum[])
+{
+   unsigned int t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+   unsigned int s0, s6;
+   unsigned int a0, a1, a2, a3, at;
+   unsigned int lo;
+   unsigned int v0, v1;
+   unsigned int ra;
+
+   // derived from the SM64 boot code
+   s6 = 0x3f;
+   a0 = 0x1000;     // 59c:   8d640008    lw a0,8(t3)
+   a1 = s6;         // 5a0:   02c02825    move  a1,s6
+   at = 0x5d588b65; // 5a4:   3c015d58    lui   at,0x5d58
+                    // 5a8:   34218b65    ori   at,at,0x8b65
+   lo = a1 * at;    // 5ac:   00a10019    multu a1,at    16 F8CA 4DDB
+
+   ra = 0x100000; // 5bc:  3c1f0010    lui   ra,0x10
+   v1 = 0;  // 5c0:  00001825    move  v1,zero
+   t0 = 0;  // 5c4:  00004025    move  t0,zero
+   t1 = a0; // 5c8:  00804825    move  t1,a0
+   t5 = 32; // 5cc:  240d0020    li t5,32
+   v0 = lo; // 5d0:  00001012    mflo  v0
+   v0++;    // 5d4:  24420001    addiu v0,v0,1
+   a3 = v0; // 5d8:  00403825    move  a3,v0
+   t2 = v0; // 5dc:  00405025    move  t2,v0
+   t3 = v0; // 5e0:  00405825    move  t3,v0
+   s0 = v0; // 5e4:  00408025    move  s0,v0
+   a2 = v0; // 5e8:  00403025    move  a2,v0
+   t4 = v0; // 5ec:  00406025    move  t4,v0
+
+   do {
+      v0 = read_u32_be(&buf[t1]);   // 5f0: 8d220000    lw v0,0(t1)
+      v1 = a3 + v0;   // 5f4: 00e21821    addu  v1,a3,v0
+      at = (v1 < a3); // 5f8: 0067082b    sltu  at,v1,a3
+      a1 = v1;        // 600: 00602825    move  a1,v1 branch delay slot
+      if (at) {       // 5fc: 10200002    beqz  at,0x608
+         t2++;        // 604: 254a0001    addiu t2,t2,1
+      }
+      v1 = v0 & 0x1F;  // 608: 3043001f    andi  v1,v0,0x1f
+      t7 = t5 - v1;    // 60c: 01a37823    subu  t7,t5,v1
+      t8 = v0 >> t7;   // 610: 01e2c006    srlv  t8,v0,t7
+      t6 = v0 << v1;   // 614: 00627004    sllv  t6,v0,v1
+      a0 = t6 | t8;    // 618: 01d82025    or a0,t6,t8
+      at = (a2 < v0);  // 61c: 00c2082b    sltu  at,a2,v0
+      a3 = a1;         // 620: 00a03825    move  a3,a1
+      t3 ^= v0;        // 624: 01625826    xor   t3,t3,v0
+      s0 += a0;        // 62c: 02048021    addu  s0,s0,a0 branch delay slot
+      if (at) {        // 628: 10200004    beqz  at,0x63c
+         t9 = a3 ^ v0; // 630: 00e2c826    xor   t9,a3,v0
+                       // 634: 10000002    b  0x640
+         a2 ^= t9;     // 638: 03263026    xor   a2,t9,a2 branch delay
+      } else {
+         a2 ^= a0;     // 63c: 00c43026    xor   a2,a2,a0
+      }
+      t0 += 4;         // 640: 25080004    addiu t0,t0,4
+      t7 = v0 ^ s0;    // 644: 00507826    xor   t7,v0,s0
+      t1 += 4;         // 648: 25290004    addiu t1,t1,4
+      t4 += t7;        // 650: 01ec6021    addu  t4,t7,t4 branch delay
+   } while (t0 != ra); // 64c: 151fffe8    bne   t0,ra,0x5f0
+   t6 = a3 ^ t2;       // 654: 00ea7026    xor   t6,a3,t2
+   a3 = t6 ^ t3;       // 658: 01cb3826    xor   a3,t6,t3
+   t8 = s0 ^ a2;       // 65c: 0206c026    xor   t8,s0,a2
+   s0 = t8 ^ t4;       // 660: 030c8026    xor   s0,t8,t4
+   
+   cksum[0] = a3;
+   cksum[1] = s0;
+}
+
+int main(int argc, char *argv[])
+{
+   static const struct {const char *name; cic_type cic;} cics[] = {
+      {"6101", CIC_6101},
+      {"6102", CIC_6102},
+      {"6103", CIC_6103},
+      {"6105", CIC_6105},
+      {"6106", CIC_6106},
+   };
+   unsigned char *rom;
+   unsigned int expected[2];
+   unsigned int cksum[2];
+   long rom_len;
+   int iterations = 100;
+   double start, elapsed;
+   double mb;
+
+   if (argc < 2) {
+      ERROR("Usage: cksumbench ROM [ITERATIONS]\n"
+            "\n"
+            "cksumbench v" CKSUMBENCH_VERSION ": N64 checksum throughput benchmark\n");
+      return EXIT_FAILURE;
+   }
+   if (argc > 2) {
+      iterations = strtol(argv[2], NULL, 0);
+      if (iterations < 1) {
+         iterations = 1;
+      }
+   }
+
+   rom_len = map_file(argv[1], &rom);
+   if (rom_len < 0x101000) {
+      ERROR("Error reading ROM file \"%s\"\n", argv[1]);
+      return EXIT_FAILURE;
+   }
+   mb = (double)iterations * 0x100000 / (1024 * 1024);
+
+   start = get_time();
+   for (int n = 0; n < iterations; n++) {
+      calc_checksums_original(rom, expected);
+   }
+   elapsed = get_time() - start;
+   printf("%-10s %08X %08X %8.1f MB/s\n", "original", expected[0], expected[1], mb / elapsed);
+
+   for (unsigned c = 0; c < DIM(cics); c++) {
+      start = get_time();
+      for (int n = 0; n < iterations; n++) {
+         n64_calc_checksums(rom, cics[c].cic, cksum);
+      }
+      elapsed = get_time() - start;
+      printf("CIC-%-6s %08X %08X %8.1f MB/s\n", cics[c].name, cksum[0], cksum[1], mb / elapsed);
+      if (cics[c].cic == CIC_6102 && (cksum[0] != expected[0] || cksum[1] != expected[1])) {
+         ERROR("Error: CIC-6102 checksum mismatch\n");
+      }
+   }
+
+   unmap_file(rom, rom_len);
+
+   return 0;
+}
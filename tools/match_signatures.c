@@ -1,10 +1,10 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <assert.h>
 
-#include <capstone/capstone.h>
-
+#include "../r4300.h"
 #include "../utils.h"
 
 typedef struct
@@ -1689,39 +1689,26 @@ static void add_offset(instruction *ins, uint32_t offset)
    ins->count++;
 }
 
-static void fill_table(instruction *ins_table, unsigned char *data, long size)
+// decode instruction id at ROM offset
+static unsigned int insn_id(const unsigned char *data, unsigned int offset)
 {
-#define BLOCK_SIZE 0x1000
-   csh handle;
-   cs_insn *insn;
-   unsigned s;
-   int i, b;
-   int icount;
+   r4300_insn insn;
+   r4300_decode(read_u32_be(&data[offset]), 0x80000000, &insn);
+   return insn.id;
+}
 
-   // open capstone disassembler
-   if (cs_open(CS_ARCH_MIPS, CS_MODE_MIPS64 + CS_MODE_BIG_ENDIAN, &handle) != CS_ERR_OK) {
-      ERROR("Error initializing disassembler\n");
-      exit(EXIT_FAILURE);
-   }
-   cs_option(handle, CS_OPT_SKIPDATA, CS_OPT_ON);
+static void fill_table(instruction *ins_table, unsigned char *data, long size)
+{
+   unsigned s, o;
 
    for (s = 0; s < DIM(sections); s++) {
       int length = sections[s].end - sections[s].start;
-      int blocks = (length + (BLOCK_SIZE-1)) / BLOCK_SIZE;
       assert(sections[s].end <= size);
-      INFO("Disassembling section %d len: %d (%X) [%d blocks of 0x%X]\n", s, length, length, blocks, BLOCK_SIZE);
-      for (b = 0; b < blocks; b++) {
-         int start = b*BLOCK_SIZE + sections[s].start;
-         int blen = MIN(sections[s].end - start, BLOCK_SIZE);
-         icount = cs_disasm(handle, &data[start], blen, 0x80000000, 0, &insn);
-         for (i = 0; i < icount; i++) {
-            unsigned int op = (unsigned int)insn[i].id;
-            add_offset(&ins_table[op], start+i*4);
-         }
-         cs_free(insn, icount);
+      INFO("Disassembling section %d len: %d (%X)\n", s, length, length);
+      for (o = sections[s].start; o + 4 <= sections[s].end; o += 4) {
+         add_offset(&ins_table[insn_id(data, o)], o);
       }
    }
-   cs_close(&handle);
 }
 
 static int in_list(unsigned int offset, instruction *insn)
@@ -1761,8 +1748,7 @@ static unsigned int rom_to_ram(unsigned int rom)
 
 static void find_matches(instruction *ins_table, unsigned char *srcdata)
 {
-   csh handle;
-   cs_insn *insn;
+   unsigned int *insn;
    unsigned int op;
    unsigned j, o;
    int i;
@@ -1770,26 +1756,23 @@ static void find_matches(instruction *ins_table, unsigned char *srcdata)
    unsigned best_matched;
    uint32_t best_offset;
 
-   // open capstone disassembler
-   if (cs_open(CS_ARCH_MIPS, CS_MODE_MIPS64 + CS_MODE_BIG_ENDIAN, &handle) != CS_ERR_OK) {
-      ERROR("Error initializing disassembler\n");
-      exit(EXIT_FAILURE);
-   }
-   cs_option(handle, CS_OPT_SKIPDATA, CS_OPT_ON);
-
    for (j = 0; j < DIM(proc_table); j++) {
       const procedure *p = &proc_table[j];
       ERROR("%2.1f%%: Looking for %s\n", (float)j * 100.0f / (float)DIM(proc_table), p->name);
       unsigned int p_length = p->rom_end - p->rom_start;
-      count = cs_disasm(handle, &srcdata[p->rom_start], p_length, 0x80000000, 0, &insn);
-      op = (unsigned int)insn[0].id;
+      count = p_length / 4;
+      insn = malloc(count * sizeof(*insn));
+      for (i = 0; i < count; i++) {
+         insn[i] = insn_id(srcdata, p->rom_start + i*4);
+      }
+      op = insn[0];
       best_offset = 0x0;
       best_matched = 0;
       for (o = 0; o < ins_table[op].count; o++) {
          unsigned newoffset = ins_table[op].offsets[o];
          unsigned matched = 0;
          for (i = 0; i < count; i++) {
-            if (!in_list(newoffset + i*4, &ins_table[insn[i].id])) {
+            if (!in_list(newoffset + i*4, &ins_table[insn[i]])) {
                matched = i*4;
                break;
             }
@@ -1809,9 +1792,8 @@ static void find_matches(instruction *ins_table, unsigned char *srcdata)
             printf("   (0x%X, \"%s\"), // best: %d/%d\n", rom_to_ram(best_offset), p->name, best_matched, p_length);
          }
       }
-      cs_free(insn, count);
+      free(insn);
    }
-   cs_close(&handle);
 }
 
 int main(int argc, char *argv[])
@@ -1836,11 +1818,11 @@ int main(int argc, char *argv[])
    newsize = read_file(newfile, &newdata);
 
    if (srcsize >= 8*MB) {
-      long size = MIPS_INS_ENDING * sizeof(*ins_table);
+      long size = R4300_INS_COUNT * sizeof(*ins_table);
       INFO("Allocating %d * %lu = %ld (%lX) bytes (%ld MB)\n",
-            MIPS_INS_ENDING, sizeof(*ins_table),
+            R4300_INS_COUNT, sizeof(*ins_table),
             size, size, size/1024/1024);
-      ins_table = calloc(MIPS_INS_ENDING, sizeof(*ins_table));
+      ins_table = calloc(R4300_INS_COUNT, sizeof(*ins_table));
       assert(ins_table);
       INFO("Filling instruction table...\n");
       fill_table(ins_table, newdata, newsize);
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../libmio0.h"
+#include "../utils.h"
+
+#define MIO0BENCH_VERSION "0.1"
+
+#define MAX_BLOCK_SIZE (8*1024*1024)
+#define STREAM_CHUNK_SIZE 4096
+
+typedef struct
+{
+   char *rom_filenames[16];
+   int rom_count;
+   int iterations;
+} arg_config;
+
+typedef struct
+{
+   unsigned int offset;
+   unsigned int dest_size;
+} mio0_block;
+
+// default configuration
+static const arg_config default_args =
+{
+   {NULL}, // ROM filenames
+   0,      // ROM count
+   20,     // iterations
+};
+
+static void print_usage(void)
+{
+   ERROR("Usage: mio0bench [-n ITERATIONS] [-v] ROM [ROM ...]\n"
+         "\n"
+         "mio0bench v" MIO0BENCH_VERSION ": MIO0 decoder throughput benchmark\n"
+         "\n"
+         "Optional arguments:\n"
+         " -n ITERATIONS number of times to decode every block (default: %d)\n"
+         " -v            verbose output\n"
+         "\n"
+         "File arguments:\n"
+         " ROM           ROM files to scan for MIO0 blocks (e.g. SM64, MK64)\n",
+         default_args.iterations);
+   exit(1);
+}
+
+// parse command line arguments
+static void parse_arguments(int argc, char *argv[], arg_config *config)
+{
+   int i;
+   if (argc < 2) {
+      print_usage();
+      exit(1);
+   }
+   for (i = 1; i < argc; i++) {
+      if (argv[i][0] == '-') {
+         switch (argv[i][1]) {
+            case 'n':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->iterations = strtol(argv[i], NULL, 0);
+               if (config->iterations < 1) {
+                  print_usage();
+               }
+               break;
+            case 'v':
+               g_verbosity = 1;
+               break;
+            default:
+               print_usage();
+               break;
+         }
+      } else {
+         if (config->rom_count >= (int)DIM(config->rom_filenames)) {
+            print_usage();
+         }
+         config->rom_filenames[config->rom_count++] = argv[i];
+      }
+   }
+   if (config->rom_count < 1) {
+      print_usage();
+   }
+}
+
+// original decoder: one control bit and one byte at a time
+static int mio0_decode_bytewise(const unsigned char *in, unsigned char *out)
+{
+   mio0_header_t head;
+   unsigned int bytes_written = 0;
+   int bit_idx = 0;
+   int comp_idx = 0;
+   int uncomp_idx = 0;
+
+   mio0_decode_header(in, &head);
+   while (bytes_written < head.dest_size) {
+      if (in[MIO0_HEADER_LENGTH + bit_idx / 8] & (1 << (7 - (bit_idx % 8)))) {
+         out[bytes_written++] = in[head.uncomp_offset + uncomp_idx++];
+      } else {
+         const unsigned char *vals = &in[head.comp_offset + comp_idx];
+         int length = ((vals[0] & 0xF0) >> 4) + 3;
+         int idx = ((vals[0] & 0x0F) << 8) + vals[1] + 1;
+         comp_idx += 2;
+         for (int i = 0; i < length; i++) {
+            out[bytes_written] = out[bytes_written - idx];
+            bytes_written++;
+         }
+      }
+      bit_idx++;
+   }
+   return bytes_written;
+}
+
+static int mio0_decode_stream(const unsigned char *in, unsigned int in_len, unsigned char *out)
+{
+   mio0_stream stream;
+   int total = 0;
+   int len;
+   mio0_stream_init(&stream);
+   mio0_stream_feed(&stream, in, in_len);
+   while ((len = mio0_stream_drain(&stream, &out[total], STREAM_CHUNK_SIZE)) > 0) {
+      total += len;
+   }
+   return len < 0 ? len : total;
+}
+
+// find all valid MIO0 blocks in ROM
+// blocks are validated with the bounded stream decoder so stray "MIO0" strings are skipped
+// returns number of blocks found
+static int find_blocks(const unsigned char *rom, long rom_len, unsigned char *tmp, mio0_block **blocks)
+{
+   int count = 0;
+   int alloc = 64;
+   *blocks = malloc(alloc * sizeof(**blocks));
+   for (long i = 0; i + MIO0_HEADER_LENGTH <= rom_len; i += 4) {
+      mio0_header_t head;
+      if (!mio0_decode_header(&rom[i], &head) || head.dest_size > MAX_BLOCK_SIZE) {
+         continue;
+      }
+      if (mio0_decode_stream(&rom[i], rom_len - i, tmp) != (int)head.dest_size) {
+         continue;
+      }
+      if (count >= alloc) {
+         alloc *= 2;
+         *blocks = realloc(*blocks, alloc * sizeof(**blocks));
+      }
+      (*blocks)[count].offset = i;
+      (*blocks)[count].dest_size = head.dest_size;
+      count++;
+   }
+   return count;
+}
+
+int main(int argc, char *argv[])
+{
+   static const char *names[] = {"bytewise", "mio0_decode", "stream"};
+   arg_config args;
+   unsigned char *expected;
+   unsigned char *out;
+
+   args = default_args;
+   parse_arguments(argc, argv, &args);
+
+   expected = malloc(MAX_BLOCK_SIZE);
+   out = malloc(MAX_BLOCK_SIZE + MIO0_WINDOW);
+
+   for (int r = 0; r < args.rom_count; r++) {
+      mio0_block *blocks;
+      unsigned char *rom;
+      long rom_len;
+      int block_count;
+      double total_bytes = 0;
+
+      rom_len = map_file(args.rom_filenames[r], &rom);
+      if (rom_len <= 0) {
+         ERROR("Error reading input file \"%s\"\n", args.rom_filenames[r]);
+         exit(1);
+      }
+      block_count = find_blocks(rom, rom_len, out, &blocks);
+      for (int b = 0; b < block_count; b++) {
+         total_bytes += blocks[b].dest_size;
+         INFO("%08X: %X bytes\n", blocks[b].offset, blocks[b].dest_size);
+      }
+      printf("%s: %d MIO0 blocks, %.1f KB decoded\n", args.rom_filenames[r], block_count, total_bytes / 1024);
+
+      for (int d = 0; d < (int)DIM(names); d++) {
+         double start = get_time();
+         double elapsed;
+         for (int n = 0; n < args.iterations; n++) {
+            for (int b = 0; b < block_count; b++) {
+               const unsigned char *in = &rom[blocks[b].offset];
+               switch (d) {
+                  case 0: mio0_decode_bytewise(in, out); break;
+                  case 1: mio0_decode(in, out, NULL); break;
+                  case 2: mio0_decode_stream(in, rom_len - blocks[b].offset, out); break;
+               }
+            }
+         }
+         elapsed = get_time() - start;
+         printf("  %-12s %8.1f MB/s\n", names[d], total_bytes * args.iterations / (1024 * 1024) / elapsed);
+      }
+
+      // verify all decoders agree
+      for (int b = 0; b < block_count; b++) {
+         const unsigned char *in = &rom[blocks[b].offset];
+         mio0_decode_bytewise(in, expected);
+         mio0_decode(in, out, NULL);
+         if (memcmp(expected, out, blocks[b].dest_size)) {
+            ERROR("Error: mio0_decode mismatch in block %08X\n", blocks[b].offset);
+         }
+      }
+
+      free(blocks);
+      unmap_file(rom, rom_len);
+   }
+
+   free(expected);
+   free(out);
+
+   return 0;
+}
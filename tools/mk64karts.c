@@ -126,7 +126,7 @@ int main(int argc, char *argv[])
    INFO("Arguments: \"%s\" \"%s\" %d\n", args.rom_filename, args.png_dir, args.wheel);
 
    INFO("Loading \"%s\"\n", args.rom_filename);
-   long rom_len = read_file(args.rom_filename, &rom);
+   long rom_len = map_file(args.rom_filename, &rom);
 
    if (rom_len <= 0) {
       ERROR("Error reading in \"%s\"\n", args.rom_filename);
@@ -144,6 +144,7 @@ int main(int argc, char *argv[])
    cur_count = 0;
    for (i = MIO0_FIRST; i <= MIO0_LAST; i += 4) {
       if (!memcmp(&rom[i], "MIO0", 4)) {
+         mio0_stream stream;
          unsigned int end;
          if (kart < 0 || i > palette_groups[kart]) {
             kart++;
@@ -153,7 +154,11 @@ int main(int argc, char *argv[])
          unsigned wheel_offset = palette_groups[kart] + 0x80*(4*cur_count + args.wheel);
          memcpy(&palette[0x180], &rom[wheel_offset], 0x80);
          INFO("Inflating MIO0 block 0x%X\n", i);
-         int len = mio0_decode(&rom[i], inflated, &end);
+         // bounded decode: corrupt blocks can't overrun 'inflated' or read past the ROM
+         mio0_stream_init(&stream);
+         mio0_stream_feed(&stream, &rom[i], rom_len - i);
+         int len = mio0_stream_drain(&stream, inflated, 2*WIDTH*HEIGHT);
+         end = mio0_stream_in_end(&stream);
          if (len != WIDTH*HEIGHT) {
             ERROR("%X: %X > %X\n", i, len, WIDTH*HEIGHT);
             exit(1);
@@ -172,6 +177,7 @@ int main(int argc, char *argv[])
 
    free(inflated);
    free(palette);
+   unmap_file(rom, rom_len);
 
    return 0;
 }
@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../n64graphics.h"
+#include "../utils.h"
+
+#define TEXBENCH_VERSION "0.1"
+
+typedef struct
+{
+   int width;
+   int height;
+   int iterations;
+   int png_iterations;
+   const char *png_file;
+} arg_config;
+
+typedef enum
+{
+   TEX_RGBA,
+   TEX_IA,
+   TEX_I,
+} tex_format;
+
+typedef struct
+{
+   const char *name;
+   tex_format format;
+   int depth;
+} tex_entry;
+
+typedef struct
+{
+   const char *spec;
+} png_entry;
+
+static const png_entry png_writers[] =
+{
+   {"stb"},
+   {"store"},
+   {"zlib:1:none"},
+   {"zlib:1"},
+   {"zlib:6:none"},
+   {"zlib:6:up"},
+   {"zlib:6:paeth"},
+   {"zlib:6"},
+   {"zlib:9"},
+};
+
+static const tex_entry formats[] =
+{
+   {"rgba16", TEX_RGBA, 16},
+   {"rgba32", TEX_RGBA, 32},
+   {"ia16",   TEX_IA,   16},
+   {"ia8",    TEX_IA,    8},
+   {"ia4",    TEX_IA,    4},
+   {"ia1",    TEX_IA,    1},
+   {"i8",     TEX_I,     8},
+   {"i4",     TEX_I,     4},
+};
+
+// default configuration
+static const arg_config default_args =
+{
+   255,    // width
+   257,    // height
+   200,    // iterations
+   20,     // png_iterations
+   "texbench.png", // png_file
+};
+
+static void print_usage(void)
+{
+   ERROR("Usage: texbench [-n ITERATIONS] [-p PNG_ITERATIONS] [-o PNG_FILE] [-s WIDTH HEIGHT] [-v]\n"
+         "\n"
+         "texbench v" TEXBENCH_VERSION ": n64graphics texture conversion kernel benchmark\n"
+         "\n"
+         "Optional arguments:\n"
+         " -n ITERATIONS number of times to convert the image (default: %d)\n"
+         " -o PNG_FILE   scratch file for the PNG writer benchmark (default: %s)\n"
+         " -p PNG_ITERATIONS number of times to write each PNG, 0 to skip (default: %d)\n"
+         " -s WIDTH HEIGHT image dimensions, odd sizes exercise kernel tails (default: %dx%d)\n"
+         " -v            verbose output\n",
+         default_args.iterations, default_args.png_file, default_args.png_iterations,
+         default_args.width, default_args.height);
+   exit(1);
+}
+
+// parse command line arguments
+static void parse_arguments(int argc, char *argv[], arg_config *config)
+{
+   for (int i = 1; i < argc; i++) {
+      if (argv[i][0] == '-') {
+         switch (argv[i][1]) {
+            case 'n':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->iterations = strtol(argv[i], NULL, 0);
+               if (config->iterations < 1) {
+                  print_usage();
+               }
+               break;
+            case 'o':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->png_file = argv[i];
+               break;
+            case 'p':
+               if (++i >= argc) {
+                  print_usage();
+               }
+               config->png_iterations = strtol(argv[i], NULL, 0);
+               if (config->png_iterations < 0) {
+                  print_usage();
+               }
+               break;
+            case 's':
+               if (i + 2 >= argc) {
+                  print_usage();
+               }
+               config->width = strtol(argv[++i], NULL, 0);
+               config->height = strtol(argv[++i], NULL, 0);
+               if (config->width < 1 || config->height < 1) {
+                  print_usage();
+               }
+               break;
+            case 'v':
+               g_verbosity = 1;
+               break;
+            default:
+               print_usage();
+               break;
+         }
+      } else {
+         print_usage();
+      }
+   }
+}
+
+static void fill_random(uint8_t *buf, int len, unsigned int seed)
+{
+   for (int i = 0; i < len; i++) {
+      seed = seed * 1103515245 + 12345;
+      buf[i] = seed >> 16;
+   }
+}
+
+// decode raw with selected kernels, returns intermediate image
+static void *decode(const tex_entry *fmt, const uint8_t *raw, int width, int height)
+{
+   switch (fmt->format) {
+      case TEX_RGBA: return raw2rgba(raw, width, height, fmt->depth);
+      case TEX_IA:   return raw2ia(raw, width, height, fmt->depth);
+      case TEX_I:    return raw2i(raw, width, height, fmt->depth);
+   }
+   return NULL;
+}
+
+static int encode(const tex_entry *fmt, uint8_t *raw, const void *img, int width, int height)
+{
+   switch (fmt->format) {
+      case TEX_RGBA: return rgba2raw(raw, img, width, height, fmt->depth);
+      case TEX_IA:   return ia2raw(raw, img, width, height, fmt->depth);
+      case TEX_I:    return i2raw(raw, img, width, height, fmt->depth);
+   }
+   return -1;
+}
+
+// smooth texture-like image so the PNG filters and deflate have something to work with
+static void fill_gradient(rgba *img, int width, int height)
+{
+   for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+         rgba *px = &img[y * width + x];
+         px->red = x * 255 / width;
+         px->green = y * 255 / height;
+         px->blue = ((x ^ y) & 0x8) ? 0xC0 : 0x40;
+         px->alpha = (x + y) & 0x20 ? 0xFF : 0x80;
+      }
+   }
+}
+
+// CI conversion with textures using 'colors' distinct RGBA16 values
+static int bench_ci(const arg_config *args, int colors, int ci_depth)
+{
+   int pixels = args->width * args->height;
+   uint16_t palette[256];
+   uint8_t *raw16 = malloc(pixels * sizeof(uint16_t));
+   uint8_t *ci = malloc(pixels);
+   unsigned int seed = 3;
+   palette_t pal;
+   double start, ci_time;
+   int errors = 0;
+
+   fill_random((uint8_t *)palette, sizeof(palette), 4);
+   for (int i = 0; i < pixels; i++) {
+      seed = seed * 1103515245 + 12345;
+      write_u16_be(&raw16[2 * i], palette[(seed >> 16) % colors]);
+   }
+
+   start = get_time();
+   for (int n = 0; n < args->iterations; n++) {
+      pal.max = 1 << ci_depth;
+      if (!raw2ci(ci, &pal, raw16, pixels * sizeof(uint16_t), ci_depth)) {
+         ERROR("Error: ci%d raw2ci failed\n", ci_depth);
+         errors++;
+         break;
+      }
+   }
+   ci_time = get_time() - start;
+   printf("  ci%d %3d colors  %8.1f Mpx/s\n", ci_depth, pal.used,
+          (double)pixels * args->iterations / 1e6 / ci_time);
+
+   free(raw16);
+   free(ci);
+   return errors;
+}
+
+static int bench_png(const arg_config *args)
+{
+   rgba *img = malloc(args->width * args->height * sizeof(*img));
+   int pixels = args->width * args->height;
+   int errors = 0;
+
+   fill_gradient(img, args->width, args->height);
+   printf("PNG writers, %d iterations\n", args->png_iterations);
+   for (unsigned w = 0; w < DIM(png_writers); w++) {
+      double start, png_time;
+      long size;
+      if (n64graphics_parse_png_writer(png_writers[w].spec) < 0) {
+         ERROR("Error: bad PNG writer \"%s\"\n", png_writers[w].spec);
+         errors++;
+         continue;
+      }
+      start = get_time();
+      for (int n = 0; n < args->png_iterations; n++) {
+         if (!rgba2png(args->png_file, img, args->width, args->height)) {
+            ERROR("Error: %s writing %s\n", png_writers[w].spec, args->png_file);
+            errors++;
+            break;
+         }
+      }
+      png_time = get_time() - start;
+      size = filesize(args->png_file);
+      printf("  %-13s %8.1f Mpx/s  %8ld bytes\n", png_writers[w].spec,
+             (double)pixels * args->png_iterations / 1e6 / png_time, size);
+   }
+   remove(args->png_file);
+   n64graphics_parse_png_writer("stb");
+   free(img);
+
+   return errors;
+}
+
+int main(int argc, char *argv[])
+{
+   arg_config args;
+   int pixels, raw_len, img_len;
+   uint8_t *raw, *img;
+   uint8_t *expected_raw, *out_raw;
+   int errors = 0;
+
+   args = default_args;
+   parse_arguments(argc, argv, &args);
+
+   pixels = args.width * args.height;
+   raw_len = pixels * 4 + 1;
+   img_len = pixels * sizeof(rgba);
+   raw = malloc(raw_len);
+   img = malloc(img_len);
+   expected_raw = malloc(raw_len);
+   out_raw = malloc(raw_len);
+   fill_random(raw, raw_len, 1);
+   fill_random(img, img_len, 2);
+
+   printf("%dx%d texture, %d iterations\n", args.width, args.height, args.iterations);
+   for (unsigned f = 0; f < DIM(formats); f++) {
+      const tex_entry *fmt = &formats[f];
+      int img_size = pixels * (fmt->format == TEX_RGBA ? sizeof(rgba) : sizeof(ia));
+      void *expected_img;
+
+      // scalar kernels are the reference output
+      n64graphics_select_kernels(N64GRAPHICS_KERNELS_SCALAR);
+      expected_img = decode(fmt, raw, args.width, args.height);
+      memset(expected_raw, 0xA5, raw_len);
+      encode(fmt, expected_raw, img, args.width, args.height);
+
+      for (int k = N64GRAPHICS_KERNELS_SCALAR; k <= N64GRAPHICS_KERNELS_AVX2; k++) {
+         double start, dec_time, enc_time;
+         void *out_img;
+         if (n64graphics_select_kernels(k) < 0) {
+            continue;
+         }
+
+         // verify bit-exact against scalar, including untouched bits of partial bytes
+         out_img = decode(fmt, raw, args.width, args.height);
+         if (memcmp(expected_img, out_img, img_size)) {
+            ERROR("Error: %s %s decode mismatch\n", fmt->name, n64graphics_kernels_name(k));
+            errors++;
+         }
+         free(out_img);
+         memset(out_raw, 0xA5, raw_len);
+         encode(fmt, out_raw, img, args.width, args.height);
+         if (memcmp(expected_raw, out_raw, raw_len)) {
+            ERROR("Error: %s %s encode mismatch\n", fmt->name, n64graphics_kernels_name(k));
+            errors++;
+         }
+
+         start = get_time();
+         for (int n = 0; n < args.iterations; n++) {
+            free(decode(fmt, raw, args.width, args.height));
+         }
+         dec_time = get_time() - start;
+         start = get_time();
+         for (int n = 0; n < args.iterations; n++) {
+            encode(fmt, out_raw, img, args.width, args.height);
+         }
+         enc_time = get_time() - start;
+         printf("  %-7s %-7s decode %8.1f Mpx/s  encode %8.1f Mpx/s\n", fmt->name, n64graphics_kernels_name(k),
+                (double)pixels * args.iterations / 1e6 / dec_time,
+                (double)pixels * args.iterations / 1e6 / enc_time);
+      }
+      free(expected_img);
+   }
+
+   printf("CI palette conversion\n");
+   errors += bench_ci(&args, 16, 4);
+   errors += bench_ci(&args, 256, 8);
+
+   if (args.png_iterations > 0) {
+      errors += bench_png(&args);
+   }
+
+   free(raw);
+   free(img);
+   free(expected_raw);
+   free(out_raw);
+
+   return errors ? 1 : 0;
+}
@@ -5,10 +5,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #if defined(_MSC_VER) || defined(__MINGW32__)
   #include <io.h>
   #include <sys/utime.h>
 #else
+  #include <sys/mman.h>
   #include <unistd.h>
   #include <utime.h>
 #endif
@@ -150,6 +152,54 @@ long read_file(const char *file_name, unsigned char **data)
    return bytes_read;
 }
 
+long map_file(const char *file_name, unsigned char **data)
+{
+#if defined(_MSC_VER) || defined(__MINGW32__)
+   // no mmap backend, fall back to reading whole file
+   return read_file(file_name, data);
+#else
+   struct stat st;
+   unsigned char *buf;
+   int fd;
+
+   fd = open(file_name, O_RDONLY);
+   if (fd < 0) {
+      return -1;
+   }
+   if (fstat(fd, &st) != 0) {
+      close(fd);
+      return -1;
+   }
+   if (st.st_size == 0) {
+      close(fd);
+      *data = NULL;
+      return 0;
+   }
+
+   // private writable mapping: pages are shared with page cache until modified
+   buf = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (buf == MAP_FAILED) {
+      return -2;
+   }
+
+   *data = buf;
+   return st.st_size;
+#endif
+}
+
+void unmap_file(unsigned char *data, long length)
+{
+#if defined(_MSC_VER) || defined(__MINGW32__)
+   (void)length;
+   free(data);
+#else
+   if (data != NULL && length > 0) {
+      munmap(data, length);
+   }
+#endif
+}
+
 long write_file(const char *file_name, unsigned char *data, long length)
 {
    FILE *out;
@@ -274,3 +324,36 @@ int str_ends_with(const char *str, const char *suffix)
    }
    return (0 == strncmp(str + len_str - len_suffix, suffix, len_suffix));
 }
+
+int cpu_count(void)
+{
+   long count;
+#if defined(_MSC_VER) || defined(__MINGW32__)
+   const char *env = getenv("NUMBER_OF_PROCESSORS");
+   count = env ? strtol(env, NULL, 0) : 1;
+#else
+   count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   return count > 0 ? (int)count : 1;
+}
+
+double get_time(void)
+{
+   struct timespec ts;
+#if defined(_MSC_VER)
+   timespec_get(&ts, TIME_UTC);
+#else
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+unsigned long long fnv1a(const void *data, size_t length, unsigned long long hash)
+{
+   const unsigned char *buf = data;
+   for (size_t i = 0; i < length; i++) {
+      hash ^= buf[i];
+      hash *= 0x100000001B3ULL;
+   }
+   return hash;
+}
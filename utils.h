@@ -110,6 +110,17 @@ void touch_file(const char *filename);
 // returns file size or negative on error
 long read_file(const char *file_name, unsigned char **data);
 
+// map entire contents of file into memory
+// data is writable, but changes are private to the process and never written back to the file
+// the file must not be truncated or overwritten while it is mapped
+// returns file size or negative on error
+long map_file(const char *file_name, unsigned char **data);
+
+// release data from map_file()
+// data: mapped data returned by map_file()
+// length: file size returned by map_file()
+void unmap_file(unsigned char *data, long length);
+
 // write buffer to file
 // returns number of bytes written out or -1 on failure
 long write_file(const char *file_name, unsigned char *data, long length);
@@ -150,4 +161,20 @@ void dir_list_free(dir_list *list);
 // returns 1 if 'str' ends with 'suffix'
 int str_ends_with(const char *str, const char *suffix);
 
+// determine number of online processors to size worker thread pools
+// returns processor count, at least 1
+int cpu_count(void);
+
+// get current time from a monotonic clock for measuring elapsed time
+// returns time in seconds
+double get_time(void);
+
+// 64-bit FNV-1a hash of a buffer, for detecting changed content
+// data: buffer to hash
+// length: length of buffer
+// hash: FNV1A_INIT, or previous result to continue hashing
+// returns updated hash
+#define FNV1A_INIT 0xCBF29CE484222325ULL
+unsigned long long fnv1a(const void *data, size_t length, unsigned long long hash);
+
 #endif // UTILS_H_
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -80,6 +81,47 @@ const char *config_section2str(section_type section)
    return "";
 }
 
+// strings parsed from YAML are packed into large blocks owned by the config
+#define STRING_BLOCK_SIZE 0x10000
+struct _string_block
+{
+   struct _string_block *next;
+   size_t used;
+   size_t size;
+   char data[];
+};
+
+static const char *config_strndup(rom_config *c, const char *str, size_t len)
+{
+   struct _string_block *block = c->strings;
+   char *dst;
+   if (len == 0) {
+      return "";
+   }
+   if (block == NULL || block->used + len + 1 > block->size) {
+      size_t size = MAX(STRING_BLOCK_SIZE, len + 1);
+      block = malloc(sizeof(*block) + size);
+      block->next = c->strings;
+      block->used = 0;
+      block->size = size;
+      c->strings = block;
+   }
+   dst = &block->data[block->used];
+   memcpy(dst, str, len);
+   dst[len] = '\0';
+   block->used += len + 1;
+   return dst;
+}
+
+// returns copy of scalar value owned by the config, or empty string if not a scalar
+static const char *get_scalar_str(rom_config *c, yaml_node_t *node)
+{
+   if (node->type == YAML_SCALAR_NODE) {
+      return config_strndup(c, (const char *)node->data.scalar.value, node->data.scalar.length);
+   }
+   return "";
+}
+
 int get_scalar_value(char *scalar, yaml_node_t *node)
 {
    if (node->type == YAML_SCALAR_NODE) {
@@ -108,6 +150,8 @@ void load_child_node(split_section *section, yaml_document_t *doc, yaml_node_t *
    yaml_node_t *next_node;
    texture *tex = &section->tex;
    size_t count = node->data.sequence.items.top - node->data.sequence.items.start;
+   section->label = "";
+   section->section_name = "";
    i_node = node->data.sequence.items.start;
    for (size_t i = 0; i < count; i++) {
       next_node = yaml_document_get_node(doc, i_node[i]);
@@ -149,13 +193,15 @@ void load_child_node(split_section *section, yaml_document_t *doc, yaml_node_t *
    }
 }
 
-void load_behavior(split_section *beh, yaml_document_t *doc, yaml_node_t *node)
+void load_behavior(rom_config *c, split_section *beh, yaml_document_t *doc, yaml_node_t *node)
 {
    char val[64];
    yaml_node_item_t *i_node;
    yaml_node_t *next_node;
    size_t count = node->data.sequence.items.top - node->data.sequence.items.start;
    i_node =  node->data.sequence.items.start;
+   beh->label = "";
+   beh->section_name = "";
    if (count != 2) {
       ERROR("Error: " SIZE_T_FORMAT " - expected 2 fields for behavior, got " SIZE_T_FORMAT "\n", node->start_mark.line, count);
       return;
@@ -163,10 +209,12 @@ void load_behavior(split_section *beh, yaml_document_t *doc, yaml_node_t *node)
    for (size_t i = 0; i < count; i++) {
       next_node = yaml_document_get_node(doc, i_node[i]);
       if (next_node && next_node->type == YAML_SCALAR_NODE) {
-         get_scalar_value(val, next_node);
          switch (i) {
-            case 0: beh->start = strtoul(val, NULL, 0); break;
-            case 1: strcpy(beh->label, val); break;
+            case 0:
+               get_scalar_value(val, next_node);
+               beh->start = strtoul(val, NULL, 0);
+               break;
+            case 1: beh->label = get_scalar_str(c, next_node); break;
          }
       } else {
          ERROR("Error: non-scalar value in behavior sequence\n");
@@ -174,7 +222,7 @@ void load_behavior(split_section *beh, yaml_document_t *doc, yaml_node_t *node)
    }
 }
 
-void load_section_data(split_section *section, yaml_document_t *doc, yaml_node_t *node)
+void load_section_data(rom_config *c, split_section *section, yaml_document_t *doc, yaml_node_t *node)
 {
    yaml_node_item_t *i_node;
    yaml_node_t *next_node;
@@ -207,7 +255,7 @@ void load_section_data(split_section *section, yaml_document_t *doc, yaml_node_t
          for (size_t i = 0; i < count; i++) {
             next_node = yaml_document_get_node(doc, i_node[i]);
             if (next_node->type == YAML_SEQUENCE_NODE) {
-               load_behavior(&beh[i], doc, next_node);
+               load_behavior(c, &beh[i], doc, next_node);
             } else {
                ERROR("Error: non-sequence behavior node\n");
                return;
@@ -223,12 +271,14 @@ void load_section_data(split_section *section, yaml_document_t *doc, yaml_node_t
    }
 }
 
-void load_section(split_section *section, yaml_document_t *doc, yaml_node_t *node)
+void load_section(rom_config *c, split_section *section, yaml_document_t *doc, yaml_node_t *node)
 {
    char val[MAX_SIZE];
    yaml_node_item_t *i_node;
    yaml_node_t *next_node;
    size_t count = node->data.sequence.items.top - node->data.sequence.items.start;
+   section->label = "";
+   section->section_name = "";
    if (count >= 3) {
       i_node = node->data.sequence.items.start;
       for (int i = 0; i < 3; i++) {
@@ -240,7 +290,7 @@ void load_section(split_section *section, yaml_document_t *doc, yaml_node_t *nod
                case 1: section->end = strtoul(val, NULL, 0); break;
                case 2: 
                   section->type = config_str2section(val); 
-                  strcpy(section->section_name, val);
+                  section->section_name = get_scalar_str(c, next_node);
                   break;
                case 3: section->vaddr = strtoul(val, NULL, 0); break;
             }
@@ -295,14 +345,12 @@ void load_section(split_section *section, yaml_document_t *doc, yaml_node_t *nod
                   section->subtype = strtoul(val, NULL, 0);
                   break;
                default:
-                  strcpy(section->label, val);
+                  section->label = get_scalar_str(c, next_node);
                   break;
             }
          } else {
             ERROR("Error: non-scalar value in section sequence\n");
          }
-      } else {
-         section->label[0] = '\0';
       }
       // extra parameters for some types
       if (count > 4) {
@@ -346,7 +394,7 @@ int load_sections_sequence(rom_config *c, yaml_document_t *doc, yaml_node_t *nod
          next_node = yaml_document_get_node(doc, i_node[i]);
          if (next_node) {
             if (next_node->type == YAML_SEQUENCE_NODE) {
-               load_section(&c->sections[c->section_count], doc, next_node);
+               load_section(c, &c->sections[c->section_count], doc, next_node);
                c->section_count++;
             } else if (next_node->type == YAML_MAPPING_NODE) {
                yaml_node_pair_t *i_node_p;
@@ -355,8 +403,8 @@ int load_sections_sequence(rom_config *c, yaml_document_t *doc, yaml_node_t *nod
                   key_node = yaml_document_get_node(doc, i_node_p->key);
                   val_node = yaml_document_get_node(doc, i_node_p->value);
                   if (key_node && val_node && key_node->type == YAML_SEQUENCE_NODE && val_node->type == YAML_SEQUENCE_NODE) {
-                     load_section(&c->sections[c->section_count], doc, key_node);
-                     load_section_data(&c->sections[c->section_count], doc, val_node);
+                     load_section(c, &c->sections[c->section_count], doc, key_node);
+                     load_section_data(c, &c->sections[c->section_count], doc, val_node);
                      c->section_count++;
                   } else {
                      ERROR("ERROR: sections sequence map is not sequence\n");
@@ -372,11 +420,12 @@ int load_sections_sequence(rom_config *c, yaml_document_t *doc, yaml_node_t *nod
    return ret_val;
 }
 
-void load_label(label *lab, yaml_document_t *doc, yaml_node_t *node)
+void load_label(rom_config *c, label *lab, yaml_document_t *doc, yaml_node_t *node)
 {
    char val[MAX_SIZE];
    yaml_node_item_t *i_node;
    yaml_node_t *next_node;
+   lab->name = "";
    if (node->type == YAML_SEQUENCE_NODE) {
       size_t count = node->data.sequence.items.top - node->data.sequence.items.start;
       if (count >= 2 && count <= 3) {
@@ -384,10 +433,12 @@ void load_label(label *lab, yaml_document_t *doc, yaml_node_t *node)
          for (size_t i = 0; i < count; i++) {
             next_node = yaml_document_get_node(doc, i_node[i]);
             if (next_node && next_node->type == YAML_SCALAR_NODE) {
-               get_scalar_value(val, next_node);
                switch (i) {
-                  case 0: lab->ram_addr = strtoul(val, NULL, 0); break;
-                  case 1: strcpy(lab->name, val); break;
+                  case 0:
+                     get_scalar_value(val, next_node);
+                     lab->ram_addr = strtoul(val, NULL, 0);
+                     break;
+                  case 1: lab->name = get_scalar_str(c, next_node); break;
                }
             } else {
                ERROR("Error: non-scalar value in label sequence\n");
@@ -411,7 +462,7 @@ int load_labels_sequence(rom_config *c, yaml_document_t *doc, yaml_node_t *node)
       for (size_t i = 0; i < count; i++) {
          next_node = yaml_document_get_node(doc, i_node[i]);
          if (next_node && next_node->type == YAML_SEQUENCE_NODE) {
-            load_label(&c->labels[c->label_count], doc, next_node);
+            load_label(c, &c->labels[c->label_count], doc, next_node);
             c->label_count++;
          } else {
             ERROR("Error: non-sequence in labels sequence\n");
@@ -468,6 +519,21 @@ void parse_yaml_root(yaml_document_t *doc, yaml_node_t *node, rom_config *c)
    }
 }
 
+static void config_init(rom_config *c)
+{
+   c->name[0] = '\0';
+   c->basename[0] = '\0';
+   c->sections = NULL;
+   c->section_count = 0;
+   c->labels = NULL;
+   c->label_count = 0;
+   c->start_index = NULL;
+   c->end_index = NULL;
+   c->strings = NULL;
+   c->mapped = NULL;
+   c->mapped_len = 0;
+}
+
 int config_parse_file(const char *filename, rom_config *c)
 {
    yaml_parser_t parser;
@@ -475,10 +541,7 @@ int config_parse_file(const char *filename, rom_config *c)
    yaml_node_t *root;
    FILE *file;
 
-   c->name[0] = '\0';
-   c->basename[0] = '\0';
-   c->section_count = 0;
-   c->label_count = 0;
+   config_init(c);
 
    // read config file, exit if problem
    file = fopen(filename, "rb");
@@ -506,10 +569,429 @@ int config_parse_file(const char *filename, rom_config *c)
    return 0;
 }
 
+int config_read_checksums(const char *filename, unsigned int *checksum1, unsigned int *checksum2)
+{
+   yaml_parser_t parser;
+   yaml_event_t event;
+   FILE *file;
+   unsigned int *dest = NULL;
+   int depth = 0;
+   int is_key = 1;
+   int found = 0;
+   int done = 0;
+
+   file = fopen(filename, "rb");
+   if (!file) {
+      ERROR("Error: cannot open %s\n", filename);
+      return -1;
+   }
+   yaml_parser_initialize(&parser);
+   yaml_parser_set_input_file(&parser, file);
+
+   // stream events of the root mapping until both keys are seen, skipping over nested values
+   while (!done && found < 2) {
+      if (!yaml_parser_parse(&parser, &event)) {
+         break;
+      }
+      switch (event.type) {
+         case YAML_MAPPING_START_EVENT:
+         case YAML_SEQUENCE_START_EVENT:
+            if (depth == 1) {
+               // nested value of a root key
+               dest = NULL;
+               is_key = 1;
+            }
+            depth++;
+            break;
+         case YAML_MAPPING_END_EVENT:
+         case YAML_SEQUENCE_END_EVENT:
+            depth--;
+            break;
+         case YAML_SCALAR_EVENT:
+         case YAML_ALIAS_EVENT:
+            if (depth == 1) {
+               if (is_key) {
+                  const char *key = (const char *)event.data.scalar.value;
+                  dest = NULL;
+                  if (event.type == YAML_SCALAR_EVENT) {
+                     if (!strcmp(key, "checksum1")) {
+                        dest = checksum1;
+                     } else if (!strcmp(key, "checksum2")) {
+                        dest = checksum2;
+                     }
+                  }
+               } else if (dest && event.type == YAML_SCALAR_EVENT) {
+                  *dest = strtoul((const char *)event.data.scalar.value, NULL, 0);
+                  found++;
+               }
+               is_key = !is_key;
+            }
+            break;
+         case YAML_STREAM_END_EVENT:
+            done = 1;
+            break;
+         default:
+            break;
+      }
+      yaml_event_delete(&event);
+   }
+
+   yaml_parser_delete(&parser);
+   fclose(file);
+
+   return (found == 2) ? 0 : -1;
+}
+
+// compiled config: header, section records (top-level sections followed by all children),
+// label records, then string table; all fields are native-endian 32-bit words
+#define CONFIG_BIN_MAGIC   "N64CFGB1"
+#define CONFIG_BIN_VERSION 2
+#define CONFIG_BIN_EXT     "bcfg"
+#define CONFIG_BIN_NONE    0xFFFFFFFF
+
+typedef struct
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t yaml_size;
+   uint64_t yaml_hash;      // fnv1a() of the YAML contents
+   uint32_t checksum1;
+   uint32_t checksum2;
+   uint32_t name;           // string offsets
+   uint32_t basename;
+   uint32_t section_count;  // top-level sections
+   uint32_t record_count;   // sections + children
+   uint32_t label_count;
+   uint32_t sections;       // file offsets
+   uint32_t labels;
+   uint32_t strings;
+   uint32_t strings_len;
+   uint32_t pad;
+} config_bin_header;
+
+typedef struct
+{
+   uint32_t label;          // string offsets
+   uint32_t section_name;
+   uint32_t start;
+   uint32_t end;
+   uint32_t vaddr;
+   uint32_t type;
+   uint32_t subtype;
+   uint32_t tex_offset;
+   uint32_t tex_palette;
+   uint32_t tex_width;
+   uint32_t tex_height;
+   uint32_t tex_depth;
+   uint32_t tex_format;
+   uint32_t children;       // record index or CONFIG_BIN_NONE
+   uint32_t child_count;
+} config_bin_section;
+
+typedef struct
+{
+   uint32_t ram_addr;
+   uint32_t name;           // string offset
+} config_bin_label;
+
+// string table being built for compiled config, duplicate strings are stored once
+typedef struct
+{
+   char *data;
+   uint32_t len;
+   uint32_t alloc;
+   uint32_t *hash_table;    // offset + 1, 0 when empty
+   uint32_t hash_size;
+   uint32_t hash_count;
+} config_bin_strings;
+
+static void bin_string_rehash(config_bin_strings *st, uint32_t size)
+{
+   uint32_t *old = st->hash_table;
+   uint32_t old_size = st->hash_size;
+   st->hash_table = calloc(size, sizeof(*st->hash_table));
+   st->hash_size = size;
+   for (uint32_t i = 0; i < old_size; i++) {
+      if (old[i]) {
+         const char *str = &st->data[old[i] - 1];
+         uint32_t h = fnv1a(str, strlen(str), FNV1A_INIT) & (size - 1);
+         while (st->hash_table[h]) {
+            h = (h + 1) & (size - 1);
+         }
+         st->hash_table[h] = old[i];
+      }
+   }
+   free(old);
+}
+
+static uint32_t bin_string_add(config_bin_strings *st, const char *str)
+{
+   size_t len = strlen(str);
+   uint32_t h;
+   if (st->hash_count * 2 >= st->hash_size) {
+      bin_string_rehash(st, st->hash_size ? st->hash_size * 2 : 1024);
+   }
+   h = fnv1a(str, len, FNV1A_INIT) & (st->hash_size - 1);
+   while (st->hash_table[h]) {
+      uint32_t offset = st->hash_table[h] - 1;
+      if (0 == strcmp(&st->data[offset], str)) {
+         return offset;
+      }
+      h = (h + 1) & (st->hash_size - 1);
+   }
+   if (st->len + len + 1 > st->alloc) {
+      st->alloc = MAX(st->alloc * 2, st->len + len + 1);
+      st->data = realloc(st->data, st->alloc);
+   }
+   memcpy(&st->data[st->len], str, len + 1);
+   st->hash_table[h] = st->len + 1;
+   st->hash_count++;
+   st->len += len + 1;
+   return st->len - len - 1;
+}
+
+static void bin_section_fill(config_bin_section *rec, const split_section *sec, config_bin_strings *st)
+{
+   rec->label = bin_string_add(st, sec->label);
+   rec->section_name = bin_string_add(st, sec->section_name);
+   rec->start = sec->start;
+   rec->end = sec->end;
+   rec->vaddr = sec->vaddr;
+   rec->type = sec->type;
+   rec->subtype = sec->subtype;
+   rec->tex_offset = sec->tex.offset;
+   rec->tex_palette = sec->tex.palette;
+   rec->tex_width = sec->tex.width;
+   rec->tex_height = sec->tex.height;
+   rec->tex_depth = sec->tex.depth;
+   rec->tex_format = sec->tex.format;
+   rec->children = CONFIG_BIN_NONE;
+   rec->child_count = sec->child_count;
+}
+
+// identify YAML contents by size and hash rather than timestamp, which misses
+// same-size edits made within the filesystem's mtime resolution
+static int config_yaml_hash(const char *filename, uint32_t *size, uint64_t *hash)
+{
+   unsigned char *data;
+   long len = map_file(filename, &data);
+   if (len < 0) {
+      return -1;
+   }
+   *size = (uint32_t)len;
+   *hash = fnv1a(data, len, FNV1A_INIT);
+   unmap_file(data, len);
+   return 0;
+}
+
+int config_compile(const char *filename, const rom_config *config)
+{
+   char bin_name[FILENAME_MAX];
+   char tmp_name[FILENAME_MAX + 8];
+   config_bin_header header;
+   config_bin_strings st = {0};
+   config_bin_section *recs;
+   config_bin_label *labs;
+   unsigned char *out;
+   uint32_t rec_count, rec_next, out_len;
+   long written;
+   int i;
+
+   memset(&header, 0, sizeof(header));
+   if (config_yaml_hash(filename, &header.yaml_size, &header.yaml_hash) < 0) {
+      return -1;
+   }
+
+   // children are stored after all top-level sections
+   rec_count = config->section_count;
+   for (i = 0; i < config->section_count; i++) {
+      if (config->sections[i].children) {
+         rec_count += config->sections[i].child_count;
+      }
+   }
+   recs = malloc(MAX(rec_count, 1) * sizeof(*recs));
+   rec_next = config->section_count;
+   for (i = 0; i < config->section_count; i++) {
+      const split_section *sec = &config->sections[i];
+      bin_section_fill(&recs[i], sec, &st);
+      if (sec->children) {
+         recs[i].children = rec_next;
+         for (int c = 0; c < sec->child_count; c++) {
+            bin_section_fill(&recs[rec_next++], &sec->children[c], &st);
+         }
+      }
+   }
+   labs = malloc(MAX(config->label_count, 1) * sizeof(*labs));
+   for (i = 0; i < config->label_count; i++) {
+      labs[i].ram_addr = config->labels[i].ram_addr;
+      labs[i].name = bin_string_add(&st, config->labels[i].name);
+   }
+
+   memcpy(header.magic, CONFIG_BIN_MAGIC, sizeof(header.magic));
+   header.version = CONFIG_BIN_VERSION;
+   header.checksum1 = config->checksum1;
+   header.checksum2 = config->checksum2;
+   header.name = bin_string_add(&st, config->name);
+   header.basename = bin_string_add(&st, config->basename);
+   header.section_count = config->section_count;
+   header.record_count = rec_count;
+   header.label_count = config->label_count;
+   header.sections = sizeof(header);
+   header.labels = header.sections + rec_count * sizeof(*recs);
+   header.strings = header.labels + config->label_count * sizeof(*labs);
+   header.strings_len = st.len;
+   out_len = header.strings + st.len;
+
+   out = malloc(out_len);
+   memcpy(out, &header, sizeof(header));
+   memcpy(&out[header.sections], recs, rec_count * sizeof(*recs));
+   memcpy(&out[header.labels], labs, config->label_count * sizeof(*labs));
+   memcpy(&out[header.strings], st.data, st.len);
+
+   // write to a temporary file and rename so a mapped copy is never overwritten in place
+   generate_filename(filename, bin_name, CONFIG_BIN_EXT);
+   sprintf(tmp_name, "%s.tmp", bin_name);
+   written = write_file(tmp_name, out, out_len);
+   if (written == (long)out_len) {
+      remove(bin_name);
+      if (rename(tmp_name, bin_name) != 0) {
+         written = -1;
+      }
+   }
+   if (written != (long)out_len) {
+      remove(tmp_name);
+   }
+
+   free(out);
+   free(labs);
+   free(recs);
+   free(st.data);
+   free(st.hash_table);
+
+   return (written == (long)out_len) ? 0 : -1;
+}
+
+// map compiled config for YAML 'filename' if it exists and is up to date
+// returns 0 on success, -1 if missing, stale or invalid
+static int config_load_bin(const char *filename, rom_config *c)
+{
+   char bin_name[FILENAME_MAX];
+   config_bin_header header;
+   const config_bin_section *recs;
+   const config_bin_label *labs;
+   const char *strings;
+   split_section *sections;
+   unsigned char *data;
+   uint32_t yaml_size;
+   uint64_t yaml_hash;
+   long len;
+   uint32_t i;
+
+   if (config_yaml_hash(filename, &yaml_size, &yaml_hash) < 0) {
+      return -1;
+   }
+   generate_filename(filename, bin_name, CONFIG_BIN_EXT);
+   if (filesize(bin_name) < (long)sizeof(header)) {
+      return -1;
+   }
+   len = map_file(bin_name, &data);
+   if (len < (long)sizeof(header)) {
+      if (len > 0) {
+         unmap_file(data, len);
+      }
+      return -1;
+   }
+   memcpy(&header, data, sizeof(header));
+
+   // reject stale and malformed files, it will be regenerated from the YAML
+   if (memcmp(header.magic, CONFIG_BIN_MAGIC, sizeof(header.magic)) || header.version != CONFIG_BIN_VERSION ||
+       header.yaml_size != yaml_size || header.yaml_hash != yaml_hash ||
+       header.section_count > header.record_count ||
+       header.sections != sizeof(header) ||
+       header.labels != header.sections + (uint64_t)header.record_count * sizeof(*recs) ||
+       header.strings != header.labels + (uint64_t)header.label_count * sizeof(*labs) ||
+       (uint64_t)header.strings + header.strings_len != (uint64_t)len ||
+       header.strings_len == 0 || data[len - 1] != '\0' ||
+       header.name >= header.strings_len || header.basename >= header.strings_len) {
+      INFO("Ignoring stale compiled config %s\n", bin_name);
+      unmap_file(data, len);
+      return -1;
+   }
+   recs = (const config_bin_section *)&data[header.sections];
+   labs = (const config_bin_label *)&data[header.labels];
+   strings = (const char *)&data[header.strings];
+
+   // sections and children are unpacked together, strings are used in place
+   sections = malloc(MAX(header.record_count, 1) * sizeof(*sections));
+   for (i = 0; i < header.record_count; i++) {
+      const config_bin_section *rec = &recs[i];
+      split_section *sec = &sections[i];
+      if (rec->label >= header.strings_len || rec->section_name >= header.strings_len ||
+          (rec->children != CONFIG_BIN_NONE &&
+           (rec->children < header.section_count || (uint64_t)rec->children + rec->child_count > header.record_count))) {
+         ERROR("Error: invalid section record %d in %s\n", i, bin_name);
+         free(sections);
+         unmap_file(data, len);
+         return -1;
+      }
+      sec->label = &strings[rec->label];
+      sec->section_name = &strings[rec->section_name];
+      sec->start = rec->start;
+      sec->end = rec->end;
+      sec->vaddr = rec->vaddr;
+      sec->type = rec->type;
+      sec->subtype = rec->subtype;
+      sec->tex.offset = rec->tex_offset;
+      sec->tex.palette = rec->tex_palette;
+      sec->tex.width = rec->tex_width;
+      sec->tex.height = rec->tex_height;
+      sec->tex.depth = rec->tex_depth;
+      sec->tex.format = rec->tex_format;
+      sec->children = (rec->children == CONFIG_BIN_NONE) ? NULL : &sections[rec->children];
+      sec->child_count = rec->child_count;
+   }
+   c->labels = malloc(MAX(header.label_count, 1) * sizeof(*c->labels));
+   for (i = 0; i < header.label_count; i++) {
+      if (labs[i].name >= header.strings_len) {
+         ERROR("Error: invalid label record %d in %s\n", i, bin_name);
+         free(c->labels);
+         c->labels = NULL;
+         free(sections);
+         unmap_file(data, len);
+         return -1;
+      }
+      c->labels[i].ram_addr = labs[i].ram_addr;
+      c->labels[i].name = &strings[labs[i].name];
+   }
+
+   snprintf(c->name, sizeof(c->name), "%s", &strings[header.name]);
+   snprintf(c->basename, sizeof(c->basename), "%s", &strings[header.basename]);
+   c->checksum1 = header.checksum1;
+   c->checksum2 = header.checksum2;
+   c->sections = sections;
+   c->section_count = header.section_count;
+   c->label_count = header.label_count;
+   c->mapped = data;
+   c->mapped_len = len;
+   INFO("Loaded compiled config %s\n", bin_name);
+
+   return 0;
+}
+
+int config_load(const char *filename, rom_config *c)
+{
+   config_init(c);
+   if (config_load_bin(filename, c) == 0) {
+      return 1;
+   }
+   return config_parse_file(filename, c);
+}
+
 void config_free(rom_config *config)
 {
    if (config) {
-      if (config->sections) {
+      // compiled configs keep children in the sections allocation
+      if (config->sections && !config->mapped) {
          for (int i = 0; i < config->section_count; i++) {
             switch (config->sections[i].type) {
                case TYPE_BLAST:
@@ -526,15 +1008,35 @@ void config_free(rom_config *config)
                   break;
             }
          }
+      }
+      if (config->sections) {
          free(config->sections);
          config->sections = NULL;
          config->section_count = 0;
       }
+      if (config->start_index) {
+         free(config->start_index);
+         config->start_index = NULL;
+      }
+      if (config->end_index) {
+         free(config->end_index);
+         config->end_index = NULL;
+      }
       if (config->labels) {
          free(config->labels);
          config->labels = NULL;
          config->label_count = 0;
       }
+      while (config->strings) {
+         struct _string_block *next = config->strings->next;
+         free(config->strings);
+         config->strings = next;
+      }
+      if (config->mapped) {
+         unmap_file(config->mapped, config->mapped_len);
+         config->mapped = NULL;
+         config->mapped_len = 0;
+      }
    }
 }
 
@@ -563,7 +1065,7 @@ void config_print(const rom_config *config)
                for (j = 0; j < s[i].child_count; j++) {
                   texture *tex = &textures[j].tex;
                   printf("  0x%06X %d", tex->offset, tex->format);
-                  switch (tex[j].format) {
+                  switch (tex->format) {
                      case TYPE_TEX_CI:
                      case TYPE_TEX_I:
                      case TYPE_TEX_IA:
@@ -600,12 +1102,87 @@ void config_print(const rom_config *config)
    }
 }
 
+static int section_index_cmp(const void *a, const void *b)
+{
+   const section_index *ia = a;
+   const section_index *ib = b;
+   if (ia->addr != ib->addr) {
+      return ia->addr < ib->addr ? -1 : 1;
+   }
+   return ia->section - ib->section;
+}
+
+// allocate array of section indices sorted by start or end address
+static section_index *sort_sections(const rom_config *config, int is_end)
+{
+   section_index *index = malloc(MAX(config->section_count, 1) * sizeof(*index));
+   for (int i = 0; i < config->section_count; i++) {
+      index[i].addr = is_end ? config->sections[i].end : config->sections[i].start;
+      index[i].section = i;
+   }
+   qsort(index, config->section_count, sizeof(*index), section_index_cmp);
+   return index;
+}
+
+void config_index_sections(rom_config *config)
+{
+   free(config->start_index);
+   free(config->end_index);
+   config->start_index = sort_sections(config, 0);
+   config->end_index = sort_sections(config, 1);
+}
+
+int config_find_section(const rom_config *config, unsigned int addr, int is_end)
+{
+   const section_index *index = is_end ? config->end_index : config->start_index;
+   int lo, hi;
+   if (index == NULL) {
+      // no index built, fall back to linear search
+      for (int i = 0; i < config->section_count; i++) {
+         if ((is_end ? config->sections[i].end : config->sections[i].start) == addr) {
+            return i;
+         }
+      }
+      return -1;
+   }
+   // lower bound: first entry with address >= addr, which has the lowest section number
+   lo = 0;
+   hi = config->section_count;
+   while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (index[mid].addr < addr) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+   if (lo < config->section_count && index[lo].addr == addr) {
+      return index[lo].section;
+   }
+   return -1;
+}
+
+static int label_name_cmp(const void *a, const void *b)
+{
+   const label *la = *(const label **)a;
+   const label *lb = *(const label **)b;
+   int cmp = strcmp(la->name, lb->name);
+   if (cmp == 0) {
+      cmp = la < lb ? -1 : (la > lb);
+   }
+   return cmp;
+}
+
 int config_validate(const rom_config *config, unsigned int max_len)
 {
    // error on overlapped and out-of-order sections
    int i, j, beh_i;
    unsigned int last_end = 0;
    int ret_val = 0;
+   section_index *sorted;
+   int *active;
+   int active_count;
+   const label **by_name;
    for (i = 0; i < config->section_count; i++) {
       split_section *isec = &config->sections[i];
       if (isec->start < last_end) {
@@ -625,32 +1202,78 @@ int config_validate(const rom_config *config, unsigned int max_len)
          isec->end=isec->start;
          //ret_val = -4;
       }
-      for (j = 0; j < i; j++) {
-         split_section *jsec = &config->sections[j];
-         if (!((isec->end <= jsec->start) || (isec->start >= jsec->end))) {
+      last_end = isec->end;
+   }
+   // sweep sections in start order, keeping the sections still open at each start ordered by end
+   sorted = sort_sections(config, 0);
+   active = malloc(MAX(config->section_count, 1) * sizeof(*active));
+   active_count = 0;
+   for (i = 0; i < config->section_count; i++) {
+      int sec_i = sorted[i].section;
+      split_section *isec = &config->sections[sec_i];
+      int lo, hi;
+      // retire sections that end at or before this start
+      for (j = 0; j < active_count && config->sections[active[j]].end <= isec->start; j++);
+      active_count -= j;
+      memmove(active, &active[j], active_count * sizeof(*active));
+      for (j = 0; j < active_count; j++) {
+         int sec_j = active[j];
+         split_section *jsec = &config->sections[sec_j];
+         if (isec->start < jsec->end && isec->end > jsec->start) {
+            // report later section in config order first
+            int a = MAX(sec_i, sec_j), b = MIN(sec_i, sec_j);
+            split_section *asec = &config->sections[a], *bsec = &config->sections[b];
             ERROR("Error: section %d \"%s\" (%X-%X) overlaps %d \"%s\" (%X-%X)\n",
-                  i, isec->label, isec->start, isec->end,
-                  j, jsec->label, jsec->start, jsec->end);
+                  a, asec->label, asec->start, asec->end,
+                  b, bsec->label, bsec->start, bsec->end);
             // ret_val = -1;
          }
       }
-      last_end = isec->end;
+      // insert in end order
+      lo = 0;
+      hi = active_count;
+      while (lo < hi) {
+         int mid = lo + (hi - lo) / 2;
+         if (config->sections[active[mid]].end <= isec->end) {
+            lo = mid + 1;
+         } else {
+            hi = mid;
+         }
+      }
+      memmove(&active[lo + 1], &active[lo], (active_count - lo) * sizeof(*active));
+      active[lo] = sec_i;
+      active_count++;
    }
-   // error duplicate label addresses
+   free(active);
+   free(sorted);
+   // error duplicate label addresses and names: sort, then report every pair within each run of equal keys
+   sorted = malloc(MAX(config->label_count, 1) * sizeof(*sorted));
    for (i = 0; i < config->label_count; i++) {
-      for (j = i+1; j < config->label_count; j++) {
-         if (config->labels[i].ram_addr == config->labels[j].ram_addr) {
-            ERROR("Error: duplicate label %X \"%s\" \"%s\"\n", config->labels[i].ram_addr,
-                  config->labels[i].name, config->labels[j].name);
-            ret_val = -5;
-         }
-         if (0 == strcmp(config->labels[i].name, config->labels[j].name)) {
-            ERROR("Error: duplicate label name \"%s\" %X %X\n", config->labels[i].name,
-                  config->labels[i].ram_addr, config->labels[j].ram_addr);
-            ret_val = -5;
-         }
+      sorted[i].addr = config->labels[i].ram_addr;
+      sorted[i].section = i;
+   }
+   qsort(sorted, config->label_count, sizeof(*sorted), section_index_cmp);
+   for (i = 0; i < config->label_count; i++) {
+      for (j = i + 1; j < config->label_count && sorted[j].addr == sorted[i].addr; j++) {
+         ERROR("Error: duplicate label %X \"%s\" \"%s\"\n", sorted[i].addr,
+               config->labels[sorted[i].section].name, config->labels[sorted[j].section].name);
+         ret_val = -5;
+      }
+   }
+   free(sorted);
+   by_name = malloc(MAX(config->label_count, 1) * sizeof(*by_name));
+   for (i = 0; i < config->label_count; i++) {
+      by_name[i] = &config->labels[i];
+   }
+   qsort(by_name, config->label_count, sizeof(*by_name), label_name_cmp);
+   for (i = 0; i < config->label_count; i++) {
+      for (j = i + 1; j < config->label_count && 0 == strcmp(by_name[i]->name, by_name[j]->name); j++) {
+         ERROR("Error: duplicate label name \"%s\" %X %X\n", by_name[i]->name,
+               by_name[i]->ram_addr, by_name[j]->ram_addr);
+         ret_val = -5;
       }
    }
+   free(by_name);
    // error duplicate behavior addresses
    beh_i = -1;
    for (i = 0; i < config->section_count; i++) {